@@ -40,6 +40,7 @@ class Edge;
 class Bounds;
 class Circle;
 class Grid;
+class Polygon;
 }
 
 /**
@@ -1059,6 +1060,13 @@ class Circle : public Location {
         /**
          * Determine if the given point is within this circle.
          * 
+         * Points outside the circle's bounding box are rejected
+         * immediately. The rest are tested with a squared planar
+         * distance scaled by the cosine of the center's latitude; only
+         * points within a thin band of the radius where that
+         * approximation could disagree with Location::distance are
+         * tested with the exact formula.
+         *
          * @param const Point& point The point to test.
          * @return bool True is the point is within the circle, False 
          *              otherwise.
@@ -1087,6 +1095,21 @@ class Circle : public Location {
          * @return std::ostream& Returns the given stream object.
          */
         friend std::ostream& operator<< (std::ostream& os, const Circle& circle);
+
+    private:
+        double lat_min_;                            ///< The southern edge of the bounding box in degrees.
+        double lat_max_;                            ///< The northern edge of the bounding box in degrees.
+        double lon_min_;                            ///< The western edge of the bounding box in degrees.
+        double lon_max_;                            ///< The eastern edge of the bounding box in degrees.
+        double cos_lat_;                            ///< The cosine of the center's latitude.
+        double radius2_;                            ///< The squared radius in radians.
+        double band_;                               ///< Half-width of the squared distance band where the planar test defers to Location::distance.
+
+        /**
+         * Precompute the bounding box and planar test constants from the
+         * center and radius.
+         */
+        void init_bounds();
 };
 
 /** @brief A boundary is a horizontally/vertically oriented rectangle based on a
@@ -1327,6 +1350,106 @@ class Grid : public Bounds, public Entity {
         friend std::ostream& operator<< (std::ostream& os, const Grid& grid);
 };
 
+/**
+ * @brief A Polygon is an area bounded by a closed outer ring of vertices that may contain holes, each described by a
+ * closed inner ring. Rings are implicitly closed; the last vertex connects back to the first.
+ *
+ * Point containment uses the even-odd rule over all rings. The ring segments are bucketed into horizontal (latitude)
+ * slabs so that a containment test only examines the segments that cross the point's slab.
+ */
+class Polygon : public Entity {
+    public:
+        using Ptr = std::shared_ptr<Polygon>;               ///< A shared pointer to a Polygon instance.
+        using CPtr = std::shared_ptr<const Polygon>;        ///< A shared pointer to a constant Polygon instance.
+        using Ring = std::vector<Point>;                    ///< A closed sequence of vertices.
+        using RingList = std::vector<Ring>;                 ///< The outer ring followed by any holes.
+
+        constexpr static uint32_t kSegmentsPerSlab = 4;     ///< The target average number of segments in each slab.
+        constexpr static uint32_t kMaxSlabs = 4096;         ///< The maximum number of slabs in a Polygon's index.
+
+        /**
+         * @brief Construct a Polygon from its rings.
+         *
+         * @param rings The outer ring followed by zero or more holes.
+         * @param uid The unique identifier of this polygon.
+         * @throws invalid_argument when there is no outer ring or a ring has fewer than three vertices.
+         */
+        Polygon(const RingList& rings, uint64_t uid);
+
+        /**
+         * @brief Get a string identifier for this entity type.
+         *
+         * @return std::string The type of this entity.
+         */
+        const std::string get_type(void) const;
+
+        /**
+         * @brief Predicate indicating whether any part of this polygon is within the provided bounds, i.e., a ring
+         * segment crosses or lies within the bounds, or the bounds is contained in the polygon.
+         *
+         * @param bounds Bounds object to test against.
+         * @return bool True if this polygon touches the bounds, otherwise False.
+         */
+        bool touches(const Bounds& bounds) const;
+
+        /**
+         * @brief Determine if the given point is within this polygon and not within one of its holes.
+         *
+         * Points exactly on a ring may be reported either way.
+         *
+         * @param point The point to test.
+         * @return bool True if the point is within the polygon, False otherwise.
+         */
+        bool contains(const Point& point) const;
+
+        /**
+         * @brief Return the unique identifier of this polygon.
+         */
+        uint64_t get_uid() const;
+
+        /**
+         * @brief Return the rings of this polygon; the outer ring is first.
+         */
+        const RingList& get_rings() const;
+
+        /**
+         * @brief Return the bounding box of this polygon.
+         */
+        const Bounds& get_bounds() const;
+
+        /**
+         * @brief Write a polygon to the provided stream in human-readable format.
+         *
+         * @param os the output stream.
+         * @param polygon the polygon to write to the stream.
+         * @return the stream after the polygon has been written.
+         */
+        friend std::ostream& operator<< (std::ostream& os, const Polygon& polygon);
+
+    private:
+        /**
+         * @brief A ring segment oriented from its southern to its northern vertex.
+         */
+        struct Segment {
+            double lat1;                                    ///< The latitude of the southern vertex.
+            double lon1;                                    ///< The longitude of the southern vertex.
+            double lat2;                                    ///< The latitude of the northern vertex.
+            double lon2;                                    ///< The longitude of the northern vertex.
+        };
+
+        uint64_t uid_;                                      ///< The unique identifier of this polygon.
+        RingList rings_;                                    ///< The outer ring followed by any holes.
+        Bounds bounds_;                                     ///< The bounding box of all rings.
+        double slab_height_;                                ///< The latitude span of each slab.
+        std::vector<uint32_t> slab_offsets_;                ///< Slab i holds segments [slab_offsets_[i], slab_offsets_[i+1]) of slab_segments_.
+        std::vector<Segment> slab_segments_;                ///< The segments of every slab stored contiguously.
+
+        /**
+         * @brief Return the index of the slab containing the latitude, clamped to the valid slabs.
+         */
+        uint32_t slab(double lat) const;
+};
+
 }
 
 #endif
@@ -0,0 +1,128 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
+ */
+
+#ifndef CVDP_DI_GRID_INDEX_HPP
+#define CVDP_DI_GRID_INDEX_HPP
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "entity.hpp"
+
+namespace geo {
+
+/**
+ * @brief A GridIndex answers point containment queries for a set of Grid squares that lie on a regular row/col lattice,
+ * e.g., the squares produced by Grid::build_grid. Every row has the same height; within a row every square has the
+ * same width (widths vary between rows since a fixed distance spans more longitude toward the poles). The row and
+ * column of a point are computed directly from its latitude and longitude and checked against a bitset of active
+ * squares, so a lookup is constant time regardless of the number of squares.
+ *
+ * Squares are inclusive of their boundaries (see Bounds::contains). Lattice lines are matched to within
+ * #kLatticeTolerance degrees (about a millimeter) to absorb the rounding in the generated and serialized coordinates.
+ */
+class GridIndex {
+    public:
+        using Ptr = std::shared_ptr<GridIndex>;                 ///< A shared pointer to a GridIndex instance.
+        using CPtr = std::shared_ptr<const GridIndex>;          ///< A shared pointer to a constant GridIndex instance.
+
+        constexpr static double kLatticeTolerance = 1e-8;       ///< Maximum deviation in degrees of a square's edges from its lattice lines.
+        constexpr static uint32_t kMaxSparsity = 64;            ///< Maximum number of lattice cells per active square before the lattice is considered too sparse to index.
+
+        /**
+         * @brief Build an index from a list of Grid squares.
+         *
+         * The squares' row and col values define their lattice positions. Squares may be missing (inactive) and may be
+         * given in any order.
+         *
+         * @param grids The Grid squares to index.
+         * @return A pointer to the index, or nullptr when the list is empty, the squares are not on a consistent
+         * lattice, or the lattice is too sparse; those squares should be handled by the Quad tree instead.
+         */
+        static CPtr build( const Grid::GridPtrVector& grids );
+
+        /**
+         * @brief Predicate indicating whether the point is within any of the indexed Grid squares.
+         *
+         * @param pt The point to check.
+         * @return true if an active square contains the point; false otherwise.
+         */
+        bool contains( const Point& pt ) const;
+
+        /**
+         * @brief Return the number of active squares in the index.
+         *
+         * @return the number of indexed squares.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief Return the number of rows in the lattice.
+         *
+         * @return the number of rows; the first row is the northernmost.
+         */
+        std::size_t rows() const;
+
+    private:
+        /**
+         * @brief The longitude lattice of a single row.
+         */
+        struct Row {
+            double west;                                        ///< The longitude of the western edge of column 0.
+            double width;                                       ///< The width of every square in this row in degrees.
+            uint32_t cols;                                      ///< The number of columns in this row.
+            std::size_t offset;                                 ///< The bit position of column 0 in the active bitset.
+        };
+
+        double north_;                                          ///< The latitude of the northern edge of row 0.
+        double height_;                                         ///< The height of every row in degrees.
+        std::vector<Row> rows_;                                 ///< The rows of the lattice; rows without squares have no columns.
+        std::vector<uint64_t> active_;                          ///< Bitset of active squares addressed by row offset plus column.
+        std::size_t size_;                                      ///< The number of active squares.
+
+        GridIndex();
+
+        /**
+         * @brief Return the inclusive range of lattice lines within tolerance of a coordinate.
+         *
+         * @param coord The coordinate offset from the lattice origin in degrees.
+         * @param step The lattice spacing in degrees.
+         * @param count The number of cells along this axis.
+         * @param first The first cell that may contain the coordinate.
+         * @param last The last cell that may contain the coordinate.
+         * @return true if the range overlaps [0,count); false otherwise.
+         */
+        static bool cell_range( double coord, double step, uint32_t count, uint32_t& first, uint32_t& last );
+
+        /**
+         * @brief Predicate indicating whether the square at the given bit position is active.
+         */
+        bool is_active( std::size_t bit ) const;
+};
+
+}
+
+#endif
@@ -67,6 +67,8 @@ class Quad : public geo::Bounds {
         constexpr static double MIN_DEGREES = 0.003;
 
         constexpr static int BUFFER_SIZE = 8 * 1024;                ///< The input stream buffer size when generating a Quad tree from a file.
+        constexpr static uint32_t SUBTREES_PER_THREAD = 4;          ///< The number of independent subtrees per thread to create before a bulk load is spread across threads.
+
         /**
          * @brief Attempt to insert an Entity into the Quad tree.
          *
@@ -76,6 +78,23 @@ class Quad : public geo::Bounds {
          */
         static bool insert( Ptr& quadptr, Entity::CPtr entity_ptr );
 
+        /**
+         * @brief Build the Quad tree from a complete list of Entities.
+         *
+         * The subdivision is computed top-down: a quad is split when more than MAX_ELEMENTS entities touch its fuzzy
+         * bounds (and it is large enough to split), and the entities are assigned to the children in a single pass.
+         * Once there are enough independent subtrees they are built concurrently. The leaves hold the same entities, in
+         * the same order, as inserting the list one at a time with #insert.
+         *
+         * If the quad already has entities or children the list is inserted incrementally instead.
+         *
+         * @param quadptr A pointer to the quad to load.
+         * @param entities The entities to load in insertion order.
+         * @param threads The maximum number of threads to use; 0 uses the hardware concurrency.
+         * @return True if at least one entity is inserted into the quad, False otherwise.
+         */
+        static bool bulk_load( Ptr& quadptr, const Entity::PtrList& entities, unsigned threads = 0 );
+
         /**
          * @brief Return the all the Bounds that contains the provided point.
          *
@@ -187,6 +206,22 @@ class Quad : public geo::Bounds {
          * @return True if the quad is split, False otherise.
          */
         bool split( );
+
+        /**
+         * @brief Split this Quad if it has too many entities and return the entities for each child; otherwise store the
+         * entities in this leaf.
+         *
+         * @param elements The entities that touch this Quad's fuzzy bounds; consumed.
+         * @return The entities touching each child's fuzzy bounds in child order; empty when this Quad remains a leaf.
+         */
+        std::vector<Entity::PtrList> distribute( Entity::PtrList& elements );
+
+        /**
+         * @brief Recursively split this Quad and distribute the entities to its descendants; used by #bulk_load.
+         *
+         * @param elements The entities that touch this Quad's fuzzy bounds; consumed.
+         */
+        void build( Entity::PtrList& elements );
 };
 
 #endif
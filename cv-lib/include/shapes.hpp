@@ -44,7 +44,7 @@ static const int POINT_LAT = 1;
 static const int POINT_LON = 2;
 
 /**
- * @brief Create and store a collection of shapes (Circles, Edges, and Grids) based on their definition in a file.
+ * @brief Create and store a collection of shapes (Circles, Edges, Grids, and Polygons) based on their definition in a file.
  *
  * A shaped file is a comma-delimited file having the following fields:
  * - type : the type of the shape, e.g., edge.
@@ -76,9 +76,14 @@ class CSVInputFactory
          * Shapes will be stored in the respective containers. If a shape specification is incorrect it will be skipped and a message 
          * will be displayed on std::cerr.
          *
+         * Lines are tokenized in place (the file is memory mapped where possible) and, for large files, parsed in
+         * parallel chunks; the shapes are then added in file order so the results match a sequential read. Messages
+         * for skipped specifications include the line number; the header is line 1.
+         *
+         * @param threads The maximum number of threads used to parse the file; 0 uses the hardware concurrency.
          * @throws invalid_argument when the file could not be opened or the file is malformed, e.g., no header.
          */
-        void make_shapes(void);
+        void make_shapes(unsigned threads = 1);
 
         /**
          * @brief Return an immutable vector of the Circle shapes specified in the file.
@@ -107,6 +112,15 @@ class CSVInputFactory
          */
         const std::vector<geo::Grid::CPtr>& get_grids(void) const;
 
+        /**
+         * @brief Return an immutable vector of the Polygon shapes specified in the file.
+         *
+         * Note: The file must contain Polygons and the make_shapes method must have been called.
+         *
+         * @return an immutable vector containing pointer to Polygon instances.
+         */
+        const std::vector<geo::Polygon::CPtr>& get_polygons(void) const;
+
 
         /**
          * @brief Attempt to construct a Circle instance from the parts provided
@@ -158,6 +172,24 @@ class CSVInputFactory
          */
         void make_grid(const StrVector& line_parts);
 
+        /**
+         * @brief Attempt to construct a Polygon instance from the parts provided
+         * and if successful add the Polygon to the container.
+         *
+         * Polygon Specification:
+         * - line_parts[0] : "polygon"
+         * - line_parts[1] : unique 64-bit integer identifier
+         * - line_parts[2] : A sequence of '|' split rings; the first ring is the outer boundary and the rest are holes.
+         *      - Ring: A sequence of colon-split points; each point is semi-colon split: <latitude>;<longitude>
+         *
+         * @param line_parts A vector of strings where each string is a part of a shape specification.
+         * @throws out_of_range exception for incorrect positions.
+         * @throws invalid_argument exception for rings with fewer than three points.
+         */
+        void make_polygon(const StrVector& line_parts);
+
+        struct EdgeRecord;                                      ///< The position independent fields of a parsed edge specification (see shapes.cpp).
+
     private:
 
         std::string file_path_;                                 ///< The file containing the shape specifications.
@@ -165,10 +197,20 @@ class CSVInputFactory
         std::vector<geo::Circle::CPtr> circles_;                ///< Vector of constant pointers to Circle instances.
         std::vector<geo::EdgeCPtr> edges_;                      ///< Vector of constant pointers to Edge instances.
         std::vector<geo::Grid::CPtr> grids_;                    ///< Vector of constant pointers to Grid instances.
+        std::vector<geo::Polygon::CPtr> polygons_;              ///< Vector of constant pointers to Polygon instances.
+
+        /**
+         * @brief Register the vertices of a parsed edge specification and add the Edge to the container.
+         *
+         * @param record The parsed edge; an error recorded while parsing is rethrown at the point it occurred.
+         * @throws invalid_way_exception for blacklisted way types.
+         * @throws out_of_range exception for incorrect positions.
+         */
+        void add_edge(const EdgeRecord& record);
 };
 
 /**
- * @brief Write a collection of shapes (Circles, Edges, and Grids) based on their data structure elements.
+ * @brief Write a collection of shapes (Circles, Edges, Grids, and Polygons) based on their data structure elements.
  *
  * See #CSVInputFactor for the file specification.
  */
@@ -206,6 +248,14 @@ class CSVOutputFactory
          */
         void add_grid(geo::Grid::CPtr grid_ptr);
 
+        /**
+         * @brief Add a Polygon shape (pointer) to the collection to eventually
+         * write.
+         *
+         * @param polygon_ptr a shared pointer to a constant Polygon instance.
+         */
+        void add_polygon(geo::Polygon::CPtr polygon_ptr);
+
         /**
          * @brief Write a shape file containing the shapes previously added to
          * the collections maintained by this instance of the #CSVOutputFactory.
@@ -239,11 +289,20 @@ class CSVOutputFactory
          */
         void write_grid(std::ofstream& os, geo::Grid::CPtr grid_ptr) const;
 
+        /**
+         * @brief Write a single Polygon to the specified stream.
+         *
+         * @param os The output stream to write the Polygon specification to.
+         * @param polygon_ptr A shared pointer to the Polygon instance.
+         */
+        void write_polygon(std::ofstream& os, geo::Polygon::CPtr polygon_ptr) const;
+
     private:
         std::string file_path_;                         ///< The file to write the shape specification to.
         std::vector<geo::Circle::CPtr> circles_;        ///< The collection of Circle instances to write.
         std::vector<geo::EdgeCPtr> edges_;              ///< The collection of Edge instances to write.
         std::vector<geo::Grid::CPtr> grids_;            ///< The collection of Grid instance to write.
+        std::vector<geo::Polygon::CPtr> polygons_;      ///< The collection of Polygon instances to write.
 };
 
 }  // end namespace Shapes
@@ -22,9 +22,11 @@
  * Contributors:
  *    Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems, UT Battelle.
  */
+#include <algorithm>
 #include <cmath>
 #include <iomanip>
 #include <sstream>
+#include <stdexcept>
 
 #include "entity.hpp"
 #include "utilities.hpp"
@@ -557,7 +559,9 @@ Circle::Circle(const Location& location, double radius) :
     south(project_position(location.lat, location.lon, 180.0, radius)),
     east(project_position(location.lat, location.lon, 90.0, radius)),
     west(project_position(location.lat, location.lon, 270.0, radius))
-    {}
+    {
+        init_bounds();
+    }
 
 Circle::Circle(double latitude, double longitude, double radius) :
     Location(latitude, longitude),
@@ -566,7 +570,9 @@ Circle::Circle(double latitude, double longitude, double radius) :
     south(project_position(latitude, longitude, 180.0, radius)),
     east(project_position(latitude, longitude, 90.0, radius)),
     west(project_position(latitude, longitude, 270.0, radius))
-    {}
+    {
+        init_bounds();
+    }
 
 Circle::Circle(double latitude, double longitude, uint64_t uid, double radius) :
     Location(latitude, longitude, uid),
@@ -575,7 +581,9 @@ Circle::Circle(double latitude, double longitude, uint64_t uid, double radius) :
     south(project_position(latitude, longitude, 180.0, radius)),
     east(project_position(latitude, longitude, 90.0, radius)),
     west(project_position(latitude, longitude, 270.0, radius))
-    {}
+    {
+        init_bounds();
+    }
 
 const std::string Circle::get_type(void) const {
     return "circle";
@@ -593,8 +601,51 @@ bool Circle::touches(const Bounds& bounds) const {
     return contains(bounds.nw) || contains(bounds.ne) || contains(bounds.se) || contains(bounds.sw);
 }
 
+void Circle::init_bounds() {
+    // Angular radius; Location::distance can only accept points whose latitude differs by at most this much.
+    double half_height = radius / kEarthRadiusM;
+    double half_width = std::numeric_limits<double>::infinity();
+
+    // The exact test scales longitude by the cosine of the mean latitude, which is never smaller than this.
+    double extreme_lat = std::abs(latr) + half_height;
+    if (extreme_lat < kPi / 2.0) {
+        half_width = half_height / std::cos(extreme_lat);
+    }
+
+    // Pad the box so rounding never rejects a point the exact test accepts.
+    double lat_pad = to_degrees(half_height) * (1.0 + 1e-9) + 1e-12;
+    double lon_pad = to_degrees(half_width) * (1.0 + 1e-9) + 1e-12;
+    lat_min_ = lat - lat_pad;
+    lat_max_ = lat + lat_pad;
+    lon_min_ = lon - lon_pad;
+    lon_max_ = lon + lon_pad;
+
+    cos_lat_ = std::cos(latr);
+    radius2_ = half_height * half_height;
+
+    // Within the box the mean latitude is within half_height/2 of the center, so replacing its cosine by cos_lat_ moves
+    // the squared distance by at most half_width^2 * half_height. The remaining terms cover rounding.
+    band_ = half_width * half_width * half_height + 4.0 * (half_height + half_width) * 1e-15 + radius2_ * 1e-12;
+}
+
 bool Circle::contains(const Point& point) const {
-   return distance(lat, lon, point.lat, point.lon) <= radius;
+    if (point.lat < lat_min_ || point.lat > lat_max_ || point.lon < lon_min_ || point.lon > lon_max_) {
+        return false;
+    }
+
+    double x = to_radians(point.lon - lon) * cos_lat_;
+    double y = to_radians(point.lat - lat);
+    double d2 = x * x + y * y;
+
+    if (d2 + band_ < radius2_) {
+        return true;
+    }
+
+    if (d2 - band_ > radius2_) {
+        return false;
+    }
+
+    return distance(lat, lon, point.lat, point.lon) <= radius;
 }
 
 bool Circle::operator==(const Circle& other) const {
@@ -772,6 +823,196 @@ Grid::GridPtrVector Grid::build_grid(const geo::Location& nw_point, double grid_
     return ret;
 }
 
+/**
+ * @brief Predicate indicating whether any part of the segment lies within the bounds (Liang-Barsky clipping with
+ * longitude as x and latitude as y).
+ */
+static bool segment_touches( const Bounds& bounds, double lat1, double lon1, double lat2, double lon2 )
+{
+    double t0 = 0.0;
+    double t1 = 1.0;
+    double p[4] = { lon1 - lon2, lon2 - lon1, lat1 - lat2, lat2 - lat1 };
+    double q[4] = { lon1 - bounds.sw.lon, bounds.ne.lon - lon1, lat1 - bounds.sw.lat, bounds.ne.lat - lat1 };
+
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            // parallel to this boundary; reject if outside it.
+            if (q[i] < 0.0) return false;
+        } else {
+            double r = q[i] / p[i];
+            if (p[i] < 0.0) {
+                if (r > t1) return false;
+                if (r > t0) t0 = r;
+            } else {
+                if (r < t0) return false;
+                if (r < t1) t1 = r;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Return the bounding box of the vertices of all rings.
+ */
+static Bounds ring_bounds( const Polygon::RingList& rings )
+{
+    double south = std::numeric_limits<double>::max();
+    double north = std::numeric_limits<double>::lowest();
+    double west = std::numeric_limits<double>::max();
+    double east = std::numeric_limits<double>::lowest();
+
+    for (auto& ring : rings) {
+        for (auto& p : ring) {
+            south = std::min(south, p.lat);
+            north = std::max(north, p.lat);
+            west = std::min(west, p.lon);
+            east = std::max(east, p.lon);
+        }
+    }
+
+    return Bounds{ Point{ south, west }, Point{ north, east } };
+}
+
+constexpr uint32_t Polygon::kMaxSlabs;
+
+Polygon::Polygon(const RingList& rings, uint64_t uid) :
+    uid_{uid},
+    rings_{rings},
+    bounds_{ ring_bounds(rings) },
+    slab_height_{0.0},
+    slab_offsets_{},
+    slab_segments_{}
+{
+    if (rings_.empty()) {
+        throw std::invalid_argument("polygon requires an outer ring.");
+    }
+
+    std::vector<Segment> segments;
+
+    for (auto& ring : rings_) {
+        // Rings are implicitly closed; drop an explicit closing vertex.
+        if (ring.size() > 1 && ring.front() == ring.back()) {
+            ring.pop_back();
+        }
+
+        if (ring.size() < 3) {
+            throw std::invalid_argument("polygon ring requires at least 3 vertices: " + std::to_string(ring.size()));
+        }
+
+        for (std::size_t i = 0; i < ring.size(); ++i) {
+            const Point& a = ring[i];
+            const Point& b = ring[(i + 1) % ring.size()];
+
+            if (a.lat <= b.lat) {
+                segments.push_back(Segment{ a.lat, a.lon, b.lat, b.lon });
+            } else {
+                segments.push_back(Segment{ b.lat, b.lon, a.lat, a.lon });
+            }
+        }
+    }
+
+    uint32_t slabs = static_cast<uint32_t>(segments.size() / kSegmentsPerSlab);
+    slabs = std::max<uint32_t>(1, std::min<uint32_t>(slabs, kMaxSlabs));
+    slab_height_ = (bounds_.ne.lat - bounds_.sw.lat) / slabs;
+    slab_offsets_.assign(slabs + 1, 0);
+
+    // Count, then fill; a segment is placed in every slab its latitude span overlaps.
+    for (auto& seg : segments) {
+        for (uint32_t i = slab(seg.lat1); i <= slab(seg.lat2); ++i) {
+            ++slab_offsets_[i + 1];
+        }
+    }
+
+    for (uint32_t i = 0; i < slabs; ++i) {
+        slab_offsets_[i + 1] += slab_offsets_[i];
+    }
+
+    slab_segments_.resize(slab_offsets_[slabs]);
+    std::vector<uint32_t> next{ slab_offsets_.begin(), slab_offsets_.end() - 1 };
+    for (auto& seg : segments) {
+        for (uint32_t i = slab(seg.lat1); i <= slab(seg.lat2); ++i) {
+            slab_segments_[next[i]++] = seg;
+        }
+    }
+}
+
+uint32_t Polygon::slab(double lat) const {
+    if (!(slab_height_ > 0.0)) return 0;
+
+    double s = std::floor((lat - bounds_.sw.lat) / slab_height_);
+    uint32_t last = static_cast<uint32_t>(slab_offsets_.size() - 2);
+
+    if (!(s > 0.0)) return 0;
+    if (s >= last) return last;
+    return static_cast<uint32_t>(s);
+}
+
+const std::string Polygon::get_type() const {
+    return "polygon";
+}
+
+bool Polygon::touches(const Bounds& bounds) const {
+    if (bounds.ne.lat < bounds_.sw.lat || bounds.sw.lat > bounds_.ne.lat || bounds.ne.lon < bounds_.sw.lon || bounds.sw.lon > bounds_.ne.lon) {
+        return false;
+    }
+
+    uint32_t first = slab(std::max(bounds.sw.lat, bounds_.sw.lat));
+    uint32_t last = slab(std::min(bounds.ne.lat, bounds_.ne.lat));
+
+    for (uint32_t i = first; i <= last; ++i) {
+        for (uint32_t j = slab_offsets_[i]; j < slab_offsets_[i + 1]; ++j) {
+            const Segment& seg = slab_segments_[j];
+            if (segment_touches(bounds, seg.lat1, seg.lon1, seg.lat2, seg.lon2)) {
+                return true;
+            }
+        }
+    }
+
+    // No ring crosses the bounds, so the bounds is either entirely inside or entirely outside.
+    return contains(bounds.sw);
+}
+
+bool Polygon::contains(const Point& point) const {
+    if (!bounds_.contains(point)) {
+        return false;
+    }
+
+    uint32_t i = slab(point.lat);
+    bool inside = false;
+
+    // Even-odd rule: count the segments crossed by a ray running east from the point.
+    for (uint32_t j = slab_offsets_[i]; j < slab_offsets_[i + 1]; ++j) {
+        const Segment& seg = slab_segments_[j];
+
+        if (seg.lat1 <= point.lat && point.lat < seg.lat2) {
+            double lon = seg.lon1 + (point.lat - seg.lat1) * (seg.lon2 - seg.lon1) / (seg.lat2 - seg.lat1);
+            if (point.lon < lon) {
+                inside = !inside;
+            }
+        }
+    }
+
+    return inside;
+}
+
+uint64_t Polygon::get_uid() const {
+    return uid_;
+}
+
+const Polygon::RingList& Polygon::get_rings() const {
+    return rings_;
+}
+
+const Bounds& Polygon::get_bounds() const {
+    return bounds_;
+}
+
+std::ostream& operator<< (std::ostream& os, const Polygon& polygon)
+{
+    return os << polygon.uid_ << "," << polygon.bounds_ << "," << polygon.rings_.size();
+}
+
 std::ostream& operator<< (std::ostream& os, const Grid& grid) 
 {
     return os << grid.sw << "," << grid.ne << "," << grid.row << "," << grid.col; 
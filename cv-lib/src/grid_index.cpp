@@ -0,0 +1,153 @@
+/**
+ * @file
+ * @author   Jason M. Carter (carterjm@ornl.gov)
+ * @author   Aaron E. Ferber (ferberae@ornl.gov)
+ * @date     April 2017
+ * @version  0.1
+ *
+ * @copyright Copyright 2017 US DOT - Joint Program Office
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License")
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors: Oak Ridge National Laboratory, Center for Trustworthy Embedded Systems,
+ * UT Battelle.
+ */
+
+#include <cmath>
+
+#include "grid_index.hpp"
+
+namespace geo {
+
+GridIndex::GridIndex() :
+    north_{ 0.0 },
+    height_{ 0.0 },
+    rows_{},
+    active_{},
+    size_{ 0 }
+{}
+
+GridIndex::CPtr GridIndex::build( const Grid::GridPtrVector& grids )
+{
+    if ( grids.empty() ) return nullptr;
+
+    // Rows or columns far beyond the number of squares would make the lattice mostly empty; leave those to the quad.
+    uint64_t max_cells = static_cast<uint64_t>( kMaxSparsity ) * grids.size();
+
+    const Grid& origin = *grids.front();
+    double height = origin.ne.lat - origin.sw.lat;
+    if ( !(height > 0.0) ) return nullptr;
+
+    uint32_t max_row = 0;
+    for ( auto& grid_ptr : grids ) {
+        if ( grid_ptr->row >= max_cells || grid_ptr->col >= max_cells ) return nullptr;
+        if ( grid_ptr->row > max_row ) max_row = grid_ptr->row;
+    }
+
+    Ptr index{ new GridIndex{} };
+    index->height_ = height;
+    index->north_ = origin.ne.lat + origin.row * height;
+    index->rows_.assign( max_row + 1, Row{ 0.0, 0.0, 0, 0 } );
+
+    // Fix each row's longitude lattice from the first square seen in that row and verify the rest against it.
+    for ( auto& grid_ptr : grids ) {
+        double north = index->north_ - grid_ptr->row * height;
+        if ( std::abs( grid_ptr->ne.lat - north ) > kLatticeTolerance ) return nullptr;
+        if ( std::abs( grid_ptr->sw.lat - ( north - height ) ) > kLatticeTolerance ) return nullptr;
+
+        double width = grid_ptr->ne.lon - grid_ptr->sw.lon;
+        if ( !(width > 0.0) ) return nullptr;
+
+        Row& row = index->rows_[ grid_ptr->row ];
+        if ( row.cols == 0 ) {
+            row.width = width;
+            row.west = grid_ptr->sw.lon - grid_ptr->col * width;
+        } else {
+            if ( std::abs( width - row.width ) > kLatticeTolerance ) return nullptr;
+            if ( std::abs( grid_ptr->sw.lon - ( row.west + grid_ptr->col * row.width ) ) > kLatticeTolerance ) return nullptr;
+        }
+
+        if ( grid_ptr->col + 1 > row.cols ) row.cols = grid_ptr->col + 1;
+    }
+
+    uint64_t total = 0;
+    for ( auto& row : index->rows_ ) {
+        row.offset = total;
+        total += row.cols;
+    }
+
+    if ( total > max_cells ) return nullptr;
+
+    index->active_.assign( ( total + 63 ) / 64, 0 );
+    for ( auto& grid_ptr : grids ) {
+        std::size_t bit = index->rows_[ grid_ptr->row ].offset + grid_ptr->col;
+        uint64_t mask = uint64_t{ 1 } << ( bit % 64 );
+
+        if ( !( index->active_[ bit / 64 ] & mask ) ) {
+            index->active_[ bit / 64 ] |= mask;
+            ++index->size_;
+        }
+    }
+
+    return index;
+}
+
+bool GridIndex::cell_range( double coord, double step, uint32_t count, uint32_t& first, uint32_t& last )
+{
+    // A coordinate on (or within tolerance of) a lattice line belongs to the cells on both sides of it.
+    double lo = std::floor( ( coord - kLatticeTolerance ) / step );
+    double hi = std::floor( ( coord + kLatticeTolerance ) / step );
+
+    // Written so that NaN coordinates fall through to false.
+    if ( !( hi >= 0.0 && lo < count ) ) return false;
+
+    first = lo < 0.0 ? 0 : static_cast<uint32_t>( lo );
+    last = hi >= count ? count - 1 : static_cast<uint32_t>( hi );
+    return true;
+}
+
+bool GridIndex::is_active( std::size_t bit ) const
+{
+    return ( active_[ bit / 64 ] >> ( bit % 64 ) ) & 1;
+}
+
+bool GridIndex::contains( const Point& pt ) const
+{
+    uint32_t first_row, last_row, first_col, last_col;
+
+    if ( !cell_range( north_ - pt.lat, height_, static_cast<uint32_t>( rows_.size() ), first_row, last_row ) ) return false;
+
+    for ( uint32_t r = first_row; r <= last_row; ++r ) {
+        const Row& row = rows_[r];
+
+        if ( row.cols == 0 || !cell_range( pt.lon - row.west, row.width, row.cols, first_col, last_col ) ) continue;
+
+        for ( uint32_t c = first_col; c <= last_col; ++c ) {
+            if ( is_active( row.offset + c ) ) return true;
+        }
+    }
+
+    return false;
+}
+
+std::size_t GridIndex::size() const
+{
+    return size_;
+}
+
+std::size_t GridIndex::rows() const
+{
+    return rows_.size();
+}
+
+}
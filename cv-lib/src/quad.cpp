@@ -23,6 +23,11 @@
  * UT Battelle.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
 #include "quad.hpp"
 #include "utilities.hpp"
 
@@ -156,6 +161,108 @@ bool Quad::insert( Quad::Ptr& quadptr, geo::Entity::CPtr entity_ptr )
     return true;
 }
 
+std::vector<geo::Entity::PtrList> Quad::distribute( Entity::PtrList& elements )
+{
+    std::vector<Entity::PtrList> child_elements;
+
+    if (elements.size() <= static_cast<std::size_t>(MAX_ELEMENTS) || !split()) {
+        element_list_ = std::move(elements);
+        return child_elements;
+    }
+
+    // One pass over the elements; order within each child matches the incremental redistribution.
+    child_elements.resize(children_.size());
+    for ( auto& e : elements ) {
+        for ( std::size_t i = 0; i < children_.size(); ++i ) {
+            if (e->touches(children_[i]->fuzzybounds_)) {
+                child_elements[i].push_back(e);
+            }
+        }
+    }
+
+    elements.clear();
+    elements.shrink_to_fit();
+    return child_elements;
+}
+
+void Quad::build( Entity::PtrList& elements )
+{
+    std::vector<Entity::PtrList> child_elements = distribute(elements);
+
+    for ( std::size_t i = 0; i < child_elements.size(); ++i ) {
+        children_[i]->build(child_elements[i]);
+    }
+}
+
+bool Quad::bulk_load( Quad::Ptr& quadptr, const Entity::PtrList& entities, unsigned threads )
+{
+    if (quadptr->haschildren() || !quadptr->element_list_.empty()) {
+        // The top-down build assumes an empty quad; merge into an existing tree one entity at a time.
+        bool inserted = false;
+        for ( auto& e : entities ) {
+            inserted = insert(quadptr, e) || inserted;
+        }
+        return inserted;
+    }
+
+    Entity::PtrList root_elements;
+    for ( auto& e : entities ) {
+        if (e->touches(quadptr->fuzzybounds_)) {
+            root_elements.push_back(e);
+        }
+    }
+
+    if (root_elements.empty()) return false;
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Split breadth-first until there are enough independent subtrees to keep the threads busy.
+    using Subtree = std::pair<Quad*, Entity::PtrList>;
+    std::vector<Subtree> subtrees;
+    subtrees.emplace_back(quadptr.get(), std::move(root_elements));
+
+    while (threads > 1 && !subtrees.empty() && subtrees.size() < threads * SUBTREES_PER_THREAD) {
+        std::vector<Subtree> next;
+
+        for ( auto& subtree : subtrees ) {
+            Quad* quad = subtree.first;
+            std::vector<Entity::PtrList> child_elements = quad->distribute(subtree.second);
+
+            for ( std::size_t i = 0; i < child_elements.size(); ++i ) {
+                next.emplace_back(quad->children_[i].get(), std::move(child_elements[i]));
+            }
+        }
+
+        subtrees = std::move(next);
+    }
+
+    // Subtrees share no quads, so they can be built concurrently; start with the largest.
+    std::sort(subtrees.begin(), subtrees.end(), [](const Subtree& a, const Subtree& b) { return a.second.size() > b.second.size(); });
+
+    std::atomic<std::size_t> next_subtree{ 0 };
+    auto worker = [&subtrees, &next_subtree]() {
+        for (std::size_t i = next_subtree++; i < subtrees.size(); i = next_subtree++) {
+            subtrees[i].first->build(subtrees[i].second);
+        }
+    };
+
+    std::size_t workers = std::min<std::size_t>(threads, subtrees.size());
+    std::vector<std::future<void>> futures;
+    for ( std::size_t i = 1; i < workers; ++i ) {
+        futures.push_back(std::async(std::launch::async, worker));
+    }
+
+    worker();
+
+    for ( auto& f : futures ) {
+        f.get();                                                // rethrows worker exceptions.
+    }
+
+    return true;
+}
+
 std::ostream& operator<<( std::ostream& os, const Quad& quad )
 {
     return os << "Quad: {" << quad.sw << ", " << quad.ne << "} element count: " << quad.element_list_.size() << " level: " << quad.level_ << " children: " << quad.children_.size() << " fuzzy: {" << quad.fuzzybounds_.sw << ", " << quad.fuzzybounds_.ne << ", " << quad.fuzzybounds_.height() << ", " << quad.fuzzybounds_.width() << "}";
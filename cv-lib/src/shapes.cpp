@@ -24,8 +24,20 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <future>
 #include <iomanip>
+#include <iterator>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "shapes.hpp"
 #include "osm.hpp"
@@ -35,175 +47,353 @@ namespace shapes {
 
 using StreamPtr = std::shared_ptr<std::istream>;
 
-CSVInputFactory::CSVInputFactory() :
-    file_path_{}
-{}
+namespace {
 
-CSVInputFactory::CSVInputFactory(const std::string& file_path) :
-    file_path_{file_path}
-{}
+const char* const kWhitespace = " \f\n\r\t\v";                // matches string_utilities::DELIMITERS.
+constexpr std::size_t kLinesPerThread = 4096;                   // minimum lines per thread before parsing is split.
 
 /**
- * Edge Specification:
- * - line_parts[0] : "edge"
- * - line_parts[1] : unique 64-bit integer identifier
- * - line_parts[2] : A sequence of colon-split points; each point is semi-colon split.
- *      - Point: <uid>;latitude;longitude
- * - line_parts[3] : A sequence of colon-split key=value attributes.
- *      - Attribute Pair: <attribute>=<value>
+ * @brief A view of a run of characters within a line; tokens refer to the file or string they came from and are never
+ * copied while parsing.
  */
-void CSVInputFactory::make_edge(const StrVector& line_parts) {
-    double lat;
-    double lon;
-    uint64_t edge_id;
-    uint64_t vertex_id;
-    osm::Highway way_type{osm::Highway::OTHER};                     // default value.
+struct Token {
+    const char* begin;
+    const char* end;
 
-    if ( line_parts.size() < 3) {
-        // lines cannot be defined without points.
-        throw std::invalid_argument("insufficient number of components to create an edge: " + std::to_string(line_parts.size()) + "; requires 3." );
+    std::size_t size() const { return static_cast<std::size_t>(end - begin); }
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string{ begin, end }; }
+
+    bool operator==( const char* s ) const {
+        std::size_t n = std::strlen(s);
+        return size() == n && std::memcmp(begin, s, n) == 0;
+    }
+};
+
+using TokenVector = std::vector<Token>;
+
+/**
+ * @brief Split a token at every occurrence of delim with the same results as string_utilities::split: an empty token
+ * yields no parts and a trailing delimiter does not yield an empty last part.
+ */
+void split( const Token& s, char delim, TokenVector& parts )
+{
+    parts.clear();
+    const char* p = s.begin;
+
+    while (p != s.end) {
+        const char* q = static_cast<const char*>(std::memchr(p, delim, s.end - p));
+        if (!q) {
+            parts.push_back(Token{ p, s.end });
+            break;
+        }
+        parts.push_back(Token{ p, q });
+        p = q + 1;
+    }
+}
+
+/**
+ * @brief Remove whitespace from both ends of the token.
+ */
+Token strip( Token t )
+{
+    while (t.begin != t.end && std::strchr(kWhitespace, *t.begin)) ++t.begin;
+    while (t.begin != t.end && std::strchr(kWhitespace, *(t.end - 1))) --t.end;
+    return t;
+}
+
+inline bool is_digit( char c ) { return c >= '0' && c <= '9'; }
+
+/**
+ * @brief Parse an unsigned integer with the semantics of std::stoull: leading whitespace is skipped and trailing
+ * characters are ignored.
+ *
+ * Plain decimal values of up to 19 digits are converted directly; anything else is handed to std::stoull.
+ *
+ * @throws invalid_argument when no conversion can be performed; out_of_range when the value is too large.
+ */
+uint64_t parse_uint64( const Token& t )
+{
+    const char* p = t.begin;
+    while (p != t.end && std::strchr(kWhitespace, *p)) ++p;
+
+    const char* digits = p;
+    uint64_t value = 0;
+    while (p != t.end && is_digit(*p) && p - digits < 19) {
+        value = value * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+
+    if (p != digits && (p == t.end || !is_digit(*p))) {
+        return value;
     }
 
-    // Attributes must be processed first (if they exist) so we pickup the specified way_type.
-    if ( line_parts.size() > 3 ) {
-        StrVector att_strings = string_utilities::split( line_parts[SHAPE_ATTS], ':' );
-        StrStrMap atts;
+    // signs, overflow, and malformed values.
+    return std::stoull(t.str());
+}
 
-        for (auto& att_string : att_strings) {
-            // att_string format: <attribute>=<value>
-            StrPair att = string_utilities::split_attribute( att_string );
+/**
+ * @brief Parse a double with the semantics of std::stod: leading whitespace is skipped and trailing characters are
+ * ignored.
+ *
+ * Decimal values with at most 19 significant digits whose mantissa is below 2^53 and whose decimal exponent is within
+ * [-22,22] are converted exactly with a single floating point multiply or divide (Clinger's fast path); the result is
+ * identical to strtod. Everything else (long mantissas, large exponents, hex, inf, nan, malformed values) is handed to
+ * std::stod.
+ *
+ * @throws invalid_argument when no conversion can be performed; out_of_range when the value is out of range.
+ */
+double parse_double( const Token& t )
+{
+    static const double kPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* p = t.begin;
+    while (p != t.end && std::strchr(kWhitespace, *p)) ++p;
+
+    bool negative = false;
+    if (p != t.end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
 
-            string_utilities::strip( att.first );
-            string_utilities::strip( att.second );
+    uint64_t mantissa = 0;
+    int significant = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    bool truncated = false;
+
+    for (; p != t.end && is_digit(*p); ++p) {
+        any_digits = true;
+        if (mantissa == 0 && *p == '0') continue;
+        if (significant < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            ++significant;
+        } else {
+            ++exponent;
+            truncated = true;
+        }
+    }
 
-            // a pair of empty strings could be returned. If any component is empty do nothing.
-            if ( !att.first.empty() && !att.second.empty() ) {
-                // a non-empty key and value.
-                atts[att.first] = att.second;
-            }	
+    if (p != t.end && *p == '.') {
+        for (++p; p != t.end && is_digit(*p); ++p) {
+            any_digits = true;
+            if (mantissa == 0 && *p == '0') {
+                --exponent;
+            } else if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                ++significant;
+                --exponent;
+            } else {
+                truncated = true;
+            }
         }
+    }
 
-        auto s1 = atts.find("way_type");
-        if ( s1 != atts.end() ) {
-            // map uses all lower case.
-            std::transform( s1->second.begin(), s1->second.end(), s1->second.begin(), ::tolower );
-            auto s2 = osm::highway_map.find( s1->second );
-            if ( s2 != osm::highway_map.end() ) {
-                way_type = s2->second;
-            } // othewise, use the default value.
+    if (any_digits && p != t.end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool negative_exponent = false;
+        if (q != t.end && (*q == '-' || *q == '+')) {
+            negative_exponent = *q == '-';
+            ++q;
         }
 
-        auto blacklist_item = osm::highway_blacklist.find( way_type );
-        if (blacklist_item != osm::highway_blacklist.end()) {
-            // this edge type should be ignored since it is in the blacklist.
-            throw osm::invalid_way_exception{ way_type };
+        // an exponent without digits is not part of the number.
+        if (q != t.end && is_digit(*q)) {
+            int e = 0;
+            for (; q != t.end && is_digit(*q); ++q) {
+                if (e < 100000) e = e * 10 + (*q - '0');
+            }
+            exponent += negative_exponent ? -e : e;
         }
     }
 
-    edge_id = std::stoull( line_parts[SHAPE_ID] );                  // throws.
-    StrVector geo_parts{ string_utilities::split( line_parts[SHAPE_GEOGRAPHY], ':' ) };
+    bool hex = p != t.end && (*p == 'x' || *p == 'X');
 
-    if ( geo_parts.size() != 2 ) {
-        // too many or too few points.
-        throw std::out_of_range{ "too many or too few points to define an edge: " + std::to_string(geo_parts.size()) };
+    if (any_digits && !hex && !truncated && mantissa <= (uint64_t{ 1 } << 53) && exponent >= -22 && exponent <= 22) {
+        double value = static_cast<double>(mantissa);
+        value = exponent < 0 ? value / kPow10[-exponent] : value * kPow10[exponent];
+        return negative ? -value : value;
     }
 
-    geo::Vertex::Ptr vp[2];
-    for ( int pi = 0; pi < 2; ++pi ) {
+    return std::stod(t.str());
+}
+
+/**
+ * @brief The result of parsing a single line of a shape file. Lines are parsed independently (possibly on several
+ * threads) and then applied to the factory in file order.
+ */
+struct ParsedLine {
+    enum Kind { SKIP, BAD_FIELDS, CIRCLE, EDGE, GRID, POLYGON };
+
+    std::size_t line;                                           ///< The line number in the file; the header is line 1.
+    std::size_t fields;                                         ///< The number of comma-split fields.
+    Kind kind;
+    geo::Circle::CPtr circle;
+    geo::Grid::CPtr grid;
+    geo::Polygon::CPtr polygon;
+    std::exception_ptr error;                                   ///< The error raised while parsing; nullptr on success.
+};
+
+}  // end anonymous namespace
 
-        // A point in a geometry is a triple: uid; latitude; longitude.
-        StrVector point_parts{ string_utilities::split( geo_parts[pi], ';' ) };
+/**
+ * @brief The context free part of an edge specification. Vertices are shared between edges, so the vertex lookup,
+ * position checks, and edge creation are applied in file order by add_edge.
+ */
+struct CSVInputFactory::EdgeRecord {
+    struct Vertex {
+        uint64_t uid;
+        double lat;
+        double lon;
+    };
+
+    bool has_attributes = false;                                ///< The way type must be checked against the blacklist.
+    osm::Highway way_type = osm::Highway::OTHER;
+    uint64_t uid = 0;
+    Vertex vertices[2];
+    int failed_vertex = -1;                                     ///< When error is set: -1 before the vertices, otherwise the vertex that failed.
+    std::exception_ptr error;                                   ///< The error raised while parsing; nullptr on success.
+};
+
+namespace {
 
-        if ( point_parts.size() != 3 ) {
-            // too many or too few components to define a point -- just skip this point.
-            throw std::out_of_range{ "too many or too few elements to define a point: " + std::to_string(point_parts.size()) };
+/**
+ * Edge Specification:
+ * - line_parts[0] : "edge"
+ * - line_parts[1] : unique 64-bit integer identifier
+ * - line_parts[2] : A sequence of colon-split points; each point is semi-colon split.
+ *      - Point: <uid>;latitude;longitude
+ * - line_parts[3] : A sequence of colon-split key=value attributes.
+ *      - Attribute Pair: <attribute>=<value>
+ *
+ * Parsing stops at the first error, which is recorded along with how far parsing got.
+ */
+void parse_edge( const TokenVector& line_parts, CSVInputFactory::EdgeRecord& record, TokenVector& parts, TokenVector& point_parts )
+{
+    try {
+        if ( line_parts.size() < 3) {
+            // lines cannot be defined without points.
+            throw std::invalid_argument("insufficient number of components to create an edge: " + std::to_string(line_parts.size()) + "; requires 3." );
         }
 
-        // convert all the parts so we can perform checks when the id was previously used.
-        vertex_id = std::stoull( point_parts[POINT_ID] );           // throws.
-        lat = std::stod( point_parts[POINT_LAT] );                  // throws.
-        lon = std::stod( point_parts[POINT_LON] );                  // throws.
+        // Attributes are processed first (if they exist) so we pickup the specified way_type.
+        if ( line_parts.size() > 3 ) {
+            record.has_attributes = true;
+            Token way_type_value{ nullptr, nullptr };
 
-        auto element_item = vertex_map_.find(vertex_id);
-        if (element_item != vertex_map_.end()) {
-            // point already defined; use existing instance.
-            // needed because we have an incident edge list.
-            vp[pi] = vertex_map_[vertex_id];
-            if ( !double_utilities::are_equal(vp[pi]->lat, lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vp[pi]->lon, lon, geo::kGPSEpsilon)) {
-                std::cerr << "WARNING: identical vertex id with different coordinates!\n";
-            }
+            split( line_parts[SHAPE_ATTS], ':', parts );
+            for (auto& att : parts) {
+                // att format: <attribute>=<value>; later duplicates replace earlier ones.
+                const char* eq = static_cast<const char*>(std::memchr(att.begin, '=', att.size()));
+                if (!eq) continue;
 
-        } else {
-            // point must be instantiated.
+                Token key = strip( Token{ att.begin, eq } );
+                Token value = strip( Token{ eq + 1, att.end } );
+
+                if ( !key.empty() && !value.empty() && key == "way_type" ) {
+                    way_type_value = value;
+                }
+            }
 
-            if (lat > 80.0 || lat < -84.0) {
-                throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
+            if ( way_type_value.begin ) {
+                // map uses all lower case.
+                std::string name = way_type_value.str();
+                std::transform( name.begin(), name.end(), name.begin(), ::tolower );
+                auto it = osm::highway_map.find( name );
+                if ( it != osm::highway_map.end() ) {
+                    record.way_type = it->second;
+                } // othewise, use the default value.
             }
+        }
+
+        record.uid = parse_uint64( line_parts[SHAPE_ID] );         // throws.
+        split( line_parts[SHAPE_GEOGRAPHY], ':', parts );
+
+        if ( parts.size() != 2 ) {
+            // too many or too few points.
+            throw std::out_of_range{ "too many or too few points to define an edge: " + std::to_string(parts.size()) };
+        }
+
+        for ( int pi = 0; pi < 2; ++pi ) {
+            record.failed_vertex = pi;
 
-            if (lon >= 180.0 || lon <= -180.0) {
-                throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
+            // A point in a geometry is a triple: uid; latitude; longitude.
+            split( parts[pi], ';', point_parts );
+
+            if ( point_parts.size() != 3 ) {
+                throw std::out_of_range{ "too many or too few elements to define a point: " + std::to_string(point_parts.size()) };
             }
 
-            vp[pi] = std::make_shared<geo::Vertex>(lat,lon,vertex_id);  
-            vertex_map_[vertex_id] = vp[pi];
-        }    
+            record.vertices[pi].uid = parse_uint64( point_parts[POINT_ID] );   // throws.
+            record.vertices[pi].lat = parse_double( point_parts[POINT_LAT] );  // throws.
+            record.vertices[pi].lon = parse_double( point_parts[POINT_LON] );  // throws.
+        }
+
+        record.failed_vertex = -1;
+
+    } catch (...) {
+        record.error = std::current_exception();
     }
+}
 
-    if ( vp[0]->uid == vp[1]->uid ) {
-        throw std::invalid_argument("The identifiers for the edges points are the same.");
+void check_position( double lat, double lon )
+{
+    if (lat > 80.0 || lat < -84.0) {
+        throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
     }
 
-    // NOTE: the way id does not uniquely identify the edge, as a way is sequence of edges.
-    geo::EdgePtr edge_ptr = std::make_shared<geo::Edge>( vp[0], vp[1], way_type, edge_id ); 
-    vp[0]->add_edge( edge_ptr );
-    vp[1]->add_edge( edge_ptr );
-    edges_.push_back(edge_ptr);
+    if (lon >= 180.0 || lon <= -180.0) {
+        throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
+    }
 }
 
-void CSVInputFactory::make_circle(const StrVector& line_parts) 
+geo::Circle::CPtr parse_circle( const TokenVector& line_parts, TokenVector& parts )
 {
     // Circle Specification:
     // - line_parts[0] : "circle"
     // - line_parts[1] : unique 64-bit integer identifier
     // - line_parts[2] : A sequence of colon-split elements that define the center.
     //      - Center: <lat>:<lon>:<radius in meters>
-    // 
+    //
     if ( line_parts.size() < 3) {
         // lines cannot be defined without points.
         throw std::invalid_argument("insufficient number of components to create a circle: " + std::to_string(line_parts.size()) + "; requires 3." );
     }
 
-    uint64_t uid = std::stoull(line_parts[1]);
+    uint64_t uid = parse_uint64(line_parts[1]);
 
-    StrVector parts = string_utilities::split(line_parts[2], ':');
+    split(line_parts[2], ':', parts);
 
     if ( parts.size() != 3 ) {
 	    throw std::out_of_range{ "wrong number of elements for circle center: " + std::to_string( parts.size() ) };
-    } 
+    }
 
-    double lat = std::stod(parts[0]);
+    double lat = parse_double(parts[0]);
 
     if (lat > 80.0 || lat < -84.0) {
         throw std::out_of_range{ "bad latitude: " + std::to_string(lat) };
     }
 
-    double lon = std::stod(parts[1]);
+    double lon = parse_double(parts[1]);
 
     if (lon >= 180.0 || lon <= -180.0) {
         throw std::out_of_range{"bad longitude: " + std::to_string(lon) };
     }
 
-    double radius = std::stod(parts[2]);
+    double radius = parse_double(parts[2]);
 
     if (radius < 0.0) {
         throw std::out_of_range{"bad radius: " + std::to_string(radius) };
     }
-    
-    circles_.push_back(std::make_shared<geo::Circle>(lat, lon, uid, radius));
-}
 
-void CSVInputFactory::make_grid(const StrVector& line_parts) {
+    return std::make_shared<const geo::Circle>(lat, lon, uid, radius);
+}
 
+geo::Grid::CPtr parse_grid( const TokenVector& line_parts, TokenVector& parts )
+{
     // Grid Specification:
     // - line_parts[0] : "grid"
     // - line_parts[1] : A '_' split row-column pair.
@@ -215,93 +405,359 @@ void CSVInputFactory::make_grid(const StrVector& line_parts) {
         throw std::invalid_argument("insufficient number of components to create a grid: " + std::to_string(line_parts.size()) + "; requires 3." );
     }
 
-    StrVector id_parts = string_utilities::split(line_parts[1], '_');
-    
-    if (id_parts.size() != 2) {
+    split(line_parts[1], '_', parts);
+
+    if (parts.size() != 2) {
         throw std::out_of_range("geo::Grid missing row/col fields.");
     }
 
-    // id_parts has 2 elements ROW and COL
+    // parts has 2 elements ROW and COL
 
-    uint32_t row = std::stoul(id_parts[0]);
-    uint32_t col = std::stoul(id_parts[1]);
+    uint32_t row = static_cast<uint32_t>(parse_uint64(parts[0]));
+    uint32_t col = static_cast<uint32_t>(parse_uint64(parts[1]));
 
-    StrVector geo_parts = string_utilities::split(line_parts[2], ':');
+    split(line_parts[2], ':', parts);
 
-    if (geo_parts.size() != 4) {
+    if (parts.size() != 4) {
         throw std::out_of_range("geo::Grid missing bounds data.");
     }
 
-    // geo_parts has 2 points each defined as a pair (lat, lon)
+    // parts has 2 points each defined as a pair (lat, lon)
+
+    double sw_lat = parse_double(parts[0]);
+    double sw_lon = parse_double(parts[1]);
+    double ne_lat = parse_double(parts[2]);
+    double ne_lon = parse_double(parts[3]);
 
-    double sw_lat = std::stod(geo_parts[0]);
-    double sw_lon = std::stod(geo_parts[1]);
-    double ne_lat = std::stod(geo_parts[2]);
-    double ne_lon = std::stod(geo_parts[3]);
+    check_position(sw_lat, sw_lon);
+    check_position(ne_lat, ne_lon);
+
+    geo::Bounds bounds(geo::Point(sw_lat, sw_lon), geo::Point(ne_lat, ne_lon));
+    return std::make_shared<const geo::Grid>(bounds, row, col);
+}
 
-    if (sw_lat > 80.0 || sw_lat < -84.0) {
-        throw std::out_of_range{ "bad latitude: " + std::to_string(sw_lat) };
+geo::Polygon::CPtr parse_polygon( const TokenVector& line_parts, TokenVector& rings, TokenVector& points, TokenVector& parts )
+{
+    // Polygon Specification:
+    // - line_parts[0] : "polygon"
+    // - line_parts[1] : unique 64-bit integer identifier
+    // - line_parts[2] : A sequence of '|' split rings; the first ring is the outer boundary and the rest are holes.
+    //      - Ring: A sequence of colon-split points; each point is semi-colon split: <latitude>;<longitude>
+    //
+    if ( line_parts.size() < 3) {
+        // polygons cannot be defined without points.
+        throw std::invalid_argument("insufficient number of components to create a polygon: " + std::to_string(line_parts.size()) + "; requires 3." );
+    }
+
+    uint64_t uid = parse_uint64(line_parts[SHAPE_ID]);                // throws.
+
+    geo::Polygon::RingList ring_list;
+    split(line_parts[SHAPE_GEOGRAPHY], '|', rings);
+
+    for (auto& ring_token : rings) {
+        geo::Polygon::Ring ring;
+        split(ring_token, ':', points);
+
+        for (auto& point_token : points) {
+            split(point_token, ';', parts);
+
+            if ( parts.size() != 2 ) {
+                throw std::out_of_range{ "too many or too few elements to define a polygon point: " + std::to_string(parts.size()) };
+            }
+
+            double lat = parse_double(parts[0]);                       // throws.
+            double lon = parse_double(parts[1]);                       // throws.
+            check_position(lat, lon);
+
+            ring.emplace_back(lat, lon);
+        }
+
+        ring_list.push_back(ring);
     }
 
-    if (sw_lon >= 180.0 || sw_lon <= -180.0) {
-        throw std::out_of_range{"bad longitude: " + std::to_string(sw_lon) };
+    return std::make_shared<const geo::Polygon>(ring_list, uid);     // throws.
+}
+
+/**
+ * @brief Convert a vector of strings to tokens that refer to those strings.
+ */
+TokenVector to_tokens( const StrVector& line_parts )
+{
+    TokenVector tokens;
+    for (auto& part : line_parts) {
+        tokens.push_back(Token{ part.data(), part.data() + part.size() });
     }
+    return tokens;
+}
+
+/**
+ * @brief The contents of a shape file; memory mapped when possible, otherwise read into memory.
+ */
+class ShapeFile {
+    public:
+        explicit ShapeFile( const std::string& file_path ) :
+            data_{ nullptr },
+            size_{ 0 },
+            mapped_{ false }
+        {
+#if defined(__unix__) || defined(__APPLE__)
+            int fd = ::open(file_path.c_str(), O_RDONLY);
+            if (fd >= 0) {
+                struct stat st;
+                if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+                    void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (addr != MAP_FAILED) {
+                        ::madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                        data_ = static_cast<const char*>(addr);
+                        size_ = static_cast<std::size_t>(st.st_size);
+                        mapped_ = true;
+                    }
+                }
+                ::close(fd);
+                if (mapped_) return;
+            }
+#endif
+            // Not mappable (or not a POSIX system); read the stream instead.
+            std::ifstream file(file_path, std::ios::binary);
+
+            if (file.fail()) {
+                throw std::invalid_argument("Could not open shape file: " + file_path);
+            }
+
+            buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+        }
+
+        ~ShapeFile() {
+#if defined(__unix__) || defined(__APPLE__)
+            if (mapped_) {
+                ::munmap(const_cast<char*>(data_), size_);
+            }
+#endif
+        }
+
+        ShapeFile( const ShapeFile& ) = delete;
+        ShapeFile& operator=( const ShapeFile& ) = delete;
+
+        const char* begin() const { return data_; }
+        const char* end() const { return data_ + size_; }
 
-    if (ne_lat > 80.0 || ne_lat < -84.0) {
-        throw std::out_of_range{ "bad latitude: " + std::to_string(ne_lat) };
+    private:
+        const char* data_;
+        std::size_t size_;
+        bool mapped_;
+        std::string buffer_;
+};
+
+}  // end anonymous namespace
+
+CSVInputFactory::CSVInputFactory() :
+    file_path_{}
+{}
+
+CSVInputFactory::CSVInputFactory(const std::string& file_path) :
+    file_path_{file_path}
+{}
+
+void CSVInputFactory::add_edge(const EdgeRecord& record) {
+    if ( record.has_attributes ) {
+        auto blacklist_item = osm::highway_blacklist.find( record.way_type );
+        if (blacklist_item != osm::highway_blacklist.end()) {
+            // this edge type should be ignored since it is in the blacklist.
+            throw osm::invalid_way_exception{ record.way_type };
+        }
     }
 
-    if (ne_lon >= 180.0 || ne_lon <= -180.0) {
-        throw std::out_of_range{"bad longitude: " + std::to_string(ne_lon) };
+    if ( record.error && record.failed_vertex < 0 ) {
+        std::rethrow_exception( record.error );
     }
-    
-    geo::Bounds bounds(geo::Point(sw_lat, sw_lon), geo::Point(ne_lat, ne_lon));
-    geo::Grid::CPtr grid_ptr = std::make_shared<const geo::Grid>(bounds, row, col);
-    grids_.push_back(grid_ptr); 
+
+    geo::Vertex::Ptr vp[2];
+    for ( int pi = 0; pi < 2; ++pi ) {
+        if ( record.error && record.failed_vertex == pi ) {
+            // the earlier vertex has been registered, as it would be had the line been parsed sequentially.
+            std::rethrow_exception( record.error );
+        }
+
+        const EdgeRecord::Vertex& v = record.vertices[pi];
+
+        auto element_item = vertex_map_.find(v.uid);
+        if (element_item != vertex_map_.end()) {
+            // point already defined; use existing instance.
+            // needed because we have an incident edge list.
+            vp[pi] = element_item->second;
+            if ( !double_utilities::are_equal(vp[pi]->lat, v.lat, geo::kGPSEpsilon) || !double_utilities::are_equal(vp[pi]->lon, v.lon, geo::kGPSEpsilon)) {
+                std::cerr << "WARNING: identical vertex id with different coordinates!\n";
+            }
+
+        } else {
+            // point must be instantiated.
+            check_position(v.lat, v.lon);
+
+            vp[pi] = std::make_shared<geo::Vertex>(v.lat, v.lon, v.uid);
+            vertex_map_[v.uid] = vp[pi];
+        }
+    }
+
+    if ( vp[0]->uid == vp[1]->uid ) {
+        throw std::invalid_argument("The identifiers for the edges points are the same.");
+    }
+
+    // NOTE: the way id does not uniquely identify the edge, as a way is sequence of edges.
+    geo::EdgePtr edge_ptr = std::make_shared<geo::Edge>( vp[0], vp[1], record.way_type, record.uid );
+    vp[0]->add_edge( edge_ptr );
+    vp[1]->add_edge( edge_ptr );
+    edges_.push_back(edge_ptr);
+}
+
+void CSVInputFactory::make_edge(const StrVector& line_parts) {
+    TokenVector parts, point_parts;
+    EdgeRecord record;
+
+    parse_edge( to_tokens(line_parts), record, parts, point_parts );
+    add_edge( record );
 }
 
-void CSVInputFactory::make_shapes() {
-    std::string line;
-    std::ifstream file(file_path_);
+void CSVInputFactory::make_circle(const StrVector& line_parts)
+{
+    TokenVector parts;
+    circles_.push_back( parse_circle( to_tokens(line_parts), parts ) );
+}
 
-    if (file.fail()) {
-        throw std::invalid_argument("Could not open shape file: " + file_path_);
+void CSVInputFactory::make_grid(const StrVector& line_parts) {
+    TokenVector parts;
+    grids_.push_back( parse_grid( to_tokens(line_parts), parts ) );
+}
+
+void CSVInputFactory::make_polygon(const StrVector& line_parts) {
+    TokenVector rings, points, parts;
+    polygons_.push_back( parse_polygon( to_tokens(line_parts), rings, points, parts ) );
+}
+
+void CSVInputFactory::make_shapes(unsigned threads) {
+    ShapeFile file(file_path_);                                         // throws.
+
+    // Split the file into lines the way std::getline does: a final newline does not start another line.
+    std::vector<Token> lines;
+    for (const char* p = file.begin(); p != file.end(); ) {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', file.end() - p));
+        if (!eol) {
+            lines.push_back(Token{ p, file.end() });
+            break;
+        }
+        lines.push_back(Token{ p, eol });
+        p = eol + 1;
     }
 
     // Get the header.
-    if (!std::getline(file, line)) {
+    if (lines.empty()) {
         throw std::invalid_argument("Shape file missing header!");
     }
 
-    while (std::getline(file, line)) {
-        try {
-            StrVector parts = string_utilities::split(line, ',');
+    std::size_t count = lines.size() - 1;
+    std::vector<ParsedLine> parsed(count);
+    std::vector<EdgeRecord> edges(count);
 
-            if (parts.size() < 3 || parts.size() > 4) {
-		// Shape file attribute order: type,id,geography[,attributes]
-		// First 3 are required; fourth is optional.
-                std::cerr << "Too few or too many elements in shape specification: " << parts.size() << " fields.\n";
+    // Parse the lines independently; nothing shared is modified here.
+    auto parse_range = [&lines, &parsed, &edges](std::size_t first, std::size_t last) {
+        TokenVector line_parts, parts, points, point_parts;
+
+        for (std::size_t i = first; i < last; ++i) {
+            ParsedLine& result = parsed[i];
+            result.line = i + 2;
+            result.kind = ParsedLine::SKIP;
+
+            split(lines[i + 1], ',', line_parts);
+            result.fields = line_parts.size();
+
+            if (line_parts.size() < 3 || line_parts.size() > 4) {
+                result.kind = ParsedLine::BAD_FIELDS;
                 continue;
             }
 
-            std::string type = parts[0];
+            try {
+                const Token& type = line_parts[SHAPE_TYPE];
+
+                if (type == "circle") {
+                    result.kind = ParsedLine::CIRCLE;
+                    result.circle = parse_circle(line_parts, parts);
+                } else if (type == "edge") {
+                    result.kind = ParsedLine::EDGE;
+                    parse_edge(line_parts, edges[i], parts, point_parts);
+                } else if (type == "grid") {
+                    result.kind = ParsedLine::GRID;
+                    result.grid = parse_grid(line_parts, parts);
+                } else if (type == "polygon") {
+                    result.kind = ParsedLine::POLYGON;
+                    result.polygon = parse_polygon(line_parts, parts, points, point_parts);
+                }
+            } catch (...) {
+                result.error = std::current_exception();
+            }
+        }
+    };
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::size_t chunks = std::max<std::size_t>(1, std::min<std::size_t>(threads, count / kLinesPerThread));
+    std::size_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<std::future<void>> futures;
 
-            if (type == "circle") {
-                make_circle(parts);
-            } else if (type == "edge") {
-                make_edge(parts);
-            } else if (type == "grid") {
-                make_grid(parts);
+    for (std::size_t c = 1; c < chunks; ++c) {
+        futures.push_back(std::async(std::launch::async, parse_range, c * chunk_size, std::min(count, (c + 1) * chunk_size)));
+    }
+
+    parse_range(0, std::min(count, chunk_size));
+
+    for (auto& f : futures) {
+        f.get();
+    }
+
+    // Apply the shapes in file order; vertices are shared between edges.
+    for (std::size_t i = 0; i < count; ++i) {
+        ParsedLine& result = parsed[i];
+
+        try {
+            switch (result.kind) {
+                case ParsedLine::BAD_FIELDS:
+                    // Shape file attribute order: type,id,geography[,attributes]
+                    // First 3 are required; fourth is optional.
+                    std::cerr << "Too few or too many elements in shape specification on line " << result.line << ": " << result.fields << " fields.\n";
+                    break;
+
+                case ParsedLine::EDGE:
+                    add_edge(edges[i]);
+                    break;
+
+                case ParsedLine::CIRCLE:
+                    if (result.error) std::rethrow_exception(result.error);
+                    circles_.push_back(result.circle);
+                    break;
+
+                case ParsedLine::GRID:
+                    if (result.error) std::rethrow_exception(result.error);
+                    grids_.push_back(result.grid);
+                    break;
+
+                case ParsedLine::POLYGON:
+                    if (result.error) std::rethrow_exception(result.error);
+                    polygons_.push_back(result.polygon);
+                    break;
+
+                default:
+                    break;
             }
 
         } catch (std::exception& e) {
             // Deal with all the exceptions thrown from the make_<shape> methods.
             // Skip the specification and move to the next shape.
             // TODO: need some logging here.
-            std::cerr << "Failed to make shape: " << e.what() << std::endl;
+            std::cerr << "Failed to make shape on line " << result.line << ": " << e.what() << std::endl;
         }
     }
-    file.close();
 }
 
 const std::vector<geo::Circle::CPtr>& CSVInputFactory::get_circles() const {
@@ -316,6 +772,10 @@ const std::vector<geo::Grid::CPtr>& CSVInputFactory::get_grids() const {
     return grids_;
 }
 
+const std::vector<geo::Polygon::CPtr>& CSVInputFactory::get_polygons() const {
+    return polygons_;
+}
+
 CSVOutputFactory::CSVOutputFactory(const std::string& file_path) :
     file_path_{file_path}
     {}
@@ -332,6 +792,10 @@ void CSVOutputFactory::add_grid(geo::Grid::CPtr grid_ptr) {
     grids_.push_back(grid_ptr);
 }
 
+void CSVOutputFactory::add_polygon(geo::Polygon::CPtr polygon_ptr) {
+    polygons_.push_back(polygon_ptr);
+}
+
 void CSVOutputFactory::write_circle(std::ofstream& os, geo::Circle::CPtr circle_ptr) const {
     os << std::setprecision(16) << "circle," << circle_ptr->uid << "," << circle_ptr->lat << ":" << circle_ptr->lon << ":" << circle_ptr->radius << std::endl;
 }
@@ -352,6 +816,25 @@ void CSVOutputFactory::write_grid(std::ofstream& os, geo::Grid::CPtr grid_ptr) c
     os << "grid," << std::setprecision(16) << grid_ptr->row << "_" << grid_ptr->col << "," << grid_ptr->sw.lat << ":" << grid_ptr->sw.lon << ":" << grid_ptr->ne.lat << ":" << grid_ptr->ne.lon << std::endl;
 }
 
+void CSVOutputFactory::write_polygon(std::ofstream& os, geo::Polygon::CPtr polygon_ptr) const {
+    os << std::setprecision(16) << "polygon," << polygon_ptr->get_uid() << ",";
+
+    char ring_sep = 0;
+    for (auto& ring : polygon_ptr->get_rings()) {
+        if (ring_sep) os << ring_sep;
+        ring_sep = '|';
+
+        char point_sep = 0;
+        for (auto& pt : ring) {
+            if (point_sep) os << point_sep;
+            point_sep = ':';
+            os << pt.lat << ";" << pt.lon;
+        }
+    }
+
+    os << std::endl;
+}
+
 void CSVOutputFactory::write_shapes() const {
     std::ofstream file(file_path_, std::ofstream::trunc);
 
@@ -373,6 +856,10 @@ void CSVOutputFactory::write_shapes() const {
         write_grid(file, grid_ptr);
     }
 
+    for (auto& polygon_ptr : polygons_) {
+        write_polygon(file, polygon_ptr);
+    }
+
     file.close();
 }
 
@@ -36,7 +36,12 @@
 #include "general-redaction/rapidjsonRedactor.hpp"
 #include "bsm.hpp"
 #include "velocityFilter.hpp"
+#include "corePrefilter.hpp"
+#include "downsampleFilter.hpp"
+#include "duplicateFilter.hpp"
+#include "tripFilter.hpp"
 #include "idRedactor.hpp"
+#include "payloadRegistry.hpp"
 #include "ppmLogger.hpp"
 
 /**
@@ -101,18 +106,24 @@ struct EnumHash {
  *
  * - The velocity is within a specified interval [min,max].
  * - The position is within a prescribed geofence; the geofence is defined using OSM road segments.
+ * - When down-sampling is enabled, no other BSM of the same vehicle was retained within the interval.
+ * - When duplicate suppression is enabled, the same BSM (id, secMark, msgCnt) was not seen within the window.
+ * - When trip trimming is enabled, the vehicle has left the head of its trip; BSMs may also be held to trim the tail.
  *
  * Currently the following BSM fields are redacted:
  *
  * - The id field is redacted for certain prescribed ids.
  *
+ * Other ODE message types registered by metadata.payloadType (see PayloadRegistry) are retained if their position is
+ * within the geofence; their configured members are redacted.
+ *
  */
 class BSMHandler {
     public:
         /**
          * records the status of the parsing including what caused parsing to stop, i.e., the point to be suppressed.
          */
-        enum ResultStatus : uint16_t { SUCCESS, SPEED, GEOPOSITION, PARSE, MISSING, OTHER };
+        enum ResultStatus : uint16_t { SUCCESS, SPEED, GEOPOSITION, PARSE, MISSING, OTHER, DOWNSAMPLED, DUPLICATE, TRIMMED, HELD, SHED };
 
         using Ptr = std::shared_ptr<BSMHandler>;                                ///< Handle to pass this handler around efficiently.
         using ResultStringMap = std::unordered_map<ResultStatus,std::string,EnumHash>;   ///< Quick retrieval of result string.
@@ -122,9 +133,14 @@ class BSMHandler {
         static constexpr uint32_t kVelocityFilterFlag = 0x1 << 0;
         static constexpr uint32_t kGeofenceFilterFlag = 0x1 << 1;
         static constexpr uint32_t kIdRedactFlag       = 0x1 << 2;
+        static constexpr uint32_t kDownsampleFlag     = 0x1 << 3;
         static constexpr uint32_t kSizeRedactFlag     = 0x1 << 4;
+        static constexpr uint32_t kDuplicateFlag      = 0x1 << 5;
+        static constexpr uint32_t kTripFlag           = 0x1 << 6;
         static constexpr uint32_t kGeneralRedactFlag  = 0x1 << 8;
 
+        static constexpr uint32_t kVehicleStateFlags = kDownsampleFlag | kDuplicateFlag | kTripFlag;   ///< The filters that keep per-vehicle state.
+
         // J2735 values indicating "unavailable" for various BSM fields
         static constexpr int J2735_SPEED_UNAVAILABLE = 8191;
         static constexpr int J2735_LATITUDE_UNAVAILABLE = 900000001;
@@ -143,6 +159,16 @@ class BSMHandler {
          */
         BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger);
 
+        /**
+         * @brief Construct a BSMHandler instance using a quad tree of the map data, a lattice index of the uniform grid
+         * squares in the geofence, and user-specified configuration.
+         *
+         * @param quad_ptr the quad tree containing the map elements not covered by the grid index.
+         * @param grid_index_ptr the index of the grid squares; may be nullptr.
+         * @param conf the user-specified configuration.
+         */
+        BSMHandler(Quad::Ptr quad_ptr, geo::GridIndex::CPtr grid_index_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger);
+
         /**
          * @brief Predicate indicating whether the BSM's position is within the prescribed geofence.
          *
@@ -163,6 +189,70 @@ class BSMHandler {
          *
          */
         bool process( const std::string& bsm_json );
+
+        /** 
+         * @brief Process a BSM presented as a JSON string that was received with the given Kafka timestamp.
+         *
+         * @param bsm_json a JSON string of the BSM.  
+         * @param timestamp the Kafka message timestamp in milliseconds; negative when not available.
+         * @return true if the SAX parser did not encounter any errors during parsing; false otherwise.
+         */
+        bool process( const std::string& bsm_json, int64_t timestamp );
+
+        /**
+         * @brief Process a BSM whose core fields were already checked by prefilter; see process above.
+         *
+         * The metadata and payload are validated as usual, so a malformed BSM has the same result as without the
+         * prefilter; only the velocity and geofence checks take the prefilter result instead of being redone.
+         *
+         * @param prefiltered the prefilter result of the BSM; 0 when it was not prefiltered.
+         */
+        bool process( const std::string& bsm_json, int64_t timestamp, uint8_t prefiltered );
+
+        /**
+         * @brief Find the vehicle id of a BSM without parsing it, e.g., to send a vehicle's BSMs to the same thread.
+         *
+         * This scans for the id member after coreData; it does not validate the JSON.
+         *
+         * @param json the ODE BSM JSON; it need not be null terminated.
+         * @param length the length of json.
+         * @param key set to the FNV-1a hash of the id when one is found.
+         * @return true if the id was found; false otherwise, e.g., for other message types.
+         */
+        static bool vehicle_key( const char* json, std::size_t length, uint64_t& key );
+
+        /**
+         * @brief Find the raw speed, lat, and long of a BSM without parsing it, e.g., to fill a batch for prefilter.
+         *
+         * This scans for the members after BasicSafetyMessage and coreData; it does not validate the JSON.
+         *
+         * @param json the ODE BSM JSON; it need not be null terminated.
+         * @param length the length of json.
+         * @param speed set to the raw speed in units of 0.02 m/s.
+         * @param lat set to the raw latitude in units of 1e-7 degrees.
+         * @param lon set to the raw longitude in units of 1e-7 degrees.
+         * @return true if all three integers were found; false otherwise, e.g., for other message types.
+         */
+        static bool core_fields( const char* json, std::size_t length, int32_t& speed, int32_t& lat, int32_t& lon );
+
+        /**
+         * @brief Check the raw core fields of a batch of BSMs against the activated velocity and geofence filters in one
+         * pass; see CorePrefilter::apply. The geofence check is against the bounds of the quad tree, so a BSM that
+         * passes may still be outside the geofence. It is skipped when a grid index is used.
+         *
+         * @param speed the raw speeds in units of 0.02 m/s.
+         * @param lat the raw latitudes in units of 1e-7 degrees.
+         * @param lon the raw longitudes in units of 1e-7 degrees.
+         * @param n the number of BSMs.
+         * @param result the n results: 0 for a BSM to process, otherwise the CorePrefilter bits of the failed checks.
+         * @return the number of BSMs to process.
+         */
+        std::size_t prefilter( const int32_t* speed, const int32_t* lat, const int32_t* lon, std::size_t n, uint8_t* result );
+
+        /**
+         * @brief Record that a message was shed without processing, e.g., by the LoadShedder; the result is SHED.
+         */
+        void shed();
     
         /**
          * @brief Handle general redaction of fields, the paths for which are specified in fieldsToRedact.txt
@@ -207,6 +297,27 @@ class BSMHandler {
          */
         std::string::size_type get_bsm_buffer_size(); 
 
+        /**
+         * @brief Return the previously held BSMs released by the most recent BSM processing, oldest first. These
+         * redacted JSON strings should be published before the processed BSM, whether or not it is retained.
+         *
+         * @return a constant reference to the released BSMs; empty unless trip tail trimming is enabled.
+         */
+        const std::vector<std::string>& get_released() const;
+
+        /**
+         * @brief Return the holds of the BSMs get_released returns, in the same order; each is nullptr unless a hold
+         * factory was set when the BSM was held.
+         */
+        const std::vector<TripFilter::Hold>& get_released_holds() const;
+
+        /**
+         * @brief Set what keeps account of the BSMs the trip filter holds, e.g., their consumed offsets uncommitted; it
+         * is called while processing a BSM that is held, so it must refer to that BSM's message. nullptr for nothing.
+         * The factory is not owned and is shared with copies of this handler, which should set their own.
+         */
+        void set_hold_factory( const TripFilter::HoldFactory* make_hold );
+
         template<uint32_t FLAG>
         bool is_active() {
             return activated_ & FLAG;
@@ -215,18 +326,31 @@ class BSMHandler {
         template<uint32_t FLAG>
         const uint32_t activate() {
             activated_ |= FLAG;
+            pipeline_ = select_pipeline( activated_ );
             return activated_;
         }
 
         template<uint32_t FLAG>
         const uint32_t deactivate() {
             activated_ &= ~FLAG;
+            pipeline_ = select_pipeline( activated_ );
             return activated_;
         }
 
+        /**
+         * @brief Give this handler, a copy, down-sampling, duplicate, and trip state of its own; only the state of the
+         * filters the configuration turned on is allocated now.
+         */
+        void own_state();
+
         const uint32_t get_activation_flag() const;
         const VelocityFilter& get_velocity_filter() const;
+        const PayloadRegistry& get_payload_registry() const;
+        const DownsampleFilter& get_downsample_filter() const;
+        const DuplicateFilter& get_duplicate_filter() const;
+        const TripFilter& get_trip_filter() const;
         const IdRedactor& get_id_redactor() const;
+        IdRedactor& get_id_redactor();
 
         /**
          * @brief for unit testing only.
@@ -236,21 +360,76 @@ class BSMHandler {
         RapidjsonRedactor& getRapidjsonRedactor();
         
     private:
+        using Pipeline = bool (BSMHandler::*)( const std::string&, int64_t );   ///< A process method specialized for a set of activation flags.
+
+        /**
+         * The per-message stages that are compiled into a pipeline only when activated; the stateful filters are
+         * dominated by their table lookups and are checked at run time.
+         */
+        static constexpr uint32_t kPipelineFlags = kVelocityFilterFlag | kGeofenceFilterFlag | kIdRedactFlag | kSizeRedactFlag | kGeneralRedactFlag;
+        static constexpr uint32_t kPipelineCount = 0x1 << 5;    ///< One pipeline for each combination of the pipeline flags.
+
+        /**
+         * @brief Return the pipeline index of a set of activation flags: the pipeline flags packed into bits 0 - 4.
+         */
+        static constexpr uint32_t pipeline_index( uint32_t activated ) {
+            return ( activated & 0x7 ) | ( ( activated & kSizeRedactFlag ) >> 1 ) | ( ( activated & kGeneralRedactFlag ) >> 4 );
+        }
+
+        /**
+         * @brief Return the pipeline flags of a pipeline index; the inverse of pipeline_index.
+         */
+        static constexpr uint32_t pipeline_mask( uint32_t index ) {
+            return ( index & 0x7 ) | ( ( index & 0x8 ) << 1 ) | ( ( index & 0x10 ) << 4 );
+        }
+
+        /**
+         * @brief Return the pipeline specialized for a set of activation flags.
+         */
+        static Pipeline select_pipeline( uint32_t activated );
+
+        /**
+         * @brief Process a BSM with the pipeline stages in MASK; the other pipeline stages are not compiled in.
+         */
+        template <uint32_t MASK>
+        bool process_pipeline( const std::string& bsm_json, int64_t timestamp );
+
+        /**
+         * @brief Check and redact a message of a registered, non-BSM payload type in place.
+         *
+         * @return true if the message is retained; false otherwise with the result set.
+         */
+        template <uint32_t MASK>
+        bool process_payload( rapidjson::Document& document, const PayloadType& type );
+
+        template <uint32_t N>
+        struct PipelineTable;
 
         // JMC: The leak seems to be caused by re-using the RapidJSON document instance.
         // JMC: We will use a unique instance for each message.
         // rapidjson::Document document_;              ///< JSON DOM
 
         uint32_t activated_;                        ///< A flag word indicating which features of the privacy protection are activiated.
+        Pipeline pipeline_;                         ///< The process method specialized for activated_.
+        std::shared_ptr<const PayloadRegistry> payloads_;   ///< The message types handled, by metadata.payloadType.
 
         bool finalized_;                            ///< Indicates the JSON string after redaction has been created and retrieved.
         ResultStatus result_;                       ///< Indicates the current state of BSM parsing and what causes failure.
         BSM bsm_;                                   ///< The BSM instance that is being built through parsing.
         Quad::Ptr quad_ptr_;                        ///< A pointer to the quad tree containing the map elements.
+        geo::GridIndex::CPtr grid_index_ptr_;       ///< A pointer to the lattice index of uniform grid squares; may be nullptr.
         bool get_value_;                            ///< Indicates the next value should be saved.
         std::string json_;                          ///< The JSON string after redaction.
 
         VelocityFilter vf_;                         ///< The velocity filter functor instance.
+        CorePrefilter prefilter_;                   ///< The batch velocity and bounds prefilter.
+        uint8_t prefiltered_;                       ///< The prefilter result of the BSM being processed.
+        DownsampleFilter dsf_;                      ///< The per-vehicle down-sampling filter instance.
+        DuplicateFilter dupf_;                      ///< The duplicate BSM filter instance.
+        TripFilter tf_;                             ///< The trip start and end trimming filter instance.
+        std::vector<std::string> released_;         ///< The held BSMs released by the most recent processing.
+        std::vector<TripFilter::Hold> released_holds_;      ///< The holds of released_.
+        const TripFilter::HoldFactory* make_hold_;  ///< Makes the holds of held BSMs; may be nullptr.
         IdRedactor idr_;                            ///< The ID Redactor to use during parsing of BSMs.
 
         double box_extension_;                      ///< The number of meters to extend the boxes that surround edges and define the geofence.
@@ -0,0 +1,51 @@
+#ifndef CVDP_BSM_SYNTHESIZER_H
+#define CVDP_BSM_SYNTHESIZER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A maker of synthetic ODE BSM corpora for load tests and benchmarks.
+ *
+ * BSM n is made from template n modulo the number of templates. Its vehicle id is n modulo the number of vehicles, in 8
+ * hexadecimal digits, and its message count and second mark advance as if each vehicle sent every 100 ms. Its ODE
+ * serial number is n, so a BSM the PPM publishes can be traced back to the one sent.
+ */
+class BsmSynthesizer {
+
+    public:
+        /**
+         * @brief Construct a synthesizer.
+         *
+         * @param templates ODE BSM JSON; those that are not ODE BSMs are skipped.
+         * @param vehicles the number of distinct vehicle ids; at least 1.
+         */
+        BsmSynthesizer( const std::vector<std::string>& templates, uint64_t vehicles );
+
+        /**
+         * @brief Return the number of usable templates.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief Return BSM n; empty when there are no usable templates.
+         */
+        std::string operator()( uint64_t n ) const;
+
+        /**
+         * @brief Return the vehicle id of BSM n, e.g., to key it as the ODE does.
+         */
+        std::string id( uint64_t n ) const;
+
+        /**
+         * @brief Return the ODE serial number of a BSM JSON; -1 when it has none.
+         */
+        static int64_t serial( const std::string& bsm );
+
+    private:
+        std::vector<std::string> templates_;
+        uint64_t vehicles_;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef CVDP_CORE_PREFILTER_H
+#define CVDP_CORE_PREFILTER_H
+
+#include <cstdint>
+
+#include "cvlib.hpp"
+#include "velocityFilter.hpp"
+
+/**
+ * @brief A batch prefilter over the raw J2735 core fields (speed, lat, long) of many BSMs, stored as separate arrays
+ * (structure of arrays). One pass computes, for every BSM, whether the velocity filter suppresses it and whether it
+ * lies outside the geofence bounds, so only the survivors need the spatial index lookup.
+ *
+ * The thresholds are converted to raw J2735 units once, so the kernel compares 32-bit integers only; it uses SSE2 when
+ * available. The results are exactly those of VelocityFilter::suppress and Bounds::contains on the converted values.
+ * As in BSMHandler::process, an unavailable speed (8191) is a speed of 0; an unavailable lat (900000001) or long
+ * (1800000001) is outside the bounds.
+ *
+ * The pipeline workers and the partition lanes fill it from the BSMs they take from their rings at once; see
+ * BSMHandler::core_fields and BSMHandler::prefilter.
+ */
+class CorePrefilter {
+
+    public:
+        static constexpr uint8_t kSpeed = 0x1 << 0;             ///< Result bit: the velocity filter suppresses the BSM.
+        static constexpr uint8_t kOutside = 0x1 << 1;           ///< Result bit: the BSM position is outside the bounds.
+
+        static constexpr int32_t kSpeedUnavailable = 8191;
+        static constexpr int32_t kLatitudeUnavailable = 900000001;
+        static constexpr int32_t kLongitudeUnavailable = 1800000001;
+
+        /**
+         * @brief Construct a prefilter that suppresses nothing.
+         */
+        CorePrefilter();
+
+        /**
+         * @brief Construct a prefilter from a velocity filter and the geofence bounds.
+         *
+         * @param vf the velocity filter; later changes to it are not reflected.
+         * @param bounds the geofence bounds, e.g., the top-level Quad.
+         */
+        CorePrefilter( const VelocityFilter& vf, const geo::Bounds& bounds );
+
+        /**
+         * @brief Compute the result of each BSM in a batch.
+         *
+         * @param speed the raw speeds in units of 0.02 m/s.
+         * @param lat the raw latitudes in units of 1e-7 degrees.
+         * @param lon the raw longitudes in units of 1e-7 degrees.
+         * @param n the number of BSMs.
+         * @param result the n results: 0 to keep the BSM, otherwise the kSpeed and kOutside bits of the failed checks.
+         * @param checks the checks to perform: kSpeed, kOutside, or both.
+         * @return the number of BSMs kept.
+         */
+        std::size_t apply( const int32_t* speed, const int32_t* lat, const int32_t* lon, std::size_t n, uint8_t* result, uint8_t checks = kSpeed | kOutside ) const;
+
+    private:
+        int32_t speed_min_;                                     ///< The smallest raw speed retained.
+        int32_t speed_max_;                                     ///< The largest raw speed retained.
+        int32_t lat_min_;                                       ///< The smallest raw latitude inside the bounds.
+        int32_t lat_max_;
+        int32_t lon_min_;                                       ///< The smallest raw longitude inside the bounds.
+        int32_t lon_max_;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef CVDP_DEAD_LETTER_QUEUE_H
+#define CVDP_DEAD_LETTER_QUEUE_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "bsmHandler.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief The raw messages that could not be processed, batched for the dead-letter topic.
+ *
+ * Messages that fail to parse or lack required fields are queued with their reason and source position. The queue is
+ * bounded, so a storm of bad messages (e.g., after an ODE schema change) drops the excess rather than growing without
+ * limit, and a batch is due when it is full or its oldest letter has waited the linger time. Adding and taking letters is
+ * safe from several threads.
+ */
+class DeadLetterQueue {
+
+    public:
+        /**
+         * @brief A message for the dead-letter topic.
+         */
+        struct Letter {
+            std::string payload;                                ///< The raw message.
+            std::string reason;                                 ///< The handler's result string.
+            std::string topic;                                  ///< The topic consumed from.
+            int32_t partition;
+            int64_t offset;
+            int64_t timestamp;                                  ///< The Kafka timestamp in milliseconds; negative when not available.
+        };
+
+        /**
+         * @brief The counts of letters handled.
+         */
+        struct Metrics {
+            uint64_t queued;                                    ///< The letters added to the queue.
+            uint64_t dropped;                                   ///< The letters dropped because the queue was full.
+            uint64_t produced;                                  ///< The letters handed to the producer.
+            uint64_t failed;                                    ///< The letters the producer refused.
+        };
+
+        static constexpr std::size_t kDefaultBatch = 100;
+        static constexpr int64_t kDefaultLinger = 1000;         ///< In milliseconds.
+        static constexpr std::size_t kDefaultCapacity = 10000;
+
+        /**
+         * @brief Construct a queue that is disabled.
+         */
+        DeadLetterQueue();
+
+        /**
+         * @brief Construct a queue using the specified configuration; enabled when a topic is configured.
+         *
+         * @param conf The configuration with which to setup this queue.
+         * @throws invalid_argument for a batch or capacity of 0.
+         */
+        DeadLetterQueue( const ConfigMap& conf );
+
+        DeadLetterQueue( const DeadLetterQueue& ) = delete;
+        DeadLetterQueue& operator=( const DeadLetterQueue& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether a dead-letter topic is configured.
+         */
+        bool enabled() const;
+
+        /**
+         * @brief Return the dead-letter topic.
+         */
+        const std::string& topic() const;
+
+        /**
+         * @brief Predicate indicating whether messages with this result go to the dead-letter topic.
+         */
+        static bool routes( BSMHandler::ResultStatus result );
+
+        /**
+         * @brief Queue a letter, or drop it when the queue is full.
+         *
+         * @param letter the letter to queue.
+         * @param now the current time in milliseconds.
+         * @return true if a batch is due.
+         */
+        bool add( Letter&& letter, int64_t now );
+
+        /**
+         * @brief Predicate indicating whether a batch is due: a full batch is queued or the oldest letter has lingered.
+         */
+        bool due( int64_t now ) const;
+
+        /**
+         * @brief Take up to one batch of letters in the order they were queued.
+         */
+        std::vector<Letter> take();
+
+        /**
+         * @brief Record the outcome of producing a batch.
+         */
+        void delivered( uint64_t produced, uint64_t failed );
+
+        /**
+         * @brief Return the counts of letters handled.
+         */
+        Metrics metrics() const;
+
+    private:
+        std::string topic_;
+        std::size_t batch_;
+        int64_t linger_;
+        std::size_t capacity_;
+
+        mutable std::mutex mutex_;
+        std::vector<Letter> letters_;
+        std::atomic<std::size_t> size_;                         ///< The letters queued; read without the lock.
+        std::atomic<int64_t> oldest_;                           ///< When the oldest letter was queued; -1 when empty.
+
+        std::atomic<uint64_t> queued_;
+        std::atomic<uint64_t> dropped_;
+        std::atomic<uint64_t> produced_;
+        std::atomic<uint64_t> failed_;
+};
+
+#endif
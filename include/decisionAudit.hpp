@@ -0,0 +1,118 @@
+#ifndef CVDP_DECISION_AUDIT_H
+#define CVDP_DECISION_AUDIT_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "bsmHandler.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief The structured record of the PPM's decisions, so the per-message text logs can be turned off.
+ *
+ * The published BSMs carry compact Kafka headers naming the PPM version, the hash of the map file, and the activated
+ * features. Of the suppressed BSMs, one in every sample decisions with the same result is recorded on an audit topic;
+ * each record counts the decisions it stands for, so the totals per result can be rebuilt from the topic. Sampling is
+ * safe to call from several threads.
+ */
+class DecisionAudit {
+
+    public:
+        using Headers = std::vector<std::pair<std::string,std::string>>;       ///< Kafka header names and values.
+
+        static constexpr uint64_t kDefaultSample = 100;
+
+        /**
+         * @brief Construct an audit that logs the decisions as text only.
+         */
+        DecisionAudit();
+
+        /**
+         * @brief Construct an audit using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this audit.
+         * @throws invalid_argument for a sample of 0.
+         */
+        DecisionAudit( const ConfigMap& conf );
+
+        DecisionAudit( const DecisionAudit& ) = delete;
+        DecisionAudit& operator=( const DecisionAudit& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether each decision is logged as text.
+         */
+        bool log_decisions() const;
+
+        /**
+         * @brief Predicate indicating whether the published BSMs carry the decision headers.
+         */
+        bool headers_enabled() const;
+
+        /**
+         * @brief Predicate indicating whether an audit topic is configured.
+         */
+        bool audit_enabled() const;
+
+        /**
+         * @brief Return the audit topic.
+         */
+        const std::string& topic() const;
+
+        /**
+         * @brief Set what the headers describe; call before processing starts.
+         *
+         * @param version the PPM version.
+         * @param map the hash of the map file.
+         * @param flags the handler's activation flag word.
+         */
+        void set_build( const std::string& version, const std::string& map, uint32_t flags );
+
+        /**
+         * @brief Return the headers that describe the build.
+         */
+        const Headers& headers() const;
+
+        /**
+         * @brief Decide whether to record a suppressed decision.
+         *
+         * @param result the handler's result.
+         * @param represents set to the number of decisions the record stands for when sampled.
+         * @return true if the decision is to be recorded.
+         */
+        bool sample( BSMHandler::ResultStatus result, uint64_t& represents );
+
+        /**
+         * @brief Return the JSON audit record of a decision.
+         *
+         * @param result the handler's result string.
+         * @param topic the topic consumed from.
+         * @param partition the partition consumed from.
+         * @param offset the offset of the message.
+         * @param timestamp the Kafka timestamp in milliseconds; negative when not available.
+         * @param represents the number of decisions the record stands for.
+         */
+        static std::string record( const std::string& result, const std::string& topic, int32_t partition, int64_t offset, int64_t timestamp, uint64_t represents );
+
+        /**
+         * @brief Return the FNV-1a hash of a stream's content as 16 hexadecimal digits.
+         */
+        static std::string hash( std::istream& in );
+
+    private:
+        bool log_decisions_;
+        bool headers_enabled_;
+        std::string topic_;
+        uint64_t sample_;
+        Headers headers_;
+
+        std::array<std::atomic<uint64_t>, BSMHandler::ResultStatus::SHED + 1> seen_;      ///< The suppressed decisions by result.
+};
+
+#endif
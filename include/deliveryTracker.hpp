@@ -0,0 +1,154 @@
+#ifndef CVDP_DELIVERY_TRACKER_H
+#define CVDP_DELIVERY_TRACKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/**
+ * @brief The consumed offsets that are safe to commit because every BSM published for them was delivered.
+ *
+ * For each consumed partition (a source) the tracker counts the published BSMs of each consumed offset that are not
+ * yet delivered and remembers the offset after the last consumed message that was processed. The offset to commit is
+ * the oldest offset with a BSM outstanding, or, when none is, the offset after the last processed message. A BSM that
+ * is never delivered keeps its offset outstanding, so it and the messages after it are consumed again after a restart
+ * or rebalance. A BSM held back by a filter, e.g., the trip filter's tail trimming, keeps its offset outstanding the
+ * same way until it is published or dropped. Sources are tracked from several threads: the processing threads mark BSMs
+ * produced and messages processed while the producer's delivery reports mark BSMs delivered.
+ */
+class DeliveryTracker {
+
+    public:
+        /**
+         * @brief The delivery state of one consumed partition; its address is stable while the tracker lives.
+         */
+        class Source {
+            public:
+                Source( const std::string& topic, int32_t partition );
+
+                const std::string& topic() const;
+                int32_t partition() const;
+
+            private:
+                friend class DeliveryTracker;
+
+                std::string topic_;
+                int32_t partition_;
+                mutable std::mutex mutex_;
+                std::map<int64_t, uint64_t> outstanding_;      ///< The undelivered and held BSMs of each consumed offset.
+                int64_t next_;                                  ///< The offset after the last processed message; -1 before one is.
+                uint64_t generation_;                           ///< Incremented by reset; older deliveries and holds are ignored.
+        };
+
+        /**
+         * @brief A published BSM waiting for its delivery report; the producer's message opaque.
+         */
+        struct Delivery {
+            Source* source;
+            int64_t offset;                                     ///< The consumed offset the BSM was published for.
+            uint64_t generation;                                ///< The generation of the source when it was produced.
+        };
+
+        /**
+         * @brief A BSM held back after its message was processed; its consumed offset stays outstanding until the hold
+         * is destroyed. It must not outlive the tracker.
+         */
+        class Hold {
+            public:
+                Hold( DeliveryTracker& tracker, Source& source, int64_t offset );
+                ~Hold();
+
+                Hold( const Hold& ) = delete;
+                Hold& operator=( const Hold& ) = delete;
+
+                Source& source() const;
+                int64_t offset() const;
+
+            private:
+                DeliveryTracker& tracker_;
+                Source& source_;
+                int64_t offset_;
+                uint64_t generation_;
+        };
+
+        DeliveryTracker();
+
+        DeliveryTracker( const DeliveryTracker& ) = delete;
+        DeliveryTracker& operator=( const DeliveryTracker& ) = delete;
+
+        /**
+         * @brief Return the source of a consumed partition, adding it when it is new.
+         */
+        Source& source( const std::string& topic, int32_t partition );
+
+        /**
+         * @brief Record a BSM about to be published for a consumed offset; call it before producing.
+         *
+         * @return the opaque for the producer; delivered takes ownership of it.
+         */
+        Delivery* produced( Source& source, int64_t offset );
+
+        /**
+         * @brief Record that a consumed message is processed and all its BSMs were produced or are held.
+         */
+        void processed( Source& source, int64_t offset );
+
+        /**
+         * @brief Hold the offset of a consumed message whose BSM is held back; see Hold.
+         */
+        std::shared_ptr<Hold> hold( Source& source, int64_t offset );
+
+        /**
+         * @brief Keep the offsets of the holds destroyed from now on outstanding, so the BSMs still held when processing
+         * stops are not committed as done and are consumed again after a restart; call once consuming has stopped for
+         * good, i.e., at shutdown, not when the consume loop restarts.
+         */
+        void freeze_holds();
+
+        /**
+         * @brief Settle the offsets of the holds destroyed from now on again, e.g., when processing restarts.
+         */
+        void thaw_holds();
+
+        /**
+         * @brief Record the delivery report of a published BSM, freeing the delivery.
+         *
+         * @param ok true if the BSM was delivered; false leaves its offset outstanding.
+         */
+        void delivered( Delivery* delivery, bool ok );
+
+        /**
+         * @brief Forget the state of a source whose partition was revoked, once its offsets are committed, so nothing is
+         * committed for it until a message is processed again; later reports of its earlier deliveries and holds are
+         * ignored, so one that failed no longer holds back the commits if the partition is assigned again.
+         *
+         * @return the number of BSMs that were still outstanding and are forgotten.
+         */
+        uint64_t reset( Source& source );
+
+        /**
+         * @brief Return the offset of a source that is safe to commit; negative when there is none.
+         */
+        int64_t committable( const Source& source ) const;
+
+        /**
+         * @brief Return the number of BSMs of a source that are outstanding: published and not delivered, or held.
+         */
+        uint64_t undelivered( const Source& source ) const;
+
+    private:
+        std::mutex mutex_;                                      ///< Guards the sources map, not the sources.
+        std::map<std::pair<std::string, int32_t>, std::unique_ptr<Source>> sources_;
+        std::atomic<bool> frozen_;                              ///< The destroyed holds keep their offsets outstanding.
+
+        /**
+         * @brief Remove one outstanding BSM of an offset of the given generation of a source; call with its mutex held.
+         */
+        static void settle( Source& source, int64_t offset, uint64_t generation );
+};
+
+#endif
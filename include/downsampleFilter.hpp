@@ -0,0 +1,87 @@
+#ifndef CVDP_DOWNSAMPLE_FILTER_H
+#define CVDP_DOWNSAMPLE_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "vehicleStateTable.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief A functor that retains at most one BSM per vehicle per interval, e.g., to reduce 10 Hz trajectories to 1 Hz.
+ *
+ * Message times come from the BSM secMark (milliseconds within the minute) or from the Kafka message timestamp. With
+ * secMark, elapsed time is taken modulo one minute, so a vehicle is forgotten after #kVehicleTTL milliseconds of
+ * wall clock time without a BSM; its next BSM is retained. Messages without a usable time are retained.
+ *
+ * The vehicle table is allocated once: at construction when privacy.filter.downsample is ON, otherwise at the first
+ * retain. Copies made after it is allocated share it.
+ */
+class DownsampleFilter {
+
+    public:
+        static constexpr uint64_t kDefaultInterval = 1000;      ///< In milliseconds = 1 Hz.
+        static constexpr std::size_t kDefaultVehicles = 65536;  ///< The default number of vehicles tracked.
+        static constexpr uint64_t kVehicleTTL = 30000;          ///< In milliseconds; less than a secMark minute so elapsed times are unambiguous.
+        static constexpr int kSecMarkRange = 60000;             ///< The number of secMark values; 60000 - 65535 mean unavailable.
+        static constexpr uint64_t kMaxSecMarkInterval = kSecMarkRange / 2;     ///< The longest interval secMark can measure.
+
+        /**
+         * @brief Construct a down-sampling filter with the default 1 second interval using secMark; nothing is allocated.
+         */
+        DownsampleFilter();
+
+        /**
+         * @brief Construct a down-sampling filter using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this filter.
+         * @throws invalid_argument for an unknown clock, or an interval over #kMaxSecMarkInterval with the secMark clock.
+         */
+        DownsampleFilter( const ConfigMap& conf );
+
+        /**
+         * @brief Predicate indicating whether this BSM should be retained; a retained BSM starts a new interval.
+         *
+         * @param id the original BSM id.
+         * @param sec_mark the BSM secMark; negative when missing.
+         * @param timestamp the Kafka message timestamp in milliseconds; negative when not available.
+         * @return true = keep this BSM; false = suppress.
+         */
+        bool retain( const std::string& id, int sec_mark, int64_t timestamp );
+
+        /**
+         * @brief Return the minimum time between retained BSMs of a vehicle in milliseconds.
+         */
+        uint64_t interval() const;
+
+        /**
+         * @brief Predicate indicating whether message times come from the BSM secMark rather than Kafka timestamps.
+         */
+        bool uses_sec_mark() const;
+
+        /**
+         * @brief Return the vehicle table metrics; all zero before the table is allocated.
+         */
+        VehicleStateTable<int64_t>::Metrics metrics() const;
+
+        /**
+         * @brief Stop sharing the vehicle table with the copies of this one; a vehicle table already allocated
+         * is replaced by a new empty one, otherwise it is allocated on first use as before.
+         */
+        void detach();
+
+    private:
+        uint64_t interval_;                                     ///< The minimum time between retained BSMs of a vehicle.
+        bool sec_mark_;                                         ///< Flag indicating message times come from secMark.
+        std::size_t capacity_;                                  ///< The number of vehicles tracked.
+        std::shared_ptr<VehicleStateTable<int64_t>> vehicles_;  ///< The time of each vehicle's last retained BSM; nullptr until allocated.
+
+        /**
+         * @brief Return the vehicle table, allocating it on first use.
+         */
+        VehicleStateTable<int64_t>& vehicles();
+};
+
+#endif
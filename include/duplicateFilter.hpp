@@ -0,0 +1,110 @@
+#ifndef CVDP_DUPLICATE_FILTER_H
+#define CVDP_DUPLICATE_FILTER_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief A functor that detects BSMs already seen within a time window, e.g., one BSM heard by several RSUs or resent
+ * by the ODE. A BSM is identified by its original id, secMark, and msgCnt.
+ *
+ * The seen BSMs are kept in a rotating pair of split block bloom filters: BSMs are added to the current filter, and
+ * both filters are searched. When the current filter is older than the window it becomes the previous filter and the
+ * old previous filter is cleared. A duplicate arriving within the window of the first copy is always detected;
+ * between one and two windows later it may not be. Memory is fixed once allocated; a distinct BSM is reported as a
+ * duplicate with a small probability that grows when more than the configured capacity of BSMs arrive in a window.
+ *
+ * The filters are allocated once: at construction when privacy.filter.duplicates is ON, otherwise at the first check.
+ * Copies made after they are allocated share them.
+ */
+class DuplicateFilter {
+
+    public:
+        static constexpr uint64_t kDefaultWindow = 2000;        ///< In milliseconds.
+        static constexpr std::size_t kDefaultCapacity = 262144; ///< The default number of BSMs per window.
+        static constexpr unsigned kBitsPerBSM = 16;             ///< Filter bits per BSM at capacity; about 0.1% false positives.
+        static constexpr unsigned kBlockWords = 8;              ///< The number of 32-bit words in a block; one bit is set in each.
+
+        /**
+         * @brief Construct a duplicate filter with the default window and capacity; nothing is allocated.
+         */
+        DuplicateFilter();
+
+        /**
+         * @brief Construct a duplicate filter using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this filter.
+         */
+        DuplicateFilter( const ConfigMap& conf );
+
+        /**
+         * @brief Predicate indicating whether this BSM was seen within the window; the BSM is recorded as seen.
+         *
+         * @param id the original BSM id.
+         * @param sec_mark the BSM secMark.
+         * @param msg_cnt the BSM msgCnt.
+         * @return true = a duplicate to suppress; false = keep this BSM.
+         */
+        bool duplicate( const std::string& id, int sec_mark, int msg_cnt );
+
+        /**
+         * @brief Predicate indicating whether this BSM was seen within the window at the given time.
+         *
+         * @param now the current time in milliseconds; it should not go backwards.
+         */
+        bool duplicate( const std::string& id, int sec_mark, int msg_cnt, uint64_t now );
+
+        /**
+         * @brief Return the window in milliseconds.
+         */
+        uint64_t window() const;
+
+        /**
+         * @brief Return the number of bytes in the filters; 0 before they are allocated.
+         */
+        std::size_t size() const;
+
+        /**
+         * @brief Stop sharing the filters with the copies of this one; filters already allocated are replaced by new
+         * empty ones, otherwise they are allocated on first use as before.
+         */
+        void detach();
+
+        /**
+         * @brief Return the number of duplicates detected.
+         */
+        uint64_t duplicates() const;
+
+    private:
+        /**
+         * @brief The filters and the time the current one was started; shared so handlers remain copyable.
+         */
+        struct Filters {
+            std::mutex mutex;
+            std::vector<uint32_t> current;
+            std::vector<uint32_t> previous;
+            uint64_t start;                                     ///< The time the current filter was started.
+            bool started;                                       ///< Flag indicating start has been set.
+            uint64_t duplicates;
+
+            explicit Filters( std::size_t words ) : mutex{}, current( words ), previous( words ), start{ 0 }, started{ false }, duplicates{ 0 } {}
+        };
+
+        uint64_t window_;
+        std::size_t capacity_;                                  ///< The number of BSMs per window the filters are sized for.
+        uint64_t block_mask_;
+        std::shared_ptr<Filters> filters_;                      ///< nullptr until allocated.
+
+        /**
+         * @brief Return the filters, allocating them on first use.
+         */
+        Filters& filters();
+};
+
+#endif
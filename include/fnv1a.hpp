@@ -0,0 +1,24 @@
+#ifndef CVDP_FNV1A_H
+#define CVDP_FNV1A_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief The 64-bit FNV-1a offset basis, the hash of no bytes.
+ */
+constexpr uint64_t kFnv1aOffsetBasis = 0xcbf29ce484222325ULL;
+
+/**
+ * @brief Return the 64-bit FNV-1a hash of the bytes; pass the hash so far to continue a hash across several buffers.
+ */
+inline uint64_t fnv1a( const char* s, std::size_t length, uint64_t h = kFnv1aOffsetBasis )
+{
+    for ( std::size_t i = 0; i < length; ++i ) {
+        h ^= static_cast<unsigned char>( s[i] );
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+#endif
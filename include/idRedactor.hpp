@@ -1,12 +1,15 @@
 #ifndef CVDP_ID_REDACTOR_H
 #define CVDP_ID_REDACTOR_H
 
+#include <cstdint>
 #include <string>
 #include <stack>
 #include <vector>
 #include <random>
 #include <unordered_set>
 #include <unordered_map>
+#include <memory>
+#include <array>
 #include <iomanip>
 #include "rapidjson/document.h"
 #include "cvlib.hpp"
@@ -14,18 +17,161 @@
 using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
 using StrVector = std::vector<std::string>;             ///< List of std::string instances.
 
+/**
+ * @brief A set of unsigned 32-bit identifiers stored in a flat open-addressing table (linear probing, power of two
+ * capacity, at most half full) so a lookup is a multiply, a shift, and usually a single cache line.
+ */
+class IdSet {
+
+    public:
+        IdSet();
+
+        /**
+         * @brief Add an id to the set.
+         *
+         * @return true if the id was new to the set; false otherwise.
+         */
+        bool insert( uint32_t id );
+
+        /**
+         * @brief Remove an id from the set.
+         *
+         * @return true if the id was removed; false if it wasn't in the set.
+         */
+        bool erase( uint32_t id );
+
+        /**
+         * @brief Predicate indicating whether the id is in the set.
+         */
+        bool contains( uint32_t id ) const;
+
+        /**
+         * @brief Grow the table so that n ids can be held without rehashing.
+         */
+        void reserve( std::size_t n );
+
+        /**
+         * @brief Remove all the ids from the set.
+         */
+        void clear();
+
+        /**
+         * @brief Return the number of ids in the set.
+         */
+        std::size_t size() const;
+
+    private:
+        std::vector<uint32_t> slots_;                           ///< The table; 0 marks an empty slot.
+        std::size_t size_;                                      ///< The number of ids in the set, including 0.
+        bool has_zero_;                                         ///< Flag indicating whether id 0 (which cannot be stored in a slot) is in the set.
+        unsigned shift_;                                        ///< 32 less log2 of the table capacity.
+
+        std::size_t slot( uint32_t id ) const;
+        void rehash( std::size_t capacity );
+};
+
+/**
+ * @brief A Pseudonymizer replaces an id with a keyed hash of the id so all the BSMs of a vehicle carry the same
+ * replacement id within an epoch (a fixed window of wall clock time) and an unlinkable one in the next.
+ *
+ * The pseudonym is the low 32 bits of SipHash-2-4 of the id under an epoch key; the epoch key is derived from the
+ * secret key and the epoch number, so PPM instances configured with the same key agree on pseudonyms. Recently used
+ * temporary ids are kept in a small direct mapped cache; since pseudonyms are a function of the id and the epoch,
+ * evictions never change a pseudonym.
+ */
+class Pseudonymizer {
+
+    public:
+        using Key = std::array<uint64_t,2>;                     ///< A 128-bit SipHash key.
+
+        static constexpr uint64_t kDefaultEpochSeconds = 300;    ///< The default pseudonym lifetime: 5 minutes.
+        static constexpr std::size_t kDefaultCacheSize = 4096;   ///< The default number of cached pseudonyms.
+
+        /**
+         * @brief Construct a pseudonymizer with a random key, the default epoch, and the default cache size.
+         */
+        Pseudonymizer();
+
+        /**
+         * @brief Construct a pseudonymizer using the provided configuration.
+         *
+         * - privacy.redaction.id.pseudonym.key : 32 hex digits; required, so every handler, lane, and restart agrees.
+         * - privacy.redaction.id.pseudonym.epoch : the pseudonym lifetime in seconds.
+         * - privacy.redaction.id.pseudonym.cache : the number of cached pseudonyms; rounded up to a power of two.
+         *
+         * @param conf The privacy configuration with which to setup this Pseudonymizer.
+         * @throws invalid_argument for a missing or malformed key or a zero epoch.
+         */
+        Pseudonymizer( const ConfigMap& conf );
+
+        /**
+         * @brief Return the pseudonym of an id at the current time.
+         */
+        uint32_t operator()( const std::string& id );
+
+        /**
+         * @brief Return the pseudonym of an id at the given time.
+         *
+         * @param id the id to replace.
+         * @param now the time in seconds since the Unix epoch.
+         */
+        uint32_t pseudonym( const std::string& id, uint64_t now );
+
+        /**
+         * @brief Return the pseudonym lifetime in seconds.
+         */
+        uint64_t epoch_seconds() const;
+
+        /**
+         * @brief Compute SipHash-2-4 of a message.
+         *
+         * @param key the 128-bit key; key[0] holds the first 8 key bytes in little endian order.
+         * @param data the message.
+         * @param length the number of bytes in the message.
+         */
+        static uint64_t siphash( const Key& key, const void* data, std::size_t length );
+
+    private:
+        /**
+         * @brief A cached pseudonym.
+         */
+        struct Entry {
+            uint64_t epoch;                                     ///< One more than the epoch of the pseudonym; 0 marks an empty entry.
+            uint32_t id;
+            uint32_t pseudonym;
+        };
+
+        Key key_;                                               ///< The secret key.
+        Key epoch_key_;                                         ///< The key for the current epoch.
+        uint64_t epoch_seconds_;                                ///< The pseudonym lifetime.
+        uint64_t epoch_;                                        ///< One more than the current epoch; 0 before the first pseudonym.
+        std::vector<Entry> cache_;                              ///< The direct mapped cache of pseudonyms of temporary ids.
+
+        void set_epoch( uint64_t epoch );
+};
+
 /**
  * @brief An IdRedactor encapsulates whether IdRedaction should take place and how it is performed.
  *
  * If inclusion_set_ is false (the default for the default constructor), ALL IDS will be redacted.
  * If inclusion_set_ is true and the inclusion_set is empty, the NO IDS will be redacted.
  * If inclusion_set_ is true and the inclusion_set is non-empty, then those IDS in the set will be redacted.
+ *
+ * Included ids that are J2735 temporary ids (8 hex digits, either case) are kept as 32-bit integers in an IdSet; any
+ * other ids are kept as strings. The inclusions are an immutable snapshot that is replaced atomically, so the
+ * inclusion file can be reloaded on another thread while BSMs are being redacted. The remaining modifiers are meant
+ * to be called from a single thread.
+ *
+ * Redacted ids are replaced by random ids unless privacy.redaction.id.mode is "pseudonym", in which case they are
+ * replaced by the Pseudonymizer's stable keyed pseudonyms.
  */
 class IdRedactor {
 
     public:
 
-        using InclusionSetType = std::unordered_set<std::string>;        ///< Alias for the inclusion set type.
+        using InclusionSetType = std::unordered_set<std::string>;        ///< Alias for the set of included ids that are not temporary ids.
+
+        static constexpr std::size_t kIdLength = sizeof(uint32_t) * 2;  ///< The number of hex characters in a generated id.
         
         /**
          * @brief Default Id Redactor constructor.
@@ -42,9 +188,18 @@ class IdRedactor {
          * Initializes itself with the default constructor prior to applying configuration settings.
          *
          * @param conf The privacy configuration with which to setup this IdRedactor.
+         * @throws invalid_argument for an unreadable inclusion file or a pseudonym mode without a valid key.
          */
         IdRedactor( const ConfigMap& conf );
 
+        /**
+         * @brief Copy a redactor; the copy has its own pseudonym cache.
+         */
+        IdRedactor( const IdRedactor& other );
+        IdRedactor& operator=( const IdRedactor& other );
+        IdRedactor( IdRedactor&& other ) = default;
+        IdRedactor& operator=( IdRedactor&& other ) = default;
+
         /**
          * @brief Predicate indicating whether of not all ids are redacted.
          *
@@ -92,6 +247,26 @@ class IdRedactor {
          */
         bool RemoveIdInclusion( const std::string& id );
 
+        /**
+         * @brief Rebuild the inclusions from the configured ids and the inclusion file and swap them in.
+         *
+         * The inclusion file (privacy.redaction.id.included.file) has one id per line; blank lines and lines starting
+         * with # are ignored. Redaction continues with the previous inclusions while the file is read.
+         *
+         * @return true if the inclusions were replaced; false if the file could not be read and the previous
+         * inclusions were kept.
+         */
+        bool ReloadInclusions();
+
+        /**
+         * @brief Parse a J2735 temporary id.
+         *
+         * @param id the id to parse.
+         * @param value the 32-bit value of the id.
+         * @return true if the id is exactly 8 hex digits; false otherwise.
+         */
+        static bool ParseId( const std::string& id, uint32_t& value );
+
         /**
          * @brief Build and return a new randomly generated unsigned 32-bit identifier in hex to replace the current identifier.
          *
@@ -99,6 +274,24 @@ class IdRedactor {
          */
 		std::string GetRandomId();
 
+        /**
+         * @brief Write a new randomly generated unsigned 32-bit identifier in hex to a buffer.
+         *
+         * The random values come from a small per-thread generator seeded from std::random_device; no memory is
+         * allocated.
+         *
+         * @param buffer the destination for #kIdLength lower case hex characters; it is not null terminated.
+         */
+        static void WriteRandomId( char* buffer );
+
+        /**
+         * @brief Write an unsigned 32-bit value as zero padded lower case hex.
+         *
+         * @param value the value to format.
+         * @param buffer the destination for #kIdLength characters; it is not null terminated.
+         */
+        static void FormatId( uint32_t value, char* buffer );
+
         /**
          * @brief Operator to redact (or retain) an id.
          *
@@ -108,6 +301,16 @@ class IdRedactor {
          */
         bool operator()( std::string& id );
 
+        /**
+         * @brief Operator to redact (or retain) an id without modifying it; the replacement is written to a buffer.
+         *
+         * @param id the id to redact.
+         * @param buffer the destination for the #kIdLength character replacement when the id is redacted.
+         *
+         * @return true the id should be replaced by the buffer contents; false the id is retained and the buffer is unchanged.
+         */
+        bool operator()( const std::string& id, char* buffer );
+
         /**
          * @brief Return the value currently being used for redaction.
          *
@@ -115,13 +318,49 @@ class IdRedactor {
          */
         const std::string& redaction_value() const;
 
+        /**
+         * @brief Predicate indicating whether redacted ids are replaced by pseudonyms rather than random ids.
+         */
+        bool UsesPseudonyms() const;
+
 
     private:
-        std::mt19937 rgen_;                                     ///< random number generator (mersenne twister).
-        std::uniform_int_distribution<uint32_t> dist_;
-        InclusionSetType inclusion_set_;                        ///< The set of ids on which to perform redaction.
+        /**
+         * @brief An immutable snapshot of the ids to redact.
+         */
+        struct Inclusions {
+            bool enabled;                                       ///< Flag indicating whether this redactor will use the inclusion sets.
+            IdSet temporary_ids;                                ///< The included temporary ids.
+            InclusionSetType other_ids;                         ///< The included ids that are not temporary ids.
+
+            std::size_t size() const;
+            bool insert( const std::string& id );
+        };
+
+        using InclusionsCPtr = std::shared_ptr<const Inclusions>;
+
+        InclusionsCPtr inclusions_;                             ///< The current inclusions; accessed with std::atomic_load and std::atomic_store.
         std::string redacted_value_;                            ///< The value to assign to those ids that require redaction.
-        bool inclusions_;                                       ///< Flag indicating whether this redactor will use the inclusion_set.
+        StrVector configured_ids_;                              ///< The ids listed in the configuration; kept for reloads.
+        std::string inclusion_file_;                            ///< The file of additional included ids; empty when not used.
+        std::unique_ptr<Pseudonymizer> pseudonymizer_;          ///< The pseudonym source; only made in the pseudonym mode.
+
+        /**
+         * @brief Return the current inclusions snapshot.
+         */
+        InclusionsCPtr inclusions() const;
+
+        /**
+         * @brief Read the inclusion file into the inclusions.
+         *
+         * @return false if the file could not be opened.
+         */
+        bool LoadInclusionFile( Inclusions& inclusions ) const;
+
+        /**
+         * @brief Predicate indicating whether an id requires redaction.
+         */
+        bool IsRedacted( const std::string& id ) const;
 };
 
 #endif
\ No newline at end of file
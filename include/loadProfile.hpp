@@ -0,0 +1,78 @@
+#ifndef CVDP_LOAD_PROFILE_H
+#define CVDP_LOAD_PROFILE_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief The send schedule of a load test: a constant rate, a linear ramp between two rates, or a base rate with
+ * periodic bursts at a peak rate.
+ *
+ * The schedule is open loop: message n is due at a fixed time after the start, whatever happened to the messages before
+ * it, so a slow system under test shows up as latency rather than as a lower offered rate.
+ */
+class LoadProfile {
+
+    public:
+        /**
+         * @brief The shape of the rate over time.
+         */
+        enum class Shape { CONSTANT, RAMP, BURST };
+
+        /**
+         * @brief Construct a profile from its specification.
+         *
+         * - constant:RATE:SECONDS
+         * - ramp:FROM:TO:SECONDS
+         * - burst:BASE:PEAK:PERIOD_MS:LENGTH_MS:SECONDS
+         *
+         * Rates are in messages per second.
+         *
+         * @param spec The specification.
+         * @throws invalid_argument for an unknown shape, a wrong number of values, a negative rate or time, a zero ramp
+         * duration, or a zero burst period.
+         */
+        LoadProfile( const std::string& spec );
+
+        Shape get_shape() const;
+
+        /**
+         * @brief Return the length of the test in seconds.
+         */
+        double duration() const;
+
+        /**
+         * @brief Return the rate in messages per second at t seconds after the start.
+         */
+        double rate_at( double t ) const;
+
+        /**
+         * @brief Return the number of messages due by t seconds after the start.
+         */
+        uint64_t due( double t ) const;
+
+        /**
+         * @brief Return the number of messages in the test.
+         */
+        uint64_t total() const;
+
+        /**
+         * @brief Return when message n is due, in seconds after the start.
+         */
+        double time_of( uint64_t n ) const;
+
+    private:
+        Shape shape_;
+        double rate_;                                           ///< The constant, ramp start, or burst base rate.
+        double peak_;                                           ///< The ramp end or burst peak rate.
+        double period_;                                         ///< The burst period in seconds.
+        double length_;                                         ///< The burst length in seconds.
+        double duration_;
+
+        /**
+         * @brief Return the messages sent by t, unrounded.
+         */
+        double sent( double t ) const;
+};
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef CVDP_LOAD_SHEDDER_H
+#define CVDP_LOAD_SHEDDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief A policy that sheds the backlog after an outage so the PPM reaches the live stream quickly.
+ *
+ * The shedder watches the age of each message (from its Kafka timestamp) and the consumer lag of its partition. When
+ * either exceeds its threshold the shedder enters the degraded mode; it returns to the normal mode once both are
+ * below half their thresholds. In the degraded mode, messages older than the drop age are shed before parsing, and of
+ * the others only one in every keep messages is processed. Shedding is decided per message and is safe to call from
+ * several threads.
+ */
+class LoadShedder {
+
+    public:
+        /**
+         * @brief What to do with a message.
+         */
+        enum class Decision { PROCESS, AGE, SAMPLE };
+
+        /**
+         * @brief The counts of shed messages and mode changes.
+         */
+        struct Metrics {
+            uint64_t aged;                                      ///< The messages shed for their age.
+            uint64_t sampled;                                   ///< The messages shed by sampling.
+            uint64_t degradations;                              ///< The number of times the degraded mode was entered.
+            bool degraded;                                      ///< Flag indicating the degraded mode is current.
+        };
+
+        static constexpr int64_t kDefaultAge = 60000;           ///< In milliseconds.
+        static constexpr int64_t kDefaultLag = 100000;          ///< In messages.
+
+        /**
+         * @brief Construct a shedder that is disabled.
+         */
+        LoadShedder();
+
+        /**
+         * @brief Construct a shedder using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this shedder.
+         * @throws invalid_argument for a keep of 0.
+         */
+        LoadShedder( const ConfigMap& conf );
+
+        LoadShedder( const LoadShedder& ) = delete;
+        LoadShedder& operator=( const LoadShedder& ) = delete;
+
+        /**
+         * @brief Predicate indicating whether shedding is configured.
+         */
+        bool enabled() const;
+
+        /**
+         * @brief Decide whether to process a message, updating the mode.
+         *
+         * @param timestamp the Kafka message timestamp in milliseconds; negative when not available.
+         * @param lag the number of messages after this one in its partition; negative when not known.
+         * @param now the current time in milliseconds since the epoch.
+         * @param changed set to true if this call changed the mode; otherwise unchanged.
+         * @return PROCESS to process the message; otherwise why it is shed.
+         */
+        Decision admit( int64_t timestamp, int64_t lag, int64_t now, bool& changed );
+
+        /**
+         * @brief Decide whether to process a message at the current time.
+         */
+        Decision admit( int64_t timestamp, int64_t lag, bool& changed );
+
+        /**
+         * @brief Predicate indicating whether the degraded mode is current.
+         */
+        bool degraded() const;
+
+        /**
+         * @brief Return the counts of shed messages and mode changes.
+         */
+        Metrics metrics() const;
+
+    private:
+        bool enabled_;
+        int64_t age_;                                           ///< The age that starts the degraded mode; 0 to ignore age.
+        int64_t lag_;                                           ///< The lag that starts the degraded mode; 0 to ignore lag.
+        int64_t drop_age_;                                      ///< In the degraded mode, messages older than this are shed.
+        uint64_t keep_;                                         ///< In the degraded mode, one in keep messages is processed.
+
+        std::atomic<bool> degraded_;
+        std::atomic<uint64_t> seen_;                            ///< The messages considered for sampling.
+        std::atomic<uint64_t> aged_;
+        std::atomic<uint64_t> sampled_;
+        std::atomic<uint64_t> degradations_;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef CVDP_OUTPUT_PARTITIONER_H
+#define CVDP_OUTPUT_PARTITIONER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "librdkafka/rdkafkacpp.h"
+#include "bsm.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief The message keys of the published BSMs and the partitioner that places each key on one partition of the
+ * filtered topic, so the BSMs of a vehicle (or of an area) stay in order on one partition.
+ *
+ * A key is the BSM id after redaction, or the geohash cell of the BSM position. Keys are hashed with FNV-1a and mapped
+ * to partitions with the jump consistent hash, which spreads the keys evenly and, when partitions are added, moves only
+ * the keys the new partitions take. Messages without a key are spread round-robin.
+ */
+class OutputPartitioner : public RdKafka::PartitionerCb {
+
+    public:
+        /**
+         * @brief What the message key is made from.
+         */
+        enum class Key { NONE, ID, GEOHASH };
+
+        static constexpr unsigned kDefaultPrecision = 5;        ///< Geohash characters; about 4.9 by 4.9 km cells.
+        static constexpr unsigned kMaxPrecision = 12;
+
+        /**
+         * @brief Construct a partitioner that does not key messages.
+         */
+        OutputPartitioner();
+
+        /**
+         * @brief Construct a partitioner using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this partitioner.
+         * @throws invalid_argument for an unknown key or a precision outside 1 to 12.
+         */
+        OutputPartitioner( const ConfigMap& conf );
+
+        /**
+         * @brief Return what the message key is made from.
+         */
+        Key get_key() const;
+
+        /**
+         * @brief Return the message key of a processed BSM.
+         *
+         * @param bsm the BSM after redaction.
+         * @return the key; empty when not keying or the BSM has no id or position.
+         */
+        std::string key( const BSM& bsm ) const;
+
+        /**
+         * @brief Return the partition of a message; called by librdkafka when producing.
+         */
+        int32_t partitioner_cb( const RdKafka::Topic* topic, const std::string* key, int32_t partition_cnt, void* msg_opaque ) override;
+
+        /**
+         * @brief Return the partition of a key in [0, count).
+         */
+        static int32_t partition( const std::string& key, int32_t count );
+
+        /**
+         * @brief Map a key hash to a bucket in [0, count) with the jump consistent hash (Lamping and Veach).
+         */
+        static int32_t jump( uint64_t hash, int32_t count );
+
+        /**
+         * @brief Return the geohash of a position.
+         *
+         * @param lat the latitude in degrees.
+         * @param lon the longitude in degrees.
+         * @param precision the number of base 32 characters.
+         */
+        static std::string geohash( double lat, double lon, unsigned precision );
+
+    private:
+        Key key_;
+        unsigned precision_;
+        std::atomic<uint32_t> next_;                            ///< The round-robin partition of unkeyed messages.
+};
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef CVDP_PAYLOAD_REGISTRY_H
+#define CVDP_PAYLOAD_REGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief The description of an ODE JSON message type the PPM handles, identified by its metadata.payloadType.
+ *
+ * The BSM type is built in and processed by BSMHandler itself. The other types declare where their position is and
+ * which members to redact; they are checked against the same geofence.
+ */
+struct PayloadType {
+    using Path = std::vector<std::string>;                  ///< The member names from the document root to a value.
+
+    /**
+     * @brief The unit of a type's position values.
+     */
+    enum class Units {
+        J2735,                                              ///< Integers in 1e-7 degrees, with the J2735 unavailable values.
+        DEGREES                                             ///< Numbers in degrees.
+    };
+
+    std::string name;                                       ///< The metadata.payloadType value.
+    bool builtin;                                           ///< Flag indicating BSMHandler processes this type itself.
+    Path latitude;                                          ///< The path to the latitude.
+    Path longitude;                                         ///< The path to the longitude.
+    Units units;                                            ///< The unit of the latitude and longitude.
+    std::vector<std::string> redactions;                    ///< The dotted paths of the members to redact; see RapidjsonRedactor.
+
+    /**
+     * @brief Split a dotted path, e.g., payload.data.value.lat, into its member names.
+     */
+    static Path split( const std::string& dotted );
+};
+
+/**
+ * @brief A registry of payload types with constant time lookup by metadata.payloadType.
+ *
+ * The names are hashed when registered into an open addressing table of (hash, index) entries, so a lookup hashes
+ * the message's payloadType once, in place, and compares the string only on a hash match.
+ */
+class PayloadRegistry {
+
+    public:
+        static constexpr const char* kBsmPayloadType = "us.dot.its.jpo.ode.model.OdeMessageFramePayload";
+
+        /**
+         * @brief Construct a registry with only the built-in BSM type.
+         */
+        PayloadRegistry();
+
+        /**
+         * @brief Construct a registry with the built-in BSM type and the types in the configuration.
+         *
+         * privacy.payload.types lists the payloadType values, separated by commas; for each type T,
+         * privacy.payload.T.lat and privacy.payload.T.long give the dotted paths to its position, the optional
+         * privacy.payload.T.units is J2735 (the default) or DEGREES, and the optional privacy.payload.T.redact lists
+         * the dotted paths of the members to redact.
+         *
+         * @param conf The configuration with which to setup this registry.
+         * @throws invalid_argument for a type without a position, with unknown units, or registered twice.
+         */
+        PayloadRegistry( const ConfigMap& conf );
+
+        /**
+         * @brief Register a payload type.
+         *
+         * @return the index of the type.
+         * @throws invalid_argument if a type with the same name is registered.
+         */
+        std::size_t add( const PayloadType& type );
+
+        /**
+         * @brief Return the type with the given payloadType.
+         *
+         * @param name the payloadType; it need not be null terminated.
+         * @param length the length of name.
+         * @return the type, or nullptr if none is registered.
+         */
+        const PayloadType* find( const char* name, std::size_t length ) const;
+
+        /**
+         * @brief Return the number of registered types.
+         */
+        std::size_t size() const;
+
+    private:
+        /**
+         * @brief An entry of the hash table; index 0 marks an empty entry, otherwise it is the type index plus one.
+         */
+        struct Slot {
+            uint64_t hash;
+            std::size_t index;
+        };
+
+        std::vector<PayloadType> types_;
+        std::vector<Slot> slots_;                           ///< A power of two number of slots, at most half full.
+
+        void rehash( std::size_t slot_count );
+};
+
+#endif
@@ -49,12 +49,24 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <thread>
+
 #include "librdkafka/rdkafkacpp.h"
 #include "tool.hpp"
 #include "bsmHandler.hpp"
 #include "cvlib.hpp"
 #include "spdlog/spdlog.h"
 #include "ppmLogger.hpp"
+#include "spscRing.hpp"
+#include "outputPartitioner.hpp"
+#include "loadShedder.hpp"
+#include "deadLetterQueue.hpp"
+#include "deliveryTracker.hpp"
+#include "decisionAudit.hpp"
 
 class PPM : public tool::Tool {
 
@@ -62,18 +74,78 @@ class PPM : public tool::Tool {
 
         std::shared_ptr<PpmLogger> logger;
 
+        static constexpr const char* kVersion = "0.1";                 ///> The version carried in the decision headers.
+        static constexpr unsigned kIdleSpins = 64;                      ///> The polls of an empty or full ring that yield before the thread sleeps.
+        static constexpr int kIdleSleepMicros = 200;                    ///> The sleep between the later polls, in microseconds.
+        static constexpr int kOffsetStoreMillis = 100;                  ///> The least time between stores of the delivered offsets.
+        static constexpr std::size_t kPrefilterBatch = 64;              ///> The most BSMs a worker or lane takes from its ring to prefilter at once.
+
         static void sigterm (int sig);
+        static void sighup (int sig);
+
+        /**
+         * @brief Clear the flags the signals set, so another PPM can run in this process.
+         */
+        static void reset_signals();
 
         PPM( const std::string& name, const std::string& description );
         ~PPM();
+
+        /**
+         * @brief Add the command line options of the PPM; options can then be parsed or set.
+         */
+        void add_options();
         void metadata_print (const std::string &topic, const RdKafka::Metadata *metadata);
-        bool topic_available( const std::string& topic );
         void print_configuration() const;
         bool configure();
         bool launch_consumer();
         bool launch_producer();
         bool msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler);
+
+        /**
+         * @brief Handle a consumed message that is not a BSM, e.g., a timeout, end of partition, or error.
+         *
+         * @return true if the message is a BSM to process; false if it was handled.
+         */
+        bool msg_status(RdKafka::Message* message);
+
+        /**
+         * @brief Process a consumed BSM message with the handler and update the receive and suppression counters.
+         *
+         * @param prefiltered The handler's prefilter result for the message; see BSMHandler::process.
+         * @return true if the BSM is retained; false if it is suppressed or held.
+         */
+        bool msg_process(RdKafka::Message* message, BSMHandler& handler, uint8_t prefiltered = 0);
+
+        /**
+         * @brief Run the consume, process, and produce stages on their own threads until no BSMs are available.
+         *
+         * A consumer thread hands the messages round-robin to the worker threads, each of which runs its own copy of
+         * the handler, and a producer thread publishes the results in the consumed order. The stages are connected by
+         * single-producer single-consumer rings and each stage thread is optionally pinned to a cpu.
+         *
+         * @param handler The handler the workers copy; the copies share the stateful filters.
+         */
+        void run_pipeline(const BSMHandler& handler);
+
+        /**
+         * @brief Run one processing lane per assigned partition until no BSMs are available.
+         *
+         * The lanes are opened and closed by the rebalance callback; each lane has its own thread, handler, and
+         * per-vehicle state, publishes its own BSMs, and commits its own offsets.
+         */
+        void run_lanes();
         Quad::Ptr BuildGeofence( const std::string& mapfile );
+
+        /**
+         * @brief Build the geofence from the configured map file; throws as BuildGeofence.
+         */
+        void load_geofence();
+
+        /**
+         * @brief Return a handler as the PPM processes BSMs with; call after configure and load_geofence.
+         */
+        BSMHandler make_handler() const;
         int operator()(void);
 
         /**
@@ -93,20 +165,254 @@ class PPM : public tool::Tool {
 
     private:
 
+        /**
+         * @brief A consumed message and its processing result, passed between the pipeline stages; nullptr ends a stage.
+         */
+        struct Envelope {
+            std::unique_ptr<RdKafka::Message> message;                  ///> The consumed message.
+            bool retained;                                              ///> Flag indicating json is to be published.
+            std::string json;                                           ///> The redacted BSM.
+            std::string key;                                            ///> The message key of json and released.
+            std::vector<std::string> released;                          ///> The held BSMs released by this one; published first.
+            std::vector<TripFilter::Hold> released_holds;               ///> The holds of released.
+            uint8_t prefiltered;                                        ///> The prefilter result; nonzero when a core field check failed.
+        };
+
+        using Ring = SpscRing<Envelope*>;
+
+        /**
+         * @brief The envelopes a worker or lane took from its ring at once, with the raw core fields of their BSMs laid
+         * out for the prefilter.
+         */
+        struct Batch {
+            std::vector<Envelope*> envelopes;                           ///> The envelopes taken, in the ring's order.
+            bool ended;                                                 ///> The ring's nullptr end was taken after them.
+            std::vector<std::size_t> scanned;                           ///> The indexes of the envelopes whose core fields were found.
+            std::vector<int32_t> speed;
+            std::vector<int32_t> lat;
+            std::vector<int32_t> lon;
+            std::vector<uint8_t> result;
+        };
+
+        /**
+         * @brief Take up to kPrefilterBatch envelopes from a ring, waiting only for the first, and set their prefiltered
+         * results with the handler; a message whose core fields are not found is processed as usual.
+         */
+        void take_batch( Ring& ring, Batch& batch, BSMHandler& handler );
+
+        /**
+         * @brief The processing of one assigned partition.
+         */
+        struct Lane {
+            DeliveryTracker::Source& source;                            ///> The consumed topic and partition and their delivery state.
+            BSMHandler handler;                                         ///> The handler; its per-vehicle state is this partition's.
+            Ring ring;                                                  ///> The consumed messages; nullptr closes the lane.
+            std::thread thread;
+
+            Lane( DeliveryTracker::Source& source, BSMHandler&& handler, std::size_t ring_size ) :
+                source( source ), handler{ std::move( handler ) }, ring{ ring_size }, thread{}
+            {}
+        };
+
+        using LaneKey = std::pair<std::string, int32_t>;                ///> A consumed topic and partition; a regular expression subscription has several topics.
+
+        /**
+         * @brief Record the delivery reports of the published BSMs, so only the offsets of delivered BSMs are committed.
+         */
+        class DeliveryReporter : public RdKafka::DeliveryReportCb {
+            public:
+                explicit DeliveryReporter( PPM& ppm ) : ppm_( ppm ) {}
+                void dr_cb( RdKafka::Message& message ) override;
+
+            private:
+                PPM& ppm_;
+        };
+
+        /**
+         * @brief Open and close the lanes as partitions are assigned and revoked, for both the eager and the
+         * cooperative incremental rebalance protocols.
+         */
+        class Rebalancer : public RdKafka::RebalanceCb {
+            public:
+                explicit Rebalancer( PPM& ppm ) : ppm_( ppm ) {}
+                void rebalance_cb( RdKafka::KafkaConsumer* consumer, RdKafka::ErrorCode err, std::vector<RdKafka::TopicPartition*>& partitions ) override;
+
+            private:
+                PPM& ppm_;
+        };
+
+        /**
+         * @brief Open the lane of a topic partition, unless it is open; called on the consumer thread.
+         */
+        void open_lane( const std::string& topic, int32_t partition );
+
+        /**
+         * @brief Drain and close the lane of a topic partition, if it is open; called on the consumer thread.
+         *
+         * @param commit Commit the offset of the lane's delivered BSMs, after waiting for their delivery; false when the
+         * assignment was lost.
+         */
+        void close_lane( const std::string& topic, int32_t partition, bool commit );
+
+        /**
+         * @brief Process the messages of a lane until it is closed; the body of the lane thread.
+         */
+        void lane_loop( Lane& lane );
+
+        /**
+         * @brief Commit the offset of a consumed topic partition up to its oldest BSM not yet delivered.
+         */
+        void commit_offset( const DeliveryTracker::Source& source, bool sync );
+
+        /**
+         * @brief Return the delivery source of a consumed message; last, when it is the message's, saves the lookup.
+         */
+        DeliveryTracker::Source& delivery_source( const RdKafka::Message& message, DeliveryTracker::Source* last );
+
+        /**
+         * @brief Return the offsets of the assigned partitions up to their oldest BSM not yet delivered; the caller
+         * destroys them.
+         */
+        std::vector<RdKafka::TopicPartition*> delivered_offsets();
+
+        /**
+         * @brief Store the delivered offsets for the consumer's automatic commits, at most every kOffsetStoreMillis
+         * unless forced; called on the consumer thread when the partitions are not in lanes.
+         */
+        void store_offsets( bool force );
+
+        /**
+         * @brief Produce a BSM to the filtered topic and update the send counters.
+         *
+         * @param bsm The BSM JSON.
+         * @param key The message key; empty for none.
+         * @param bytes The number of bytes to count as sent.
+         * @param kind The kind of BSM for the log, e.g., retained.
+         * @param source The consumed partition whose offset waits for the delivery; nullptr to not track it.
+         * @param offset The consumed offset the BSM is published for.
+         * @return true if the BSM was queued for delivery.
+         */
+        bool publish( const std::string& bsm, const std::string& key, int64_t bytes, const std::string& kind, DeliveryTracker::Source* source, int64_t offset );
+
+        /**
+         * @brief Publish the held BSMs a message released, each for the consumed offset its hold kept outstanding.
+         *
+         * @param holds The holds of released, in order; a BSM without one is published for the current offset.
+         * @param source The consumed partition of the current message.
+         * @param offset The consumed offset of the current message.
+         */
+        void publish_released( const std::vector<std::string>& released, const std::vector<TripFilter::Hold>& holds, const std::string& key, DeliveryTracker::Source* source, int64_t offset );
+
+        /**
+         * @brief Return a factory of the holds that keep the offset of the message being processed outstanding while the
+         * trip filter holds its BSM; set it on the thread's handler.
+         *
+         * @param current Refers to the message being processed.
+         */
+        TripFilter::HoldFactory hold_factory( RdKafka::Message* const& current );
+
+        /**
+         * @brief Return the message key of the BSM the handler last processed; empty when the output is not keyed.
+         */
+        std::string output_key( BSMHandler& handler ) const;
+
+        /**
+         * @brief Queue a message the handler could not process for the dead-letter topic, producing a batch when due.
+         */
+        void dead_letter( RdKafka::Message* message, const std::string& payload, BSMHandler& handler, int64_t timestamp );
+
+        /**
+         * @brief Produce the due batches of dead letters; with all set, produce every queued letter.
+         */
+        void flush_dead_letters( bool all );
+
+        /**
+         * @brief Return the decision headers of a published BSM; the producer owns them once the BSM is queued.
+         *
+         * @param decision The kind of BSM, e.g., retained.
+         */
+        RdKafka::Headers* decision_headers( const std::string& decision ) const;
+
+        /**
+         * @brief Record a sample of the suppressed decisions on the audit topic.
+         */
+        void audit_decision( RdKafka::Message* message, BSMHandler::ResultStatus result, const std::string& result_string, int64_t timestamp );
+
+        /**
+         * @brief Start, or collect the result of, a background reload of the id inclusions of the handlers.
+         *
+         * @param pending The reload in progress, if any.
+         * @param handlers The handlers whose inclusions are reloaded.
+         */
+        void reload_inclusions_check( std::future<bool>& pending, const std::vector<BSMHandler*>& handlers );
+
+        /**
+         * @brief Drain and shut down after consuming has stopped and the in-flight BSMs are processed: flush the
+         * producer until the shutdown deadline, commit the final offsets up to the oldest BSM not delivered, leave the
+         * consumer group, and log what was drained.
+         */
+        void shutdown();
+
+        /**
+         * @brief Wait before polling a ring that was empty or full again: yield for the first kIdleSpins polls in a
+         * row, then sleep, so an idle stage or lane does not hold its core.
+         *
+         * @param polls The polls in a row that found the ring empty or full; the caller resets it to 0 on success.
+         */
+        static void idle( unsigned& polls );
+
+        /**
+         * @brief Pin the calling thread to a cpu, when cpu is not negative and the platform supports it.
+         */
+        void pin_thread( int cpu, const std::string& stage );
+
         static bool bootstrap;                                          ///> flag indicating we need to bootstrap the consumer and producer
-        static bool bsms_available;                                     ///> flag to find consumer/produce bsms; set via signals so static.
+        static std::atomic<bool> bsms_available;                        ///> flag to find consumer/produce bsms; set via signals so static.
+        static bool reload_inclusions;                                  ///> flag to reload the id inclusion list; set via SIGHUP so static.
 
         bool exit_eof;                                                  ///> flag to cause the application to exit on stream eof.
         int eof_cnt;                                                    ///> counts the number of eofs needed for exit_eof to work; each partition must end.
         int partition_cnt;                                              ///> TODO: the number of partitions being processed; currently 1.
 
         // counters.
-        long bsm_recv_count;                                            ///> Counter for the number of BSMs received.
-        long bsm_send_count;                                            ///> Counter for the number of BSMs published.
-        long bsm_filt_count;                                            ///> Counter for hte number of BSMs filtered/suppressed.
-        int64_t bsm_recv_bytes;                                         ///> Counter for the number of BSM bytes received.
-        int64_t bsm_send_bytes;                                         ///> Counter for the nubmer of BSM bytes published.
-        int64_t bsm_filt_bytes;                                         ///> Counter for the nubmer of BSM bytes filtered/suppressed.
+        std::atomic<long> bsm_recv_count;                               ///> Counter for the number of BSMs received.
+        std::atomic<long> bsm_send_count;                               ///> Counter for the number of BSMs published.
+        std::atomic<long> bsm_filt_count;                               ///> Counter for hte number of BSMs filtered/suppressed.
+        std::atomic<int64_t> bsm_recv_bytes;                            ///> Counter for the number of BSM bytes received.
+        std::atomic<int64_t> bsm_send_bytes;                            ///> Counter for the nubmer of BSM bytes published.
+        std::atomic<int64_t> bsm_filt_bytes;                            ///> Counter for the nubmer of BSM bytes filtered/suppressed.
+
+        // staged pipeline.
+        bool pipelined;                                                 ///> flag to consume, process, and produce on separate threads.
+        unsigned pipeline_workers;                                      ///> The number of processing threads.
+        std::size_t pipeline_ring_size;                                 ///> The capacity of each ring between the stages.
+        std::vector<int> pipeline_cpus;                                 ///> The cpus of the consumer, the workers, and the producer; -1 is unpinned.
+
+        // partition lanes.
+        bool laned;                                                     ///> flag to process each assigned partition in its own lane.
+        std::size_t lane_commit_count;                                  ///> The number of BSMs a lane processes between offset commits.
+        std::map<LaneKey, std::unique_ptr<Lane>> lanes;                 ///> The open lanes by topic partition; changed on the consumer thread only.
+        std::unique_ptr<BSMHandler> lane_handler;                       ///> The handler the lanes copy, so they share its configuration and keys.
+        std::future<bool> lane_reload;                                  ///> The inclusion reload in progress for the lane handlers.
+        Rebalancer rebalancer;
+        std::shared_ptr<DeliveryTracker> deliveries;                    ///> The consumed offsets whose published BSMs were delivered.
+        DeliveryReporter reporter;
+        std::chrono::steady_clock::time_point offsets_stored;           ///> When the delivered offsets were last stored.
+
+        std::shared_ptr<OutputPartitioner> output_partitioner;         ///> The keys and partitions of the published BSMs.
+        std::shared_ptr<LoadShedder> shedder;                           ///> The backlog shedding policy.
+        std::shared_ptr<DeadLetterQueue> dead_letters;                  ///> The unprocessable messages waiting for the dead-letter topic.
+        std::shared_ptr<DecisionAudit> audit;                           ///> The decision headers and the sampled audit of suppressed BSMs.
+        std::string map_hash;                                           ///> The hash of the map file content.
+
+        // startup.
+        std::string mapfile;                                            ///> The geofence map file.
+        bool subscribed;                                                ///> flag indicating the consumer is subscribed to the consumed topic.
+        bool ready;                                                     ///> flag indicating partitions were assigned to the consumer.
+        std::size_t assigned;                                           ///> The number of partitions assigned to the consumer.
+        std::chrono::steady_clock::time_point start_time;               ///> When the PPM started; for the readiness logs.
+
+        int shutdown_timeout;                                           ///> The milliseconds allowed to deliver the queued BSMs at shutdown.
 
         std::string mode;
         std::string debug;
@@ -123,11 +429,14 @@ class PPM : public tool::Tool {
         RdKafka::Conf *tconf;
 
         Quad::Ptr qptr;
+        geo::GridIndex::CPtr grid_index;                                ///> lattice index for uniform grid geofences; nullptr when grids are in the quad.
 
         std::shared_ptr<RdKafka::KafkaConsumer> consumer;
         int consumer_timeout;
         std::shared_ptr<RdKafka::Producer> producer;
         std::shared_ptr<RdKafka::Topic> raw_topic;
         std::shared_ptr<RdKafka::Topic> filtered_topic;
+        std::shared_ptr<RdKafka::Topic> dead_letter_topic;
+        std::shared_ptr<RdKafka::Topic> audit_topic;
 };
 
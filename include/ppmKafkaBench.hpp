@@ -0,0 +1,83 @@
+#ifndef CVDP_PPM_KAFKA_BENCH_H
+#define CVDP_PPM_KAFKA_BENCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "librdkafka/rdkafkacpp.h"
+#include "tool.hpp"
+#include "bsmSynthesizer.hpp"
+
+/**
+ * @brief An end-to-end throughput benchmark of the PPM that needs no network or Kafka installation.
+ *
+ * The benchmark starts librdkafka's in-process mock cluster, preloads the consumed topic with a synthetic BSM corpus,
+ * and then runs the real PPM once per producer setting (batch size, linger, and compression). A reader of the filtered
+ * topic measures the sustained rate, from the first published BSM to the last, and the delivery latency of each BSM,
+ * from when the PPM produced it until the reader received it.
+ */
+class PpmKafkaBench : public tool::Tool {
+
+    public:
+        /**
+         * @brief The producer settings of one run.
+         */
+        struct Setting {
+            std::string batch;                                  ///< batch.num.messages.
+            std::string linger;                                 ///< linger.ms.
+            std::string compression;                            ///< compression.type.
+        };
+
+        /**
+         * @brief The measurements of one run.
+         */
+        struct Result {
+            uint64_t published;                                 ///< The BSMs read from the filtered topic.
+            double seconds;                                     ///< From the first published BSM to the last.
+            double p50;                                         ///< Delivery latency percentiles in milliseconds.
+            double p95;
+            double p99;
+            double max;
+        };
+
+        PpmKafkaBench( const std::string& name, const std::string& description );
+
+        /**
+         * @brief Add the command line options of the benchmark.
+         */
+        void add_options();
+
+        int operator()( void ) override;
+
+        /**
+         * @brief Parse settings written as batch/linger/compression, separated by commas.
+         *
+         * @throws invalid_argument for a setting without three parts.
+         */
+        static std::vector<Setting> parse_settings( const std::string& settings );
+
+        /**
+         * @brief Return the p percentile (0 to 1) of sorted values; 0 when there are none.
+         */
+        static double percentile( const std::vector<double>& sorted, double p );
+
+    private:
+        std::string bootstraps;                                 ///< The mock cluster's brokers.
+        std::string consumed_topic;
+        uint64_t corpus_bytes;
+
+        /**
+         * @brief Produce the synthetic corpus to the consumed topic.
+         *
+         * @return the number of BSMs produced.
+         */
+        uint64_t preload( RdKafka::Producer& loader, const BsmSynthesizer& synthesize, uint64_t count );
+
+        /**
+         * @brief Run the PPM with one setting and read what it publishes.
+         */
+        bool run_setting( const Setting& setting, int index, Result& result );
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef CVDP_PPM_LOADGEN_H
+#define CVDP_PPM_LOADGEN_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "librdkafka/rdkafkacpp.h"
+#include "tool.hpp"
+#include "loadProfile.hpp"
+
+/**
+ * @brief A repeatable capacity test of a running PPM.
+ *
+ * The generator sends synthetic ODE BSMs to the PPM's consumed topic on an open-loop schedule (constant, ramp, or
+ * burst) while a reader collects what the PPM publishes. Afterwards the corpus is run through a handler configured as
+ * the PPM is, in the order and with the timestamps it was sent, and the BSMs the PPM published are checked against
+ * those the handler retained. The latency of each published BSM is measured from when it was due to be sent, so a
+ * generator or PPM that falls behind shows up as latency.
+ */
+class PpmLoadgen : public tool::Tool {
+
+    public:
+        PpmLoadgen( const std::string& name, const std::string& description );
+
+        /**
+         * @brief Add the command line options of the load generator.
+         */
+        void add_options();
+
+        int operator()( void ) override;
+
+    private:
+        std::mutex mutex;
+        std::unordered_map<int64_t, int64_t> received;          ///< Serial number to when it was received, in ms.
+        uint64_t duplicates;                                    ///< Serial numbers received more than once.
+        uint64_t untraced;                                      ///< BSMs received without a serial number.
+        std::atomic<bool> reading;
+
+        /**
+         * @brief Read the filtered topic until reading is cleared.
+         */
+        void read( RdKafka::KafkaConsumer& reader );
+};
+
+#endif
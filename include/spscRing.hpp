@@ -0,0 +1,125 @@
+#ifndef CVDP_SPSC_RING_H
+#define CVDP_SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief A bounded, lock-free ring buffer for exactly one producer thread and one consumer thread, e.g., to pass
+ * message handles between the stages of the PPM pipeline.
+ *
+ * The producer owns the tail index and the consumer the head index; each sits on its own cache line with the
+ * producer's or consumer's cached copy of the other index, so the threads share a line only when the cached index is
+ * stale (the ring looks full or empty).
+ *
+ * @tparam T The element type; it must be default constructible and movable. Handles (pointers) are intended.
+ */
+template <typename T>
+class SpscRing {
+
+    public:
+        static constexpr std::size_t kCacheLine = 64;           ///< The assumed cache line size in bytes.
+
+        /**
+         * @brief Construct a ring.
+         *
+         * @param capacity The minimum number of elements the ring holds; rounded up to a power of two.
+         */
+        explicit SpscRing( std::size_t capacity ) :
+            padding_{},
+            producer_{},
+            consumer_{},
+            mask_{ 0 },
+            slots_{}
+        {
+            std::size_t size = 2;
+            while ( size < capacity ) size *= 2;
+
+            mask_ = size - 1;
+            slots_.resize( size );
+        }
+
+        SpscRing( const SpscRing& ) = delete;
+        SpscRing& operator=( const SpscRing& ) = delete;
+
+        /**
+         * @brief Add an element; called by the producer thread only.
+         *
+         * @return true if the element was added; false if the ring is full.
+         */
+        bool try_push( T&& value ) {
+            std::size_t tail = producer_.index.load( std::memory_order_relaxed );
+
+            if ( tail - producer_.cached >= slots_.size() ) {
+                producer_.cached = consumer_.index.load( std::memory_order_acquire );
+                if ( tail - producer_.cached >= slots_.size() ) {
+                    return false;
+                }
+            }
+
+            slots_[ tail & mask_ ] = std::move( value );
+            producer_.index.store( tail + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @brief Remove the oldest element; called by the consumer thread only.
+         *
+         * @return true if an element was removed into value; false if the ring is empty.
+         */
+        bool try_pop( T& value ) {
+            std::size_t head = consumer_.index.load( std::memory_order_relaxed );
+
+            if ( head == consumer_.cached ) {
+                consumer_.cached = producer_.index.load( std::memory_order_acquire );
+                if ( head == consumer_.cached ) {
+                    return false;
+                }
+            }
+
+            value = std::move( slots_[ head & mask_ ] );
+            consumer_.index.store( head + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+         * @brief Return the approximate number of elements; exact when called from either thread while the other is idle.
+         */
+        std::size_t size() const {
+            return producer_.index.load( std::memory_order_acquire ) - consumer_.index.load( std::memory_order_acquire );
+        }
+
+        /**
+         * @brief Return the number of elements the ring holds.
+         */
+        std::size_t capacity() const {
+            return slots_.size();
+        }
+
+    private:
+        /**
+         * @brief One side's index and its cached copy of the other side's index, alone on a cache line.
+         *
+         * Not aligned, since C++11 new does not honor an extended alignment; padded to two lines instead, so the
+         * sides never share a line wherever the ring is placed.
+         */
+        struct Side {
+            std::atomic<std::size_t> index;                     ///< The next slot this side will use.
+            std::size_t cached;                                 ///< This side's last view of the other side's index.
+            char padding[ 2 * kCacheLine - sizeof( std::atomic<std::size_t> ) - sizeof( std::size_t ) ];
+
+            Side() : index{ 0 }, cached{ 0 } {}
+        };
+
+        char padding_[ kCacheLine ];                            ///< Keeps the members before the ring off the producer's line.
+        Side producer_;                                         ///< Written by the producer.
+        Side consumer_;                                         ///< Written by the consumer.
+        std::size_t mask_;
+        std::vector<T> slots_;
+};
+
+template <typename T>
+constexpr std::size_t SpscRing<T>::kCacheLine;
+
+#endif
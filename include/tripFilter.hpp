@@ -0,0 +1,167 @@
+#ifndef CVDP_TRIP_FILTER_H
+#define CVDP_TRIP_FILTER_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vehicleStateTable.hpp"
+
+using ConfigMap = std::unordered_map<std::string,std::string>;            ///< An alias to a string key - value configuration for the privacy parameters.
+
+/**
+ * @brief A filter that trims the start and end of each vehicle's trip, i.e., the locations that are most likely to
+ * identify the driver.
+ *
+ * A trip starts with the first BSM of a vehicle and ends when the vehicle is not heard from for the timeout. The head
+ * of the trip, until the vehicle is beyond the head distance from its first position (and the head duration has
+ * passed), is suppressed immediately. When tail trimming is configured, each later BSM is held in a per-vehicle delay
+ * ring and released once the vehicle is beyond the tail distance from that BSM's position (and the tail duration has
+ * passed); the BSMs still held when the trip times out are dropped. Without tail trimming no BSM is delayed. A caller
+ * can attach a hold to each held BSM, e.g., to keep its consumed offset uncommitted; the hold is given back with the
+ * BSM when it is released and destroyed when it is dropped.
+ *
+ * Memory is bounded by the number of vehicles times the ring size; when a ring is full, its oldest BSM is released
+ * early, so the ring should hold the BSMs sent while a vehicle travels the tail distance. The trip table is allocated
+ * once: at construction when privacy.filter.trip is ON, otherwise at the first apply. Copies made after it is
+ * allocated share it.
+ */
+class TripFilter {
+
+    public:
+        static constexpr double kDefaultHeadDistance = 200.0;   ///< In meters.
+        static constexpr uint64_t kDefaultTimeout = 120000;     ///< In milliseconds.
+        static constexpr std::size_t kDefaultBuffer = 64;       ///< The default number of BSMs held per vehicle.
+        static constexpr std::size_t kDefaultVehicles = 16384;  ///< The default number of vehicles tracked.
+
+        /**
+         * @brief What to do with a BSM.
+         */
+        enum Disposition { RETAIN, TRIM, HOLD };
+
+        using Hold = std::shared_ptr<void>;                     ///< Kept alive by a held BSM; opaque to the filter.
+        using HoldFactory = std::function<Hold()>;              ///< Makes the hold of the BSM being held.
+
+        /**
+         * @brief A BSM held in a delay ring.
+         */
+        struct Pending {
+            std::string json;                                   ///< The redacted BSM.
+            double lat;
+            double lon;
+            uint64_t time;                                      ///< The time the BSM arrived.
+            Hold hold;                                          ///< Given back on release; nullptr without a factory.
+        };
+
+        /**
+         * @brief The state of a vehicle's trip.
+         */
+        struct Trip {
+            bool started;                                       ///< Flag indicating the first position is known.
+            bool past_head;                                     ///< Flag indicating the vehicle has left the head of the trip.
+            double lat;                                         ///< The first position, then the latest position.
+            double lon;
+            uint64_t start;                                     ///< The time of the first position.
+            std::deque<Pending> pending;                        ///< The delay ring; oldest first.
+
+            Trip() : started{ false }, past_head{ false }, lat{ 0.0 }, lon{ 0.0 }, start{ 0 }, pending{} {}
+        };
+
+        using Table = VehicleStateTable<Trip>;                  ///< The per-vehicle trips.
+
+        /**
+         * @brief Construct a trip filter that trims the default head distance and no tail; nothing is allocated.
+         */
+        TripFilter();
+
+        /**
+         * @brief Construct a trip filter using the specified configuration.
+         *
+         * @param conf The configuration with which to setup this filter.
+         */
+        TripFilter( const ConfigMap& conf );
+
+        /**
+         * @brief Return the trip key of a BSM id; see VehicleStateTable::key.
+         */
+        static uint64_t key( const std::string& id );
+
+        /**
+         * @brief Decide whether a BSM is retained, trimmed, or held; releases the held BSMs of the vehicle that have
+         * left the tail distance behind.
+         *
+         * @param key the trip key of the original BSM id.
+         * @param has_position true if lat and lon are available.
+         * @param lat the BSM latitude in degrees.
+         * @param lon the BSM longitude in degrees.
+         * @param json the redacted BSM; copied when held.
+         * @param released the BSMs to publish before this one are appended to this list, oldest first.
+         * @return the disposition of this BSM.
+         */
+        Disposition apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released );
+
+        /**
+         * @brief Decide what to do with a BSM at the given time; see apply above.
+         *
+         * @param now the current time in milliseconds.
+         */
+        Disposition apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, uint64_t now );
+
+        /**
+         * @brief Decide what to do with a BSM, attaching a hold when it is held; see apply above.
+         *
+         * @param released_holds the holds of the released BSMs are appended to this list, in the order of released.
+         * @param make_hold makes the hold of this BSM if it is held; nullptr for none.
+         */
+        Disposition apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, std::vector<Hold>& released_holds, const HoldFactory* make_hold );
+
+        /**
+         * @brief Decide what to do with a BSM at the given time, attaching a hold when it is held; see apply above.
+         */
+        Disposition apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, std::vector<Hold>& released_holds, const HoldFactory* make_hold, uint64_t now );
+
+        /**
+         * @brief Predicate indicating whether BSMs after the head are held to trim the tail.
+         */
+        bool trims_tail() const;
+
+        double head_distance() const;
+        uint64_t head_duration() const;
+        double tail_distance() const;
+        uint64_t tail_duration() const;
+        uint64_t timeout() const;
+        std::size_t buffer() const;
+
+        /**
+         * @brief Return the trip table metrics; all zero before the table is allocated.
+         */
+        Table::Metrics metrics() const;
+
+        /**
+         * @brief Stop sharing the trip table with the copies of this one; a trip table already allocated
+         * is replaced by a new empty one, otherwise it is allocated on first use as before.
+         */
+        void detach();
+
+    private:
+        double head_distance_;                                  ///< In meters.
+        uint64_t head_duration_;                                ///< In milliseconds.
+        double tail_distance_;                                  ///< In meters.
+        uint64_t tail_duration_;                                ///< In milliseconds.
+        uint64_t timeout_;                                      ///< A vehicle unseen for this long in milliseconds ends its trip.
+        std::size_t buffer_;                                    ///< The delay ring size.
+        std::size_t capacity_;                                  ///< The number of vehicles tracked.
+        uint64_t last_sweep_;                                   ///< The time ended trips were last freed.
+        std::shared_ptr<Table> trips_;                          ///< nullptr until allocated.
+
+        /**
+         * @brief Return the trip table, allocating it on first use.
+         */
+        Table& trips();
+};
+
+#endif
@@ -0,0 +1,290 @@
+#ifndef CVDP_VEHICLE_STATE_TABLE_H
+#define CVDP_VEHICLE_STATE_TABLE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "idRedactor.hpp"
+
+/**
+ * @brief A bounded table of per-vehicle state for stateful privacy filters, keyed by the original BSM id.
+ *
+ * The table is a set associative cache: a key hashes to a shard and to a bucket of #kWays slots within that shard,
+ * so every access is constant time. Each shard has its own lock (lock striping), so threads working on different
+ * vehicles rarely contend. All memory is allocated at construction.
+ *
+ * Time is supplied by the caller (e.g., BSM or Kafka time in milliseconds). A vehicle not seen for longer than the
+ * TTL is expired: its slot is reused, and a later access starts from a fresh state. When a bucket has no free or
+ * expired slot, the least recently seen vehicle in the bucket is evicted.
+ *
+ * @tparam State The per-vehicle state; it must be default constructible and copy assignable.
+ */
+template <typename State>
+class VehicleStateTable {
+
+    public:
+        static constexpr unsigned kWays = 8;                    ///< The number of slots in a bucket.
+        static constexpr unsigned kDefaultShards = 16;          ///< The default number of independently locked shards.
+
+        /**
+         * @brief Occupancy and eviction counters.
+         */
+        struct Metrics {
+            std::size_t capacity;                               ///< The number of slots.
+            std::size_t occupancy;                              ///< The number of slots in use, including expired vehicles not yet reused.
+            uint64_t inserts;                                   ///< The number of vehicles added.
+            uint64_t expirations;                               ///< The number of vehicles removed because their TTL passed.
+            uint64_t evictions;                                 ///< The number of live vehicles removed to make room.
+        };
+
+        /**
+         * @brief Construct a table.
+         *
+         * @param capacity The minimum number of vehicles the table can hold; rounded up so every shard has a power of
+         * two number of buckets.
+         * @param ttl The time after which an unseen vehicle is expired, in the caller's time units.
+         * @param shards The number of shards; rounded up to a power of two.
+         */
+        VehicleStateTable( std::size_t capacity, uint64_t ttl, unsigned shards = kDefaultShards ) :
+            ttl_{ ttl },
+            shard_mask_{ 0 },
+            bucket_mask_{ 0 },
+            shards_{}
+        {
+            unsigned shard_count = 1;
+            while ( shard_count < shards ) shard_count *= 2;
+
+            std::size_t buckets = 1;
+            while ( buckets * shard_count * kWays < capacity ) buckets *= 2;
+
+            shard_mask_ = shard_count - 1;
+            bucket_mask_ = buckets - 1;
+
+            for ( unsigned i = 0; i < shard_count; ++i ) {
+                shards_.emplace_back( new Shard( buckets * kWays ) );
+            }
+        }
+
+        /**
+         * @brief Return the table key of a BSM id: temporary ids (8 hex digits) map to their value, other ids to a hash.
+         */
+        static uint64_t key( const std::string& id ) {
+            uint32_t value;
+            if ( IdRedactor::ParseId( id, value ) ) {
+                return value;
+            }
+
+            // outside the 32-bit range of temporary ids.
+            return static_cast<uint64_t>( std::hash<std::string>{}( id ) ) | ( uint64_t{ 1 } << 63 );
+        }
+
+        /**
+         * @brief Apply a function to the state of a vehicle while holding its shard lock.
+         *
+         * The function is called as f( State& state, bool is_new ); is_new is true when the vehicle was not in the
+         * table (or had expired) and state has been reset to State{}. The vehicle's last seen time becomes now.
+         *
+         * @param key The vehicle key; see key().
+         * @param now The current time in the caller's time units.
+         * @param f The function to apply.
+         * @return the result of f.
+         */
+        template <typename F>
+        auto update( uint64_t key, uint64_t now, F f ) -> decltype( f( std::declval<State&>(), true ) ) {
+            uint64_t h = mix( key );
+            Shard& shard = *shards_[ h & shard_mask_ ];
+            std::lock_guard<std::mutex> lock( shard.mutex );
+
+            Slot* bucket = &shard.slots[ ( ( h >> 32 ) & bucket_mask_ ) * kWays ];
+            Slot* slot = nullptr;
+            Slot* victim = nullptr;
+
+            for ( unsigned w = 0; w < kWays; ++w ) {
+                Slot& s = bucket[w];
+                if ( !s.used ) {
+                    if ( !victim || victim->used ) victim = &s;
+                } else if ( s.key == key ) {
+                    slot = &s;
+                    break;
+                } else if ( !victim || ( victim->used && s.last_seen < victim->last_seen ) ) {
+                    victim = &s;
+                }
+            }
+
+            bool is_new = slot == nullptr;
+
+            if ( slot && expired( *slot, now ) ) {
+                ++shard.expirations;
+                ++shard.inserts;
+                is_new = true;
+            } else if ( is_new ) {
+                slot = victim;
+                if ( slot->used ) {
+                    if ( expired( *slot, now ) ) {
+                        ++shard.expirations;
+                    } else {
+                        ++shard.evictions;
+                    }
+                } else {
+                    slot->used = true;
+                    ++shard.occupancy;
+                }
+                slot->key = key;
+                ++shard.inserts;
+            }
+
+            if ( is_new ) {
+                slot->state = State{};
+            }
+
+            // time may go backwards across sources; keep the latest.
+            if ( is_new || now > slot->last_seen ) {
+                slot->last_seen = now;
+            }
+
+            return f( slot->state, is_new );
+        }
+
+        /**
+         * @brief Apply a function to the state of a vehicle identified by its BSM id; see update( uint64_t, ... ).
+         */
+        template <typename F>
+        auto update( const std::string& id, uint64_t now, F f ) -> decltype( f( std::declval<State&>(), true ) ) {
+            return update( key( id ), now, f );
+        }
+
+        /**
+         * @brief Remove a vehicle from the table.
+         *
+         * @return true if the vehicle was in the table; false otherwise.
+         */
+        bool erase( uint64_t key ) {
+            uint64_t h = mix( key );
+            Shard& shard = *shards_[ h & shard_mask_ ];
+            std::lock_guard<std::mutex> lock( shard.mutex );
+
+            Slot* bucket = &shard.slots[ ( ( h >> 32 ) & bucket_mask_ ) * kWays ];
+            for ( unsigned w = 0; w < kWays; ++w ) {
+                if ( bucket[w].used && bucket[w].key == key ) {
+                    bucket[w].used = false;
+                    bucket[w].state = State{};
+                    --shard.occupancy;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        /**
+         * @brief Free the slots (and reset the states) of all the expired vehicles; expired slots are otherwise reused lazily.
+         *
+         * @param now The current time in the caller's time units.
+         * @return the number of vehicles expired.
+         */
+        std::size_t expire( uint64_t now ) {
+            std::size_t count = 0;
+
+            for ( auto& shard_ptr : shards_ ) {
+                Shard& shard = *shard_ptr;
+                std::lock_guard<std::mutex> lock( shard.mutex );
+
+                for ( auto& s : shard.slots ) {
+                    if ( s.used && expired( s, now ) ) {
+                        s.used = false;
+                        s.state = State{};
+                        --shard.occupancy;
+                        ++shard.expirations;
+                        ++count;
+                    }
+                }
+            }
+
+            return count;
+        }
+
+        /**
+         * @brief Return the table's occupancy and eviction counters.
+         */
+        Metrics metrics() const {
+            Metrics m{ 0, 0, 0, 0, 0 };
+
+            for ( auto& shard_ptr : shards_ ) {
+                Shard& shard = *shard_ptr;
+                std::lock_guard<std::mutex> lock( shard.mutex );
+
+                m.capacity += shard.slots.size();
+                m.occupancy += shard.occupancy;
+                m.inserts += shard.inserts;
+                m.expirations += shard.expirations;
+                m.evictions += shard.evictions;
+            }
+
+            return m;
+        }
+
+        /**
+         * @brief Return the TTL in the caller's time units.
+         */
+        uint64_t ttl() const {
+            return ttl_;
+        }
+
+    private:
+        /**
+         * @brief The state of one vehicle.
+         */
+        struct Slot {
+            uint64_t key;
+            uint64_t last_seen;                                 ///< The latest time the vehicle was seen.
+            bool used;                                          ///< Flag indicating whether the slot holds a vehicle.
+            State state;
+
+            Slot() : key{ 0 }, last_seen{ 0 }, used{ false }, state{} {}
+        };
+
+        /**
+         * @brief An independently locked part of the table.
+         */
+        struct Shard {
+            mutable std::mutex mutex;
+            std::vector<Slot> slots;                            ///< Buckets of kWays slots.
+            std::size_t occupancy;
+            uint64_t inserts;
+            uint64_t expirations;
+            uint64_t evictions;
+
+            explicit Shard( std::size_t size ) : mutex{}, slots( size ), occupancy{ 0 }, inserts{ 0 }, expirations{ 0 }, evictions{ 0 } {}
+        };
+
+        uint64_t ttl_;
+        uint64_t shard_mask_;
+        uint64_t bucket_mask_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+
+        /**
+         * @brief SplitMix64 finalizer; spreads sequential ids over shards and buckets.
+         */
+        static uint64_t mix( uint64_t z ) {
+            z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+            z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+            return z ^ ( z >> 31 );
+        }
+
+        bool expired( const Slot& s, uint64_t now ) const {
+            return now > s.last_seen && now - s.last_seen > ttl_;
+        }
+};
+
+template <typename State>
+constexpr unsigned VehicleStateTable<State>::kWays;
+
+template <typename State>
+constexpr unsigned VehicleStateTable<State>::kDefaultShards;
+
+#endif
@@ -52,6 +52,16 @@ class VelocityFilter {
          */
         void set_max( double v );
 
+        /**
+         * @brief Return the minimum velocity for the filter in meters per second.
+         */
+        double get_min() const;
+
+        /**
+         * @brief Return the maximum velocity for the filter in meters per second.
+         */
+        double get_max() const;
+
         /**
          * @brief Predicate function operator indicating whether this velocity should be filtered, i.e. suppressed.
          *
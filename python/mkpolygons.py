@@ -0,0 +1,61 @@
+"""Union the buffered edges of a shape file into a few polygon shapes.
+
+Usage: python mkpolygons.py <width meters> [tolerance meters] < I_80.edges > I_80.polygons
+
+Every edge is buffered by half the width on each side (flat ends; rounded joins
+come from the union) in a local equirectangular projection centered on the
+data, the buffers are unioned, optionally simplified, and each resulting
+polygon (with holes) is written as a polygon shape line. Requires shapely.
+"""
+import math
+import sys
+
+from shapely.geometry import LineString, MultiPolygon
+from shapely.ops import unary_union
+
+EARTH_RADIUS_M = 6378137.0
+
+width = float(sys.argv[1])
+tolerance = float(sys.argv[2]) if len(sys.argv) > 2 else 0.0
+
+next(sys.stdin)
+
+segments = []
+for l in sys.stdin:
+    parts = l.strip().split(',')
+    if len(parts) < 3 or parts[0] != 'edge':
+        continue
+    points = [p.split(';') for p in parts[2].split(':')]
+    segments.append([(float(p[1]), float(p[2])) for p in points])
+
+if not segments:
+    sys.exit('no edges found on stdin')
+
+lat0 = sum(lat for s in segments for lat, _ in s) / sum(len(s) for s in segments)
+lon0 = sum(lon for s in segments for _, lon in s) / sum(len(s) for s in segments)
+coslat0 = math.cos(math.radians(lat0))
+
+def to_xy(lat, lon):
+    return (math.radians(lon - lon0) * coslat0 * EARTH_RADIUS_M, math.radians(lat - lat0) * EARTH_RADIUS_M)
+
+def to_latlon(x, y):
+    return (lat0 + math.degrees(y / EARTH_RADIUS_M), lon0 + math.degrees(x / (EARTH_RADIUS_M * coslat0)))
+
+buffers = [LineString([to_xy(lat, lon) for lat, lon in s]).buffer(width / 2.0, cap_style=2) for s in segments]
+merged = unary_union(buffers)
+
+if tolerance > 0.0:
+    merged = merged.simplify(tolerance, preserve_topology=True)
+
+polygons = merged.geoms if isinstance(merged, MultiPolygon) else [merged]
+
+def ring_string(ring):
+    # shapely repeats the first vertex at the end; the PPM closes rings implicitly.
+    coords = list(ring.coords)[:-1]
+    return ':'.join('{:.8f};{:.8f}'.format(*to_latlon(x, y)) for x, y in coords)
+
+sys.stdout.write('type,id,geography,attributes\n')
+
+for i, polygon in enumerate(polygons):
+    rings = [ring_string(polygon.exterior)] + [ring_string(hole) for hole in polygon.interiors]
+    sys.stdout.write('polygon,{},{}\n'.format(i, '|'.join(rings)))
@@ -29,12 +29,14 @@
 #include <sstream>
 #include <random>
 #include <limits>
+#include <algorithm>
 
 #include "rapidjson/writer.h"
 #include "rapidjson/stringbuffer.h"
 
 #include "cvlib.hpp"
 #include "bsmHandler.hpp"
+#include "fnv1a.hpp"
 #include "spdlog/spdlog.h"
 #include "redactionPropertiesManager.hpp"
 
@@ -44,17 +46,37 @@ BSMHandler::ResultStringMap BSMHandler::result_string_map{
             { ResultStatus::GEOPOSITION, "geoposition" },
             { ResultStatus::PARSE, "parse" },
             { ResultStatus::MISSING, "missing" },
-            { ResultStatus::OTHER, "other" }
+            { ResultStatus::OTHER, "other" },
+            { ResultStatus::DOWNSAMPLED, "downsampled" },
+            { ResultStatus::DUPLICATE, "duplicate" },
+            { ResultStatus::TRIMMED, "trimmed" },
+            { ResultStatus::HELD, "held" },
+            { ResultStatus::SHED, "shed" }
         };
 
 BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger ):
+    BSMHandler{ quad_ptr, nullptr, conf, logger }
+{}
+
+BSMHandler::BSMHandler(Quad::Ptr quad_ptr, geo::GridIndex::CPtr grid_index_ptr, const ConfigMap& conf, std::shared_ptr<PpmLogger> logger ):
     activated_{0},
+    pipeline_{ select_pipeline( 0 ) },
+    payloads_{ std::make_shared<PayloadRegistry>( conf ) },
+    finalized_{ false },
     result_{ ResultStatus::SUCCESS },
     bsm_{},
     quad_ptr_{quad_ptr},
-    finalized_{ false },
+    grid_index_ptr_{grid_index_ptr},
     json_{},
     vf_{ conf },
+    prefilter_{ quad_ptr ? CorePrefilter{ vf_, *quad_ptr } : CorePrefilter{} },
+    prefiltered_{ 0 },
+    dsf_{ conf },
+    dupf_{ conf },
+    tf_{ conf },
+    released_{},
+    released_holds_{},
+    make_hold_{ nullptr },
     idr_{ conf },
     box_extension_{ 10.0 },
     logger_{ logger }
@@ -76,6 +98,21 @@ BSMHandler::BSMHandler(Quad::Ptr quad_ptr, const ConfigMap& conf, std::shared_pt
         activate<BSMHandler::kGeofenceFilterFlag>();
     }
 
+    search = conf.find("privacy.filter.downsample");
+    if ( search != conf.end() && search->second=="ON" ) {
+        activate<BSMHandler::kDownsampleFlag>();
+    }
+
+    search = conf.find("privacy.filter.duplicates");
+    if ( search != conf.end() && search->second=="ON" ) {
+        activate<BSMHandler::kDuplicateFlag>();
+    }
+
+    search = conf.find("privacy.filter.trip");
+    if ( search != conf.end() && search->second=="ON" ) {
+        activate<BSMHandler::kTripFlag>();
+    }
+
     search = conf.find("privacy.redaction.size");
     if ( search != conf.end() && search->second=="ON" ) {
         activate<BSMHandler::kSizeRedactFlag>();
@@ -101,8 +138,13 @@ bool BSMHandler::isWithinEntity(BSM &bsm) const {
     geo::Circle::CPtr circle_ptr = nullptr;
     geo::EdgeCPtr edge_ptr = nullptr;
     geo::Grid::CPtr grid_ptr = nullptr;
+    geo::Polygon::CPtr polygon_ptr = nullptr;
     geo::AreaPtr area_ptr = nullptr;
 
+    if (grid_index_ptr_ && grid_index_ptr_->contains(bsm)) {
+        return true;
+    }
+
     geo::Entity::PtrList entity_set = quad_ptr_->retrieve_elements(bsm); 
 
     for (auto& entity_ptr : entity_set) {
@@ -131,22 +173,71 @@ bool BSMHandler::isWithinEntity(BSM &bsm) const {
                 return true;
             }
 
+        } else if (entity_ptr->get_type() == "polygon") {
+            polygon_ptr = std::static_pointer_cast<const geo::Polygon>(entity_ptr);
+
+            if (polygon_ptr->contains(bsm)) {
+                return true;
+            }
+
         }
     }
     return false;
 }
 
 bool BSMHandler::process( const std::string& message_json ) {
+    return process( message_json, -1 );
+}
+
+bool BSMHandler::process( const std::string& message_json, int64_t timestamp ) {
+    return (this->*pipeline_)( message_json, timestamp );
+}
+
+bool BSMHandler::process( const std::string& message_json, int64_t timestamp, uint8_t prefiltered ) {
+    prefiltered_ = prefiltered;
+    bool retained = (this->*pipeline_)( message_json, timestamp );
+    prefiltered_ = 0;
+    return retained;
+}
+
+void BSMHandler::shed() {
+    finalized_ = false;
+    result_ = ResultStatus::SHED;
+    released_.clear();
+    released_holds_.clear();
+    bsm_.reset();
+}
+
+std::size_t BSMHandler::prefilter( const int32_t* speed, const int32_t* lat, const int32_t* lon, std::size_t n, uint8_t* result ) {
+    uint8_t checks = 0;
+
+    if (is_active<kVelocityFilterFlag>()) {
+        checks |= CorePrefilter::kSpeed;
+    }
+
+    if (is_active<kGeofenceFilterFlag>() && quad_ptr_ && !grid_index_ptr_) {
+        checks |= CorePrefilter::kOutside;
+    }
+
+    return prefilter_.apply( speed, lat, lon, n, result, checks );
+}
+
+template <uint32_t MASK>
+bool BSMHandler::process_pipeline( const std::string& message_json, int64_t timestamp ) {
     double speed = 0.0;
     double latitude = 0.0;
     double longitude = 0.0;
     std::string id;
+    uint64_t trip_key = 0;
+    bool has_position = false;
     
     // JMC: Attempt to fix memory leak; build and destroy JSON object each time to ensure memory is reclaimed.
     rapidjson::Document document;
 
     finalized_ = false;
     result_ = ResultStatus::SUCCESS;
+    released_.clear();
+    released_holds_.clear();
     
     // create the DOM
     // check for errors
@@ -206,9 +297,15 @@ bool BSMHandler::process( const std::string& message_json ) {
         return false;
     }
 
-    std::string payload_type_str = metadata["payloadType"].GetString();
+    const PayloadType* payload_type = payloads_->find(metadata["payloadType"].GetString(), metadata["payloadType"].GetStringLength());
+
+    if (payload_type == nullptr) {
+        // Unsupported payload type
+        result_ = ResultStatus::MISSING;
+        return false;
+    }
 
-    if (payload_type_str == "us.dot.its.jpo.ode.model.OdeMessageFramePayload") {
+    if (payload_type->builtin) {
         if (!document.HasMember("payload")) {
             result_ = ResultStatus::MISSING;
 
@@ -250,6 +347,16 @@ bool BSMHandler::process( const std::string& message_json ) {
 
         rapidjson::Value& core_data = basicSafetyMessage["coreData"];
 
+        // drop duplicates before any further work; BSMs lacking these fields are checked below.
+        if (is_active<kDuplicateFlag>() && core_data.HasMember("id") && core_data["id"].IsString()
+                && core_data.HasMember("secMark") && core_data["secMark"].IsInt()
+                && core_data.HasMember("msgCnt") && core_data["msgCnt"].IsInt()
+                && dupf_.duplicate(core_data["id"].GetString(), core_data["secMark"].GetInt(), core_data["msgCnt"].GetInt())) {
+            result_ = ResultStatus::DUPLICATE;
+
+            return false;
+        }
+
         if (!core_data.HasMember("speed")) {
             result_ = ResultStatus::MISSING;
 
@@ -268,7 +375,7 @@ bool BSMHandler::process( const std::string& message_json ) {
             speed = core_data["speed"].GetInt() * 0.02;
         }
 
-        if (is_active<kVelocityFilterFlag>() && vf_.suppress(speed)) {
+        if ((MASK & kVelocityFilterFlag) && ((prefiltered_ & CorePrefilter::kSpeed) || vf_.suppress(speed))) {
             result_ = ResultStatus::SPEED;
 
             return false;
@@ -301,7 +408,10 @@ bool BSMHandler::process( const std::string& message_json ) {
             bsm_.set_longitude(longitude);
         }
 
-        if (is_active<kGeofenceFilterFlag>() && !isWithinEntity(bsm_)) {
+        has_position = core_data["lat"].GetInt() != J2735_LATITUDE_UNAVAILABLE && core_data["long"].GetInt() != J2735_LONGITUDE_UNAVAILABLE;
+
+        // outside the quad tree's bounds is outside every entity.
+        if ((MASK & kGeofenceFilterFlag) && ((prefiltered_ & CorePrefilter::kOutside) || !isWithinEntity(bsm_))) {
             result_ = ResultStatus::GEOPOSITION;
 
             return false;
@@ -320,13 +430,29 @@ bool BSMHandler::process( const std::string& message_json ) {
         }
 
         id = core_data["id"].GetString();
-        
 
-        if (is_active<kIdRedactFlag>()) {
+        if (is_active<kDownsampleFlag>()) {
+            int sec_mark = core_data.HasMember("secMark") && core_data["secMark"].IsInt() ? core_data["secMark"].GetInt() : -1;
+
+            if (!dsf_.retain(id, sec_mark, timestamp)) {
+                result_ = ResultStatus::DOWNSAMPLED;
+
+                return false;
+            }
+        }
+
+        if (is_active<kTripFlag>()) {
+            trip_key = TripFilter::key(id);
+        }
+
+        if (MASK & kIdRedactFlag) {
             bsm_.set_original_id(id);
-            idr_(id);
 
-            core_data["id"].SetString(id.c_str(), static_cast<rapidjson::SizeType>(id.size()), document.GetAllocator());
+            char redacted_id[IdRedactor::kIdLength];
+            if (idr_(id, redacted_id)) {
+                core_data["id"].SetString(redacted_id, static_cast<rapidjson::SizeType>(IdRedactor::kIdLength), document.GetAllocator());
+                id.assign(redacted_id, IdRedactor::kIdLength);
+            }
         }
 
         bsm_.set_id(id);
@@ -335,7 +461,7 @@ bool BSMHandler::process( const std::string& message_json ) {
         // Check for BSM size.  
         // Size is a special case; if it's not included, then we do 
         // NOT return an error/suppress
-        if (core_data.HasMember("size") && is_active<kSizeRedactFlag>()) {
+        if ((MASK & kSizeRedactFlag) && core_data.HasMember("size")) {
             // size included
             rapidjson::Value& size = core_data["size"];
           
@@ -350,11 +476,11 @@ bool BSMHandler::process( const std::string& message_json ) {
             } 
         }
 
-        handleGeneralRedaction(document); // uses fieldsToRedact.txt
+        if (MASK & kGeneralRedactFlag) {
+            handleGeneralRedaction(document); // uses fieldsToRedact.txt
+        }
     }
-    else {
-        // Unsupported payload type
-        result_ = ResultStatus::MISSING;
+    else if (!process_payload<MASK>(document, *payload_type)) {
         return false;
     }
 
@@ -366,12 +492,122 @@ bool BSMHandler::process( const std::string& message_json ) {
     document.Accept(writer);
     json_ = buffer.GetString();
 
+    // trimmed and held BSMs are complete, but not published now.
+    if (is_active<kTripFlag>() && payload_type->builtin) {
+        switch (tf_.apply(trip_key, has_position, latitude, longitude, json_, released_, released_holds_, make_hold_)) {
+            case TripFilter::TRIM:
+                result_ = ResultStatus::TRIMMED;
+                break;
+            case TripFilter::HOLD:
+                result_ = ResultStatus::HELD;
+                break;
+            default:
+                break;
+        }
+    }
+
     // TODO: if we keep this model, this variable serves no purpose.
     finalized_ = true;
     
     return result_ == ResultStatus::SUCCESS;
 }
 
+/**
+ * @brief Return the value at the end of a path of member names, or nullptr if a member is missing.
+ */
+static const rapidjson::Value* find_path(const rapidjson::Value& root, const PayloadType::Path& path) {
+    const rapidjson::Value* value = &root;
+
+    for (auto& name : path) {
+        if (!value->IsObject()) {
+            return nullptr;
+        }
+
+        auto member = value->FindMember(name.c_str());
+        if (member == value->MemberEnd()) {
+            return nullptr;
+        }
+
+        value = &member->value;
+    }
+
+    return value;
+}
+
+template <uint32_t MASK>
+bool BSMHandler::process_payload( rapidjson::Document& document, const PayloadType& type ) {
+    const rapidjson::Value* lat = find_path(document, type.latitude);
+    const rapidjson::Value* lon = find_path(document, type.longitude);
+
+    if (lat == nullptr || lon == nullptr) {
+        result_ = ResultStatus::MISSING;
+
+        return false;
+    }
+
+    bool degrees = type.units == PayloadType::Units::DEGREES;
+
+    if (degrees ? !lat->IsNumber() || !lon->IsNumber() : !lat->IsInt() || !lon->IsInt()) {
+        result_ = ResultStatus::OTHER;
+
+        return false;
+    }
+
+    // positions in degrees have no unavailable value; one outside the geofence is suppressed as any other.
+    bool has_position = degrees || (lat->GetInt() != J2735_LATITUDE_UNAVAILABLE && lon->GetInt() != J2735_LONGITUDE_UNAVAILABLE);
+
+    // these types have no id or speed; clear those of a previous BSM for the log.
+    bsm_.set_id("");
+    bsm_.set_velocity(0.0);
+
+    if (degrees) {
+        bsm_.set_latitude(lat->GetDouble());
+        bsm_.set_longitude(lon->GetDouble());
+    } else if (has_position) {
+        bsm_.set_latitude(lat->GetInt() * 1e-7);
+        bsm_.set_longitude(lon->GetInt() * 1e-7);
+    }
+
+    // a message that cannot be placed is not within the geofence.
+    if ((MASK & kGeofenceFilterFlag) && (!has_position || !isWithinEntity(bsm_))) {
+        result_ = ResultStatus::GEOPOSITION;
+
+        return false;
+    }
+
+    for (auto& path : type.redactions) {
+        rapidjsonRedactor.redactMemberByPath(document, path);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Fills a table with the pipeline of every combination of the activation flags, indexed by pipeline_index.
+ */
+template <uint32_t N>
+struct BSMHandler::PipelineTable {
+    static void fill( BSMHandler::Pipeline* table ) {
+        table[N - 1] = &BSMHandler::process_pipeline<BSMHandler::pipeline_mask( N - 1 )>;
+        PipelineTable<N - 1>::fill( table );
+    }
+};
+
+template <>
+struct BSMHandler::PipelineTable<0> {
+    static void fill( BSMHandler::Pipeline* ) {}
+};
+
+BSMHandler::Pipeline BSMHandler::select_pipeline( uint32_t activated ) {
+    static const std::vector<Pipeline> table = []() {
+        std::vector<Pipeline> t( kPipelineCount );
+        PipelineTable<kPipelineCount>::fill( t.data() );
+        return t;
+    }();
+
+    return table[ pipeline_index( activated ) ];
+}
+
 void BSMHandler::handleGeneralRedaction(rapidjson::Document& document) {
     if (is_active<kGeneralRedactFlag>()) {
         for (std::string memberPath : rpm.getFields()) {
@@ -443,6 +679,148 @@ const VelocityFilter& BSMHandler::get_velocity_filter() const {
     return vf_;
 }
 
+const DownsampleFilter& BSMHandler::get_downsample_filter() const {
+    return dsf_;
+}
+
+const PayloadRegistry& BSMHandler::get_payload_registry() const {
+    return *payloads_;
+}
+
+const DuplicateFilter& BSMHandler::get_duplicate_filter() const {
+    return dupf_;
+}
+
+const TripFilter& BSMHandler::get_trip_filter() const {
+    return tf_;
+}
+
+const std::vector<std::string>& BSMHandler::get_released() const {
+    return released_;
+}
+
+const std::vector<TripFilter::Hold>& BSMHandler::get_released_holds() const {
+    return released_holds_;
+}
+
+void BSMHandler::set_hold_factory( const TripFilter::HoldFactory* make_hold ) {
+    make_hold_ = make_hold;
+}
+
+bool BSMHandler::vehicle_key( const char* json, std::size_t length, uint64_t& key ) {
+    static const char core_data[] = "\"coreData\"";
+    static const char id[] = "\"id\"";
+
+    const char* end = json + length;
+    const char* p = std::search( json, end, core_data, core_data + sizeof(core_data) - 1 );
+    if (p == end) return false;
+
+    p = std::search( p, end, id, id + sizeof(id) - 1 );
+    if (p == end) return false;
+
+    // "id" : "value"
+    p += sizeof(id) - 1;
+    while (p != end && (*p == ' ' || *p == ':')) ++p;
+    if (p == end || *p != '"') return false;
+
+    const char* value = ++p;
+    p = std::find( value, end, '"' );
+    if (p == end) return false;
+
+    key = fnv1a( value, static_cast<std::size_t>( p - value ) );
+    return true;
+}
+
+/**
+ * @brief Parse the JSON integer at p into value; return the end of the integer, or nullptr if it is not a 32-bit integer.
+ */
+static const char* raw_int( const char* p, const char* end, int32_t& value ) {
+    bool negative = p != end && *p == '-';
+    if (negative) ++p;
+    if (p == end || *p < '0' || *p > '9') return nullptr;
+
+    int64_t v = 0;
+    for ( ; p != end && *p >= '0' && *p <= '9'; ++p ) {
+        v = v * 10 + (*p - '0');
+        if (v > std::numeric_limits<int32_t>::max()) return nullptr;
+    }
+
+    // a fraction or exponent is not an integer; process suppresses it as OTHER.
+    if (p != end && (*p == '.' || *p == 'e' || *p == 'E')) return nullptr;
+
+    value = static_cast<int32_t>( negative ? -v : v );
+    return p;
+}
+
+bool BSMHandler::core_fields( const char* json, std::size_t length, int32_t& speed, int32_t& lat, int32_t& lon ) {
+    static const char basic_safety_message[] = "\"BasicSafetyMessage\"";
+    static const char core_data[] = "\"coreData\"";
+
+    const char* end = json + length;
+    const char* p = std::search( json, end, basic_safety_message, basic_safety_message + sizeof(basic_safety_message) - 1 );
+    if (p == end) return false;
+
+    p = std::search( p, end, core_data, core_data + sizeof(core_data) - 1 );
+    if (p == end) return false;
+
+    // "coreData" : { ... }
+    p += sizeof(core_data) - 1;
+    while (p != end && (*p == ' ' || *p == ':')) ++p;
+    if (p == end || *p != '{') return false;
+
+    // only the members of coreData itself, not those of its nested objects.
+    unsigned found = 0;
+    int depth = 0;
+
+    while (p != end) {
+        char c = *p++;
+
+        if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) break;
+        } else if (c == '"') {
+            const char* name = p;
+            while (p != end && *p != '"') p += (*p == '\\' && p + 1 != end) ? 2 : 1;
+            if (p == end) return false;
+
+            std::size_t name_length = static_cast<std::size_t>( p++ - name );
+            const char* value = p;
+            bool member = false;
+            while (value != end && (*value == ' ' || *value == ':')) member = *value++ == ':' || member;
+
+            int32_t* field = nullptr;
+            unsigned bit = 0;
+            if (depth == 1 && member) {
+                if (name_length == 5 && std::equal( name, name + 5, "speed" )) {
+                    field = &speed;
+                    bit = 0x1;
+                } else if (name_length == 3 && std::equal( name, name + 3, "lat" )) {
+                    field = &lat;
+                    bit = 0x2;
+                } else if (name_length == 4 && std::equal( name, name + 4, "long" )) {
+                    field = &lon;
+                    bit = 0x4;
+                }
+            }
+
+            if (field) {
+                p = raw_int( value, end, *field );
+                if (!p) return false;
+                found |= bit;
+            }
+        }
+    }
+
+    return found == 0x7;
+}
+
+void BSMHandler::own_state() {
+    dsf_.detach();
+    dupf_.detach();
+    tf_.detach();
+}
+
 const uint32_t BSMHandler::get_activation_flag() const {
     return activated_;
 }
@@ -451,6 +829,10 @@ const IdRedactor& BSMHandler::get_id_redactor() const {
     return idr_;
 }
 
+IdRedactor& BSMHandler::get_id_redactor() {
+    return idr_;
+}
+
 RapidjsonRedactor& BSMHandler::getRapidjsonRedactor() {
     return rapidjsonRedactor;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <cstdio>
+
+#include "rapidjson/document.h"
+#include "rapidjson/pointer.h"
+#include "rapidjson/stringbuffer.h"
+#include "rapidjson/writer.h"
+
+#include "bsmSynthesizer.hpp"
+
+namespace {
+
+const char* kCoreData = "/payload/data/value/BasicSafetyMessage/coreData";
+const char* kId = "/payload/data/value/BasicSafetyMessage/coreData/id";
+const char* kMsgCnt = "/payload/data/value/BasicSafetyMessage/coreData/msgCnt";
+const char* kSecMark = "/payload/data/value/BasicSafetyMessage/coreData/secMark";
+const char* kSerial = "/metadata/serialId/serialNumber";
+
+}
+
+BsmSynthesizer::BsmSynthesizer( const std::vector<std::string>& templates, uint64_t vehicles ) :
+    templates_{},
+    vehicles_{ vehicles ? vehicles : 1 }
+{
+    for ( auto& t : templates ) {
+        rapidjson::Document document;
+
+        if ( !document.Parse( t.c_str() ).HasParseError() ) {
+            const rapidjson::Value* core = rapidjson::Pointer( kCoreData ).Get( document );
+            if ( core && core->IsObject() ) {
+                templates_.push_back( t );
+            }
+        }
+    }
+}
+
+std::size_t BsmSynthesizer::size() const
+{
+    return templates_.size();
+}
+
+std::string BsmSynthesizer::operator()( uint64_t n ) const
+{
+    if ( templates_.empty() ) {
+        return "";
+    }
+
+    rapidjson::Document document;
+    document.Parse( templates_[ n % templates_.size() ].c_str() );
+
+    // each vehicle sends every 100 ms.
+    uint64_t sent = n / vehicles_;
+    rapidjson::Pointer( kId ).Set( document, id( n ).c_str() );
+    rapidjson::Pointer( kMsgCnt ).Set( document, static_cast<unsigned>( sent % 128 ) );
+    rapidjson::Pointer( kSecMark ).Set( document, static_cast<unsigned>( ( sent * 100 ) % 60000 ) );
+    rapidjson::Pointer( kSerial ).Set( document, static_cast<uint64_t>( n ) );
+
+    rapidjson::StringBuffer buffer;
+    rapidjson::Writer<rapidjson::StringBuffer> writer{ buffer };
+    document.Accept( writer );
+    return buffer.GetString();
+}
+
+std::string BsmSynthesizer::id( uint64_t n ) const
+{
+    char id[9];
+    std::snprintf( id, sizeof(id), "%08X", static_cast<unsigned>( n % vehicles_ ) );
+    return id;
+}
+
+int64_t BsmSynthesizer::serial( const std::string& bsm )
+{
+    rapidjson::Document document;
+
+    if ( document.Parse( bsm.c_str() ).HasParseError() ) {
+        return -1;
+    }
+
+    const rapidjson::Value* serial = rapidjson::Pointer( kSerial ).Get( document );
+    return serial && serial->IsUint64() ? static_cast<int64_t>( serial->GetUint64() ) : -1;
+}
@@ -0,0 +1,131 @@
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "corePrefilter.hpp"
+
+constexpr uint8_t CorePrefilter::kSpeed;
+constexpr uint8_t CorePrefilter::kOutside;
+constexpr int32_t CorePrefilter::kSpeedUnavailable;
+constexpr int32_t CorePrefilter::kLatitudeUnavailable;
+constexpr int32_t CorePrefilter::kLongitudeUnavailable;
+
+namespace {
+
+const double kSpeedUnit = 0.02;                                 ///< J2735 speed units in m/s.
+const double kPositionUnit = 1e-7;                              ///< J2735 lat and long units in degrees.
+
+const int32_t kRawMin = std::numeric_limits<int32_t>::min();
+const int32_t kRawMax = std::numeric_limits<int32_t>::max();
+
+/**
+ * @brief Return the smallest raw value r such that r * unit >= v, computed as BSMHandler::process does.
+ */
+int32_t first_at_least( double v, double unit ) {
+    double scaled = std::ceil( v / unit );
+    if ( !( scaled > kRawMin ) ) return kRawMin;
+    if ( scaled >= kRawMax ) return kRawMax;
+
+    int64_t r = static_cast<int64_t>( scaled );
+    while ( r < kRawMax && static_cast<double>( r ) * unit < v ) ++r;
+    while ( r > kRawMin && static_cast<double>( r - 1 ) * unit >= v ) --r;
+    return static_cast<int32_t>( r );
+}
+
+/**
+ * @brief Return the largest raw value r such that r * unit <= v, computed as BSMHandler::process does.
+ */
+int32_t last_at_most( double v, double unit ) {
+    double scaled = std::floor( v / unit );
+    if ( !( scaled < kRawMax ) ) return kRawMax;
+    if ( scaled <= kRawMin ) return kRawMin;
+
+    int64_t r = static_cast<int64_t>( scaled );
+    while ( r > kRawMin && static_cast<double>( r ) * unit > v ) --r;
+    while ( r < kRawMax && static_cast<double>( r + 1 ) * unit <= v ) ++r;
+    return static_cast<int32_t>( r );
+}
+
+}
+
+CorePrefilter::CorePrefilter() :
+    speed_min_{ kRawMin },
+    speed_max_{ kRawMax },
+    lat_min_{ kRawMin },
+    lat_max_{ kRawMax },
+    lon_min_{ kRawMin },
+    lon_max_{ kRawMax }
+{}
+
+CorePrefilter::CorePrefilter( const VelocityFilter& vf, const geo::Bounds& bounds ) :
+    speed_min_{ first_at_least( vf.get_min(), kSpeedUnit ) },
+    speed_max_{ last_at_most( vf.get_max(), kSpeedUnit ) },
+    lat_min_{ first_at_least( bounds.sw.lat, kPositionUnit ) },
+    lat_max_{ last_at_most( bounds.ne.lat, kPositionUnit ) },
+    lon_min_{ first_at_least( bounds.sw.lon, kPositionUnit ) },
+    lon_max_{ last_at_most( bounds.ne.lon, kPositionUnit ) }
+{}
+
+std::size_t CorePrefilter::apply( const int32_t* speed, const int32_t* lat, const int32_t* lon, std::size_t n, uint8_t* result, uint8_t checks ) const
+{
+    std::size_t kept = 0;
+    std::size_t i = 0;
+
+#ifdef __SSE2__
+    static const int kPopCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+    const __m128i speed_unavailable = _mm_set1_epi32( kSpeedUnavailable );
+    const __m128i lat_unavailable = _mm_set1_epi32( kLatitudeUnavailable );
+    const __m128i lon_unavailable = _mm_set1_epi32( kLongitudeUnavailable );
+    const __m128i speed_min = _mm_set1_epi32( speed_min_ );
+    const __m128i speed_max = _mm_set1_epi32( speed_max_ );
+    const __m128i lat_min = _mm_set1_epi32( lat_min_ );
+    const __m128i lat_max = _mm_set1_epi32( lat_max_ );
+    const __m128i lon_min = _mm_set1_epi32( lon_min_ );
+    const __m128i lon_max = _mm_set1_epi32( lon_max_ );
+    const __m128i speed_bit = _mm_set1_epi32( checks & kSpeed );
+    const __m128i outside_bit = _mm_set1_epi32( checks & kOutside );
+    const __m128i zero = _mm_setzero_si128();
+
+    // 8 BSMs per iteration: two groups of 4 lanes packed into 8 result bytes.
+    for ( ; i + 8 <= n; i += 8 ) {
+        __m128i group[2];
+
+        for ( int g = 0; g < 2; ++g ) {
+            __m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i*>( speed + i + 4 * g ) );
+            __m128i la = _mm_loadu_si128( reinterpret_cast<const __m128i*>( lat + i + 4 * g ) );
+            __m128i lo = _mm_loadu_si128( reinterpret_cast<const __m128i*>( lon + i + 4 * g ) );
+
+            s = _mm_andnot_si128( _mm_cmpeq_epi32( s, speed_unavailable ), s );
+            __m128i slow = _mm_or_si128( _mm_cmplt_epi32( s, speed_min ), _mm_cmpgt_epi32( s, speed_max ) );
+
+            __m128i outside = _mm_or_si128( _mm_cmplt_epi32( la, lat_min ), _mm_cmpgt_epi32( la, lat_max ) );
+            outside = _mm_or_si128( outside, _mm_cmplt_epi32( lo, lon_min ) );
+            outside = _mm_or_si128( outside, _mm_cmpgt_epi32( lo, lon_max ) );
+            outside = _mm_or_si128( outside, _mm_cmpeq_epi32( la, lat_unavailable ) );
+            outside = _mm_or_si128( outside, _mm_cmpeq_epi32( lo, lon_unavailable ) );
+
+            group[g] = _mm_or_si128( _mm_and_si128( slow, speed_bit ), _mm_and_si128( outside, outside_bit ) );
+            kept += kPopCount[ _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( group[g], zero ) ) ) ];
+        }
+
+        __m128i packed = _mm_packs_epi32( group[0], group[1] );
+        _mm_storel_epi64( reinterpret_cast<__m128i*>( result + i ), _mm_packus_epi16( packed, packed ) );
+    }
+#endif
+
+    for ( ; i < n; ++i ) {
+        int32_t s = speed[i] == kSpeedUnavailable ? 0 : speed[i];
+        bool slow = s < speed_min_ || s > speed_max_;
+        bool outside = lat[i] < lat_min_ || lat[i] > lat_max_ || lon[i] < lon_min_ || lon[i] > lon_max_
+            || lat[i] == kLatitudeUnavailable || lon[i] == kLongitudeUnavailable;
+
+        result[i] = static_cast<uint8_t>( ( slow ? checks & kSpeed : 0 ) | ( outside ? checks & kOutside : 0 ) );
+        kept += result[i] == 0;
+    }
+
+    return kept;
+}
@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#include "deadLetterQueue.hpp"
+
+constexpr std::size_t DeadLetterQueue::kDefaultBatch;
+constexpr int64_t DeadLetterQueue::kDefaultLinger;
+constexpr std::size_t DeadLetterQueue::kDefaultCapacity;
+
+DeadLetterQueue::DeadLetterQueue() :
+    topic_{},
+    batch_{ kDefaultBatch },
+    linger_{ kDefaultLinger },
+    capacity_{ kDefaultCapacity },
+    mutex_{},
+    letters_{},
+    size_{ 0 },
+    oldest_{ -1 },
+    queued_{ 0 },
+    dropped_{ 0 },
+    produced_{ 0 },
+    failed_{ 0 }
+{}
+
+DeadLetterQueue::DeadLetterQueue( const ConfigMap& conf ) :
+    DeadLetterQueue{}
+{
+    auto search = conf.find("privacy.deadletter.topic");
+    if ( search != conf.end() ) {
+        topic_ = search->second;
+    }
+
+    search = conf.find("privacy.deadletter.batch");
+    if ( search != conf.end() ) {
+        batch_ = std::stoul( search->second );                  // throws.
+        if ( batch_ == 0 ) {
+            throw std::invalid_argument( "privacy.deadletter.batch must be at least 1." );
+        }
+    }
+
+    search = conf.find("privacy.deadletter.linger.ms");
+    if ( search != conf.end() ) {
+        linger_ = std::stoll( search->second );                 // throws.
+    }
+
+    search = conf.find("privacy.deadletter.capacity");
+    if ( search != conf.end() ) {
+        capacity_ = std::stoul( search->second );               // throws.
+        if ( capacity_ == 0 ) {
+            throw std::invalid_argument( "privacy.deadletter.capacity must be at least 1." );
+        }
+    }
+}
+
+bool DeadLetterQueue::enabled() const
+{
+    return !topic_.empty();
+}
+
+const std::string& DeadLetterQueue::topic() const
+{
+    return topic_;
+}
+
+bool DeadLetterQueue::routes( BSMHandler::ResultStatus result )
+{
+    return result == BSMHandler::ResultStatus::PARSE || result == BSMHandler::ResultStatus::MISSING || result == BSMHandler::ResultStatus::OTHER;
+}
+
+bool DeadLetterQueue::add( Letter&& letter, int64_t now )
+{
+    {
+        std::lock_guard<std::mutex> lock{ mutex_ };
+
+        if ( letters_.size() >= capacity_ ) {
+            ++dropped_;
+            return true;
+        }
+
+        if ( letters_.empty() ) {
+            oldest_ = now;
+        }
+
+        letters_.push_back( std::move( letter ) );
+        size_ = letters_.size();
+    }
+
+    ++queued_;
+    return due( now );
+}
+
+bool DeadLetterQueue::due( int64_t now ) const
+{
+    int64_t oldest = oldest_.load( std::memory_order_relaxed );
+    return oldest >= 0 && ( size_.load( std::memory_order_relaxed ) >= batch_ || now - oldest >= linger_ );
+}
+
+std::vector<DeadLetterQueue::Letter> DeadLetterQueue::take()
+{
+    std::vector<Letter> batch;
+    std::lock_guard<std::mutex> lock{ mutex_ };
+
+    if ( letters_.size() <= batch_ ) {
+        batch.swap( letters_ );
+    } else {
+        auto end = letters_.begin() + batch_;
+        batch.assign( std::make_move_iterator( letters_.begin() ), std::make_move_iterator( end ) );
+        letters_.erase( letters_.begin(), end );
+    }
+
+    size_ = letters_.size();
+
+    // the letters left keep the time of the oldest, so they are due at once.
+    if ( letters_.empty() ) {
+        oldest_ = -1;
+    }
+
+    return batch;
+}
+
+void DeadLetterQueue::delivered( uint64_t produced, uint64_t failed )
+{
+    produced_ += produced;
+    failed_ += failed;
+}
+
+DeadLetterQueue::Metrics DeadLetterQueue::metrics() const
+{
+    return Metrics{ queued_.load(), dropped_.load(), produced_.load(), failed_.load() };
+}
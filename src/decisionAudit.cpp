@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <stdexcept>
+
+#include "decisionAudit.hpp"
+#include "fnv1a.hpp"
+
+constexpr uint64_t DecisionAudit::kDefaultSample;
+
+DecisionAudit::DecisionAudit() :
+    log_decisions_{ true },
+    headers_enabled_{ false },
+    topic_{},
+    sample_{ kDefaultSample },
+    headers_{}
+{
+    for ( auto& seen : seen_ ) {
+        seen = 0;
+    }
+}
+
+DecisionAudit::DecisionAudit( const ConfigMap& conf ) :
+    DecisionAudit{}
+{
+    auto search = conf.find("privacy.log.decisions");
+    log_decisions_ = search == conf.end() || search->second != "OFF";
+
+    search = conf.find("privacy.output.headers");
+    headers_enabled_ = search != conf.end() && search->second == "ON";
+
+    search = conf.find("privacy.audit.topic");
+    if ( search != conf.end() ) {
+        topic_ = search->second;
+    }
+
+    search = conf.find("privacy.audit.sample");
+    if ( search != conf.end() ) {
+        sample_ = std::stoull( search->second );                // throws.
+        if ( sample_ == 0 ) {
+            throw std::invalid_argument( "privacy.audit.sample must be at least 1." );
+        }
+    }
+}
+
+bool DecisionAudit::log_decisions() const
+{
+    return log_decisions_;
+}
+
+bool DecisionAudit::headers_enabled() const
+{
+    return headers_enabled_;
+}
+
+bool DecisionAudit::audit_enabled() const
+{
+    return !topic_.empty();
+}
+
+const std::string& DecisionAudit::topic() const
+{
+    return topic_;
+}
+
+void DecisionAudit::set_build( const std::string& version, const std::string& map, uint32_t flags )
+{
+    char hex[9];
+    std::snprintf( hex, sizeof(hex), "%08x", flags );
+
+    headers_ = Headers{ { "ppm.version", version }, { "ppm.map", map }, { "ppm.flags", hex } };
+}
+
+const DecisionAudit::Headers& DecisionAudit::headers() const
+{
+    return headers_;
+}
+
+bool DecisionAudit::sample( BSMHandler::ResultStatus result, uint64_t& represents )
+{
+    if ( result >= seen_.size() ) {
+        return false;
+    }
+
+    // the first of every sample decisions is recorded, so a quiet result is still seen.
+    if ( seen_[result]++ % sample_ != 0 ) {
+        return false;
+    }
+
+    represents = sample_;
+    return true;
+}
+
+std::string DecisionAudit::record( const std::string& result, const std::string& topic, int32_t partition, int64_t offset, int64_t timestamp, uint64_t represents )
+{
+    return "{\"result\":\"" + result + "\",\"topic\":\"" + topic + "\",\"partition\":" + std::to_string(partition)
+        + ",\"offset\":" + std::to_string(offset) + ",\"timestamp\":" + std::to_string(timestamp)
+        + ",\"represents\":" + std::to_string(represents) + "}";
+}
+
+std::string DecisionAudit::hash( std::istream& in )
+{
+    uint64_t h = kFnv1aOffsetBasis;
+    char buffer[4096];
+
+    while ( in.read( buffer, sizeof(buffer) ) || in.gcount() > 0 ) {
+        h = fnv1a( buffer, static_cast<std::size_t>( in.gcount() ), h );
+    }
+
+    char hex[17];
+    std::snprintf( hex, sizeof(hex), "%016llx", static_cast<unsigned long long>( h ) );
+    return hex;
+}
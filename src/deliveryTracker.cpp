@@ -0,0 +1,146 @@
+#include "deliveryTracker.hpp"
+
+DeliveryTracker::Source::Source( const std::string& topic, int32_t partition ) :
+    topic_{ topic },
+    partition_{ partition },
+    mutex_{},
+    outstanding_{},
+    next_{ -1 },
+    generation_{ 0 }
+{}
+
+const std::string& DeliveryTracker::Source::topic() const
+{
+    return topic_;
+}
+
+int32_t DeliveryTracker::Source::partition() const
+{
+    return partition_;
+}
+
+DeliveryTracker::Hold::Hold( DeliveryTracker& tracker, Source& source, int64_t offset ) :
+    tracker_( tracker ),
+    source_( source ),
+    offset_{ offset },
+    generation_{ 0 }
+{
+    std::lock_guard<std::mutex> lock( source_.mutex_ );
+    generation_ = source_.generation_;
+    ++source_.outstanding_[ offset_ ];
+}
+
+DeliveryTracker::Hold::~Hold()
+{
+    if ( tracker_.frozen_ ) return;
+
+    std::lock_guard<std::mutex> lock( source_.mutex_ );
+    settle( source_, offset_, generation_ );
+}
+
+DeliveryTracker::Source& DeliveryTracker::Hold::source() const
+{
+    return source_;
+}
+
+int64_t DeliveryTracker::Hold::offset() const
+{
+    return offset_;
+}
+
+DeliveryTracker::DeliveryTracker() :
+    mutex_{},
+    sources_{},
+    frozen_{ false }
+{}
+
+DeliveryTracker::Source& DeliveryTracker::source( const std::string& topic, int32_t partition )
+{
+    std::lock_guard<std::mutex> lock( mutex_ );
+    std::unique_ptr<Source>& source = sources_[ std::make_pair( topic, partition ) ];
+
+    if ( !source ) {
+        source.reset( new Source{ topic, partition } );
+    }
+    return *source;
+}
+
+DeliveryTracker::Delivery* DeliveryTracker::produced( Source& source, int64_t offset )
+{
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    ++source.outstanding_[ offset ];
+    return new Delivery{ &source, offset, source.generation_ };
+}
+
+void DeliveryTracker::processed( Source& source, int64_t offset )
+{
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    source.next_ = offset + 1;
+}
+
+std::shared_ptr<DeliveryTracker::Hold> DeliveryTracker::hold( Source& source, int64_t offset )
+{
+    return std::make_shared<Hold>( *this, source, offset );
+}
+
+void DeliveryTracker::freeze_holds()
+{
+    frozen_ = true;
+}
+
+void DeliveryTracker::thaw_holds()
+{
+    frozen_ = false;
+}
+
+void DeliveryTracker::delivered( Delivery* delivery, bool ok )
+{
+    std::unique_ptr<Delivery> owned{ delivery };
+    if ( !ok ) return;
+
+    Source& source = *delivery->source;
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    settle( source, delivery->offset, delivery->generation );
+}
+
+uint64_t DeliveryTracker::reset( Source& source )
+{
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    uint64_t forgotten = 0;
+
+    for ( auto& entry : source.outstanding_ ) {
+        forgotten += entry.second;
+    }
+
+    source.outstanding_.clear();
+    source.next_ = -1;
+    ++source.generation_;
+    return forgotten;
+}
+
+void DeliveryTracker::settle( Source& source, int64_t offset, uint64_t generation )
+{
+    if ( generation != source.generation_ ) return;
+
+    auto search = source.outstanding_.find( offset );
+    if ( search != source.outstanding_.end() && --search->second == 0 ) {
+        source.outstanding_.erase( search );
+    }
+}
+
+int64_t DeliveryTracker::committable( const Source& source ) const
+{
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    return source.outstanding_.empty() ? source.next_ : source.outstanding_.begin()->first;
+}
+
+uint64_t DeliveryTracker::undelivered( const Source& source ) const
+{
+    std::lock_guard<std::mutex> lock( source.mutex_ );
+    uint64_t count = 0;
+
+    for ( auto& entry : source.outstanding_ ) {
+        count += entry.second;
+    }
+    return count;
+}
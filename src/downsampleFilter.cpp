@@ -0,0 +1,120 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "downsampleFilter.hpp"
+
+constexpr uint64_t DownsampleFilter::kDefaultInterval;
+constexpr std::size_t DownsampleFilter::kDefaultVehicles;
+constexpr uint64_t DownsampleFilter::kVehicleTTL;
+constexpr int DownsampleFilter::kSecMarkRange;
+constexpr uint64_t DownsampleFilter::kMaxSecMarkInterval;
+
+DownsampleFilter::DownsampleFilter() :
+    interval_{ kDefaultInterval },
+    sec_mark_{ true },
+    capacity_{ kDefaultVehicles },
+    vehicles_{}
+{}
+
+DownsampleFilter::DownsampleFilter( const ConfigMap& conf ) :
+    DownsampleFilter{}
+{
+    auto search = conf.find("privacy.filter.downsample.interval");
+    if ( search != conf.end() ) {
+        interval_ = std::stoull( search->second );
+    }
+
+    search = conf.find("privacy.filter.downsample.clock");
+    if ( search != conf.end() ) {
+        if ( search->second == "kafka" ) {
+            sec_mark_ = false;
+        } else if ( search->second != "secmark" ) {
+            throw std::invalid_argument( "unknown down-sampling clock: " + search->second );
+        }
+    }
+
+    // a longer interval would never elapse: later secMarks look like late messages, and the vehicle never ages out.
+    if ( sec_mark_ && interval_ > kMaxSecMarkInterval ) {
+        throw std::invalid_argument( "down-sampling interval " + std::to_string( interval_ ) + " exceeds the "
+            + std::to_string( kMaxSecMarkInterval ) + " ms the secmark clock can measure; use the kafka clock." );
+    }
+
+    search = conf.find("privacy.filter.downsample.vehicles");
+    if ( search != conf.end() ) {
+        capacity_ = std::stoul( search->second );
+    }
+
+    // allocated now so the handlers copied from this one share the table.
+    search = conf.find("privacy.filter.downsample");
+    if ( search != conf.end() && search->second == "ON" ) {
+        vehicles();
+    }
+}
+
+VehicleStateTable<int64_t>& DownsampleFilter::vehicles()
+{
+    if ( !vehicles_ ) {
+        vehicles_ = std::make_shared<VehicleStateTable<int64_t>>( capacity_, kVehicleTTL );
+    }
+    return *vehicles_;
+}
+
+bool DownsampleFilter::retain( const std::string& id, int sec_mark, int64_t timestamp )
+{
+    uint64_t interval = interval_;
+
+    if ( sec_mark_ ) {
+        if ( sec_mark < 0 || sec_mark >= kSecMarkRange ) {
+            return true;
+        }
+
+        // secMark wraps every minute, so the table is aged with the local clock instead.
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() );
+
+        return vehicles().update( id, static_cast<uint64_t>( now.count() ), [sec_mark, interval]( int64_t& last, bool is_new ) {
+            int elapsed = ( sec_mark - static_cast<int>( last ) + kSecMarkRange ) % kSecMarkRange;
+
+            // more than half a minute "later" is a late message from before the last retained one.
+            if ( is_new || ( elapsed >= static_cast<int>( interval ) && elapsed <= kSecMarkRange / 2 ) ) {
+                last = sec_mark;
+                return true;
+            }
+            return false;
+        } );
+    }
+
+    if ( timestamp < 0 ) {
+        return true;
+    }
+
+    return vehicles().update( id, static_cast<uint64_t>( timestamp ), [timestamp, interval]( int64_t& last, bool is_new ) {
+        if ( is_new || timestamp - last >= static_cast<int64_t>( interval ) ) {
+            last = timestamp;
+            return true;
+        }
+        return false;
+    } );
+}
+
+uint64_t DownsampleFilter::interval() const
+{
+    return interval_;
+}
+
+bool DownsampleFilter::uses_sec_mark() const
+{
+    return sec_mark_;
+}
+
+void DownsampleFilter::detach()
+{
+    if ( vehicles_ ) {
+        vehicles_.reset();
+        vehicles();
+    }
+}
+
+VehicleStateTable<int64_t>::Metrics DownsampleFilter::metrics() const
+{
+    return vehicles_ ? vehicles_->metrics() : VehicleStateTable<int64_t>::Metrics{ 0, 0, 0, 0, 0 };
+}
@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <chrono>
+
+#include "duplicateFilter.hpp"
+#include "vehicleStateTable.hpp"
+
+constexpr uint64_t DuplicateFilter::kDefaultWindow;
+constexpr std::size_t DuplicateFilter::kDefaultCapacity;
+constexpr unsigned DuplicateFilter::kBitsPerBSM;
+constexpr unsigned DuplicateFilter::kBlockWords;
+
+namespace {
+
+/**
+ * @brief Odd multipliers that select the bit set in each word of a block (from the Parquet split block bloom filter).
+ */
+constexpr uint32_t kSalt[DuplicateFilter::kBlockWords] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+/**
+ * @brief SplitMix64 finalizer.
+ */
+uint64_t mix( uint64_t z ) {
+    z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+    z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+    return z ^ ( z >> 31 );
+}
+
+bool contains( const uint32_t* block, uint32_t h ) {
+    for ( unsigned i = 0; i < DuplicateFilter::kBlockWords; ++i ) {
+        if ( !( block[i] & ( 1U << ( ( h * kSalt[i] ) >> 27 ) ) ) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void insert( uint32_t* block, uint32_t h ) {
+    for ( unsigned i = 0; i < DuplicateFilter::kBlockWords; ++i ) {
+        block[i] |= 1U << ( ( h * kSalt[i] ) >> 27 );
+    }
+}
+
+}
+
+DuplicateFilter::DuplicateFilter() :
+    window_{ kDefaultWindow },
+    capacity_{ kDefaultCapacity },
+    block_mask_{ 0 },
+    filters_{}
+{}
+
+DuplicateFilter::DuplicateFilter( const ConfigMap& conf ) :
+    DuplicateFilter{}
+{
+    auto search = conf.find("privacy.filter.duplicates.window");
+    if ( search != conf.end() ) {
+        window_ = std::stoull( search->second );
+    }
+
+    search = conf.find("privacy.filter.duplicates.capacity");
+    if ( search != conf.end() ) {
+        capacity_ = std::stoul( search->second );
+    }
+
+    // allocated now so the handlers copied from this one share the filters.
+    search = conf.find("privacy.filter.duplicates");
+    if ( search != conf.end() && search->second == "ON" ) {
+        filters();
+    }
+}
+
+DuplicateFilter::Filters& DuplicateFilter::filters()
+{
+    if ( !filters_ ) {
+        std::size_t blocks = 1;
+        while ( blocks * kBlockWords * 32 < capacity_ * kBitsPerBSM ) blocks *= 2;
+
+        block_mask_ = blocks - 1;
+        filters_ = std::make_shared<Filters>( blocks * kBlockWords );
+    }
+    return *filters_;
+}
+
+bool DuplicateFilter::duplicate( const std::string& id, int sec_mark, int msg_cnt )
+{
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() );
+    return duplicate( id, sec_mark, msg_cnt, static_cast<uint64_t>( now.count() ) );
+}
+
+bool DuplicateFilter::duplicate( const std::string& id, int sec_mark, int msg_cnt, uint64_t now )
+{
+    Filters& f = filters();
+
+    uint64_t fields = ( static_cast<uint64_t>( sec_mark & 0xFFFF ) << 8 ) | static_cast<uint64_t>( msg_cnt & 0xFF );
+    uint64_t h = mix( VehicleStateTable<int>::key( id ) ^ mix( fields ) );
+    std::size_t offset = ( ( h >> 32 ) & block_mask_ ) * kBlockWords;
+    uint32_t bits = static_cast<uint32_t>( h );
+
+    std::lock_guard<std::mutex> lock( f.mutex );
+
+    if ( !f.started ) {
+        f.start = now;
+        f.started = true;
+    } else if ( now >= f.start + window_ ) {
+        if ( now >= f.start + 2 * window_ ) {
+            // nothing in the current filter is within the window either.
+            std::fill( f.current.begin(), f.current.end(), 0 );
+        }
+        f.current.swap( f.previous );
+        std::fill( f.current.begin(), f.current.end(), 0 );
+        f.start = now;
+    }
+
+    uint32_t* current = &f.current[offset];
+
+    if ( contains( current, bits ) ) {
+        ++f.duplicates;
+        return true;
+    }
+
+    insert( current, bits );
+
+    if ( contains( &f.previous[offset], bits ) ) {
+        ++f.duplicates;
+        return true;
+    }
+
+    return false;
+}
+
+uint64_t DuplicateFilter::window() const
+{
+    return window_;
+}
+
+void DuplicateFilter::detach()
+{
+    if ( filters_ ) {
+        filters_.reset();
+        filters();
+    }
+}
+
+std::size_t DuplicateFilter::size() const
+{
+    return filters_ ? 2 * filters_->current.size() * sizeof( uint32_t ) : 0;
+}
+
+uint64_t DuplicateFilter::duplicates() const
+{
+    if ( !filters_ ) return 0;
+
+    std::lock_guard<std::mutex> lock( filters_->mutex );
+    return filters_->duplicates;
+}
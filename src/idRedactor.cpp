@@ -1,19 +1,370 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
 #include "idRedactor.hpp"
 
-IdRedactor::IdRedactor() :
-    inclusion_set_{},
-    redacted_value_{"FFFFFFFF"},                    // default value.
-    inclusions_{false}                              // redact everything.
+constexpr std::size_t IdRedactor::kIdLength;
+
+namespace {
+
+/**
+ * @brief The lower case hex digit pairs for every byte value; byte b is at offset 2 * b.
+ */
+const char kHexPairs[] =
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+/**
+ * @brief SplitMix64 generator; one word of state, statistically strong, and a handful of instructions per value.
+ */
+class SplitMix64 {
+    public:
+        SplitMix64() {
+            std::random_device rd;
+            state_ = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+        }
+
+        uint64_t operator()() {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            return z ^ (z >> 31);
+        }
+
+    private:
+        uint64_t state_;
+};
+
+}  // end anonymous namespace
+
+IdSet::IdSet() :
+    slots_( 16, 0 ),
+    size_{ 0 },
+    has_zero_{ false },
+    shift_{ 28 }
+{}
+
+std::size_t IdSet::slot( uint32_t id ) const
+{
+    // Fibonacci hashing; the high bits of the product select the slot.
+    return static_cast<uint32_t>( id * 2654435769u ) >> shift_;
+}
+
+void IdSet::rehash( std::size_t capacity )
+{
+    std::vector<uint32_t> old_slots( capacity, 0 );
+    old_slots.swap( slots_ );
+
+    shift_ = 32;
+    while ( ( std::size_t{ 1 } << ( 32 - shift_ ) ) < capacity ) --shift_;
+
+    std::size_t mask = slots_.size() - 1;
+    for ( uint32_t id : old_slots ) {
+        if ( id == 0 ) continue;
+
+        std::size_t i = slot( id );
+        while ( slots_[i] != 0 ) i = ( i + 1 ) & mask;
+        slots_[i] = id;
+    }
+}
+
+void IdSet::reserve( std::size_t n )
+{
+    std::size_t capacity = slots_.size();
+    while ( capacity < 2 * n ) capacity *= 2;
+
+    if ( capacity > slots_.size() ) {
+        rehash( capacity );
+    }
+}
+
+bool IdSet::insert( uint32_t id )
+{
+    if ( id == 0 ) {
+        if ( has_zero_ ) return false;
+        has_zero_ = true;
+        ++size_;
+        return true;
+    }
+
+    reserve( size_ + 1 );
+
+    std::size_t mask = slots_.size() - 1;
+    std::size_t i = slot( id );
+    while ( slots_[i] != 0 ) {
+        if ( slots_[i] == id ) return false;
+        i = ( i + 1 ) & mask;
+    }
+
+    slots_[i] = id;
+    ++size_;
+    return true;
+}
+
+bool IdSet::erase( uint32_t id )
+{
+    if ( id == 0 ) {
+        if ( !has_zero_ ) return false;
+        has_zero_ = false;
+        --size_;
+        return true;
+    }
+
+    std::size_t mask = slots_.size() - 1;
+    std::size_t i = slot( id );
+    while ( slots_[i] != id ) {
+        if ( slots_[i] == 0 ) return false;
+        i = ( i + 1 ) & mask;
+    }
+
+    // Shift later members of the probe run back so no lookup stops early at the hole.
+    for ( std::size_t j = ( i + 1 ) & mask; slots_[j] != 0; j = ( j + 1 ) & mask ) {
+        std::size_t home = slot( slots_[j] );
+        bool movable = i <= j ? ( home <= i || home > j ) : ( home <= i && home > j );
+
+        if ( movable ) {
+            slots_[i] = slots_[j];
+            i = j;
+        }
+    }
+
+    slots_[i] = 0;
+    --size_;
+    return true;
+}
+
+bool IdSet::contains( uint32_t id ) const
+{
+    if ( id == 0 ) return has_zero_;
+
+    std::size_t mask = slots_.size() - 1;
+    for ( std::size_t i = slot( id ); slots_[i] != 0; i = ( i + 1 ) & mask ) {
+        if ( slots_[i] == id ) return true;
+    }
+
+    return false;
+}
+
+void IdSet::clear()
+{
+    std::fill( slots_.begin(), slots_.end(), 0 );
+    size_ = 0;
+    has_zero_ = false;
+}
+
+std::size_t IdSet::size() const
+{
+    return size_;
+}
+
+constexpr uint64_t Pseudonymizer::kDefaultEpochSeconds;
+constexpr std::size_t Pseudonymizer::kDefaultCacheSize;
+
+namespace {
+
+inline uint64_t rotl( uint64_t x, int b )
+{
+    return ( x << b ) | ( x >> ( 64 - b ) );
+}
+
+inline void sipround( uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3 )
+{
+    v0 += v1; v1 = rotl( v1, 13 ); v1 ^= v0; v0 = rotl( v0, 32 );
+    v2 += v3; v3 = rotl( v3, 16 ); v3 ^= v2;
+    v0 += v3; v3 = rotl( v3, 21 ); v3 ^= v0;
+    v2 += v1; v1 = rotl( v1, 17 ); v1 ^= v2; v2 = rotl( v2, 32 );
+}
+
+/**
+ * @brief Read 8 bytes in little endian order.
+ */
+inline uint64_t load64( const unsigned char* p )
+{
+    uint64_t v = 0;
+    for ( int i = 7; i >= 0; --i ) v = ( v << 8 ) | p[i];
+    return v;
+}
+
+}  // end anonymous namespace
+
+Pseudonymizer::Pseudonymizer() :
+    key_{},
+    epoch_key_{},
+    epoch_seconds_{ kDefaultEpochSeconds },
+    epoch_{ 0 },
+    cache_( kDefaultCacheSize, Entry{ 0, 0, 0 } )
 {
-    // setup random number generator.
     std::random_device rd;
-    rgen_ = std::mt19937{ rd() };
-    dist_ = std::uniform_int_distribution<uint32_t>{ 0, std::numeric_limits<uint32_t>::max() };
+    for ( auto& k : key_ ) {
+        k = ( static_cast<uint64_t>( rd() ) << 32 ) ^ rd();
+    }
+}
+
+Pseudonymizer::Pseudonymizer( const ConfigMap& conf ) :
+    key_{},
+    epoch_key_{},
+    epoch_seconds_{ kDefaultEpochSeconds },
+    epoch_{ 0 },
+    cache_( kDefaultCacheSize, Entry{ 0, 0, 0 } )
+{
+    // a random key would give each handler, lane, and restart its own pseudonyms.
+    auto search = conf.find("privacy.redaction.id.pseudonym.key");
+    if ( search == conf.end() ) {
+        throw std::invalid_argument( "pseudonyms require privacy.redaction.id.pseudonym.key." );
+    }
+
+    const std::string& hex = search->second;
+    uint32_t words[4];
+
+    if ( hex.size() != 4 * IdRedactor::kIdLength ) {
+        throw std::invalid_argument( "pseudonym key must be 32 hex digits." );
+    }
+
+    for ( int i = 0; i < 4; ++i ) {
+        if ( !IdRedactor::ParseId( hex.substr( i * IdRedactor::kIdLength, IdRedactor::kIdLength ), words[i] ) ) {
+            throw std::invalid_argument( "pseudonym key must be 32 hex digits." );
+        }
+    }
+
+    key_[0] = ( static_cast<uint64_t>( words[0] ) << 32 ) | words[1];
+    key_[1] = ( static_cast<uint64_t>( words[2] ) << 32 ) | words[3];
+
+    search = conf.find("privacy.redaction.id.pseudonym.epoch");
+    if ( search != conf.end() ) {
+        epoch_seconds_ = std::stoull( search->second );                 // throws.
+        if ( epoch_seconds_ == 0 ) {
+            throw std::invalid_argument( "pseudonym epoch must be at least one second." );
+        }
+    }
+
+    search = conf.find("privacy.redaction.id.pseudonym.cache");
+    if ( search != conf.end() ) {
+        std::size_t size = 1;
+        std::size_t requested = std::stoul( search->second );           // throws.
+        while ( size < requested ) size *= 2;
+        cache_.assign( size, Entry{ 0, 0, 0 } );
+    }
+}
+
+uint64_t Pseudonymizer::siphash( const Key& key, const void* data, std::size_t length )
+{
+    const unsigned char* p = static_cast<const unsigned char*>( data );
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+
+    const unsigned char* end = p + ( length & ~std::size_t{ 7 } );
+    for ( ; p != end; p += 8 ) {
+        uint64_t m = load64( p );
+        v3 ^= m;
+        sipround( v0, v1, v2, v3 );
+        sipround( v0, v1, v2, v3 );
+        v0 ^= m;
+    }
+
+    // The final block holds the remaining bytes and the length in its top byte.
+    uint64_t b = static_cast<uint64_t>( length ) << 56;
+    for ( std::size_t i = 0; i < ( length & 7 ); ++i ) {
+        b |= static_cast<uint64_t>( p[i] ) << ( 8 * i );
+    }
+
+    v3 ^= b;
+    sipround( v0, v1, v2, v3 );
+    sipround( v0, v1, v2, v3 );
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    for ( int i = 0; i < 4; ++i ) {
+        sipround( v0, v1, v2, v3 );
+    }
+
+    return v0 ^ v1 ^ v2 ^ v3;
 }
 
+void Pseudonymizer::set_epoch( uint64_t epoch )
+{
+    // Each epoch key is the SipHash of the epoch number under the secret key; the two halves use different domains.
+    uint64_t message[2] = { epoch, 0 };
+    epoch_key_[0] = siphash( key_, message, sizeof(message) );
+    message[1] = 1;
+    epoch_key_[1] = siphash( key_, message, sizeof(message) );
+    epoch_ = epoch + 1;
+}
+
+uint32_t Pseudonymizer::pseudonym( const std::string& id, uint64_t now )
+{
+    uint64_t epoch = now / epoch_seconds_;
+    if ( epoch + 1 != epoch_ ) {
+        set_epoch( epoch );
+    }
+
+    uint32_t value;
+    if ( !IdRedactor::ParseId( id, value ) ) {
+        // not a temporary id; hash the characters.
+        return static_cast<uint32_t>( siphash( epoch_key_, id.data(), id.size() ) );
+    }
+
+    Entry& entry = cache_[ static_cast<uint32_t>( value * 2654435769u ) & ( cache_.size() - 1 ) ];
+    if ( entry.epoch != epoch_ || entry.id != value ) {
+        // hash the value so either case of the same temporary id gets the same pseudonym.
+        unsigned char bytes[4] = {
+            static_cast<unsigned char>( value >> 24 ), static_cast<unsigned char>( value >> 16 ),
+            static_cast<unsigned char>( value >> 8 ), static_cast<unsigned char>( value )
+        };
+        entry = Entry{ epoch_, value, static_cast<uint32_t>( siphash( epoch_key_, bytes, sizeof(bytes) ) ) };
+    }
+
+    return entry.pseudonym;
+}
+
+uint32_t Pseudonymizer::operator()( const std::string& id )
+{
+    auto now = std::chrono::system_clock::now().time_since_epoch();
+    return pseudonym( id, static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::seconds>( now ).count() ) );
+}
+
+uint64_t Pseudonymizer::epoch_seconds() const
+{
+    return epoch_seconds_;
+}
+
+std::size_t IdRedactor::Inclusions::size() const
+{
+    return temporary_ids.size() + other_ids.size();
+}
+
+bool IdRedactor::Inclusions::insert( const std::string& id )
+{
+    uint32_t value;
+    if ( ParseId( id, value ) ) {
+        return temporary_ids.insert( value );
+    }
+    return other_ids.insert( id ).second;
+}
+
+IdRedactor::IdRedactor() :
+    inclusions_{ std::make_shared<const Inclusions>( Inclusions{ false, IdSet{}, InclusionSetType{} } ) },   // redact everything.
+    redacted_value_{"FFFFFFFF"},                    // default value.
+    configured_ids_{},
+    inclusion_file_{},
+    pseudonymizer_{}                                // random replacement ids.
+{}
+
 IdRedactor::IdRedactor( const ConfigMap& conf ) :
     IdRedactor{}
 {
+    Inclusions inclusions{ false, IdSet{}, InclusionSetType{} };
+
     // TODO: The redaction value is deprecated (it is randomly assigned now).
     auto search = conf.find("privacy.redaction.id.value");
     if ( search != conf.end() ) {
@@ -22,88 +373,232 @@ IdRedactor::IdRedactor( const ConfigMap& conf ) :
 
     search = conf.find("privacy.redaction.id.inclusions");
     if ( search != conf.end() && search->second=="ON" ) {
-        inclusions_ = true;
+        inclusions.enabled = true;
     }
 
     search = conf.find("privacy.redaction.id.included");
     if ( search != conf.end() ) {
-        StrVector sv = string_utilities::split( search->second, ',' );
-        for ( auto& id : sv ) {
-            inclusion_set_.insert( id );
+        configured_ids_ = string_utilities::split( search->second, ',' );
+        for ( auto& id : configured_ids_ ) {
+            inclusions.insert( id );
         }
     }
+
+    search = conf.find("privacy.redaction.id.mode");
+    if ( search != conf.end() && search->second == "pseudonym" ) {
+        pseudonymizer_.reset( new Pseudonymizer{ conf } );             // throws.
+    }
+
+    search = conf.find("privacy.redaction.id.included.file");
+    if ( search != conf.end() ) {
+        inclusion_file_ = search->second;
+        if ( !LoadInclusionFile( inclusions ) ) {
+            throw std::invalid_argument( "Could not open id inclusion file: " + inclusion_file_ );
+        }
+    }
+
+    inclusions_ = std::make_shared<const Inclusions>( std::move( inclusions ) );
 };
 
+IdRedactor::IdRedactor( const IdRedactor& other ) :
+    inclusions_{ other.inclusions() },
+    redacted_value_{ other.redacted_value_ },
+    configured_ids_{ other.configured_ids_ },
+    inclusion_file_{ other.inclusion_file_ },
+    pseudonymizer_{ other.pseudonymizer_ ? new Pseudonymizer{ *other.pseudonymizer_ } : nullptr }
+{}
+
+IdRedactor& IdRedactor::operator=( const IdRedactor& other )
+{
+    if ( this != &other ) {
+        std::atomic_store( &inclusions_, other.inclusions() );
+        redacted_value_ = other.redacted_value_;
+        configured_ids_ = other.configured_ids_;
+        inclusion_file_ = other.inclusion_file_;
+        pseudonymizer_.reset( other.pseudonymizer_ ? new Pseudonymizer{ *other.pseudonymizer_ } : nullptr );
+    }
+    return *this;
+}
+
+IdRedactor::InclusionsCPtr IdRedactor::inclusions() const
+{
+    return std::atomic_load( &inclusions_ );
+}
+
+bool IdRedactor::LoadInclusionFile( Inclusions& inclusions ) const
+{
+    std::ifstream file{ inclusion_file_ };
+    if ( !file ) {
+        return false;
+    }
+
+    std::string line;
+    while ( std::getline( file, line ) ) {
+        string_utilities::strip( line );
+        if ( !line.empty() && line[0] != '#' ) {
+            inclusions.insert( line );
+        }
+    }
+
+    return true;
+}
+
+bool IdRedactor::ReloadInclusions()
+{
+    Inclusions reloaded{ inclusions()->enabled, IdSet{}, InclusionSetType{} };
+
+    for ( auto& id : configured_ids_ ) {
+        reloaded.insert( id );
+    }
+
+    if ( !inclusion_file_.empty() && !LoadInclusionFile( reloaded ) ) {
+        return false;
+    }
+
+    std::atomic_store( &inclusions_, InclusionsCPtr{ std::make_shared<const Inclusions>( std::move( reloaded ) ) } );
+    return true;
+}
+
+bool IdRedactor::ParseId( const std::string& id, uint32_t& value )
+{
+    if ( id.size() != kIdLength ) {
+        return false;
+    }
+
+    value = 0;
+    for ( char c : id ) {
+        uint32_t digit;
+        if ( c >= '0' && c <= '9' ) {
+            digit = c - '0';
+        } else if ( c >= 'A' && c <= 'F' ) {
+            digit = c - 'A' + 10;
+        } else if ( c >= 'a' && c <= 'f' ) {
+            digit = c - 'a' + 10;
+        } else {
+            return false;
+        }
+        value = ( value << 4 ) | digit;
+    }
+
+    return true;
+}
+
 bool IdRedactor::HasInclusions() const
 {
-    return inclusions_;
+    return inclusions()->enabled;
 }
 
 int IdRedactor::NumInclusions() const
 {
-    if ( inclusions_ ) {
-        return inclusion_set_.size();
+    InclusionsCPtr current = inclusions();
+    if ( current->enabled ) {
+        return current->size();
     }
     return -1;
 }
 
 void IdRedactor::RedactAll()
 {
-    inclusion_set_.clear();
-    inclusions_ = false;
+    std::atomic_store( &inclusions_, InclusionsCPtr{ std::make_shared<const Inclusions>( Inclusions{ false, IdSet{}, InclusionSetType{} } ) } );
 }
 
 bool IdRedactor::ClearInclusions()
 {
-    bool r = inclusion_set_.size() > 0;
-    inclusion_set_.clear();
+    InclusionsCPtr current = inclusions();
+    bool r = current->size() > 0;
+    std::atomic_store( &inclusions_, InclusionsCPtr{ std::make_shared<const Inclusions>( Inclusions{ current->enabled, IdSet{}, InclusionSetType{} } ) } );
     return r;
 }
 
 bool IdRedactor::AddIdInclusion( const std::string& id )
 {
-    auto result = inclusion_set_.insert( id );
-    if ( !inclusions_ && result.second ) {
+    std::shared_ptr<Inclusions> updated = std::make_shared<Inclusions>( *inclusions() );
+    bool r = updated->insert( id );
+    if ( r ) {
         // previously redacting everything, not we are building the inclusion list.
-        inclusions_ = true;
+        updated->enabled = true;
+        std::atomic_store( &inclusions_, InclusionsCPtr{ updated } );
     }
-    return result.second;
+    return r;
 }
 
 bool IdRedactor::RemoveIdInclusion( const std::string& id )
 {
-    bool r = false;
-    auto search = inclusion_set_.find( id );
-    if ( search != inclusion_set_.end() ) {
+    std::shared_ptr<Inclusions> updated = std::make_shared<Inclusions>( *inclusions() );
+    uint32_t value;
+    bool r = ParseId( id, value ) ? updated->temporary_ids.erase( value ) : updated->other_ids.erase( id ) > 0;
+    if ( r ) {
         // id is currently in the inclusion set so erase it.
-        inclusion_set_.erase( search );
-        r = true;
+        std::atomic_store( &inclusions_, InclusionsCPtr{ updated } );
     }
     return r;
 }
 
 std::string IdRedactor::GetRandomId()
 {
-	std::stringstream ss;
-    uint32_t v = dist_(rgen_);
-    ss << std::hex << std::setfill('0') << std::setw(sizeof(uint32_t)*2) << v;                                                 
-	return ss.str();
+    char buffer[kIdLength];
+    WriteRandomId( buffer );
+    return std::string( buffer, kIdLength );
 }
 
-bool IdRedactor::operator()( std::string& id )
+void IdRedactor::WriteRandomId( char* buffer )
 {
-    if ( inclusions_ ) {
-        auto search = inclusion_set_.find( id );
-        if ( search == inclusion_set_.end() ) {
-            // Case 1: Using inclusion set, but not found; do NOT redact.
-            return false;
-        }
+    // Each thread has its own generator so redaction needs no locking.
+    static thread_local SplitMix64 rgen;
+    FormatId( static_cast<uint32_t>( rgen() >> 32 ), buffer );
+}
+
+void IdRedactor::FormatId( uint32_t value, char* buffer )
+{
+    // Most significant byte first.
+    std::memcpy( buffer,     kHexPairs + 2 * ( ( value >> 24 ) & 0xFF ), 2 );
+    std::memcpy( buffer + 2, kHexPairs + 2 * ( ( value >> 16 ) & 0xFF ), 2 );
+    std::memcpy( buffer + 4, kHexPairs + 2 * ( ( value >> 8 ) & 0xFF ), 2 );
+    std::memcpy( buffer + 6, kHexPairs + 2 * ( value & 0xFF ), 2 );
+}
+
+bool IdRedactor::IsRedacted( const std::string& id ) const
+{
+    InclusionsCPtr current = inclusions();
+
+    if ( current->enabled ) {
+        // Case 1: Using inclusion set, but not found; do NOT redact.
         // Case 2: Found this id in the inclusions set; redact.
-    } // Case 3: Not using inclusion set; redact everything.
+        uint32_t value;
+        if ( ParseId( id, value ) ) {
+            return current->temporary_ids.contains( value );
+        }
+        return !current->other_ids.empty() && current->other_ids.find( id ) != current->other_ids.end();
+    }
+
+    // Case 3: Not using inclusion set; redact everything.
+    return true;
+}
+
+bool IdRedactor::operator()( std::string& id )
+{
+    char buffer[kIdLength];
+
+    if ( !(*this)( id, buffer ) ) {
+        return false;
+    }
 
     // Case 2 and 3: Overwrite existing id with redaction id.
-    //id = redacted_value_;
-    id = GetRandomId();
+    id.assign( buffer, kIdLength );
+    return true;
+}
+
+bool IdRedactor::operator()( const std::string& id, char* buffer )
+{
+    if ( !IsRedacted( id ) ) {
+        return false;
+    }
+
+    if ( pseudonymizer_ ) {
+        FormatId( (*pseudonymizer_)( id ), buffer );
+    } else {
+        WriteRandomId( buffer );
+    }
     return true;
 }
 
@@ -111,3 +606,8 @@ const std::string& IdRedactor::redaction_value() const
 {
     return redacted_value_;
 }
+
+bool IdRedactor::UsesPseudonyms() const
+{
+    return pseudonymizer_ != nullptr;
+}
@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+#include "loadProfile.hpp"
+#include "utilities.hpp"
+
+LoadProfile::LoadProfile( const std::string& spec ) :
+    shape_{ Shape::CONSTANT },
+    rate_{ 0.0 },
+    peak_{ 0.0 },
+    period_{ 1.0 },
+    length_{ 0.0 },
+    duration_{ 0.0 }
+{
+    StrVector pieces = string_utilities::split( spec, ':' );
+    std::vector<double> values;
+
+    for ( std::size_t i = 1; i < pieces.size(); ++i ) {
+        values.push_back( std::stod( pieces[i] ) );             // throws.
+        if ( values.back() < 0.0 ) {
+            throw std::invalid_argument( "load profile values cannot be negative: " + spec );
+        }
+    }
+
+    if ( pieces.empty() ) {
+        throw std::invalid_argument( "empty load profile." );
+
+    } else if ( pieces[0] == "constant" && values.size() == 2 ) {
+        rate_ = peak_ = values[0];
+        duration_ = values[1];
+
+    } else if ( pieces[0] == "ramp" && values.size() == 3 ) {
+        shape_ = Shape::RAMP;
+        rate_ = values[0];
+        peak_ = values[1];
+        duration_ = values[2];
+
+        if ( duration_ <= 0.0 ) {
+            throw std::invalid_argument( "the ramp duration must be positive: " + spec );
+        }
+
+    } else if ( pieces[0] == "burst" && values.size() == 5 ) {
+        shape_ = Shape::BURST;
+        rate_ = values[0];
+        peak_ = values[1];
+        period_ = values[2] / 1000.0;
+        length_ = std::min( values[3], values[2] ) / 1000.0;
+        duration_ = values[4];
+
+        if ( period_ <= 0.0 ) {
+            throw std::invalid_argument( "the burst period must be positive: " + spec );
+        }
+
+    } else {
+        throw std::invalid_argument( "unknown load profile: " + spec );
+    }
+}
+
+LoadProfile::Shape LoadProfile::get_shape() const
+{
+    return shape_;
+}
+
+double LoadProfile::duration() const
+{
+    return duration_;
+}
+
+double LoadProfile::rate_at( double t ) const
+{
+    if ( t < 0.0 || t >= duration_ ) {
+        return 0.0;
+    }
+
+    switch ( shape_ ) {
+        case Shape::RAMP:
+            return rate_ + ( peak_ - rate_ ) * t / duration_;
+
+        case Shape::BURST:
+            return std::fmod( t, period_ ) < length_ ? peak_ : rate_;
+
+        default:
+            return rate_;
+    }
+}
+
+double LoadProfile::sent( double t ) const
+{
+    t = std::max( 0.0, std::min( t, duration_ ) );
+
+    switch ( shape_ ) {
+        case Shape::RAMP:
+            return rate_ * t + ( peak_ - rate_ ) * t * t / ( 2.0 * duration_ );
+
+        case Shape::BURST: {
+            double periods = std::floor( t / period_ );
+            double into = t - periods * period_;
+            double per_period = peak_ * length_ + rate_ * ( period_ - length_ );
+            double partial = into < length_ ? peak_ * into : peak_ * length_ + rate_ * ( into - length_ );
+            return periods * per_period + partial;
+        }
+
+        default:
+            return rate_ * t;
+    }
+}
+
+uint64_t LoadProfile::due( double t ) const
+{
+    // a little slack, so the messages due exactly at t are not lost to rounding.
+    return static_cast<uint64_t>( std::floor( sent( t ) + 1e-9 ) );
+}
+
+uint64_t LoadProfile::total() const
+{
+    return due( duration_ );
+}
+
+double LoadProfile::time_of( uint64_t n ) const
+{
+    // the earliest time more than n messages are due; sent is nondecreasing, so bisect.
+    double lo = 0.0;
+    double hi = duration_;
+
+    for ( int i = 0; i < 64 && hi - lo > 1e-7; ++i ) {
+        double mid = ( lo + hi ) / 2.0;
+        if ( due( mid ) > n ) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+
+    return hi;
+}
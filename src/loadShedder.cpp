@@ -0,0 +1,115 @@
+#include <chrono>
+#include <stdexcept>
+
+#include "loadShedder.hpp"
+
+constexpr int64_t LoadShedder::kDefaultAge;
+constexpr int64_t LoadShedder::kDefaultLag;
+
+LoadShedder::LoadShedder() :
+    enabled_{ false },
+    age_{ kDefaultAge },
+    lag_{ kDefaultLag },
+    drop_age_{ kDefaultAge },
+    keep_{ 1 },
+    degraded_{ false },
+    seen_{ 0 },
+    aged_{ 0 },
+    sampled_{ 0 },
+    degradations_{ 0 }
+{}
+
+LoadShedder::LoadShedder( const ConfigMap& conf ) :
+    LoadShedder{}
+{
+    auto search = conf.find("privacy.shed");
+    enabled_ = search != conf.end() && search->second == "ON";
+
+    search = conf.find("privacy.shed.age");
+    if ( search != conf.end() ) {
+        age_ = std::stoll( search->second );                    // throws.
+    }
+
+    search = conf.find("privacy.shed.lag");
+    if ( search != conf.end() ) {
+        lag_ = std::stoll( search->second );                    // throws.
+    }
+
+    drop_age_ = age_;
+    search = conf.find("privacy.shed.drop.age");
+    if ( search != conf.end() ) {
+        drop_age_ = std::stoll( search->second );               // throws.
+    }
+
+    search = conf.find("privacy.shed.keep");
+    if ( search != conf.end() ) {
+        keep_ = std::stoull( search->second );                  // throws.
+        if ( keep_ == 0 ) {
+            throw std::invalid_argument( "privacy.shed.keep must be at least 1." );
+        }
+    }
+}
+
+bool LoadShedder::enabled() const
+{
+    return enabled_;
+}
+
+LoadShedder::Decision LoadShedder::admit( int64_t timestamp, int64_t lag, bool& changed )
+{
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() );
+    return admit( timestamp, lag, static_cast<int64_t>( now.count() ), changed );
+}
+
+LoadShedder::Decision LoadShedder::admit( int64_t timestamp, int64_t lag, int64_t now, bool& changed )
+{
+    if ( !enabled_ ) {
+        return Decision::PROCESS;
+    }
+
+    int64_t age = timestamp < 0 ? -1 : now - timestamp;
+
+    // enter above the thresholds; leave below half of them, so the mode does not flap at a threshold.
+    bool over = ( age_ > 0 && age > age_ ) || ( lag_ > 0 && lag > lag_ );
+    bool under = ( age_ <= 0 || age <= age_ / 2 ) && ( lag_ <= 0 || lag <= lag_ / 2 );
+
+    bool degraded = degraded_.load( std::memory_order_relaxed );
+    if ( !degraded && over ) {
+        if ( degraded_.compare_exchange_strong( degraded, true ) ) {
+            ++degradations_;
+            changed = true;
+        }
+        degraded = true;
+    } else if ( degraded && under ) {
+        if ( degraded_.compare_exchange_strong( degraded, false ) ) {
+            changed = true;
+        }
+        degraded = false;
+    }
+
+    if ( !degraded ) {
+        return Decision::PROCESS;
+    }
+
+    if ( drop_age_ > 0 && age > drop_age_ ) {
+        ++aged_;
+        return Decision::AGE;
+    }
+
+    if ( seen_++ % keep_ != 0 ) {
+        ++sampled_;
+        return Decision::SAMPLE;
+    }
+
+    return Decision::PROCESS;
+}
+
+bool LoadShedder::degraded() const
+{
+    return degraded_.load();
+}
+
+LoadShedder::Metrics LoadShedder::metrics() const
+{
+    return Metrics{ aged_.load(), sampled_.load(), degradations_.load(), degraded_.load() };
+}
@@ -0,0 +1,127 @@
+#include <stdexcept>
+
+#include "fnv1a.hpp"
+#include "outputPartitioner.hpp"
+
+constexpr unsigned OutputPartitioner::kDefaultPrecision;
+constexpr unsigned OutputPartitioner::kMaxPrecision;
+
+namespace {
+
+const char kBase32[] = "0123456789bcdefghjkmnpqrstuvwxyz";
+
+}
+
+OutputPartitioner::OutputPartitioner() :
+    key_{ Key::NONE },
+    precision_{ kDefaultPrecision },
+    next_{ 0 }
+{}
+
+OutputPartitioner::OutputPartitioner( const ConfigMap& conf ) :
+    OutputPartitioner{}
+{
+    auto search = conf.find("privacy.output.key");
+    if ( search != conf.end() ) {
+        if ( search->second == "ID" ) {
+            key_ = Key::ID;
+        } else if ( search->second == "GEOHASH" ) {
+            key_ = Key::GEOHASH;
+        } else if ( search->second != "NONE" ) {
+            throw std::invalid_argument( "privacy.output.key must be NONE, ID, or GEOHASH." );
+        }
+    }
+
+    search = conf.find("privacy.output.key.geohash.precision");
+    if ( search != conf.end() ) {
+        precision_ = std::stoul( search->second );              // throws.
+        if ( precision_ == 0 || precision_ > kMaxPrecision ) {
+            throw std::invalid_argument( "privacy.output.key.geohash.precision must be 1 to 12." );
+        }
+    }
+}
+
+OutputPartitioner::Key OutputPartitioner::get_key() const
+{
+    return key_;
+}
+
+std::string OutputPartitioner::key( const BSM& bsm ) const
+{
+    switch ( key_ ) {
+        case Key::ID:
+            return bsm.get_id();
+
+        case Key::GEOHASH:
+            // BSMs without a position keep the reset position, (90, 180).
+            if ( bsm.lat >= 90.0 || bsm.lat <= -90.0 || bsm.lon >= 180.0 || bsm.lon < -180.0 ) {
+                return "";
+            }
+            return geohash( bsm.lat, bsm.lon, precision_ );
+
+        default:
+            return "";
+    }
+}
+
+int32_t OutputPartitioner::partitioner_cb( const RdKafka::Topic* /* topic */, const std::string* key, int32_t partition_cnt, void* /* msg_opaque */ )
+{
+    if ( !key || key->empty() ) {
+        return static_cast<int32_t>( next_++ % static_cast<uint32_t>( partition_cnt ) );
+    }
+
+    return partition( *key, partition_cnt );
+}
+
+int32_t OutputPartitioner::partition( const std::string& key, int32_t count )
+{
+    return jump( fnv1a( key.data(), key.size() ), count );
+}
+
+int32_t OutputPartitioner::jump( uint64_t hash, int32_t count )
+{
+    int64_t b = -1;
+    int64_t j = 0;
+
+    while ( j < count ) {
+        b = j;
+        hash = hash * 2862933555777941757ULL + 1;
+        j = static_cast<int64_t>( ( b + 1 ) * ( static_cast<double>( 1LL << 31 ) / static_cast<double>( ( hash >> 33 ) + 1 ) ) );
+    }
+
+    return static_cast<int32_t>( b );
+}
+
+std::string OutputPartitioner::geohash( double lat, double lon, unsigned precision )
+{
+    double lat_range[2] = { -90.0, 90.0 };
+    double lon_range[2] = { -180.0, 180.0 };
+    std::string cell;
+    bool even = true;
+    int bits = 0;
+    int index = 0;
+
+    // bits alternate longitude, latitude; every 5 bits is a character.
+    while ( cell.size() < precision ) {
+        double* range = even ? lon_range : lat_range;
+        double value = even ? lon : lat;
+        double mid = ( range[0] + range[1] ) / 2;
+
+        index <<= 1;
+        if ( value >= mid ) {
+            index |= 1;
+            range[0] = mid;
+        } else {
+            range[1] = mid;
+        }
+
+        even = !even;
+        if ( ++bits == 5 ) {
+            cell.push_back( kBase32[index] );
+            bits = 0;
+            index = 0;
+        }
+    }
+
+    return cell;
+}
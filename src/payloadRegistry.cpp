@@ -0,0 +1,134 @@
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#include "fnv1a.hpp"
+#include "payloadRegistry.hpp"
+
+constexpr const char* PayloadRegistry::kBsmPayloadType;
+
+PayloadType::Path PayloadType::split( const std::string& dotted )
+{
+    Path path;
+    std::stringstream ss{ dotted };
+    std::string name;
+
+    while ( std::getline( ss, name, '.' ) ) {
+        if ( !name.empty() ) {
+            path.push_back( name );
+        }
+    }
+
+    return path;
+}
+
+PayloadRegistry::PayloadRegistry() :
+    types_{},
+    slots_( 8, Slot{ 0, 0 } )
+{
+    add( PayloadType{ kBsmPayloadType, true, {}, {}, PayloadType::Units::J2735, {} } );
+}
+
+PayloadRegistry::PayloadRegistry( const ConfigMap& conf ) :
+    PayloadRegistry{}
+{
+    auto search = conf.find("privacy.payload.types");
+    if ( search == conf.end() ) {
+        return;
+    }
+
+    std::stringstream ss{ search->second };
+    std::string name;
+
+    while ( std::getline( ss, name, ',' ) ) {
+        name.erase( 0, name.find_first_not_of( " \t" ) );
+        name.erase( name.find_last_not_of( " \t" ) + 1 );
+        if ( name.empty() ) continue;
+
+        PayloadType type{ name, false, {}, {}, PayloadType::Units::J2735, {} };
+        std::string prefix = "privacy.payload." + name;
+
+        auto lat = conf.find( prefix + ".lat" );
+        auto lon = conf.find( prefix + ".long" );
+        if ( lat == conf.end() || lon == conf.end() ) {
+            throw std::invalid_argument( "payload type " + name + " requires " + prefix + ".lat and " + prefix + ".long" );
+        }
+
+        type.latitude = PayloadType::split( lat->second );
+        type.longitude = PayloadType::split( lon->second );
+
+        auto units = conf.find( prefix + ".units" );
+        if ( units != conf.end() ) {
+            if ( units->second == "DEGREES" ) {
+                type.units = PayloadType::Units::DEGREES;
+            } else if ( units->second != "J2735" ) {
+                throw std::invalid_argument( prefix + ".units must be J2735 or DEGREES." );
+            }
+        }
+
+        auto redact = conf.find( prefix + ".redact" );
+        if ( redact != conf.end() ) {
+            std::stringstream paths{ redact->second };
+            std::string path;
+            while ( std::getline( paths, path, ',' ) ) {
+                path.erase( 0, path.find_first_not_of( " \t" ) );
+                path.erase( path.find_last_not_of( " \t" ) + 1 );
+                if ( !path.empty() ) type.redactions.push_back( path );
+            }
+        }
+
+        add( type );
+    }
+}
+
+std::size_t PayloadRegistry::add( const PayloadType& type )
+{
+    if ( find( type.name.data(), type.name.size() ) ) {
+        throw std::invalid_argument( "payload type " + type.name + " is already registered" );
+    }
+
+    types_.push_back( type );
+
+    if ( types_.size() * 2 > slots_.size() ) {
+        rehash( slots_.size() * 2 );
+    } else {
+        rehash( slots_.size() );
+    }
+
+    return types_.size() - 1;
+}
+
+const PayloadType* PayloadRegistry::find( const char* name, std::size_t length ) const
+{
+    uint64_t h = fnv1a( name, length );
+    std::size_t mask = slots_.size() - 1;
+
+    for ( std::size_t i = h & mask; slots_[i].index != 0; i = ( i + 1 ) & mask ) {
+        if ( slots_[i].hash == h ) {
+            const PayloadType& type = types_[ slots_[i].index - 1 ];
+            if ( type.name.size() == length && std::memcmp( type.name.data(), name, length ) == 0 ) {
+                return &type;
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+std::size_t PayloadRegistry::size() const
+{
+    return types_.size();
+}
+
+void PayloadRegistry::rehash( std::size_t slot_count )
+{
+    slots_.assign( slot_count, Slot{ 0, 0 } );
+    std::size_t mask = slot_count - 1;
+
+    for ( std::size_t t = 0; t < types_.size(); ++t ) {
+        uint64_t h = fnv1a( types_[t].name.data(), types_[t].name.size() );
+        std::size_t i = h & mask;
+        while ( slots_[i].index != 0 ) i = ( i + 1 ) & mask;
+        slots_[i] = Slot{ h, t + 1 };
+    }
+}
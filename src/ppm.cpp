@@ -51,10 +51,19 @@
 
 #include "ppm.hpp"
 #include "spdlog/spdlog.h"
+#include <algorithm>
 #include <csignal>
 #include <chrono>
+#include <fstream>
+#include <future>
+#include <limits>
 #include <thread>
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 // for both windows and linux.
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -75,13 +84,31 @@
 
 
 bool PPM::bootstrap = true;
-bool PPM::bsms_available = true;
+std::atomic<bool> PPM::bsms_available{ true };
+bool PPM::reload_inclusions = false;
 
 void PPM::sigterm (int sig) {
-    bsms_available = false;
+    // cleared first, so a loop stopped by this signal sees it is shutting down.
     bootstrap = false;
+    bsms_available = false;
+}
+
+void PPM::sighup (int sig) {
+    reload_inclusions = true;
+}
+
+void PPM::reset_signals() {
+    bootstrap = true;
+    bsms_available = true;
+    reload_inclusions = false;
 }
 
+constexpr const char* PPM::kVersion;
+constexpr unsigned PPM::kIdleSpins;
+constexpr int PPM::kIdleSleepMicros;
+constexpr int PPM::kOffsetStoreMillis;
+constexpr std::size_t PPM::kPrefilterBatch;
+
 PPM::PPM( const std::string& name, const std::string& description ) :
     Tool{ name, description },
     exit_eof{true},
@@ -93,6 +120,30 @@ PPM::PPM( const std::string& name, const std::string& description ) :
     bsm_recv_bytes{0},
     bsm_send_bytes{0},
     bsm_filt_bytes{0},
+    pipelined{false},
+    pipeline_workers{1},
+    pipeline_ring_size{4096},
+    pipeline_cpus{},
+    laned{false},
+    lane_commit_count{1000},
+    lanes{},
+    lane_handler{},
+    lane_reload{},
+    rebalancer{*this},
+    deliveries{ std::make_shared<DeliveryTracker>() },
+    reporter{*this},
+    offsets_stored{},
+    output_partitioner{},
+    shedder{ std::make_shared<LoadShedder>() },
+    dead_letters{ std::make_shared<DeadLetterQueue>() },
+    audit{ std::make_shared<DecisionAudit>() },
+    map_hash{},
+    mapfile{},
+    subscribed{false},
+    ready{false},
+    assigned{0},
+    start_time{ std::chrono::steady_clock::now() },
+    shutdown_timeout{10000},
     pconf{},
     brokers{"localhost"},
     partition{RdKafka::Topic::PARTITION_UA},
@@ -104,11 +155,14 @@ PPM::PPM( const std::string& name, const std::string& description ) :
     conf{nullptr},
     tconf{nullptr},
     qptr{},
+    grid_index{},
     consumer{},
     consumer_timeout{500},
     producer{},
     raw_topic{},
-    filtered_topic{}
+    filtered_topic{},
+    dead_letter_topic{},
+    audit_topic{}
 {
 }
 
@@ -181,30 +235,77 @@ void PPM::metadata_print (const std::string &topic, const RdKafka::Metadata *met
     }
 }
 
-bool PPM::topic_available( const std::string& topic ) {
-    bool r = false;
+void PPM::shutdown() {
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::milliseconds( shutdown_timeout );
+    auto remaining = [&deadline]() {
+        return static_cast<int>( std::max<int64_t>( 0, std::chrono::duration_cast<std::chrono::milliseconds>( deadline - std::chrono::steady_clock::now() ).count() ) );
+    };
 
-    RdKafka::Metadata* md;
-    RdKafka::ErrorCode err = consumer->metadata( true, nullptr, &md, 5000 );
-    // TODO: Will throw a broker transport error (ERR__TRANSPORT = -195) if the broker is not available.
+    // fetching has stopped and the in-flight BSMs are processed; deliver the queued ones before the deadline.
+    int queued = 0;
+    int undelivered = 0;
+
+    if (producer) {
+        if ( dead_letters->enabled() ) {
+            flush_dead_letters( true );
+        }
 
-    if ( err == RdKafka::ERR_NO_ERROR ) {
-        RdKafka::Metadata::TopicMetadataIterator it = md->topics()->begin();
+        queued = producer->outq_len();
+        RdKafka::ErrorCode err = producer->flush( remaining() );
+        undelivered = producer->outq_len();
 
-        // search for the raw BSM topic.
-        while ( it != md->topics()->end() && !r ) {
-            // finish when we find it.
-            r = ( (*it)->topic() == topic );
-            if ( r ) logger->info("Topic: " + topic + " found in the kafka metadata.");
-            ++it;
+        if (err) {
+            logger->error("producer flush ended with " + std::to_string(undelivered) + " BSMs undelivered: " + RdKafka::err2str(err));
         }
-        if (!r) logger->warn("Metadata did not contain topic: " + topic + ".");
+    }
 
-    } else {
-        logger->error("cannot retrieve consumer metadata with error: " + err2str(err) + ".");
+    // commit the offsets of the BSMs consumed up to the oldest one not delivered, then leave the group; the undelivered
+    // BSMs are consumed again by the next member of the group.
+    std::string committed = "none";
+
+    if (consumer) {
+        std::vector<RdKafka::TopicPartition*> offsets = delivered_offsets();
+
+        if (!offsets.empty()) {
+            // stored too, so the automatic commit when leaving commits the same offsets.
+            if (!laned) {
+                consumer->offsets_store( offsets );
+            }
+
+            RdKafka::ErrorCode err = consumer->commitSync( offsets );
+
+            if (err == RdKafka::ERR_NO_ERROR) {
+                committed = undelivered == 0 ? "committed" : "committed up to the undelivered BSMs";
+            } else if (err != RdKafka::ERR__NO_OFFSET) {
+                committed = "failed";
+                logger->error("cannot commit the final offsets: " + RdKafka::err2str(err));
+            }
+        }
+        RdKafka::TopicPartition::destroy( offsets );
+
+        consumer->close();
+        consumer.reset();
     }
-    
-    return r;
+
+    filtered_topic.reset();
+    dead_letter_topic.reset();
+    audit_topic.reset();
+    producer.reset();
+
+    logger->info("PPM drained in " + std::to_string( std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start ).count() ) + " ms: "
+        + std::to_string(queued - undelivered) + " of " + std::to_string(queued) + " queued BSMs delivered; final offsets " + committed + "; left the consumer group.");
+}
+
+BSMHandler PPM::make_handler() const {
+    return BSMHandler{ qptr, grid_index, pconf, logger };
+}
+
+void PPM::load_geofence() {
+    qptr = BuildGeofence( mapfile );                // throws.
+
+    std::ifstream in{ mapfile, std::ios::binary };
+    map_hash = DecisionAudit::hash( in );
 }
 
 void PPM::print_configuration() const
@@ -305,8 +406,6 @@ bool PPM::configure() {
     // All configuration file settings are overridden, if supplied, by CLI options.
 
     // fail first on mapfile.
-    std::string mapfile;
-
     if ( optIsSet('m') ) {
         // map file is specified on command line.
         mapfile = optString('m');
@@ -321,9 +420,19 @@ bool PPM::configure() {
         }
     }
 
+    auto inclusion_file = pconf.find("privacy.redaction.id.included.file");
+    if ( inclusion_file != pconf.end() && !std::ifstream{ inclusion_file->second } ) {
+        logger->error("cannot open id inclusion file: " + inclusion_file->second);
+        return false;
+    }
+
     logger->info("ppm mapfile: " + mapfile);
 
-    qptr = BuildGeofence( mapfile );                // throws.
+    // the geofence is built by load_geofence, while the consumer joins its group.
+    if ( !std::ifstream{ mapfile } ) {
+        logger->error("cannot open map file: " + mapfile);
+        return false;
+    }
 
     if ( optIsSet('b') ) {
         // broker specified.
@@ -442,64 +551,131 @@ bool PPM::configure() {
         }
     }
 
-    logger->trace("ending configure()");
-    return true;
-}
+    search = pconf.find("privacy.shutdown.timeout.ms");
+    if ( search != pconf.end() ) {
+        shutdown_timeout = std::stoi( search->second );                 // throws.
+    }
 
-bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler) {
-    static std::string tsname;
-    static RdKafka::MessageTimestamp ts;
+    search = pconf.find("privacy.pipeline");
+    pipelined = search != pconf.end() && search->second == "ON";
 
-    // payload is a void *
-    // len is a size_t
-    std::string payload(static_cast<const char*>(message->payload()), message->len());
+    search = pconf.find("privacy.pipeline.workers");
+    if ( search != pconf.end() ) {
+        pipeline_workers = std::stoul( search->second );                // throws.
+        if ( pipeline_workers == 0 ) {
+            logger->error("privacy.pipeline.workers must be at least 1.");
+            return false;
+        }
+    }
 
-    switch (message->err()) {
-        case RdKafka::ERR__TIMED_OUT:
-            logger->info("Waiting for more BSMs from the ODE producer.");
-            break;
+    search = pconf.find("privacy.pipeline.ring.size");
+    if ( search != pconf.end() ) {
+        pipeline_ring_size = std::stoul( search->second );              // throws.
+    }
 
-        case RdKafka::ERR_NO_ERROR:
-            /* Real message */
-            bsm_recv_count++;
+    search = pconf.find("privacy.pipeline.cpus");
+    if ( search != pconf.end() ) {
+        pipeline_cpus.clear();
+        for ( auto& cpu : string_utilities::split( search->second, ',' ) ) {
+            pipeline_cpus.push_back( std::stoi( string_utilities::strip( cpu ) ) );     // throws.
+        }
+    }
 
-            bsm_recv_bytes += message->len();
+    output_partitioner = std::make_shared<OutputPartitioner>( pconf );     // throws.
 
-            logger->trace("Read message at byte offset: " + std::to_string(message->offset()) );
+    if ( output_partitioner->get_key() != OutputPartitioner::Key::NONE ) {
+        if ( tconf->set("partitioner_cb", output_partitioner.get(), error_string) != RdKafka::Conf::CONF_OK ) {
+            logger->error("kafka error setting the output partitioner: " + error_string);
+            return false;
+        }
 
-            ts = message->timestamp();
+        if ( partition != RdKafka::Topic::PARTITION_UA ) {
+            logger->warn("privacy.kafka.partition is set, so the keyed BSMs are all published to partition " + std::to_string(partition) + ".");
+        }
+    }
 
-            if (ts.type != RdKafka::MessageTimestamp::MSG_TIMESTAMP_NOT_AVAILABLE) {
-                if (ts.type == RdKafka::MessageTimestamp::MSG_TIMESTAMP_CREATE_TIME) {
-                    tsname = "create time";
-                } else if (ts.type == RdKafka::MessageTimestamp::MSG_TIMESTAMP_LOG_APPEND_TIME) {
-                    tsname = "log append time";
-                } else {
-                    tsname = "unknown";
-                }
+    shedder = std::make_shared<LoadShedder>( pconf );                       // throws.
+    if ( shedder->enabled() ) {
+        logger->info("load shedding: enabled.");
+    }
 
-                logger->trace("Message timestamp: " + tsname + ", type: " + std::to_string(ts.timestamp));
-            }
+    dead_letters = std::make_shared<DeadLetterQueue>( pconf );              // throws.
+    if ( dead_letters->enabled() ) {
+        logger->info("dead letters: publishing unprocessable messages to topic " + dead_letters->topic() + ".");
+    }
 
-            if ( message->key() ) {
-                logger->trace("Message key: " + *message->key() );
-            }
+    audit = std::make_shared<DecisionAudit>( pconf );                      // throws.
+    if ( audit->audit_enabled() ) {
+        logger->info("decision audit: publishing sampled suppressed decisions to topic " + audit->topic() + ".");
+    }
 
-            // Process the BSM payload.
-            if ( handler.process( payload ) ) {
-                // the complete BSM was parsed, so we have all the information.
-                logger->info("BSM [RETAINED]: " + handler.get_bsm().logString());
-                return true;
-                
-            } else {
-                // Suppressed BSM.
-                logger->info("BSM [SUPPRESSED-" + handler.get_result_string() + "]: " + handler.get_bsm().logString());
-                bsm_filt_count++;
-                bsm_filt_bytes += message->len();
-            } // return false;
+    search = pconf.find("privacy.lanes");
+    laned = search != pconf.end() && search->second == "ON";
+
+    search = pconf.find("privacy.lanes.commit.count");
+    if ( search != pconf.end() ) {
+        lane_commit_count = std::stoul( search->second );               // throws.
+        if ( lane_commit_count == 0 ) {
+            logger->error("privacy.lanes.commit.count must be at least 1.");
+            return false;
+        }
+    }
+
+    // the assignment tells when the consumer is ready and opens the lanes.
+    if ( conf->set("rebalance_cb", &rebalancer, error_string) != RdKafka::Conf::CONF_OK ) {
+        logger->error("kafka error setting the rebalance callback: " + error_string);
+        return false;
+    }
+
+    // the delivery reports tell which consumed offsets are safe to commit.
+    if ( conf->set("dr_cb", &reporter, error_string) != RdKafka::Conf::CONF_OK ) {
+        logger->error("kafka error setting the delivery report callback: " + error_string);
+        return false;
+    }
 
+    // only the offsets of delivered BSMs are stored for the automatic commits.
+    if ( conf->set("enable.auto.offset.store", "false", error_string) != RdKafka::Conf::CONF_OK ) {
+        logger->error("kafka error setting the offset store configuration: " + error_string);
+        return false;
+    }
+
+    if ( laned ) {
+        // the lanes commit the offsets of the BSMs they delivered rather than those consumed.
+        if ( conf->set("enable.auto.commit", "false", error_string) != RdKafka::Conf::CONF_OK ) {
+            logger->error("kafka error setting the partition lane configuration: " + error_string);
+            return false;
+        }
+
+        if ( pipelined ) {
+            logger->warn("privacy.lanes is ON; ignoring privacy.pipeline.");
+            pipelined = false;
+        }
+
+        logger->info("partition lanes: offsets committed every " + std::to_string(lane_commit_count) + " BSMs.");
+    }
+
+    if ( pipelined ) {
+        logger->info("pipeline: " + std::to_string(pipeline_workers) + " workers with rings of " + std::to_string(pipeline_ring_size) + " BSMs.");
+    }
+
+    logger->trace("ending configure()");
+    return true;
+}
+
+bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handler) {
+    return msg_status(message) && msg_process(message, handler);
+}
+
+bool PPM::msg_status(RdKafka::Message* message) {
+    switch (message->err()) {
+        case RdKafka::ERR__TIMED_OUT:
+            logger->info("Waiting for more BSMs from the ODE producer.");
             break;
 
+        case RdKafka::ERR_NO_ERROR:
+            /* Real message */
+            return true;
+
         case RdKafka::ERR__PARTITION_EOF:
             logger->info("ODE BSM consumer partition end of file, but PPM still alive.");
             if (exit_eof) {
@@ -513,8 +689,9 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
             break;
 
         case RdKafka::ERR__UNKNOWN_TOPIC:
-            logger->error("cannot consume due to an UNKNOWN consumer topic: " + message->errstr());
-            bsms_available = false;
+        case RdKafka::ERR_UNKNOWN_TOPIC_OR_PART:
+            // the subscription picks the topic up when it is created.
+            logger->warn("waiting for the consumer topic to be created: " + message->errstr());
             break;
 
         case RdKafka::ERR__UNKNOWN_PARTITION:
@@ -530,6 +707,609 @@ bool PPM::msg_consume(RdKafka::Message* message, void* opaque, BSMHandler& handl
     return false;
 }
 
+bool PPM::msg_process(RdKafka::Message* message, BSMHandler& handler, uint8_t prefiltered) {
+    std::string tsname;
+    RdKafka::MessageTimestamp ts = message->timestamp();
+    int64_t timestamp = ts.type != RdKafka::MessageTimestamp::MSG_TIMESTAMP_NOT_AVAILABLE ? ts.timestamp : -1;
+
+    bsm_recv_count++;
+
+    bsm_recv_bytes += message->len();
+
+    // shed backlog before parsing.
+    if ( shedder->enabled() ) {
+        int64_t low = -1;
+        int64_t high = -1;
+        int64_t lag = -1;
+        bool changed = false;
+
+        // the watermarks are cached by the consumer; this does not wait for the broker.
+        if ( consumer && consumer->get_watermark_offsets( message->topic_name(), message->partition(), &low, &high ) == RdKafka::ERR_NO_ERROR && high >= 0 ) {
+            lag = high - message->offset() - 1;
+        }
+
+        int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+        LoadShedder::Decision decision = shedder->admit( timestamp, lag, now, changed );
+
+        if ( changed ) {
+            std::string conditions = "message age " + ( timestamp < 0 ? std::string{ "unknown" } : std::to_string(now - timestamp) + " ms" ) + ", lag " + std::to_string(lag) + " messages";
+
+            if ( shedder->degraded() ) {
+                logger->warn("load shedding: entering the degraded mode; " + conditions + ".");
+            } else {
+                auto metrics = shedder->metrics();
+                logger->warn("load shedding: leaving the degraded mode; " + conditions + "; shed " + std::to_string(metrics.aged) + " by age and " + std::to_string(metrics.sampled) + " by sampling so far.");
+            }
+        }
+
+        if ( decision != LoadShedder::Decision::PROCESS ) {
+            handler.shed();
+            logger->trace("BSM [SHED-" + std::string( decision == LoadShedder::Decision::AGE ? "age" : "sample" ) + "] at byte offset: " + std::to_string(message->offset()));
+            audit_decision( message, handler.get_result(), handler.get_result_string(), timestamp );
+            bsm_filt_count++;
+            bsm_filt_bytes += message->len();
+            return false;
+        }
+    }
+
+    // payload is a void *
+    // len is a size_t
+    std::string payload(static_cast<const char*>(message->payload()), message->len());
+
+    logger->trace("Read message at byte offset: " + std::to_string(message->offset()) );
+
+    if (ts.type != RdKafka::MessageTimestamp::MSG_TIMESTAMP_NOT_AVAILABLE) {
+        if (ts.type == RdKafka::MessageTimestamp::MSG_TIMESTAMP_CREATE_TIME) {
+            tsname = "create time";
+        } else if (ts.type == RdKafka::MessageTimestamp::MSG_TIMESTAMP_LOG_APPEND_TIME) {
+            tsname = "log append time";
+        } else {
+            tsname = "unknown";
+        }
+
+        logger->trace("Message timestamp: " + tsname + ", type: " + std::to_string(ts.timestamp));
+    }
+
+    if ( message->key() ) {
+        logger->trace("Message key: " + *message->key() );
+    }
+
+    // letters linger no longer than configured while only good messages arrive.
+    if ( dead_letters->enabled() ) {
+        flush_dead_letters( false );
+    }
+
+    // Process the BSM payload; its metadata is validated even when the prefilter failed its core fields.
+    bool retained = handler.process( payload, timestamp, prefiltered );
+
+    if ( retained ) {
+        // the complete BSM was parsed, so we have all the information.
+        if ( audit->log_decisions() ) {
+            logger->info("BSM [RETAINED]: " + handler.get_bsm().logString());
+        }
+        return true;
+        
+    } else if ( handler.get_result() == BSMHandler::ResultStatus::HELD ) {
+        // Published later unless the trip ends first.
+        if ( audit->log_decisions() ) {
+            logger->info("BSM [HELD]: " + handler.get_bsm().logString());
+        }
+
+    } else if ( dead_letters->enabled() && DeadLetterQueue::routes( handler.get_result() ) ) {
+        // the dead-letter topic is the record; a storm of bad messages does not flood the log.
+        logger->trace("BSM [DEAD-LETTER-" + handler.get_result_string() + "] at byte offset: " + std::to_string(message->offset()));
+        dead_letter( message, payload, handler, timestamp );
+        bsm_filt_count++;
+        bsm_filt_bytes += message->len();
+
+    } else {
+        // Suppressed BSM.
+        if ( audit->log_decisions() ) {
+            logger->info("BSM [SUPPRESSED-" + handler.get_result_string() + "]: " + handler.get_bsm().logString());
+        }
+        audit_decision( message, handler.get_result(), handler.get_result_string(), timestamp );
+        bsm_filt_count++;
+        bsm_filt_bytes += message->len();
+    }
+
+    return false;
+}
+
+void PPM::reload_inclusions_check( std::future<bool>& pending, const std::vector<BSMHandler*>& handlers ) {
+    if (reload_inclusions && !pending.valid()) {
+        reload_inclusions = false;
+        logger->info("reloading the id inclusions.");
+        pending = std::async(std::launch::async, [handlers]() {
+            bool r = true;
+            for ( auto h : handlers ) {
+                r = h->get_id_redactor().ReloadInclusions() && r;
+            }
+            return r;
+        });
+    }
+
+    if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        if (pending.get()) {
+            logger->info("reloaded the id inclusions: " + std::to_string(handlers.front()->get_id_redactor().NumInclusions()) + " ids.");
+        } else {
+            logger->error("failed to reload the id inclusions; keeping the previous list.");
+        }
+    }
+}
+
+void PPM::idle( unsigned& polls ) {
+    if ( ++polls < kIdleSpins ) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for( std::chrono::microseconds( kIdleSleepMicros ) );
+    }
+}
+
+void PPM::pin_thread( int cpu, const std::string& stage ) {
+    if ( cpu < 0 ) return;
+
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    if ( pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus ) == 0 ) {
+        logger->info("pipeline " + stage + " pinned to cpu " + std::to_string(cpu) + ".");
+    } else {
+        logger->warn("cannot pin the pipeline " + stage + " to cpu " + std::to_string(cpu) + ".");
+    }
+#else
+    logger->warn("cpu affinity is not supported; the pipeline " + stage + " is not pinned.");
+#endif
+}
+
+void PPM::run_pipeline(const BSMHandler& handler) {
+    const unsigned n = pipeline_workers;
+
+    // The stage cpus, in order: the consumer, each worker, the producer.
+    auto cpu = [this]( std::size_t stage ) { return stage < pipeline_cpus.size() ? pipeline_cpus[stage] : -1; };
+
+    // copies share the per-vehicle state; a vehicle's BSMs go to one worker so they are applied to it in order.
+    std::vector<BSMHandler> handlers( n, handler );
+    bool keyed = handler.get_activation_flag() & BSMHandler::kVehicleStateFlags;
+    std::vector<BSMHandler*> handler_ptrs;
+    for ( auto& h : handlers ) handler_ptrs.push_back( &h );
+
+    std::vector<std::unique_ptr<Ring>> inputs;
+    std::vector<std::unique_ptr<Ring>> outputs;
+    for ( unsigned i = 0; i < n; ++i ) {
+        inputs.emplace_back( new Ring{ pipeline_ring_size } );
+        outputs.emplace_back( new Ring{ pipeline_ring_size } );
+    }
+
+    // the worker of each consumed message, in the consumed order.
+    SpscRing<unsigned> order{ n * pipeline_ring_size };
+
+    // Wait on a full ring; the downstream stage is running.
+    auto push = []( Ring& ring, Envelope* e ) {
+        unsigned polls = 0;
+        while ( !ring.try_push( std::move(e) ) ) idle( polls );
+    };
+    auto dispatch = [&]( unsigned worker, Envelope* e ) {
+        unsigned polls = 0;
+        while ( !order.try_push( std::move(worker) ) ) idle( polls );
+        push( *inputs[worker], e );
+    };
+
+    std::thread consumer_stage{ [&]() {
+        pin_thread( cpu(0), "consumer" );
+
+        std::future<bool> inclusion_reload;
+        unsigned next = 0;
+
+        while (bsms_available) {
+            reload_inclusions_check( inclusion_reload, handler_ptrs );
+
+            std::unique_ptr<RdKafka::Message> msg{ consumer->consume( consumer_timeout ) };
+            store_offsets( false );
+
+            // letters linger no longer than configured while no messages arrive.
+            if ( msg->err() == RdKafka::ERR__TIMED_OUT && dead_letters->enabled() ) {
+                flush_dead_letters( false );
+            }
+
+            // only BSMs go downstream.
+            if ( !msg_status(msg.get()) ) continue;
+
+            // messages without a vehicle, or when no filter keeps per-vehicle state, are dealt in turn.
+            uint64_t vehicle = 0;
+            unsigned worker = next;
+            if ( keyed && BSMHandler::vehicle_key( static_cast<const char*>( msg->payload() ), msg->len(), vehicle ) ) {
+                worker = static_cast<unsigned>( vehicle % n );
+            } else {
+                next = ( next + 1 ) % n;
+            }
+
+            dispatch( worker, new Envelope{ std::move(msg), false, {}, {} } );
+        }
+
+        for ( unsigned i = 0; i < n; ++i ) dispatch( i, nullptr );
+
+        if ( inclusion_reload.valid() ) inclusion_reload.wait();
+    } };
+
+    std::vector<std::thread> worker_stages;
+    for ( unsigned i = 0; i < n; ++i ) {
+        worker_stages.emplace_back( [&, i]() {
+            pin_thread( cpu(1 + i), "worker " + std::to_string(i) );
+
+            RdKafka::Message* current = nullptr;
+            const TripFilter::HoldFactory make_hold = hold_factory( current );
+            handlers[i].set_hold_factory( &make_hold );
+
+            Batch batch;
+            do {
+                take_batch( *inputs[i], batch, handlers[i] );
+
+                for ( Envelope* e : batch.envelopes ) {
+                    current = e->message.get();
+                    e->retained = msg_process( e->message.get(), handlers[i], e->prefiltered );
+                    if ( e->retained ) e->json = handlers[i].get_json();
+                    e->released = handlers[i].get_released();
+                    e->released_holds = handlers[i].get_released_holds();
+                    e->key = output_key( handlers[i] );
+                    push( *outputs[i], e );
+                }
+            } while ( !batch.ended );
+
+            push( *outputs[i], nullptr );
+        } );
+    }
+
+    std::thread producer_stage{ [&]() {
+        pin_thread( cpu(1 + n), "producer" );
+
+        Envelope* e = nullptr;
+        unsigned next = 0;
+        bool ordered = false;
+        unsigned polls = 0;
+        DeliveryTracker::Source* source = nullptr;
+
+        // the outputs are read in the order the consumer filled the inputs, so BSMs are published in the consumed order.
+        for ( unsigned ended = 0; ended < n; ) {
+            if ( !ordered ) ordered = order.try_pop( next );
+
+            if ( !ordered || !outputs[next]->try_pop( e ) ) {
+                producer->poll(0);
+                // NOTE: good for troubleshooting, but bad for performance; only flush when idle.
+                logger->flush();
+                idle( polls );
+                continue;
+            }
+
+            ordered = false;
+            polls = 0;
+
+            if ( !e ) {
+                ++ended;
+                continue;
+            }
+
+            std::unique_ptr<Envelope> owned{ e };
+
+            RdKafka::Message* message = e->message.get();
+            source = &delivery_source( *message, source );
+
+            // held BSMs released by this one precede it.
+            publish_released( e->released, e->released_holds, e->key, source, message->offset() );
+
+            if ( e->retained ) {
+                publish( e->json, e->key, message->len(), "retained", source, message->offset() );
+            }
+
+            deliveries->processed( *source, message->offset() );
+            producer->poll(0);
+        }
+    } };
+
+    consumer_stage.join();
+
+    std::size_t in_flight = 0;
+    for ( unsigned i = 0; i < n; ++i ) {
+        in_flight += inputs[i]->size() + outputs[i]->size();
+    }
+    logger->info("pipeline stopped consuming; draining about " + std::to_string(in_flight) + " in-flight BSMs.");
+
+    for ( auto& t : worker_stages ) t.join();
+    producer_stage.join();
+
+    // at shutdown the BSMs still held are consumed again after the final commit; a restarted loop drops them.
+    if ( !bootstrap ) deliveries->freeze_holds();
+
+    logger->flush();
+}
+
+void PPM::Rebalancer::rebalance_cb( RdKafka::KafkaConsumer* consumer, RdKafka::ErrorCode err, std::vector<RdKafka::TopicPartition*>& partitions ) {
+    bool cooperative = consumer->rebalance_protocol() == "COOPERATIVE";
+    RdKafka::ErrorCode status = RdKafka::ERR_NO_ERROR;
+    RdKafka::Error* error = nullptr;
+
+    // eager rebalancing assigns and revokes every partition; cooperative rebalancing only those that move.
+    switch (err) {
+        case RdKafka::ERR__ASSIGN_PARTITIONS:
+            if ( ppm_.laned ) {
+                for ( auto tp : partitions ) {
+                    ppm_.open_lane( tp->topic(), tp->partition() );
+                }
+            }
+
+            if ( cooperative ) {
+                error = consumer->incremental_assign( partitions );
+                ppm_.assigned += partitions.size();
+            } else {
+                status = consumer->assign( partitions );
+                ppm_.assigned = partitions.size();
+            }
+
+            if ( !ppm_.ready ) {
+                ppm_.ready = true;
+                ppm_.logger->info("consumer ready: " + std::to_string(ppm_.assigned) + " partition(s) assigned "
+                    + std::to_string( std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - ppm_.start_time ).count() ) + " ms after start.");
+            } else {
+                ppm_.logger->info("consumer assigned " + std::to_string(partitions.size()) + " partition(s); " + std::to_string(ppm_.assigned) + " in all.");
+            }
+            break;
+
+        case RdKafka::ERR__REVOKE_PARTITIONS:
+            // a lost assignment already belongs to another consumer, so its offsets are not committed.
+            if ( ppm_.laned ) {
+                for ( auto tp : partitions ) {
+                    ppm_.close_lane( tp->topic(), tp->partition(), !consumer->assignment_lost() );
+                }
+            } else if ( !consumer->assignment_lost() ) {
+                // the automatic commit on revocation commits the stored offsets.
+                ppm_.store_offsets( true );
+            }
+
+            // their committed offsets stand; the next owner consumes the outstanding BSMs again.
+            for ( auto tp : partitions ) {
+                uint64_t forgotten = ppm_.deliveries->reset( ppm_.deliveries->source( tp->topic(), tp->partition() ) );
+                if ( forgotten > 0 ) {
+                    ppm_.logger->warn("revoked partition " + std::to_string(tp->partition()) + " of " + tp->topic() + " with " + std::to_string(forgotten)
+                        + " BSMs undelivered or held; they are consumed again by the partition's next owner.");
+                }
+            }
+
+            if ( cooperative ) {
+                error = consumer->incremental_unassign( partitions );
+                ppm_.assigned -= std::min( ppm_.assigned, partitions.size() );
+            } else {
+                status = consumer->unassign();
+                ppm_.assigned = 0;
+            }
+
+            ppm_.logger->info("consumer revoked " + std::to_string(partitions.size()) + " partition(s); " + std::to_string(ppm_.assigned) + " remain.");
+            break;
+
+        default:
+            ppm_.logger->error("rebalance failed with error: " + RdKafka::err2str( err ));
+            status = consumer->unassign();
+    }
+
+    if ( error ) {
+        ppm_.logger->error("cannot change the partition assignment because: " + error->str());
+        delete error;
+    } else if ( status != RdKafka::ERR_NO_ERROR ) {
+        ppm_.logger->error("cannot change the partition assignment because: " + RdKafka::err2str( status ));
+    }
+}
+
+void PPM::open_lane( const std::string& topic, int32_t partition ) {
+    LaneKey key{ topic, partition };
+    if ( lanes.count( key ) ) return;
+
+    // a copy of the lanes' handler with per-vehicle state of its own, allocated only for the enabled filters.
+    if ( !lane_handler ) {
+        lane_handler.reset( new BSMHandler{ make_handler() } );
+    }
+    // a reload may still change the inclusions being copied.
+    if ( lane_reload.valid() ) lane_reload.wait();
+
+    BSMHandler handler{ *lane_handler };
+    handler.own_state();
+
+    std::unique_ptr<Lane> lane{ new Lane{ deliveries->source( topic, partition ), std::move( handler ), pipeline_ring_size } };
+    Lane& opened = *lane;
+    lanes.emplace( key, std::move( lane ) );
+    opened.thread = std::thread{ [this, &opened]() { lane_loop( opened ); } };
+
+    logger->info("opened the lane for partition " + std::to_string(partition) + " of " + topic + ".");
+}
+
+void PPM::close_lane( const std::string& topic, int32_t partition, bool commit ) {
+    auto search = lanes.find( LaneKey{ topic, partition } );
+    if ( search == lanes.end() ) return;
+
+    Lane& lane = *search->second;
+    Envelope* end = nullptr;
+    std::size_t in_flight = lane.ring.size();
+
+    // the lane processes the messages before the end.
+    unsigned polls = 0;
+    while ( !lane.ring.try_push( std::move(end) ) ) idle( polls );
+    lane.thread.join();
+
+    // a reload may still use the handler.
+    if ( lane_reload.valid() ) lane_reload.wait();
+
+    // the partition's next owner consumes again from the oldest BSM not delivered.
+    if ( commit ) {
+        if ( deliveries->undelivered( lane.source ) > 0 ) {
+            producer->flush( shutdown_timeout );
+        }
+        commit_offset( lane.source, true );
+    }
+
+    lanes.erase( search );
+    logger->info("closed the lane for partition " + std::to_string(partition) + " of " + topic + " after draining " + std::to_string(in_flight) + " BSMs.");
+}
+
+void PPM::lane_loop( Lane& lane ) {
+    Batch batch;
+    std::size_t uncommitted = 0;
+
+    RdKafka::Message* current = nullptr;
+    const TripFilter::HoldFactory make_hold = hold_factory( current );
+    lane.handler.set_hold_factory( &make_hold );
+
+    do {
+        take_batch( lane.ring, batch, lane.handler );
+
+        for ( Envelope* e : batch.envelopes ) {
+            std::unique_ptr<Envelope> owned{ e };
+            RdKafka::Message* message = e->message.get();
+            current = message;
+            bool retained = msg_process( message, lane.handler, e->prefiltered );
+            std::string key = output_key( lane.handler );
+
+            // held BSMs released by this one precede it.
+            publish_released( lane.handler.get_released(), lane.handler.get_released_holds(), key, &lane.source, message->offset() );
+
+            if ( retained ) {
+                publish( lane.handler.get_json(), key, message->len(), "retained", &lane.source, message->offset() );
+            }
+
+            deliveries->processed( lane.source, message->offset() );
+
+            // only up to the oldest BSM not yet delivered.
+            if ( ++uncommitted == lane_commit_count ) {
+                commit_offset( lane.source, false );
+                uncommitted = 0;
+            }
+        }
+    } while ( !batch.ended );
+}
+
+void PPM::take_batch( Ring& ring, Batch& batch, BSMHandler& handler ) {
+    batch.envelopes.clear();
+    batch.ended = false;
+    batch.scanned.clear();
+    batch.speed.clear();
+    batch.lat.clear();
+    batch.lon.clear();
+
+    Envelope* e = nullptr;
+    unsigned polls = 0;
+    while ( !ring.try_pop( e ) ) idle( polls );
+
+    // then only the envelopes already in the ring.
+    for (;;) {
+        if ( !e ) {
+            batch.ended = true;
+            break;
+        }
+
+        batch.envelopes.push_back( e );
+
+        int32_t speed = 0;
+        int32_t lat = 0;
+        int32_t lon = 0;
+        if ( BSMHandler::core_fields( static_cast<const char*>( e->message->payload() ), e->message->len(), speed, lat, lon ) ) {
+            batch.scanned.push_back( batch.envelopes.size() - 1 );
+            batch.speed.push_back( speed );
+            batch.lat.push_back( lat );
+            batch.lon.push_back( lon );
+        }
+
+        if ( batch.envelopes.size() == kPrefilterBatch || !ring.try_pop( e ) ) break;
+    }
+
+    // every BSM is still parsed and validated; only the survivors are looked up in the geofence.
+    batch.result.resize( batch.scanned.size() );
+    handler.prefilter( batch.speed.data(), batch.lat.data(), batch.lon.data(), batch.scanned.size(), batch.result.data() );
+
+    for ( std::size_t j = 0; j < batch.scanned.size(); ++j ) {
+        batch.envelopes[ batch.scanned[j] ]->prefiltered = batch.result[j];
+    }
+}
+
+void PPM::DeliveryReporter::dr_cb( RdKafka::Message& message ) {
+    auto delivery = static_cast<DeliveryTracker::Delivery*>( message.msg_opaque() );
+
+    // the dead letters and audit records are not tracked.
+    if ( !delivery ) return;
+
+    if ( message.err() != RdKafka::ERR_NO_ERROR ) {
+        ppm_.logger->error("cannot deliver the BSM of offset " + std::to_string(delivery->offset) + " of partition " + std::to_string(delivery->source->partition())
+            + "; it is consumed again after a restart or rebalance: " + message.errstr());
+    }
+
+    ppm_.deliveries->delivered( delivery, message.err() == RdKafka::ERR_NO_ERROR );
+}
+
+void PPM::commit_offset( const DeliveryTracker::Source& source, bool sync ) {
+    int64_t offset = deliveries->committable( source );
+    if ( offset < 0 ) return;
+
+    // the topic of the messages, not the subscription, which may be a regular expression.
+    std::vector<RdKafka::TopicPartition*> offsets{ RdKafka::TopicPartition::create( source.topic(), source.partition(), offset ) };
+    RdKafka::ErrorCode err = sync ? consumer->commitSync( offsets ) : consumer->commitAsync( offsets );
+
+    if ( err ) {
+        logger->error("cannot commit offset " + std::to_string(offset) + " of partition " + std::to_string(source.partition()) + " of " + source.topic() + " because: " + RdKafka::err2str( err ));
+    }
+
+    RdKafka::TopicPartition::destroy( offsets );
+}
+
+void PPM::run_lanes() {
+    std::vector<BSMHandler*> handlers;
+
+    while (bsms_available) {
+        // the lanes' handler too, so lanes opened later copy the reloaded inclusions.
+        handlers.clear();
+        for ( auto& lane : lanes ) {
+            handlers.push_back( &lane.second->handler );
+        }
+        if ( lane_handler ) {
+            handlers.push_back( lane_handler.get() );
+        }
+
+        if ( !handlers.empty() ) {
+            reload_inclusions_check( lane_reload, handlers );
+        }
+
+        // the rebalance callback opens and closes lanes during consume.
+        std::unique_ptr<RdKafka::Message> msg{ consumer->consume( consumer_timeout ) };
+        producer->poll(0);
+
+        // letters linger no longer than configured while no messages arrive.
+        if ( msg->err() == RdKafka::ERR__TIMED_OUT && dead_letters->enabled() ) {
+            flush_dead_letters( false );
+        }
+
+        if ( !msg_status(msg.get()) ) continue;
+
+        LaneKey key{ msg->topic_name(), msg->partition() };
+        auto search = lanes.find( key );
+        if ( search == lanes.end() ) {
+            // not assigned through the rebalance callback.
+            open_lane( key.first, key.second );
+            search = lanes.find( key );
+        }
+
+        Envelope* e = new Envelope{ std::move(msg), false, {}, {} };
+        unsigned polls = 0;
+        while ( !search->second->ring.try_push( std::move(e) ) ) idle( polls );
+    }
+
+    // at shutdown the BSMs still held are consumed again after the final commit; a restarted loop drops them.
+    if ( !bootstrap ) deliveries->freeze_holds();
+
+    while ( !lanes.empty() ) {
+        // the final offsets are committed once the producer is flushed.
+        LaneKey key = lanes.begin()->first;
+        close_lane( key.first, key.second, false );
+    }
+
+    logger->flush();
+}
+
 Quad::Ptr PPM::BuildGeofence( const std::string& mapfile )  // throws
 {
     geo::Point sw, ne;
@@ -556,30 +1336,214 @@ Quad::Ptr PPM::BuildGeofence( const std::string& mapfile )  // throws
         ne.lon = stod(search->second);
     }
 
+    unsigned threads = 0;
+    search = pconf.find("privacy.filter.geofence.threads");
+    if ( search != pconf.end() ) {
+        threads = std::stoul(search->second);              // throws.
+    }
+
     Quad::Ptr qptr = std::make_shared<Quad>(sw, ne);
 
     // Read the file and parse the shapes.
     shapes::CSVInputFactory shape_factory( mapfile );
-    shape_factory.make_shapes();
+    shape_factory.make_shapes(threads);
 
-    // Add all the shapes to the quad.
-    // NOTE: we are only using Edges right now.
-    for (auto& circle_ptr : shape_factory.get_circles()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(circle_ptr)); 
-    }
+    // Grids laid out on a regular lattice are served by the grid index and kept out of the quad.
+    grid_index = geo::GridIndex::build(shape_factory.get_grids());
 
-    for (auto& edge_ptr : shape_factory.get_edges()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(edge_ptr)); 
+    if (grid_index) {
+        logger->info("Indexed " + std::to_string(grid_index->size()) + " grid squares in " + std::to_string(grid_index->rows()) + " rows.");
     }
 
-    for (auto& grid_ptr : shape_factory.get_grids()) {
-        Quad::insert(qptr, std::dynamic_pointer_cast<const geo::Entity>(grid_ptr)); 
+    // Collect the shapes in the order they were inserted individually; the bulk load yields the same quad leaves.
+    geo::Entity::PtrList entities;
+    entities.insert(entities.end(), shape_factory.get_circles().begin(), shape_factory.get_circles().end());
+    entities.insert(entities.end(), shape_factory.get_edges().begin(), shape_factory.get_edges().end());
+    entities.insert(entities.end(), shape_factory.get_polygons().begin(), shape_factory.get_polygons().end());
+
+    if (!grid_index) {
+        entities.insert(entities.end(), shape_factory.get_grids().begin(), shape_factory.get_grids().end());
     }
 
+    Quad::bulk_load(qptr, entities, threads);
+
     logger->trace("Completed BuildGeofence.");
     return qptr;
 }
 
+DeliveryTracker::Source& PPM::delivery_source( const RdKafka::Message& message, DeliveryTracker::Source* last ) {
+    if ( last && last->partition() == message.partition() && last->topic() == message.topic_name() ) {
+        return *last;
+    }
+    return deliveries->source( message.topic_name(), message.partition() );
+}
+
+std::vector<RdKafka::TopicPartition*> PPM::delivered_offsets() {
+    std::vector<RdKafka::TopicPartition*> offsets;
+    std::vector<RdKafka::TopicPartition*> assignment;
+
+    if ( consumer->assignment( assignment ) != RdKafka::ERR_NO_ERROR ) {
+        return offsets;
+    }
+
+    // only the assigned partitions; a revoked one may be committed by its new owner.
+    for ( auto tp : assignment ) {
+        int64_t offset = deliveries->committable( deliveries->source( tp->topic(), tp->partition() ) );
+        if ( offset >= 0 ) {
+            offsets.push_back( RdKafka::TopicPartition::create( tp->topic(), tp->partition(), offset ) );
+        }
+    }
+
+    RdKafka::TopicPartition::destroy( assignment );
+    return offsets;
+}
+
+void PPM::store_offsets( bool force ) {
+    auto now = std::chrono::steady_clock::now();
+    if ( !force && now - offsets_stored < std::chrono::milliseconds( kOffsetStoreMillis ) ) return;
+    offsets_stored = now;
+
+    std::vector<RdKafka::TopicPartition*> offsets = delivered_offsets();
+
+    if ( !offsets.empty() ) {
+        RdKafka::ErrorCode err = consumer->offsets_store( offsets );
+        if ( err ) {
+            logger->warn("cannot store the delivered offsets because: " + RdKafka::err2str( err ));
+        }
+    }
+
+    RdKafka::TopicPartition::destroy( offsets );
+}
+
+bool PPM::publish( const std::string& bsm, const std::string& key, int64_t bytes, const std::string& kind, DeliveryTracker::Source* source, int64_t offset ) {
+    RdKafka::ErrorCode status;
+
+    // marked before producing; the report may arrive on another thread before produce returns.
+    DeliveryTracker::Delivery* delivery = source ? deliveries->produced( *source, offset ) : nullptr;
+
+    if ( audit->headers_enabled() ) {
+        // produced by name to carry headers, which reuses the filtered topic handle and its partitioner.
+        RdKafka::Headers* headers = decision_headers( kind );
+        status = producer->produce(published_topic, partition, RdKafka::Producer::RK_MSG_COPY, (void *)bsm.c_str(), bsm.size(), key.empty() ? NULL : key.c_str(), key.size(), 0, headers, delivery);
+
+        if (status != RdKafka::ERR_NO_ERROR) {
+            delete headers;
+        }
+    } else {
+        status = producer->produce(filtered_topic.get(), partition, RdKafka::Producer::RK_MSG_COPY, (void *)bsm.c_str(), bsm.size(), key.empty() ? NULL : &key, delivery);
+    }
+
+    if (status != RdKafka::ERR_NO_ERROR) {
+        logger->error("failed to produce " + kind + " BSM because: " + RdKafka::err2str( status ));
+
+        // an undelivered BSM holds back the offsets to commit.
+        if ( delivery ) deliveries->delivered( delivery, false );
+        return false;
+    }
+
+    // successfully sent; update counters.
+    bsm_send_count++;
+    bsm_send_bytes += bytes;
+    logger->trace("produced " + kind + " BSM successfully.");
+    return true;
+}
+
+void PPM::publish_released( const std::vector<std::string>& released, const std::vector<TripFilter::Hold>& holds, const std::string& key, DeliveryTracker::Source* source, int64_t offset ) {
+    for ( std::size_t i = 0; i < released.size(); ++i ) {
+        // produced before the hold is dropped, so the held offset stays outstanding until the BSM is delivered.
+        auto hold = i < holds.size() ? static_cast<const DeliveryTracker::Hold*>( holds[i].get() ) : nullptr;
+        publish( released[i], key, released[i].size(), "released", hold ? &hold->source() : source, hold ? hold->offset() : offset );
+    }
+}
+
+TripFilter::HoldFactory PPM::hold_factory( RdKafka::Message* const& current ) {
+    DeliveryTracker::Source* last = nullptr;
+
+    return [this, &current, last]() mutable -> TripFilter::Hold {
+        last = &delivery_source( *current, last );
+        return deliveries->hold( *last, current->offset() );
+    };
+}
+
+void PPM::dead_letter( RdKafka::Message* message, const std::string& payload, BSMHandler& handler, int64_t timestamp ) {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    if ( dead_letters->add( DeadLetterQueue::Letter{ payload, handler.get_result_string(), message->topic_name(), message->partition(), message->offset(), timestamp }, now ) ) {
+        flush_dead_letters( false );
+    }
+}
+
+void PPM::flush_dead_letters( bool all ) {
+    int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+
+    while ( producer && dead_letter_topic && ( all ? dead_letters->due( std::numeric_limits<int64_t>::max() ) : dead_letters->due( now ) ) ) {
+        std::vector<DeadLetterQueue::Letter> batch = dead_letters->take();
+        uint64_t failed = 0;
+        RdKafka::ErrorCode last = RdKafka::ERR_NO_ERROR;
+
+        if ( batch.empty() ) break;
+
+        for ( auto& letter : batch ) {
+            RdKafka::Headers* headers = RdKafka::Headers::create();
+            headers->add("ppm.reason", letter.reason);
+            headers->add("ppm.source.topic", letter.topic);
+            headers->add("ppm.source.partition", std::to_string(letter.partition));
+            headers->add("ppm.source.offset", std::to_string(letter.offset));
+
+            // produced asynchronously by name, which reuses the dead-letter topic handle and its configuration.
+            RdKafka::ErrorCode status = producer->produce(dead_letters->topic(), RdKafka::Topic::PARTITION_UA, RdKafka::Producer::RK_MSG_COPY,
+                    (void *)letter.payload.c_str(), letter.payload.size(), NULL, 0, letter.timestamp < 0 ? 0 : letter.timestamp, headers, NULL);
+
+            if ( status != RdKafka::ERR_NO_ERROR ) {
+                // the producer owns the headers only when the message is queued.
+                delete headers;
+                last = status;
+                ++failed;
+            }
+        }
+
+        dead_letters->delivered( batch.size() - failed, failed );
+
+        // one line per batch, not per message.
+        if ( failed > 0 ) {
+            logger->warn("dead letters: failed to produce " + std::to_string(failed) + " of " + std::to_string(batch.size()) + " messages because: " + RdKafka::err2str( last ));
+        }
+    }
+}
+
+RdKafka::Headers* PPM::decision_headers( const std::string& decision ) const {
+    RdKafka::Headers* headers = RdKafka::Headers::create();
+
+    for ( auto& header : audit->headers() ) {
+        headers->add( header.first, header.second );
+    }
+    headers->add( "ppm.decision", decision );
+
+    return headers;
+}
+
+void PPM::audit_decision( RdKafka::Message* message, BSMHandler::ResultStatus result, const std::string& result_string, int64_t timestamp ) {
+    uint64_t represents = 0;
+
+    if ( !producer || !audit_topic || !audit->sample( result, represents ) ) {
+        return;
+    }
+
+    std::string record = DecisionAudit::record( result_string, message->topic_name(), message->partition(), message->offset(), timestamp, represents );
+    RdKafka::Headers* headers = decision_headers( "suppressed" );
+
+    // produced by name to carry headers, which reuses the audit topic handle.
+    RdKafka::ErrorCode status = producer->produce(audit->topic(), RdKafka::Topic::PARTITION_UA, RdKafka::Producer::RK_MSG_COPY, (void *)record.c_str(), record.size(), NULL, 0, 0, headers, NULL);
+
+    if (status != RdKafka::ERR_NO_ERROR) {
+        delete headers;
+        logger->trace("failed to produce an audit record because: " + RdKafka::err2str( status ));
+    }
+}
+
+std::string PPM::output_key( BSMHandler& handler ) const {
+    return output_partitioner ? output_partitioner->key( handler.get_bsm() ) : "";
+}
+
 bool PPM::launch_producer()
 {
     std::string error_string;
@@ -599,6 +1563,27 @@ bool PPM::launch_producer()
         return false;
     } 
 
+    if ( dead_letters->enabled() ) {
+        // a handle of its own, without the output partitioner, so the dead letters are spread over the partitions.
+        std::unique_ptr<RdKafka::Conf> dconf{ RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC) };
+
+        dead_letter_topic = std::shared_ptr<RdKafka::Topic>( RdKafka::Topic::create(producer.get(), dead_letters->topic(), dconf.get(), error_string) );
+        if ( !dead_letter_topic ) {
+            logger->critical("Failed to create topic: " + dead_letters->topic() + ". Error: " + error_string + "." );
+            return false;
+        }
+    }
+
+    if ( audit->audit_enabled() ) {
+        std::unique_ptr<RdKafka::Conf> aconf{ RdKafka::Conf::create(RdKafka::Conf::CONF_TOPIC) };
+
+        audit_topic = std::shared_ptr<RdKafka::Topic>( RdKafka::Topic::create(producer.get(), audit->topic(), aconf.get(), error_string) );
+        if ( !audit_topic ) {
+            logger->critical("Failed to create topic: " + audit->topic() + ". Error: " + error_string + "." );
+            return false;
+        }
+    }
+
     logger->info("Producer: " + producer->name() + " created using topic: " + published_topic + ".");
     return true;
 }
@@ -616,31 +1601,21 @@ bool PPM::launch_consumer()
         }
     }
 
-    //raw_topic = nullptr;
-
-    std::vector<std::string> topics;
+    // subscribe at once; the group assigns the partitions when the topic exists, and a topic starting with ^ is a
+    // regular expression.
+    if (!subscribed) {
+        std::vector<std::string> topics{ consumed_topic };
+        RdKafka::ErrorCode err = consumer->subscribe(topics);
 
-    while ( bsms_available ) {
-        if ( topic_available( consumed_topic ) ) {
-            logger->trace("Consumer topic: " + consumed_topic + " is available.");
-            //raw_topic = std::shared_ptr<RdKafka::Topic>( RdKafka::Topic::create(consumer.get(), consumed_topic, tconf, error_string) );
-            topics.push_back(consumed_topic);
-            RdKafka::ErrorCode err = consumer->subscribe(topics);
-
-            if ( err ) {
-                logger->critical("Failed to subscribe to topic: " + consumed_topic + ". Error: " + RdKafka::err2str(err) + "." );
-                return false;
-            } 
-
-            break;
+        if ( err ) {
+            logger->critical("Failed to subscribe to topic: " + consumed_topic + ". Error: " + RdKafka::err2str(err) + "." );
+            return false;
         }
 
-        // topic is not available, wait for a second or two.
-        std::this_thread::sleep_for( std::chrono::milliseconds( 1500 ) );
-        logger->trace("Waiting for needed consumer topic: " + consumed_topic + ".");
+        subscribed = true;
     }
 
-    logger->info("Consumer: " + consumer->name() + " created using topic: " + consumed_topic + ".");
+    logger->info("Consumer: " + consumer->name() + " subscribed to topic: " + consumed_topic + ".");
     return true;
 }
 
@@ -732,10 +1707,14 @@ bool PPM::make_loggers( bool remove_files )
 int PPM::operator()(void) {
 
     std::string error_string;
-    RdKafka::ErrorCode status;
 
     signal(SIGINT, sigterm);
     signal(SIGTERM, sigterm);
+#ifdef SIGHUP
+    signal(SIGHUP, sighup);
+#endif
+
+    start_time = std::chrono::steady_clock::now();
 
     try {
         // throws for mapfile and other items.
@@ -748,9 +1727,13 @@ int PPM::operator()(void) {
         return EXIT_FAILURE;
     }
 
+    // the geofence is built while the consumer joins its group.
+    std::future<void> geofence = std::async(std::launch::async, [this]() { load_geofence(); });
+
     while (bootstrap) {
         // reset flag here, or else nothing works below
         bsms_available = true;
+        deliveries->thaw_holds();
 
         if (!launch_consumer()) {
             std::this_thread::sleep_for( std::chrono::milliseconds( 1500 ) );
@@ -764,8 +1747,20 @@ int PPM::operator()(void) {
             continue;
         }
 
+        if (geofence.valid()) {
+            try {
+                geofence.get();
+                logger->info("geofence ready " + std::to_string( std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start_time ).count() ) + " ms after start.");
+
+            } catch (std::exception& e) {
+                logger->critical("Fatal std::Exception: " + std::string(e.what()));
+                return EXIT_FAILURE;
+            }
+        }
+
         // JMC: There was leak in here caused by RapidJSON.  It has been fixed.  The notes are in that class's code.
-        BSMHandler handler{qptr, pconf, logger};
+        BSMHandler handler = make_handler();
+        audit->set_build( kVersion, map_hash, handler.get_activation_flag() );
 
         std::vector<RdKafka::TopicPartition*> partitions;
         RdKafka::ErrorCode err = consumer->position(partitions);
@@ -778,36 +1773,103 @@ int PPM::operator()(void) {
             }
         }
 
+        if (laned) {
+            run_lanes();
+            continue;
+        }
+
+        if (pipelined) {
+            run_pipeline(handler);
+            continue;
+        }
+
+        // inclusion reloads run in the background; declared after the handler so it finishes first.
+        std::future<bool> inclusion_reload;
+        const std::vector<BSMHandler*> handlers{ &handler };
+        DeliveryTracker::Source* source = nullptr;
+
+        // the BSMs the trip filter holds keep their offsets outstanding.
+        RdKafka::Message* current = nullptr;
+        const TripFilter::HoldFactory make_hold = hold_factory( current );
+        handler.set_hold_factory( &make_hold );
+
         // consume-produce loop.
         while (bsms_available) {
+            reload_inclusions_check( inclusion_reload, handlers );
+
             std::unique_ptr<RdKafka::Message> msg{ consumer->consume( consumer_timeout ) };
+            current = msg.get();
 
-            if ( msg_consume(msg.get(), NULL, handler) ) {
-                status = producer->produce(filtered_topic.get(), partition, RdKafka::Producer::RK_MSG_COPY, (void *)handler.get_json().c_str(), handler.get_bsm_buffer_size(), NULL, NULL);
+            bool retained = msg_consume(msg.get(), NULL, handler);
 
-                if (status != RdKafka::ERR_NO_ERROR) {
-                    logger->error("failed to produce retained BSM because: " + RdKafka::err2str( status ));
+            // letters linger no longer than configured while no messages arrive.
+            if ( msg->err() == RdKafka::ERR__TIMED_OUT && dead_letters->enabled() ) {
+                flush_dead_letters( false );
+            }
+
+            if ( msg->err() == RdKafka::ERR_NO_ERROR ) {
+                const std::string key = output_key( handler );
+                source = &delivery_source( *msg, source );
 
-                } else {
-                    // successfully sent; update counters.
-                    bsm_send_count++;
-                    bsm_send_bytes += msg->len();
-                    logger->trace("produced BSM successfully.");
+                // held BSMs released by this one precede it.
+                publish_released( handler.get_released(), handler.get_released_holds(), key, source, msg->offset() );
+
+                if ( retained ) {
+                    publish( handler.get_json(), key, msg->len(), "retained", source, msg->offset() );
                 }
+
+                deliveries->processed( *source, msg->offset() );
             }
 
+            // serve the delivery reports, then store the offsets they allow.
+            producer->poll(0);
+            store_offsets( false );
+
             // NOTE: good for troubleshooting, but bad for performance.
             logger->flush();
         }
+
+        // at shutdown the BSMs still held are consumed again after the final commit; a restarted loop drops them.
+        if ( !bootstrap ) deliveries->freeze_holds();
     }
 
     logger->info("PPM operations complete; shutting down...");
+    shutdown();
+
     logger->info("PPM consumed  : " + std::to_string(bsm_recv_count) + " BSMs and " + std::to_string(bsm_recv_bytes) + " bytes");
     logger->info("PPM published : " + std::to_string(bsm_send_count) + " BSMs and " + std::to_string(bsm_send_bytes) + " bytes");
     logger->info("PPM suppressed: " + std::to_string(bsm_filt_count) + " BSMs and " + std::to_string(bsm_filt_bytes) + " bytes");
+
+    if ( shedder->enabled() ) {
+        auto metrics = shedder->metrics();
+        logger->info("PPM shed      : " + std::to_string(metrics.aged) + " BSMs by age and " + std::to_string(metrics.sampled) + " by sampling; degraded " + std::to_string(metrics.degradations) + " times");
+    }
+
+    if ( dead_letters->enabled() ) {
+        auto metrics = dead_letters->metrics();
+        logger->info("PPM dead letters: " + std::to_string(metrics.produced) + " produced, " + std::to_string(metrics.failed) + " failed, and " + std::to_string(metrics.dropped) + " dropped");
+    }
     return EXIT_SUCCESS;
 }
 
+void PPM::add_options() {
+    addOption('c', "config", "Configuration for Kafka and Privacy Protection Module.", true);
+    addOption('C', "config-check", "Check the configuration and output the settings.", false);
+    addOption('u', "unfiltered-topic", "The unfiltered consume topic.", true);
+    addOption('f', "filtered-topic", "The unfiltered produce topic.", true);
+    addOption('p', "partition", "Consumer topic partition from which to read.", true);
+    addOption('g', "group", "Consumer group identifier", true);
+    addOption('b', "broker", "List of broker addresses (localhost:9092)", true);
+    addOption('o', "offset", "Byte offset to start reading in the consumed topic.", true);
+    addOption('x', "exit", "Exit consumer when last message in partition has been received.", false);
+    addOption('d', "debug", "debug level.", true);
+    addOption('m', "mapfile", "Map data file to specify the geofence.", true);
+    addOption('D', "log-dir", "Directory for the log files.", true);
+    addOption('R', "log-rm", "Remove specified/default log files if they exist.", false);
+    addOption('i', "log", "Log file name.", true);
+    addOption('h', "help", "print out some help");
+}
+
 const char* PPM::getEnvironmentVariable(const char* variableName) {
     const char* toReturn = getenv(variableName);
     if (!toReturn) {
@@ -817,27 +1879,13 @@ const char* PPM::getEnvironmentVariable(const char* variableName) {
     return toReturn;
 }
 
-#ifndef _PPM_TESTS
+#if !defined(_PPM_TESTS) && !defined(_PPM_NO_MAIN)
 
 int main( int argc, char* argv[] )
 {
     PPM ppm{"ppm","Privacy Protection Module"};
 
-    ppm.addOption('c', "config", "Configuration for Kafka and Privacy Protection Module.", true);
-    ppm.addOption('C', "config-check", "Check the configuration and output the settings.", false);
-    ppm.addOption('u', "unfiltered-topic", "The unfiltered consume topic.", true);
-    ppm.addOption('f', "filtered-topic", "The unfiltered produce topic.", true);
-    ppm.addOption('p', "partition", "Consumer topic partition from which to read.", true);
-    ppm.addOption('g', "group", "Consumer group identifier", true);
-    ppm.addOption('b', "broker", "List of broker addresses (localhost:9092)", true);
-    ppm.addOption('o', "offset", "Byte offset to start reading in the consumed topic.", true);
-    ppm.addOption('x', "exit", "Exit consumer when last message in partition has been received.", false);
-    ppm.addOption('d', "debug", "debug level.", true);
-    ppm.addOption('m', "mapfile", "Map data file to specify the geofence.", true);
-    ppm.addOption('D', "log-dir", "Directory for the log files.", true);
-    ppm.addOption('R', "log-rm", "Remove specified/default log files if they exist.", false);
-    ppm.addOption('i', "log", "Log file name.", true);
-    ppm.addOption('h', "help", "print out some help");
+    ppm.add_options();
 
     if (!ppm.parseArgs(argc, argv)) {
         ppm.usage();
@@ -858,6 +1906,7 @@ int main( int argc, char* argv[] )
     if (ppm.optIsSet('C')) {
         try {
             if (ppm.configure()) {
+                ppm.load_geofence();
                 ppm.print_configuration();
                 exit(EXIT_SUCCESS);
             } else {
@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "librdkafka/rdkafka_mock.h"
+#include "ppm.hpp"
+#include "ppmKafkaBench.hpp"
+
+namespace {
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+}
+
+PpmKafkaBench::PpmKafkaBench( const std::string& name, const std::string& description ) :
+    Tool{ name, description, false },
+    bootstraps{},
+    consumed_topic{ "ppm.bench.OdeBsmJson" },
+    corpus_bytes{ 0 }
+{}
+
+void PpmKafkaBench::add_options() {
+    addOption('c', "config", "The PPM configuration; the brokers, topics, and producer settings are replaced.", true);
+    addOption('m', "mapfile", "Map data file to specify the geofence.", true);
+    addOption('t', "templates", "The ODE BSMs, one per line, the corpus is made from.", true, "unit-test-data/test-case.inside.geofence.json");
+    addOption('n', "count", "The number of BSMs in the corpus.", true, "100000");
+    addOption('v', "vehicles", "The number of distinct vehicle ids in the corpus.", true, "1000");
+    addOption('P', "partitions", "The number of partitions of the consumed topic.", true, "1");
+    addOption('B', "brokers", "The number of mock brokers.", true, "3");
+    addOption('s', "settings", "The producer settings to run, as batch/linger/compression separated by commas.", true, "10000/5/none,10000/5/lz4,1000/0/none,100000/50/lz4");
+    addOption('q', "quiet", "The milliseconds without a published BSM that end a run.", true, "3000");
+    addOption('D', "log-dir", "Directory for the PPM log files.", true, "logs/");
+    addOption('h', "help", "print out some help");
+}
+
+std::vector<PpmKafkaBench::Setting> PpmKafkaBench::parse_settings( const std::string& settings ) {
+    std::vector<Setting> r;
+
+    for ( auto& setting : string_utilities::split( settings, ',' ) ) {
+        StrVector pieces = string_utilities::split( string_utilities::strip( setting ), '/' );
+        if ( pieces.size() != 3 ) {
+            throw std::invalid_argument( "a setting is batch/linger/compression: " + setting );
+        }
+        r.push_back( Setting{ pieces[0], pieces[1], pieces[2] } );
+    }
+
+    return r;
+}
+
+double PpmKafkaBench::percentile( const std::vector<double>& sorted, double p ) {
+    if ( sorted.empty() ) return 0.0;
+    return sorted[ static_cast<std::size_t>( p * ( sorted.size() - 1 ) + 0.5 ) ];
+}
+
+uint64_t PpmKafkaBench::preload( RdKafka::Producer& loader, const BsmSynthesizer& synthesize, uint64_t count ) {
+    uint64_t produced = 0;
+
+    for ( uint64_t n = 0; n < count; ++n ) {
+        std::string bsm = synthesize( n );
+
+        RdKafka::ErrorCode err;
+        while ( ( err = loader.produce( consumed_topic, RdKafka::Topic::PARTITION_UA, RdKafka::Producer::RK_MSG_COPY, (void *)bsm.c_str(), bsm.size(), NULL, 0, 0, NULL ) ) == RdKafka::ERR__QUEUE_FULL ) {
+            loader.poll( 100 );
+        }
+
+        if ( err != RdKafka::ERR_NO_ERROR ) {
+            std::cerr << "cannot preload the corpus: " << RdKafka::err2str( err ) << std::endl;
+            break;
+        }
+
+        corpus_bytes += bsm.size();
+        ++produced;
+        loader.poll( 0 );
+    }
+
+    loader.flush( 60000 );
+    return produced - loader.outq_len();
+}
+
+bool PpmKafkaBench::run_setting( const Setting& setting, int index, Result& result ) {
+    std::string error_string;
+    std::string published_topic = "ppm.bench.filtered." + std::to_string( index );
+    std::string config_file = optString('D') + "/ppm_bench_" + std::to_string( index ) + ".properties";
+
+    // the base configuration, then the settings of this run; later lines replace earlier ones.
+    std::ifstream base{ optString('c') };
+    std::ofstream config{ config_file };
+    if ( !base || !config ) {
+        std::cerr << "cannot copy the configuration " << optString('c') << " to " << config_file << std::endl;
+        return false;
+    }
+
+    config << base.rdbuf() << "\n"
+        << "batch.num.messages=" << setting.batch << "\n"
+        << "linger.ms=" << setting.linger << "\n"
+        << "compression.type=" << setting.compression << "\n"
+        << "auto.offset.reset=earliest\n"
+        << "privacy.log.decisions=OFF\n";
+    config.close();
+
+    // the real PPM, configured as from its command line. ~PPM waits up to 5 s for every librdkafka handle to be destroyed,
+    // so the reader is made after it and destroyed first; the loader lives through every run, so each run still ends
+    // with that wait.
+    std::unique_ptr<PPM> ppm{ new PPM{ "ppm", "Privacy Protection Module" } };
+    ppm->add_options();
+    ppm->set( 'c', config_file.c_str() );
+    ppm->set( 'b', bootstraps.c_str() );
+    ppm->set( 'u', consumed_topic.c_str() );
+    ppm->set( 'f', published_topic.c_str() );
+    ppm->set( 'g', ( "ppm.bench." + std::to_string( index ) ).c_str() );
+    ppm->set( 'D', optString('D').c_str() );
+    ppm->set( 'i', ( "ppm_bench_" + std::to_string( index ) + ".log" ).c_str() );
+    if ( optIsSet('m') ) {
+        ppm->set( 'm', optString('m').c_str() );
+    }
+
+    if ( !ppm->make_loggers( true ) ) {
+        return false;
+    }
+
+    // the reader of the filtered topic.
+    std::unique_ptr<RdKafka::Conf> rconf{ RdKafka::Conf::create( RdKafka::Conf::CONF_GLOBAL ) };
+    rconf->set( "metadata.broker.list", bootstraps, error_string );
+    rconf->set( "group.id", "ppm.bench.reader." + std::to_string( index ), error_string );
+    rconf->set( "auto.offset.reset", "earliest", error_string );
+
+    std::unique_ptr<RdKafka::KafkaConsumer> reader{ RdKafka::KafkaConsumer::create( rconf.get(), error_string ) };
+    if ( !reader ) {
+        std::cerr << "cannot create the reader: " << error_string << std::endl;
+        return false;
+    }
+    reader->subscribe( std::vector<std::string>{ published_topic } );
+
+    PPM::reset_signals();
+    std::thread runner{ [&ppm]() { ppm->run(); } };
+
+    std::vector<double> latencies;
+    auto start = std::chrono::steady_clock::now();
+    auto first = start;
+    auto last = start;
+    auto quiet = std::chrono::milliseconds( optInt('q') );
+
+    // read until the PPM is quiet; allow a minute for the group join and the geofence.
+    while ( latencies.empty() ? std::chrono::steady_clock::now() - start < std::chrono::seconds( 60 ) : std::chrono::steady_clock::now() - last < quiet ) {
+        std::unique_ptr<RdKafka::Message> message{ reader->consume( 100 ) };
+
+        if ( message->err() != RdKafka::ERR_NO_ERROR ) {
+            continue;
+        }
+
+        last = std::chrono::steady_clock::now();
+        if ( latencies.empty() ) {
+            first = last;
+        }
+
+        latencies.push_back( static_cast<double>( now_ms() - message->timestamp().timestamp ) );
+    }
+
+    PPM::sigterm( SIGTERM );
+    runner.join();
+    reader->close();
+    reader.reset();
+
+    std::sort( latencies.begin(), latencies.end() );
+    result.published = latencies.size();
+    result.seconds = std::chrono::duration<double>( last - first ).count();
+    result.p50 = percentile( latencies, 0.50 );
+    result.p95 = percentile( latencies, 0.95 );
+    result.p99 = percentile( latencies, 0.99 );
+    result.max = latencies.empty() ? 0.0 : latencies.back();
+    return !latencies.empty();
+}
+
+int PpmKafkaBench::operator()( void ) {
+    std::string error_string;
+
+    if ( !optIsSet('c') ) {
+        std::cerr << "a PPM configuration is required." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Setting> settings = parse_settings( optString('s') );      // throws.
+    uint64_t count = std::stoull( optString('n') );                        // throws.
+    uint64_t vehicles = std::stoull( optString('v') );                     // throws.
+
+    std::vector<std::string> templates;
+    std::ifstream ifs{ optString('t') };
+    std::string line;
+
+    while ( std::getline( ifs, line ) ) {
+        templates.push_back( line );
+    }
+
+    BsmSynthesizer synthesize{ templates, vehicles };
+    if ( synthesize.size() == 0 ) {
+        std::cerr << "no ODE BSMs in " << optString('t') << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // the run configurations are written beside the PPM logs.
+    mkdir( optString('D').c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH );
+
+    // the loader's handle owns the mock cluster.
+    std::unique_ptr<RdKafka::Conf> lconf{ RdKafka::Conf::create( RdKafka::Conf::CONF_GLOBAL ) };
+    if ( lconf->set( "test.mock.num.brokers", optString('B'), error_string ) != RdKafka::Conf::CONF_OK ) {
+        std::cerr << "cannot start the mock cluster: " << error_string << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<RdKafka::Producer> loader{ RdKafka::Producer::create( lconf.get(), error_string ) };
+    if ( !loader ) {
+        std::cerr << "cannot create the loader: " << error_string << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    rd_kafka_mock_cluster_t* cluster = rd_kafka_handle_mock_cluster( loader->c_ptr() );
+    if ( !cluster ) {
+        std::cerr << "this librdkafka has no mock cluster." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    bootstraps = rd_kafka_mock_cluster_bootstraps( cluster );
+    rd_kafka_mock_topic_create( cluster, consumed_topic.c_str(), optInt('P'), 1 );
+    for ( std::size_t i = 0; i < settings.size(); ++i ) {
+        rd_kafka_mock_topic_create( cluster, ( "ppm.bench.filtered." + std::to_string( i ) ).c_str(), optInt('P'), 1 );
+    }
+
+    auto loaded = preload( *loader, synthesize, count );
+    std::cout << "preloaded " << loaded << " BSMs (" << corpus_bytes << " bytes) on " << optString('B') << " mock brokers at " << bootstraps << "\n\n";
+
+    std::printf( "%-8s %-6s %-8s %10s %10s %10s %9s %9s %9s %9s\n", "batch", "linger", "codec", "published", "msgs/s", "MB/s", "p50 ms", "p95 ms", "p99 ms", "max ms" );
+
+    for ( std::size_t i = 0; i < settings.size(); ++i ) {
+        Result result{};
+
+        if ( !run_setting( settings[i], static_cast<int>( i ), result ) ) {
+            std::printf( "%-8s %-6s %-8s %10s\n", settings[i].batch.c_str(), settings[i].linger.c_str(), settings[i].compression.c_str(), "no output" );
+            continue;
+        }
+
+        // the corpus was consumed while the BSMs were published, so the rates are of the corpus.
+        double seconds = result.seconds > 0.0 ? result.seconds : 1e-3;
+        std::printf( "%-8s %-6s %-8s %10llu %10.0f %10.2f %9.1f %9.1f %9.1f %9.1f\n", settings[i].batch.c_str(), settings[i].linger.c_str(), settings[i].compression.c_str(),
+                static_cast<unsigned long long>( result.published ), loaded / seconds, corpus_bytes / seconds / 1e6, result.p50, result.p95, result.p99, result.max );
+        std::fflush( stdout );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main( int argc, char* argv[] )
+{
+    PpmKafkaBench bench{ "ppm_kafka_bench", "End-to-end PPM throughput on librdkafka's mock cluster" };
+    bench.add_options();
+
+    if ( !bench.parseArgs( argc, argv ) ) {
+        bench.usage();
+        exit( EXIT_FAILURE );
+    }
+
+    if ( bench.optIsSet('h') ) {
+        bench.help();
+        exit( EXIT_SUCCESS );
+    }
+
+    try {
+        exit( bench.run() );
+    } catch ( std::exception& e ) {
+        std::cerr << "std::exception: " << e.what() << std::endl;
+        exit( EXIT_FAILURE );
+    }
+}
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+
+#include "ppm.hpp"
+#include "bsmSynthesizer.hpp"
+#include "ppmLoadgen.hpp"
+
+namespace {
+
+int64_t now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+double percentile( const std::vector<double>& sorted, double p ) {
+    if ( sorted.empty() ) return 0.0;
+    return sorted[ static_cast<std::size_t>( p * ( sorted.size() - 1 ) + 0.5 ) ];
+}
+
+}
+
+PpmLoadgen::PpmLoadgen( const std::string& name, const std::string& description ) :
+    Tool{ name, description, false },
+    mutex{},
+    received{},
+    duplicates{ 0 },
+    untraced{ 0 },
+    reading{ false }
+{}
+
+void PpmLoadgen::add_options() {
+    addOption('c', "config", "The configuration of the PPM under test, for the expected outcomes.", true);
+    addOption('m', "mapfile", "Map data file of the PPM under test.", true);
+    addOption('p', "profile", "The send schedule: constant:RATE:SECONDS, ramp:FROM:TO:SECONDS, or burst:BASE:PEAK:PERIOD_MS:LENGTH_MS:SECONDS.", true);
+    addOption('t', "templates", "The ODE BSMs, one per line, the corpus is made from.", true, "unit-test-data/test-case.all.good.json");
+    addOption('v', "vehicles", "The number of distinct vehicle ids in the corpus.", true, "1000");
+    addOption('b', "broker", "List of broker addresses.", true, "localhost:9092");
+    addOption('u', "unfiltered-topic", "The topic the PPM consumes.", true, "topic.OdeBsmJson");
+    addOption('f', "filtered-topic", "The topic the PPM publishes to.", true, "topic.FilteredOdeBsmJson");
+    addOption('q', "quiet", "The milliseconds without a published BSM, after sending, that end the test.", true, "5000");
+    addOption('L', "latency", "The largest 99th percentile latency in milliseconds that passes; 0 to not check.", true, "0");
+    addOption('D', "log-dir", "Directory for the log of the expected outcomes.", true, "logs/");
+    addOption('h', "help", "print out some help");
+}
+
+void PpmLoadgen::read( RdKafka::KafkaConsumer& reader ) {
+    while ( reading ) {
+        std::unique_ptr<RdKafka::Message> message{ reader.consume( 100 ) };
+
+        if ( message->err() != RdKafka::ERR_NO_ERROR ) {
+            continue;
+        }
+
+        int64_t when = now_ms();
+        int64_t serial = BsmSynthesizer::serial( std::string{ static_cast<const char*>( message->payload() ), message->len() } );
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        if ( serial < 0 ) {
+            ++untraced;
+        } else if ( !received.emplace( serial, when ).second ) {
+            ++duplicates;
+        }
+    }
+}
+
+int PpmLoadgen::operator()( void ) {
+    std::string error_string;
+
+    if ( !optIsSet('c') || !optIsSet('p') ) {
+        std::cerr << "a PPM configuration and a load profile are required." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    LoadProfile profile{ optString('p') };                                  // throws.
+    double max_latency = std::stod( optString('L') );                       // throws.
+
+    std::vector<std::string> templates;
+    std::ifstream ifs{ optString('t') };
+    std::string line;
+
+    while ( std::getline( ifs, line ) ) {
+        templates.push_back( line );
+    }
+
+    BsmSynthesizer synthesize{ templates, std::stoull( optString('v') ) };  // throws.
+    if ( synthesize.size() == 0 ) {
+        std::cerr << "no ODE BSMs in " << optString('t') << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // a PPM configured as the one under test gives the expected outcomes; it does not connect to Kafka.
+    PPM ppm{ "ppm", "Privacy Protection Module" };
+    ppm.add_options();
+    ppm.set( 'c', optString('c').c_str() );
+    ppm.set( 'D', optString('D').c_str() );
+    ppm.set( 'i', "ppm_loadgen.log" );
+    ppm.set( 'u', optString('u').c_str() );
+    ppm.set( 'f', optString('f').c_str() );
+    if ( optIsSet('m') ) {
+        ppm.set( 'm', optString('m').c_str() );
+    }
+
+    if ( !ppm.make_loggers( true ) || !ppm.configure() ) {
+        std::cerr << "cannot configure the PPM from " << optString('c') << std::endl;
+        return EXIT_FAILURE;
+    }
+    ppm.load_geofence();                                                    // throws.
+
+    // the corpus and its schedule are made before the test, so sending is only producing.
+    uint64_t total = profile.total();
+    std::vector<std::string> corpus;
+    std::vector<std::string> ids;
+    std::vector<double> offsets;
+    corpus.reserve( total );
+    ids.reserve( total );
+    offsets.reserve( total );
+
+    for ( uint64_t n = 0; n < total; ++n ) {
+        corpus.push_back( synthesize( n ) );
+        ids.push_back( synthesize.id( n ) );
+        offsets.push_back( profile.time_of( n ) );
+    }
+
+    std::unique_ptr<RdKafka::Conf> conf{ RdKafka::Conf::create( RdKafka::Conf::CONF_GLOBAL ) };
+    conf->set( "metadata.broker.list", optString('b'), error_string );
+    conf->set( "linger.ms", "1", error_string );
+
+    std::unique_ptr<RdKafka::Producer> producer{ RdKafka::Producer::create( conf.get(), error_string ) };
+    if ( !producer ) {
+        std::cerr << "cannot create the producer: " << error_string << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // read only what is published from now on.
+    conf->set( "group.id", "ppm.loadgen." + std::to_string( now_ms() ), error_string );
+    conf->set( "auto.offset.reset", "latest", error_string );
+
+    std::unique_ptr<RdKafka::KafkaConsumer> reader{ RdKafka::KafkaConsumer::create( conf.get(), error_string ) };
+    if ( !reader ) {
+        std::cerr << "cannot create the reader: " << error_string << std::endl;
+        return EXIT_FAILURE;
+    }
+    reader->subscribe( std::vector<std::string>{ optString('f') } );
+
+    std::vector<RdKafka::TopicPartition*> assigned;
+    auto joined = std::chrono::steady_clock::now();
+    while ( assigned.empty() && std::chrono::steady_clock::now() - joined < std::chrono::seconds( 30 ) ) {
+        delete reader->consume( 100 );
+        reader->assignment( assigned );
+    }
+
+    if ( assigned.empty() ) {
+        std::cerr << "the reader was not assigned the topic " << optString('f') << std::endl;
+        return EXIT_FAILURE;
+    }
+    RdKafka::TopicPartition::destroy( assigned );
+
+    reading = true;
+    std::thread reader_thread{ [this, &reader]() { read( *reader ); } };
+
+    std::cout << "sending " << total << " BSMs over " << profile.duration() << " s to " << optString('u') << std::endl;
+
+    // open loop: each BSM is sent when it is due, however the ones before it fared.
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds( 100 );
+    int64_t start_ms = now_ms() + 100;
+    std::vector<int64_t> due_ms( total );
+    uint64_t late = 0;
+
+    for ( uint64_t n = 0; n < total; ++n ) {
+        auto when = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( offsets[n] ) );
+        due_ms[n] = start_ms + static_cast<int64_t>( std::llround( offsets[n] * 1000.0 ) );
+
+        auto now = std::chrono::steady_clock::now();
+        if ( when - now > std::chrono::milliseconds( 1 ) ) {
+            std::this_thread::sleep_for( when - now - std::chrono::microseconds( 500 ) );
+        }
+        while ( std::chrono::steady_clock::now() < when ) {
+            std::this_thread::yield();
+        }
+
+        if ( std::chrono::steady_clock::now() - when > std::chrono::milliseconds( 10 ) ) {
+            ++late;
+        }
+
+        // the due time is the Kafka timestamp, which the PPM's stateful filters see; keyed by the vehicle id, as the
+        // ODE does, so each vehicle's BSMs stay in order on one partition.
+        RdKafka::ErrorCode err;
+        while ( ( err = producer->produce( optString('u'), RdKafka::Topic::PARTITION_UA, RdKafka::Producer::RK_MSG_COPY, (void *)corpus[n].c_str(), corpus[n].size(), ids[n].c_str(), ids[n].size(), due_ms[n], NULL ) ) == RdKafka::ERR__QUEUE_FULL ) {
+            producer->poll( 1 );
+        }
+
+        if ( err != RdKafka::ERR_NO_ERROR ) {
+            std::cerr << "cannot send BSM " << n << ": " << RdKafka::err2str( err ) << std::endl;
+            break;
+        }
+
+        producer->poll( 0 );
+    }
+
+    double sending = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    producer->flush( 30000 );
+
+    // wait until the PPM is quiet.
+    auto quiet = std::chrono::milliseconds( std::stoll( optString('q') ) );
+    std::size_t count = 0;
+    auto last = std::chrono::steady_clock::now();
+
+    while ( std::chrono::steady_clock::now() - last < quiet ) {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+
+        std::lock_guard<std::mutex> lock{ mutex };
+        if ( received.size() != count ) {
+            count = received.size();
+            last = std::chrono::steady_clock::now();
+        }
+    }
+
+    reading = false;
+    reader_thread.join();
+    reader->close();
+
+    // the expected outcomes: the corpus through the PPM's handler, in the order and with the timestamps it was sent.
+    BSMHandler handler = ppm.make_handler();
+    std::unordered_set<int64_t> expected;
+
+    for ( uint64_t n = 0; n < total; ++n ) {
+        bool retained = handler.process( corpus[n], due_ms[n] );
+
+        for ( auto& released : handler.get_released() ) {
+            expected.insert( BsmSynthesizer::serial( released ) );
+        }
+
+        if ( retained ) {
+            expected.insert( static_cast<int64_t>( n ) );
+        }
+    }
+
+    uint64_t missing = 0;
+    uint64_t unexpected = 0;
+    std::vector<double> latencies;
+
+    for ( auto serial : expected ) {
+        missing += received.find( serial ) == received.end();
+    }
+
+    for ( auto& r : received ) {
+        unexpected += expected.find( r.first ) == expected.end();
+
+        if ( r.first >= 0 && static_cast<uint64_t>( r.first ) < total ) {
+            latencies.push_back( static_cast<double>( r.second - due_ms[ r.first ] ) );
+        }
+    }
+
+    std::sort( latencies.begin(), latencies.end() );
+    double p99 = percentile( latencies, 0.99 );
+
+    std::printf( "sent      : %llu BSMs in %.1f s (%.0f msgs/s offered, %.0f msgs/s sent); %llu sent more than 10 ms late\n",
+            static_cast<unsigned long long>( total ), sending, profile.duration() > 0 ? total / profile.duration() : 0.0,
+            sending > 0 ? total / sending : 0.0, static_cast<unsigned long long>( late ) );
+    std::printf( "expected  : %zu retained, %llu suppressed\n", expected.size(), static_cast<unsigned long long>( total - expected.size() ) );
+    std::printf( "published : %zu BSMs; %llu missing, %llu unexpected, %llu duplicates, %llu without a serial number\n",
+            received.size(), static_cast<unsigned long long>( missing ), static_cast<unsigned long long>( unexpected ),
+            static_cast<unsigned long long>( duplicates ), static_cast<unsigned long long>( untraced ) );
+    std::printf( "latency   : p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms\n",
+            percentile( latencies, 0.50 ), percentile( latencies, 0.95 ), p99, latencies.empty() ? 0.0 : latencies.back() );
+
+    bool pass = missing == 0 && unexpected == 0 && duplicates == 0 && ( max_latency <= 0.0 || p99 <= max_latency );
+    std::printf( "%s\n", pass ? "PASS" : "FAIL" );
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main( int argc, char* argv[] )
+{
+    PpmLoadgen loadgen{ "ppm_loadgen", "Rate-controlled BSM load generator and verifier for a running PPM" };
+    loadgen.add_options();
+
+    if ( !loadgen.parseArgs( argc, argv ) ) {
+        loadgen.usage();
+        exit( EXIT_FAILURE );
+    }
+
+    if ( loadgen.optIsSet('h') ) {
+        loadgen.help();
+        exit( EXIT_SUCCESS );
+    }
+
+    try {
+        exit( loadgen.run() );
+    } catch ( std::exception& e ) {
+        std::cerr << "std::exception: " << e.what() << std::endl;
+        exit( EXIT_FAILURE );
+    }
+}
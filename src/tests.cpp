@@ -1,4 +1,5 @@
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include "catch.hpp"
 #include "redactionPropertiesManager.hpp"
 
@@ -22,10 +23,33 @@
 // #include <algorithm>
 #include <regex>
 #include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <cstdlib>
+#include <limits>
+#include <cstdio>
+#include <unordered_set>
+#include <atomic>
+#include <thread>
 
 #include "cvlib.hpp"
 #include "bsmHandler.hpp"
 #include "bsm.hpp"
+#include "vehicleStateTable.hpp"
+#include "downsampleFilter.hpp"
+#include "duplicateFilter.hpp"
+#include "tripFilter.hpp"
+#include "corePrefilter.hpp"
+#include "payloadRegistry.hpp"
+#include "spscRing.hpp"
+#include "outputPartitioner.hpp"
+#include "loadShedder.hpp"
+#include "deadLetterQueue.hpp"
+#include "deliveryTracker.hpp"
+#include "decisionAudit.hpp"
+#include "loadProfile.hpp"
+#include "bsmSynthesizer.hpp"
 
 static std::shared_ptr<PpmLogger> testLogger = std::make_shared<PpmLogger>("test.log");
 
@@ -422,6 +446,126 @@ TEST_CASE( "Parse Shape File Data", "[quad][shapefile]" ) {
     CHECK_NOTHROW(output_factory.write_shapes());
 }
 
+/**
+ * @brief Read a shape file one line at a time with the std::string based factory methods.
+ */
+void readShapesByLine( const std::string& mapfile, shapes::CSVInputFactory& factory ) {
+    std::ifstream file( mapfile );
+    std::string line;
+    std::getline( file, line );
+
+    while ( std::getline( file, line ) ) {
+        StrVector parts = string_utilities::split( line, ',' );
+        if ( parts.size() < 3 || parts.size() > 4 ) continue;
+
+        try {
+            if ( parts[0] == "circle" ) factory.make_circle( parts );
+            else if ( parts[0] == "edge" ) factory.make_edge( parts );
+            else if ( parts[0] == "grid" ) factory.make_grid( parts );
+            else if ( parts[0] == "polygon" ) factory.make_polygon( parts );
+        } catch ( std::exception& ) {
+        }
+    }
+}
+
+/**
+ * @brief Predicate indicating whether two edges have the same identifiers, way type, and exact vertex positions.
+ */
+bool sameEdge( const geo::EdgeCPtr& a, const geo::EdgeCPtr& b ) {
+    return a->get_uid() == b->get_uid() && a->get_way_type() == b->get_way_type() &&
+        a->v1->uid == b->v1->uid && a->v1->lat == b->v1->lat && a->v1->lon == b->v1->lon &&
+        a->v2->uid == b->v2->uid && a->v2->lat == b->v2->lat && a->v2->lon == b->v2->lon;
+}
+
+TEST_CASE( "Shape File Parser", "[quad][shapefile][parser]" ) {
+
+    SECTION("Numbers") {
+        // Values are converted exactly as std::stod and std::stoull convert them.
+        std::vector<std::string> centers {
+            "42.283135:-83.735670:22.0",
+            " 42.283135 : -83.735670 : 22 ",
+            "4.2283135e1:-8373567E-5:2.2e+1",
+            "42.2831351234567890123456789:-83.735670000000000000000001:0.000000000000000000000000022",
+            "42.5abc:-83.5e:1e400x",
+            "+0.0000000000000000000000042:-0:1e-30",
+            "4207199254740993e-14:-83.0:18446744073709551615"
+        };
+
+        for ( auto& center : centers ) {
+            shapes::CSVInputFactory sf{};
+            StrVector parts = string_utilities::split( "circle, 18446744073709551615 ," + center, ',' );
+
+            if ( center.find( "1e400" ) != std::string::npos ) {
+                CHECK_THROWS_AS( sf.make_circle( parts ), std::out_of_range );
+                continue;
+            }
+
+            REQUIRE_NOTHROW( sf.make_circle( parts ) );
+            StrVector values = string_utilities::split( center, ':' );
+            const geo::Circle& c = *sf.get_circles().back();
+            CHECK( c.uid == std::numeric_limits<uint64_t>::max() );
+            CHECK( c.lat == std::stod( values[0] ) );
+            CHECK( c.lon == std::stod( values[1] ) );
+            CHECK( c.radius == std::stod( values[2] ) );
+        }
+
+        shapes::CSVInputFactory sf{};
+        CHECK_THROWS_AS( sf.make_circle( string_utilities::split( "circle,18446744073709551616,42.0:-83.0:22.0", ',' ) ), std::out_of_range );
+        CHECK_THROWS_AS( sf.make_circle( string_utilities::split( "circle,0,.:-83.0:22.0", ',' ) ), std::invalid_argument );
+        CHECK_THROWS_AS( sf.make_circle( string_utilities::split( "circle,0,e5:-83.0:22.0", ',' ) ), std::invalid_argument );
+        CHECK_THROWS_AS( sf.make_circle( string_utilities::split( "circle,0,42.0:-:22.0", ',' ) ), std::invalid_argument );
+    }
+
+    SECTION("Map File") {
+        shapes::CSVInputFactory expected{};
+        readShapesByLine( "data/I_80.edges", expected );
+        REQUIRE( expected.get_edges().size() > 20000 );
+
+        for ( unsigned threads : { 1u, 4u, 0u } ) {
+            shapes::CSVInputFactory sf( "data/I_80.edges" );
+            sf.make_shapes( threads );
+
+            REQUIRE( sf.get_edges().size() == expected.get_edges().size() );
+            bool same = true;
+            for ( std::size_t i = 0; i < sf.get_edges().size(); ++i ) {
+                same = same && sameEdge( sf.get_edges()[i], expected.get_edges()[i] );
+            }
+            CHECK( same );
+
+            // Vertices are shared between consecutive edges of a way.
+            CHECK( sf.get_edges()[0]->v2 == sf.get_edges()[1]->v1 );
+        }
+
+        shapes::CSVInputFactory polygons( "unit-test-data/test-data/test.polygons" );
+        polygons.make_shapes( 4 );
+        CHECK( polygons.get_polygons().size() == 2 );
+    }
+
+    SECTION("Line Numbers") {
+        std::ostringstream errors;
+        std::streambuf* cerr_buffer = std::cerr.rdbuf( errors.rdbuf() );
+
+        shapes::CSVInputFactory bad_1( "unit-test-data/test-data/test.shapes.bad1" );
+        bad_1.make_shapes();
+        shapes::CSVInputFactory bad_4( "unit-test-data/test-data/test.shapes.bad4" );
+        bad_4.make_shapes();
+
+        std::cerr.rdbuf( cerr_buffer );
+        std::string messages = errors.str();
+
+        CHECK( messages.find( "in shape specification on line 2: 2 fields." ) != std::string::npos );
+        CHECK( messages.find( "in shape specification on line 3: 5 fields." ) != std::string::npos );
+        CHECK( messages.find( "Failed to make shape on line 3: bad latitude" ) != std::string::npos );
+        CHECK( messages.find( "Failed to make shape on line 5: The identifiers for the edges points are the same." ) != std::string::npos );
+
+        CHECK( bad_1.get_edges().size() == 1 );
+        CHECK( bad_4.get_circles().empty() );
+        CHECK( bad_4.get_grids().size() == 1 );
+        REQUIRE( bad_4.get_edges().size() == 2 );
+        CHECK( bad_4.get_edges()[0]->v2 == bad_4.get_edges()[1]->v1 );
+    }
+}
+
 TEST_CASE("Entity", "[quad][entity]") {
     SECTION("Conversions") {
         CHECK(geo::to_degrees(0.0) == Approx(0.0));
@@ -818,6 +962,152 @@ TEST_CASE("Entity", "[quad][entity]") {
     }
 }
 
+TEST_CASE("Circle Fast Path", "[quad][entity][circle]") {
+    std::mt19937 rng{ 20170401 };
+    std::uniform_real_distribution<double> unit{ 0.0, 1.0 };
+
+    // The fast path must agree exactly with the equirectangular distance test it replaces.
+    auto exact = [](const geo::Circle& c, const geo::Point& pt) {
+        return geo::Location::distance(c.lat, c.lon, pt.lat, pt.lon) <= c.radius;
+    };
+
+    for (double center_lat : { 0.0, 35.952, -42.29, 60.5, 84.9 }) {
+        for (double radius : { 1.0, 22.0, 250.0, 5000.0 }) {
+            geo::Circle c{ center_lat, -83.93, radius };
+            double span = geo::to_degrees(radius / geo::kEarthRadiusM);
+            double lon_span = span / std::cos(geo::to_radians(std::abs(center_lat) + span));
+
+            int mismatches = 0;
+            for (int i = 0; i < 2000; ++i) {
+                geo::Point pt{ center_lat + (unit(rng) * 3.0 - 1.5) * span, -83.93 + (unit(rng) * 3.0 - 1.5) * lon_span };
+                if (c.contains(pt) != exact(c, pt)) ++mismatches;
+            }
+
+            // Points that straddle the circle's edge exercise the exact fallback.
+            for (int i = 0; i < 360; ++i) {
+                for (double scale : { 1.0 - 1e-9, 1.0, 1.0 + 1e-9 }) {
+                    geo::Location edge = geo::Location::project_position(c.lat, c.lon, i, radius * scale);
+                    if (c.contains(edge) != exact(c, edge)) ++mismatches;
+                }
+            }
+
+            CHECK(mismatches == 0);
+            CHECK(c.contains(c));
+            CHECK(c.contains(geo::Location::project_position(c.lat, c.lon, 45.0, radius * 0.5)));
+            CHECK_FALSE(c.contains(geo::Location::project_position(c.lat, c.lon, 45.0, radius * 1.5)));
+        }
+    }
+}
+
+TEST_CASE("Polygon", "[quad][entity][polygon]") {
+    shapes::CSVInputFactory input_factory("unit-test-data/test-data/test.polygons");
+    input_factory.make_shapes();
+
+    // The malformed point and the two vertex ring are skipped.
+    REQUIRE(input_factory.get_polygons().size() == 2);
+    geo::Polygon::CPtr square = input_factory.get_polygons()[0];
+    geo::Polygon::CPtr ell = input_factory.get_polygons()[1];
+
+    // Reference even-odd test that walks every ring.
+    auto brute_force = [](const geo::Polygon& polygon, const geo::Point& pt) {
+        bool inside = false;
+        for (auto& ring : polygon.get_rings()) {
+            for (std::size_t i = 0, j = ring.size() - 1; i < ring.size(); j = i++) {
+                if ((ring[i].lat > pt.lat) != (ring[j].lat > pt.lat) &&
+                    pt.lon < ring[i].lon + (pt.lat - ring[i].lat) * (ring[j].lon - ring[i].lon) / (ring[j].lat - ring[i].lat)) {
+                    inside = !inside;
+                }
+            }
+        }
+        return inside;
+    };
+
+    SECTION("Parsing") {
+        CHECK(square->get_type() == "polygon");
+        CHECK(square->get_uid() == 1);
+        CHECK(square->get_rings().size() == 2);
+        CHECK(ell->get_rings().size() == 1);
+        // The explicit closing vertex is dropped.
+        CHECK(ell->get_rings()[0].size() == 6);
+        CHECK(ell->get_bounds().sw.lat == Approx(35.94));
+        CHECK(ell->get_bounds().ne.lon == Approx(-83.93));
+
+        CHECK_THROWS_AS(geo::Polygon(geo::Polygon::RingList{}, 5), std::invalid_argument);
+        CHECK_THROWS_AS(input_factory.make_polygon(StrVector{ "polygon", "6", "35.94;-83.94:35.94;-83.93" }), std::invalid_argument);
+        CHECK_THROWS_AS(input_factory.make_polygon(StrVector{ "polygon", "7", "95.0;-83.94:35.94;-83.93:35.95;-83.93" }), std::out_of_range);
+    }
+
+    SECTION("Contains") {
+        CHECK(square->contains(geo::Point{35.951, -83.939}));
+        CHECK_FALSE(square->contains(geo::Point{35.955, -83.935}));      // in the hole.
+        CHECK_FALSE(square->contains(geo::Point{35.961, -83.935}));      // north of the polygon.
+        CHECK(ell->contains(geo::Point{35.941, -83.931}));
+        CHECK(ell->contains(geo::Point{35.947, -83.939}));
+        CHECK_FALSE(ell->contains(geo::Point{35.947, -83.931}));         // in the notch.
+
+        // A many sided polygon uses many slabs.
+        geo::Polygon::Ring star;
+        for (int i = 0; i < 2000; ++i) {
+            double r = (i % 2 == 0) ? 500.0 : 200.0 + (i % 7) * 20.0;
+            star.push_back(geo::Location::project_position(35.955, -83.935, i * 360.0 / 2000.0, r));
+        }
+        geo::Polygon star_polygon{ geo::Polygon::RingList{ star }, 8 };
+
+        std::mt19937 rng{ 42 };
+        std::uniform_real_distribution<double> lat_dist{ 35.949, 35.961 };
+        std::uniform_real_distribution<double> lon_dist{ -83.942, -83.928 };
+
+        int mismatches = 0;
+        for (int i = 0; i < 20000; ++i) {
+            geo::Point pt{ lat_dist(rng), lon_dist(rng) };
+            if (star_polygon.contains(pt) != brute_force(star_polygon, pt)) ++mismatches;
+            if (square->contains(pt) != brute_force(*square, pt)) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    SECTION("Touches") {
+        CHECK(square->touches(geo::Bounds{ geo::Point{35.951, -83.939}, geo::Point{35.952, -83.938} }));       // inside.
+        CHECK_FALSE(square->touches(geo::Bounds{ geo::Point{35.954, -83.936}, geo::Point{35.956, -83.934} })); // inside the hole.
+        CHECK(square->touches(geo::Bounds{ geo::Point{35.955, -83.936}, geo::Point{35.958, -83.934} }));       // crosses the hole.
+        CHECK(square->touches(geo::Bounds{ geo::Point{35.940, -83.950}, geo::Point{35.970, -83.920} }));       // contains the polygon.
+        CHECK_FALSE(square->touches(geo::Bounds{ geo::Point{35.961, -83.950}, geo::Point{35.970, -83.920} }));
+        CHECK_FALSE(ell->touches(geo::Bounds{ geo::Point{35.944, -83.936}, geo::Point{35.947, -83.931} }));    // in the notch.
+    }
+
+    SECTION("Round Trip") {
+        shapes::CSVOutputFactory output_factory("unit-test-data/test-data/test.polygons.out");
+        output_factory.add_polygon(square);
+        output_factory.add_polygon(ell);
+        output_factory.write_shapes();
+
+        shapes::CSVInputFactory reread("unit-test-data/test-data/test.polygons.out");
+        reread.make_shapes();
+        REQUIRE(reread.get_polygons().size() == 2);
+        CHECK(reread.get_polygons()[0]->get_rings() == square->get_rings());
+        CHECK(reread.get_polygons()[1]->get_rings() == ell->get_rings());
+    }
+
+    SECTION("Geofence") {
+        ConfigMap pconf;
+        REQUIRE( buildBaseConfiguration( pconf ) );
+
+        Quad::Ptr quad_ptr = std::make_shared<Quad>(geo::Point{35.930, -83.950}, geo::Point{35.970, -83.920});
+        CHECK(Quad::insert(quad_ptr, square));
+        CHECK(Quad::insert(quad_ptr, ell));
+        BSMHandler handler{ quad_ptr, pconf, testLogger };
+
+        BSM bsm;
+        bsm.set_latitude(35.951);
+        bsm.set_longitude(-83.939);
+        CHECK(handler.isWithinEntity(bsm));
+
+        bsm.set_latitude(35.955);
+        bsm.set_longitude(-83.935);
+        CHECK_FALSE(handler.isWithinEntity(bsm));
+    }
+}
+
 TEST_CASE("Quad Tree", "[quad]") {
     // borrowing network from entity tests
     geo::Vertex::Ptr v_a = std::make_shared<geo::Vertex>(35.952500, -83.932434, 1);
@@ -951,6 +1241,253 @@ TEST_CASE("Quad Tree", "[quad]") {
     }
 }
 
+TEST_CASE("Grid Index", "[quad][grid]") {
+    geo::Location nw(35.953642, -83.932832);
+    geo::Grid::GridPtrVector grids = geo::Grid::build_grid(nw, 10, 35.951853, -83.929975);
+    REQUIRE(grids.size() == 520);
+
+    // Brute force reference: the union of the grid squares.
+    auto in_any = [](const geo::Grid::GridPtrVector& squares, const geo::Point& pt) {
+        for (auto& grid_ptr : squares) {
+            if (grid_ptr->contains(pt)) return true;
+        }
+        return false;
+    };
+
+    // Probe every square's corners and center plus a lattice of points that covers and overhangs the grid.
+    auto probes = [](const geo::Grid::GridPtrVector& squares) {
+        std::vector<geo::Point> points;
+        for (auto& grid_ptr : squares) {
+            points.push_back(grid_ptr->sw);
+            points.push_back(grid_ptr->ne);
+            points.push_back(grid_ptr->nw);
+            points.push_back(grid_ptr->se);
+            points.push_back(grid_ptr->center());
+        }
+        for (double lat = 35.951700; lat <= 35.953800; lat += 0.0000137) {
+            for (double lon = -83.933000; lon <= -83.929800; lon += 0.0000171) {
+                points.emplace_back(lat, lon);
+            }
+        }
+        return points;
+    };
+
+    SECTION("Full Grid") {
+        geo::GridIndex::CPtr index = geo::GridIndex::build(grids);
+        REQUIRE(index);
+        CHECK(index->size() == 520);
+        CHECK(index->rows() == 20);
+
+        int mismatches = 0;
+        for (auto& pt : probes(grids)) {
+            if (index->contains(pt) != in_any(grids, pt)) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+
+        CHECK_FALSE(index->contains(geo::Point{35.9537, -83.932832}));
+        CHECK_FALSE(index->contains(geo::Point{35.953642, -83.9329}));
+        CHECK_FALSE(index->contains(geo::Point{std::nan(""), -83.931}));
+    }
+
+    SECTION("Sparse Grid") {
+        geo::Grid::GridPtrVector sparse;
+        for (auto& grid_ptr : grids) {
+            if ((grid_ptr->row + 2 * grid_ptr->col) % 3 == 0) sparse.push_back(grid_ptr);
+        }
+        std::reverse(sparse.begin(), sparse.end());
+
+        geo::GridIndex::CPtr index = geo::GridIndex::build(sparse);
+        REQUIRE(index);
+        CHECK(index->size() == sparse.size());
+
+        // Corners of the inactive squares are not probed; they can sit within the lattice tolerance of an active square.
+        int mismatches = 0;
+        for (auto& pt : probes(sparse)) {
+            if (index->contains(pt) != in_any(sparse, pt)) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    SECTION("Serialized Grid") {
+        shapes::CSVInputFactory input_factory("unit-test-data/test-data/test.shapes");
+        input_factory.make_shapes();
+        REQUIRE(input_factory.get_grids().size() == 3);
+
+        geo::GridIndex::CPtr index = geo::GridIndex::build(input_factory.get_grids());
+        REQUIRE(index);
+        CHECK(index->size() == 3);
+
+        for (auto& pt : probes(input_factory.get_grids())) {
+            CHECK(index->contains(pt) == in_any(input_factory.get_grids(), pt));
+        }
+    }
+
+    SECTION("Irregular Grids") {
+        CHECK_FALSE(geo::GridIndex::build(geo::Grid::GridPtrVector{}));
+
+        // Mixed square sizes.
+        geo::Grid::GridPtrVector mixed = geo::Grid::build_grid(nw, 20, 35.951853, -83.929975);
+        mixed.push_back(grids[1]);
+        CHECK_FALSE(geo::GridIndex::build(mixed));
+
+        // A square shifted off its column.
+        geo::Grid::GridPtrVector shifted = grids;
+        geo::Bounds b{ grids[0]->sw, grids[0]->ne };
+        b.sw.lon += 0.00001;
+        b.ne.lon += 0.00001;
+        shifted[0] = std::make_shared<const geo::Grid>(b, grids[0]->row, grids[0]->col);
+        CHECK_FALSE(geo::GridIndex::build(shifted));
+
+        // Too few squares to justify the lattice.
+        geo::Grid::GridPtrVector far_apart{ grids[0], std::make_shared<const geo::Grid>(*grids[0], 0, 1000) };
+        CHECK_FALSE(geo::GridIndex::build(far_apart));
+    }
+
+    SECTION("Handler Geofence") {
+        ConfigMap pconf;
+        REQUIRE( buildBaseConfiguration( pconf ) );
+
+        // The quad is empty; only the grid index can place the BSM in the geofence.
+        Quad::Ptr quad_ptr = std::make_shared<Quad>(geo::Point{35.946920, -83.938486}, geo::Point{35.955526, -83.926738});
+        BSMHandler handler{ quad_ptr, geo::GridIndex::build(grids), pconf, testLogger };
+        BSMHandler quad_only{ quad_ptr, pconf, testLogger };
+
+        BSM bsm;
+        bsm.set_latitude(grids[271]->center().lat);
+        bsm.set_longitude(grids[271]->center().lon);
+        CHECK(handler.isWithinEntity(bsm));
+        CHECK_FALSE(quad_only.isWithinEntity(bsm));
+
+        bsm.set_latitude(35.950);
+        CHECK_FALSE(handler.isWithinEntity(bsm));
+    }
+}
+
+/**
+ * @brief Load the edges in a map file into a list of entities in file order.
+ */
+geo::Entity::PtrList loadMapEntities( const std::string& mapfile ) {
+    shapes::CSVInputFactory shape_factory( mapfile );
+    shape_factory.make_shapes();
+
+    geo::Entity::PtrList entities{ shape_factory.get_edges().begin(), shape_factory.get_edges().end() };
+    return entities;
+}
+
+/**
+ * @brief Predicate indicating whether two quad trees have the same leaves holding the same entities in the same order.
+ */
+bool sameQuadLeaves( Quad::Ptr& a, Quad::Ptr& b ) {
+    std::vector<geo::Bounds::Ptr> a_leaves = Quad::retrieve_all_bounds( a, true );
+    std::vector<geo::Bounds::Ptr> b_leaves = Quad::retrieve_all_bounds( b, true );
+
+    if ( a_leaves.size() != b_leaves.size() ) return false;
+
+    for ( std::size_t i = 0; i < a_leaves.size(); ++i ) {
+        if ( !( a_leaves[i]->sw == b_leaves[i]->sw ) || !( a_leaves[i]->ne == b_leaves[i]->ne ) ) return false;
+        if ( a->retrieve_elements( a_leaves[i]->center() ) != b->retrieve_elements( b_leaves[i]->center() ) ) return false;
+    }
+
+    return true;
+}
+
+TEST_CASE("Quad Bulk Load", "[quad][bulk]") {
+    // The I-80 corridor from the example configuration.
+    geo::Point sw{ 40.986411, -111.039503 };
+    geo::Point ne{ 42.494963, -104.050793 };
+    geo::Entity::PtrList entities = loadMapEntities( "data/I_80.edges" );
+    REQUIRE( entities.size() > 20000 );
+
+    Quad::Ptr incremental = std::make_shared<Quad>( sw, ne );
+    for ( auto& e : entities ) {
+        Quad::insert( incremental, e );
+    }
+
+    SECTION("Single Thread") {
+        Quad::Ptr bulk = std::make_shared<Quad>( sw, ne );
+        CHECK( Quad::bulk_load( bulk, entities, 1 ) );
+        CHECK( sameQuadLeaves( incremental, bulk ) );
+    }
+
+    SECTION("Multiple Threads") {
+        Quad::Ptr bulk = std::make_shared<Quad>( sw, ne );
+        CHECK( Quad::bulk_load( bulk, entities, 8 ) );
+        CHECK( sameQuadLeaves( incremental, bulk ) );
+        CHECK( Quad::retrieve_all_bounds( bulk ).size() == Quad::retrieve_all_bounds( incremental ).size() );
+    }
+
+    SECTION("Existing Quad") {
+        // A partially loaded quad falls back to incremental insertion.
+        Quad::Ptr bulk = std::make_shared<Quad>( sw, ne );
+        geo::Entity::PtrList head{ entities.begin(), entities.begin() + 1000 };
+        geo::Entity::PtrList tail{ entities.begin() + 1000, entities.end() };
+        CHECK( Quad::bulk_load( bulk, head, 4 ) );
+        CHECK( Quad::bulk_load( bulk, tail, 4 ) );
+        CHECK( sameQuadLeaves( incremental, bulk ) );
+    }
+
+    SECTION("Outside") {
+        Quad::Ptr elsewhere = std::make_shared<Quad>( geo::Point{ 35.946920, -83.938486 }, geo::Point{ 35.955526, -83.926738 } );
+        CHECK_FALSE( Quad::bulk_load( elsewhere, entities ) );
+        CHECK( Quad::retrieve_all_bounds( elsewhere ).size() == 1 );
+    }
+}
+
+// The benchmarks, here and below, are hidden; run them with: ppm_tests "[.benchmark]" --benchmark-samples 10
+TEST_CASE("Quad Build Benchmark", "[.benchmark][quad]") {
+    const char* env_mapfile = std::getenv( "PPM_BENCHMARK_MAPFILE" );
+    std::string mapfile = env_mapfile ? env_mapfile : "data/CO-Motorways.edges";
+
+    // The Colorado region from the ppmBsm configuration.
+    geo::Point sw{ 37.002, -109.044 };
+    geo::Point ne{ 41.002, -102.052 };
+    geo::Entity::PtrList entities = loadMapEntities( mapfile );
+    REQUIRE( !entities.empty() );
+
+    BENCHMARK("Incremental insert") {
+        Quad::Ptr qptr = std::make_shared<Quad>( sw, ne );
+        for ( auto& e : entities ) {
+            Quad::insert( qptr, e );
+        }
+        return qptr;
+    };
+
+    BENCHMARK("Bulk load, 1 thread") {
+        Quad::Ptr qptr = std::make_shared<Quad>( sw, ne );
+        Quad::bulk_load( qptr, entities, 1 );
+        return qptr;
+    };
+
+    BENCHMARK("Bulk load, all cores") {
+        Quad::Ptr qptr = std::make_shared<Quad>( sw, ne );
+        Quad::bulk_load( qptr, entities );
+        return qptr;
+    };
+}
+
+TEST_CASE("Shape File Parse Benchmark", "[.benchmark][shapefile]") {
+    const char* env_mapfile = std::getenv( "PPM_BENCHMARK_MAPFILE" );
+    std::string mapfile = env_mapfile ? env_mapfile : "data/CO-Motorways.edges";
+
+    BENCHMARK("Line by line") {
+        shapes::CSVInputFactory sf{};
+        readShapesByLine( mapfile, sf );
+        return sf.get_edges().size();
+    };
+
+    BENCHMARK("make_shapes, 1 thread") {
+        shapes::CSVInputFactory sf( mapfile );
+        sf.make_shapes( 1 );
+        return sf.get_edges().size();
+    };
+
+    BENCHMARK("make_shapes, all cores") {
+        shapes::CSVInputFactory sf( mapfile );
+        sf.make_shapes( 0 );
+        return sf.get_edges().size();
+    };
+}
+
 /** PPM tests below **/
 
 TEST_CASE( "Redactor Checks", "[ppm][redactor]" ) {
@@ -1046,105 +1583,1631 @@ TEST_CASE( "Redactor Checks", "[ppm][redactor]" ) {
         CHECK( r == "ID2" );
 
     }
+
+    SECTION( "Id Format" ) {
+
+        char buffer[IdRedactor::kIdLength];
+        std::regex hex_id{ "[0-9a-f]{8}" };
+
+        IdRedactor::FormatId( 0, buffer );
+        CHECK( std::string( buffer, IdRedactor::kIdLength ) == "00000000" );
+        IdRedactor::FormatId( 0x0123abcd, buffer );
+        CHECK( std::string( buffer, IdRedactor::kIdLength ) == "0123abcd" );
+        IdRedactor::FormatId( 0xffffffff, buffer );
+        CHECK( std::string( buffer, IdRedactor::kIdLength ) == "ffffffff" );
+
+        // the formatter matches the stream formatting used for ids.
+        std::mt19937 rgen{ 2017 };
+        for ( int i = 0; i < 1000; ++i ) {
+            uint32_t v = rgen();
+            std::stringstream ss;
+            ss << std::hex << std::setfill('0') << std::setw(8) << v;
+            IdRedactor::FormatId( v, buffer );
+            CHECK( std::string( buffer, IdRedactor::kIdLength ) == ss.str() );
+        }
+
+        r = "ID1";
+        buffer[0] = 'X';
+        CHECK( idr( r, buffer ) );
+        CHECK( r == "ID1" );
+        CHECK( std::regex_match( std::string( buffer, IdRedactor::kIdLength ), hex_id ) );
+
+        buffer[0] = 'X';
+        CHECK_FALSE( idr( "IDX", buffer ) );
+        CHECK( buffer[0] == 'X' );
+
+        CHECK( std::regex_match( idr.GetRandomId(), hex_id ) );
+        CHECK( idr.GetRandomId() != idr.GetRandomId() );
+    }
 }
 
-TEST_CASE( "Velocity Filter", "[ppm][velocity]" ) {
+TEST_CASE( "Id Set", "[ppm][redactor][idset]" ) {
 
-    ConfigMap conf{ 
-        { "privacy.filter.velocity.min", "5" },
-        { "privacy.filter.velocity.max", "100" }
-    };
-    
-    // cover default constructor
-    VelocityFilter v_test;
+    IdSet ids;
+    std::unordered_set<uint32_t> expected;
+    std::mt19937 rgen{ 2017 };
 
-    VelocityFilter vf{ conf };
+    // small values collide often in a small table; large ones exercise growth.
+    for ( int i = 0; i < 20000; ++i ) {
+        uint32_t v = i % 3 ? rgen() % 512 : rgen();
 
-    SECTION( "Using Configuration" ) {
-        CHECK( vf( 4.999 ) );
-        CHECK( vf( 100.001 ) );
-        CHECK_FALSE( vf( 10 ) );
+        if ( rgen() % 3 ) {
+            CHECK( ids.insert( v ) == expected.insert( v ).second );
+        } else {
+            CHECK( ids.erase( v ) == ( expected.erase( v ) > 0 ) );
+        }
+    }
 
-        CHECK( vf.suppress( 4.999 ) );
-        CHECK( vf.suppress( 100.001 ) );
-        CHECK_FALSE( vf.suppress( 10 ) );
+    CHECK( ids.size() == expected.size() );
 
-        CHECK( vf.retain( 5 ) );
-        CHECK( vf.retain( 100 ) );
-        CHECK( vf.retain( 10 ) );
-        CHECK_FALSE( vf.retain( 4.999 ) );
-        CHECK_FALSE( vf.retain( 100.001 ) );
+    bool same = true;
+    for ( uint32_t v = 0; v < 512; ++v ) {
+        same = same && ids.contains( v ) == ( expected.count( v ) > 0 );
+    }
+    for ( uint32_t v : expected ) {
+        same = same && ids.contains( v );
     }
+    CHECK( same );
 
-    SECTION( "Changing the filter's min and max" ) {
-        vf.set_min( 3.0 );
-        vf.set_max( 200.0 );
-        CHECK( vf( 2.999 ) );
-        CHECK( vf( 200.001 ) );
-        CHECK_FALSE( vf( 10 ) );
+    CHECK( ids.insert( 0 ) == expected.insert( 0 ).second );
+    CHECK( ids.contains( 0 ) );
+    CHECK( ids.erase( 0 ) );
+    CHECK_FALSE( ids.contains( 0 ) );
 
-        CHECK( vf.suppress( 2.999 ) );
-        CHECK( vf.suppress( 200.001 ) );
-        CHECK_FALSE( vf.suppress( 10 ) );
+    ids.clear();
+    CHECK( ids.size() == 0 );
+    CHECK_FALSE( ids.contains( *expected.begin() ) );
+}
 
-        CHECK( vf.retain( 3 ) );
-        CHECK( vf.retain( 200 ) );
-        CHECK( vf.retain( 10 ) );
-        CHECK_FALSE( vf.retain( 2.999 ) );
-        CHECK_FALSE( vf.retain( 200.001 ) );
+TEST_CASE( "Id Inclusion File", "[ppm][redactor][idset]" ) {
+
+    uint32_t value;
+    CHECK( IdRedactor::ParseId( "BEA1000f", value ) );
+    CHECK( value == 0xBEA1000F );
+    CHECK_FALSE( IdRedactor::ParseId( "BEA1000", value ) );
+    CHECK_FALSE( IdRedactor::ParseId( "BEA1000G", value ) );
+    CHECK_FALSE( IdRedactor::ParseId( "ON-VG-99", value ) );
+
+    ConfigMap conf{
+        { "privacy.redaction.id.inclusions", "ON" },
+        { "privacy.redaction.id.included", "B1,BEA1000F" },
+        { "privacy.redaction.id.included.file", "unit-test-data/test-data/test.included.ids" }
+    };
+
+    IdRedactor idr{ conf };
+    char buffer[IdRedactor::kIdLength];
+
+    CHECK( idr.NumInclusions() == 7 );
+
+    for ( auto& id : { "BEA10000", "bea10000", "BEA10001", "0000000a", "ON-VG-99", "00000000", "B1", "BEA1000F" } ) {
+        CHECK( idr( id, buffer ) );
     }
-}
 
-TEST_CASE( "BSM Checks", "[ppm][bsm]" ) {
+    for ( auto& id : { "BEA10002", "on-vg-99", "0000000", "A", "b1" } ) {
+        CHECK_FALSE( idr( id, buffer ) );
+    }
 
-    BSM bsm;
+    CHECK( idr.RemoveIdInclusion( "bea10000" ) );
+    CHECK_FALSE( idr( "BEA10000", buffer ) );
+    CHECK( idr.RemoveIdInclusion( "ON-VG-99" ) );
+    CHECK_FALSE( idr( "ON-VG-99", buffer ) );
+    CHECK( idr.NumInclusions() == 5 );
 
-    SECTION( "Default Construction" ) {
-        CHECK( bsm.lat == 90.0 );
-        CHECK( bsm.lon == 180.0 );
-        CHECK( bsm.get_velocity() == -1.0 );
-        CHECK( bsm.get_secmark() == 0 );
-        CHECK( bsm.get_id() == "" );
-        CHECK( bsm.get_original_id() == "" );
+    SECTION( "Missing File" ) {
+        conf["privacy.redaction.id.included.file"] = "unit-test-data/test-data/missing.ids";
+        CHECK_THROWS_AS( IdRedactor{ conf }, std::invalid_argument );
     }
 
-    SECTION( "Change and Reset" ) {
+    SECTION( "Reload" ) {
+        std::string file = "unit-test-data/test-data/test.included.ids.out";
+        conf["privacy.redaction.id.included.file"] = file;
 
-        bsm.set_latitude( 22.0 );
-        CHECK( bsm.lat == 22.0 );
-        bsm.set_longitude( 22.0 );
-        CHECK( bsm.lon == 22.0 );
-        bsm.set_id( "XXX" );
-        CHECK( bsm.get_id() == "XXX" );
-        bsm.set_original_id( "YYY" );
-        CHECK( bsm.get_original_id() == "YYY" );
-        bsm.set_velocity( 456 );
-        CHECK( bsm.get_velocity() == 456.0 );
-        bsm.set_secmark( 123 );
-        CHECK( bsm.get_secmark() == 123 );
-        CHECK( bsm.logString() == "(XXX,123,22.000000,22.000000,456.000000)" );
+        {
+            std::ofstream os{ file };
+            for ( uint32_t v = 1; v <= 100000; ++v ) {
+                IdRedactor::FormatId( v, buffer );
+                os << std::string( buffer, IdRedactor::kIdLength ) << '\n';
+            }
+        }
 
-        SECTION( "Reset" ) {
-            bsm.reset();
-            CHECK( bsm.lat == 90.0 );
-            CHECK( bsm.lon == 180.0 );
-            CHECK( bsm.get_velocity() == -1.0 );
-            CHECK( bsm.get_id() == "" );
-            CHECK( bsm.get_secmark() == 0 );
-            CHECK( bsm.get_original_id() == "");
+        IdRedactor reloading{ conf };
+        CHECK( reloading.NumInclusions() == 100002 );
+        CHECK( reloading( "000186a0", buffer ) );
+        CHECK_FALSE( reloading( "000186a1", buffer ) );
+
+        {
+            std::ofstream os{ file };
+            os << "000186A1\n";
         }
+
+        // redact on another thread while the list is replaced.
+        std::atomic<bool> done{ false };
+        std::atomic<int> redacted{ 0 };
+        std::thread reader( [&]() {
+            char id[IdRedactor::kIdLength];
+            while ( !done ) {
+                if ( reloading( "BEA1000F", id ) ) ++redacted;
+            }
+        } );
+
+        while ( redacted == 0 ) std::this_thread::yield();
+        CHECK( reloading.ReloadInclusions() );
+        done = true;
+        reader.join();
+
+        CHECK( reloading.NumInclusions() == 3 );
+        CHECK_FALSE( reloading( "000186a0", buffer ) );
+        CHECK( reloading( "000186a1", buffer ) );
+
+        std::remove( file.c_str() );
+        CHECK_FALSE( reloading.ReloadInclusions() );
+        CHECK( reloading( "000186a1", buffer ) );
     }
 }
 
-TEST_CASE( "BSMHandler Checks", "[ppm][handler]" ) {
-// designed to NOT trigger the quadtree code; we just checking basic functions of
-// state process within the BSMHandler.
+TEST_CASE( "Pseudonymizer", "[ppm][redactor][pseudonym]" ) {
 
-    ConfigMap pconf;
-    REQUIRE( buildBaseConfiguration( pconf ) ); 
-    BSMHandler handler{ nullptr, pconf, testLogger };
+    SECTION( "SipHash" ) {
+        // reference vectors: key 00 01 .. 0f; message 00 01 .. (length-1).
+        Pseudonymizer::Key key{ { 0x0706050403020100ULL, 0x0f0e0d0c0b0a0908ULL } };
+        unsigned char message[64];
+        for ( int i = 0; i < 64; ++i ) message[i] = static_cast<unsigned char>( i );
 
-    // FOR EACH SECTION THE TEST CASE IS EXECUTED FROM THE START.
+        CHECK( Pseudonymizer::siphash( key, message, 0 ) == 0x726fdb47dd0e0e31ULL );
+        CHECK( Pseudonymizer::siphash( key, message, 1 ) == 0x74f839c593dc67fdULL );
+        CHECK( Pseudonymizer::siphash( key, message, 8 ) == 0x93f5f5799a932462ULL );
+        CHECK( Pseudonymizer::siphash( key, message, 15 ) == 0xa129ca6149be45e5ULL );
+        CHECK( Pseudonymizer::siphash( key, message, 63 ) == 0x958a324ceb064572ULL );
+    }
+
+    ConfigMap conf{
+        { "privacy.redaction.id.pseudonym.key", "000102030405060708090a0b0c0d0e0f" },
+        { "privacy.redaction.id.pseudonym.epoch", "300" },
+        { "privacy.redaction.id.pseudonym.cache", "1" }
+    };
+
+    Pseudonymizer pseudonymizer{ conf };
+    uint64_t start = 1500000000;                // an epoch boundary.
+    uint32_t p = pseudonymizer.pseudonym( "BEA10000", start );
+
+    SECTION( "Epochs" ) {
+        CHECK( pseudonymizer.epoch_seconds() == 300 );
+
+        // the one entry cache is evicted by every other id.
+        CHECK( pseudonymizer.pseudonym( "BEA10001", start ) != p );
+        CHECK( pseudonymizer.pseudonym( "bea10000", start + 1 ) == p );
+        CHECK( pseudonymizer.pseudonym( "ON-VG-99", start + 2 ) != p );
+        CHECK( pseudonymizer.pseudonym( "BEA10000", start + 299 ) == p );
+        CHECK( pseudonymizer.pseudonym( "BEA10000", start + 300 ) != p );
+        CHECK( pseudonymizer.pseudonym( "BEA10000", start + 600 ) != pseudonymizer.pseudonym( "BEA10000", start + 300 ) );
+        CHECK( pseudonymizer.pseudonym( "BEA10000", start - 1 ) != p );
+        CHECK( pseudonymizer.pseudonym( "BEA10000", start ) == p );
+        CHECK( pseudonymizer.pseudonym( "ON-VG-99", start ) == pseudonymizer.pseudonym( "ON-VG-99", start + 1 ) );
+    }
+
+    SECTION( "Keys" ) {
+        // instances sharing a key agree; other keys do not.
+        Pseudonymizer shared{ conf };
+        CHECK( shared.pseudonym( "BEA10000", start + 10 ) == p );
+
+        conf["privacy.redaction.id.pseudonym.key"] = "000102030405060708090a0b0c0d0e0e";
+        Pseudonymizer other{ conf };
+        CHECK( other.pseudonym( "BEA10000", start ) != p );
+        CHECK( Pseudonymizer{}.pseudonym( "BEA10000", start ) != p );
+
+        conf["privacy.redaction.id.pseudonym.key"] = "000102030405060708090a0b0c0d0e";
+        CHECK_THROWS_AS( Pseudonymizer{ conf }, std::invalid_argument );
+        conf["privacy.redaction.id.pseudonym.key"] = "000102030405060708090a0b0c0d0eXX";
+        CHECK_THROWS_AS( Pseudonymizer{ conf }, std::invalid_argument );
+        conf.erase("privacy.redaction.id.pseudonym.key");
+        CHECK_THROWS_AS( Pseudonymizer{ conf }, std::invalid_argument );
+        conf["privacy.redaction.id.pseudonym.key"] = "000102030405060708090a0b0c0d0e0f";
+        conf["privacy.redaction.id.pseudonym.epoch"] = "0";
+        CHECK_THROWS_AS( Pseudonymizer{ conf }, std::invalid_argument );
+    }
+
+    SECTION( "Redactor" ) {
+        conf["privacy.redaction.id.mode"] = "pseudonym";
+        IdRedactor idr{ conf };
+        CHECK( idr.UsesPseudonyms() );
+        CHECK_FALSE( IdRedactor{}.UsesPseudonyms() );
+
+        std::string a = "BEA10000";
+        std::string b = "BEA10000";
+        std::string c = "BEA10001";
+        CHECK( idr( a ) );
+        CHECK( idr( b ) );
+        CHECK( idr( c ) );
+        CHECK( a != "BEA10000" );
+        CHECK( a.size() == IdRedactor::kIdLength );
+        CHECK( a == b );
+        CHECK( a != c );
+
+        // copies agree on pseudonyms but keep their own caches.
+        IdRedactor copy{ idr };
+        std::string d = "BEA10000";
+        CHECK( copy.UsesPseudonyms() );
+        CHECK( copy( d ) );
+        CHECK( d == a );
+
+        conf.erase("privacy.redaction.id.pseudonym.key");
+        CHECK_THROWS_AS( IdRedactor{ conf }, std::invalid_argument );
+    }
+}
+
+TEST_CASE( "Vehicle State Table", "[ppm][state]" ) {
+
+    using Table = VehicleStateTable<int>;
+    auto count = []( int& n, bool ) { return ++n; };
+
+    CHECK( Table::key( "BEA10000" ) == 0xBEA10000 );
+    CHECK( Table::key( "bea10000" ) == 0xBEA10000 );
+    CHECK( Table::key( "ON-VG-99" ) > 0xFFFFFFFFULL );
+
+    SECTION( "Updates" ) {
+        Table table{ 1000, 100 };
+        CHECK( table.metrics().capacity >= 1000 );
+        CHECK( table.ttl() == 100 );
+
+        bool first = false;
+        table.update( "BEA10000", 0, [&first]( int& n, bool is_new ) { first = is_new; return n; } );
+        CHECK( first );
+        CHECK( table.update( "BEA10000", 10, count ) == 1 );
+        CHECK( table.update( "BEA10000", 20, count ) == 2 );
+        CHECK( table.update( "ON-VG-99", 20, count ) == 1 );
+
+        Table::Metrics m = table.metrics();
+        CHECK( m.occupancy == 2 );
+        CHECK( m.inserts == 2 );
+        CHECK( m.evictions == 0 );
+
+        // the TTL runs from the latest time seen; earlier times do not rewind it.
+        CHECK( table.update( "BEA10000", 5, count ) == 3 );
+        CHECK( table.update( "BEA10000", 120, count ) == 4 );
+        CHECK( table.update( "BEA10000", 221, count ) == 1 );
+        CHECK( table.metrics().expirations == 1 );
+
+        CHECK( table.expire( 200 ) == 1 );
+        CHECK( table.metrics().occupancy == 1 );
+        CHECK( table.erase( Table::key( "BEA10000" ) ) );
+        CHECK_FALSE( table.erase( Table::key( "BEA10000" ) ) );
+        CHECK( table.metrics().occupancy == 0 );
+    }
+
+    SECTION( "Eviction" ) {
+        // a single bucket.
+        Table table{ 1, 1000, 1 };
+        CHECK( table.metrics().capacity == Table::kWays );
+
+        for ( uint64_t k = 0; k < Table::kWays; ++k ) {
+            table.update( k, 10 + k, count );
+        }
+
+        // once keys 0 and 1 are refreshed, key 2 is the least recently seen.
+        table.update( 0, 50, count );
+        table.update( 1, 51, count );
+        table.update( Table::kWays, 52, count );
+
+        Table::Metrics m = table.metrics();
+        CHECK( m.occupancy == Table::kWays );
+        CHECK( m.evictions == 1 );
+        CHECK( table.update( 1, 53, count ) == 3 );
+        CHECK( table.update( 0, 54, count ) == 3 );
+        CHECK( table.update( 2, 55, count ) == 1 );
+        CHECK( table.metrics().evictions == 2 );
+
+        // expired vehicles are replaced before live ones are evicted.
+        table.update( Table::kWays + 1, 2000, count );
+        m = table.metrics();
+        CHECK( m.evictions == 2 );
+        CHECK( m.expirations == 1 );
+    }
+
+    SECTION( "Threads" ) {
+        Table table{ 4096, 1000 };
+        std::vector<std::thread> workers;
+
+        for ( int t = 0; t < 4; ++t ) {
+            workers.emplace_back( [&table, &count]() {
+                for ( int round = 0; round < 100; ++round ) {
+                    for ( uint64_t k = 0; k < 1000; ++k ) {
+                        table.update( k, round, count );
+                    }
+                }
+            } );
+        }
+
+        for ( auto& w : workers ) w.join();
+
+        bool all = true;
+        for ( uint64_t k = 0; k < 1000; ++k ) {
+            all = all && table.update( k, 100, []( int& n, bool ) { return n; } ) == 400;
+        }
+        CHECK( all );
+        CHECK( table.metrics().evictions == 0 );
+    }
+}
+
+TEST_CASE( "Id Redaction Benchmark", "[.benchmark][redactor]" ) {
+
+    IdRedactor idr{};
+
+    BENCHMARK( "Stream formatted mt19937 id" ) {
+        // the previous implementation.
+        static std::mt19937 rgen{ std::random_device{}() };
+        static std::uniform_int_distribution<uint32_t> dist{ 0, std::numeric_limits<uint32_t>::max() };
+        std::stringstream ss;
+        ss << std::hex << std::setfill('0') << std::setw(8) << dist(rgen);
+        return ss.str();
+    };
+
+    BENCHMARK( "GetRandomId" ) {
+        return idr.GetRandomId();
+    };
+
+    BENCHMARK( "Redact to buffer" ) {
+        char buffer[IdRedactor::kIdLength];
+        idr( "BEA10000", buffer );
+        return buffer[0];
+    };
+
+    IdRedactor pseudonyms{ ConfigMap{ { "privacy.redaction.id.mode", "pseudonym" }, { "privacy.redaction.id.pseudonym.key", "000102030405060708090a0b0c0d0e0f" } } };
+    std::vector<std::string> vehicles;
+    for ( uint32_t v = 0; v < 1024; ++v ) {
+        vehicles.push_back( pseudonyms.GetRandomId() );
+    }
+    std::size_t next = 0;
+
+    BENCHMARK( "Pseudonym to buffer, 1024 vehicles" ) {
+        char buffer[IdRedactor::kIdLength];
+        pseudonyms( vehicles[ next++ & 1023 ], buffer );
+        return buffer[0];
+    };
+
+    Pseudonymizer::Key key{ { 1, 2 } };
+    BENCHMARK( "SipHash of a temporary id" ) {
+        uint32_t value = static_cast<uint32_t>( next++ );
+        return Pseudonymizer::siphash( key, &value, sizeof(value) );
+    };
+}
+
+TEST_CASE( "Vehicle State Table Benchmark", "[.benchmark][state]" ) {
+
+    // one million vehicles seen 10 times a second for 10 seconds; the table holds about half of them.
+    const uint64_t vehicles = 1000000;
+    std::vector<uint64_t> keys( vehicles );
+    std::mt19937 rgen{ 2017 };
+    for ( auto& k : keys ) k = rgen();
+
+    BENCHMARK( "1M vehicles, 1 thread" ) {
+        VehicleStateTable<uint64_t> table{ vehicles / 2, 500 };
+        for ( uint64_t t = 0; t < 1000; t += 100 ) {
+            for ( uint64_t k : keys ) {
+                table.update( k, t, []( uint64_t& n, bool ) { return ++n; } );
+            }
+        }
+        return table.metrics().evictions;
+    };
+
+    BENCHMARK( "1M vehicles, 4 threads" ) {
+        VehicleStateTable<uint64_t> table{ vehicles / 2, 500 };
+        std::vector<std::thread> workers;
+        for ( std::size_t w = 0; w < 4; ++w ) {
+            workers.emplace_back( [&table, &keys, w]() {
+                for ( uint64_t t = 0; t < 1000; t += 100 ) {
+                    for ( std::size_t i = w; i < keys.size(); i += 4 ) {
+                        table.update( keys[i], t, []( uint64_t& n, bool ) { return ++n; } );
+                    }
+                }
+            } );
+        }
+        for ( auto& w : workers ) w.join();
+        return table.metrics().evictions;
+    };
+}
+
+TEST_CASE( "Duplicate Filter Benchmark", "[.benchmark][duplicates]" ) {
+
+    // 20% of the BSMs are repeated, as at a dense interchange.
+    DuplicateFilter df;
+    std::vector<std::string> ids;
+    char buffer[IdRedactor::kIdLength];
+    std::mt19937 rgen{ 2017 };
+    for ( uint32_t v = 0; v < 1024; ++v ) {
+        IdRedactor::FormatId( rgen(), buffer );
+        ids.emplace_back( buffer, IdRedactor::kIdLength );
+    }
+    uint64_t next = 0;
+
+    BENCHMARK( "Duplicate check, 1024 vehicles" ) {
+        uint64_t n = next++;
+        uint64_t bsm = n % 5 == 4 ? n - 1 : n;
+        return df.duplicate( ids[ bsm & 1023 ], static_cast<int>( ( bsm >> 10 ) % 60000 ), static_cast<int>( ( bsm >> 10 ) & 127 ), n / 10000 );
+    };
+}
+
+TEST_CASE( "Trip Filter Benchmark", "[.benchmark][trip]" ) {
+
+    // 20000 vehicles at 10 Hz and 15 m/s, so 1.5 m per BSM: the head is the first 133 BSMs, and the tail holds 20.
+    const uint64_t vehicles = 20000;
+    const double step = 1.5 / 111195.0;
+    std::vector<uint64_t> keys( vehicles );
+    std::mt19937 rgen{ 2017 };
+    for ( auto& k : keys ) k = rgen();
+    std::string json( 1500, 'x' );
+    std::vector<std::string> released;
+
+    BENCHMARK( "20000 vehicles, 200 m head, 10 BSMs each" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.vehicles", "32768" } } };
+        std::size_t retained = 0;
+        for ( uint64_t t = 0; t < 10; ++t ) {
+            for ( uint64_t v = 0; v < vehicles; ++v ) {
+                retained += tf.apply( keys[v], true, 39.0 + ( t + v % 200 ) * step, -105.0, json, released, t * 100 ) == TripFilter::RETAIN;
+            }
+        }
+        return retained;
+    };
+
+    BENCHMARK( "20000 vehicles, 200 m head and 30 m tail, 10 BSMs each" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.vehicles", "32768" }, { "privacy.filter.trip.tail.distance", "30" }, { "privacy.filter.trip.buffer", "32" } } };
+        std::size_t held = 0;
+        for ( uint64_t t = 0; t < 10; ++t ) {
+            for ( uint64_t v = 0; v < vehicles; ++v ) {
+                released.clear();
+                held += tf.apply( keys[v], true, 39.0 + ( t + v % 200 ) * step, -105.0, json, released, t * 100 ) == TripFilter::HOLD;
+            }
+        }
+        return held;
+    };
+}
+
+TEST_CASE( "Core Prefilter Benchmark", "[.benchmark][prefilter]" ) {
+
+    VelocityFilter vf;
+    geo::Bounds bounds{ geo::Point{ 35.0, -84.5 }, geo::Point{ 36.5, -83.0 } };
+    CorePrefilter prefilter{ vf, bounds };
+
+    const std::size_t n = 4096;
+    std::vector<int32_t> speed( n ), lat( n ), lon( n );
+    std::vector<uint8_t> result( n );
+    std::mt19937 rgen{ 2017 };
+    for ( std::size_t i = 0; i < n; ++i ) {
+        speed[i] = static_cast<int32_t>( rgen() % 8192 );
+        lat[i] = 340000000 + static_cast<int32_t>( rgen() % 30000000 );
+        lon[i] = -850000000 + static_cast<int32_t>( rgen() % 30000000 );
+    }
+
+    BENCHMARK( "Scalar VelocityFilter and Bounds, 4096 BSMs" ) {
+        std::size_t kept = 0;
+        for ( std::size_t i = 0; i < n; ++i ) {
+            double v = speed[i] == 8191 ? 0.0 : speed[i] * 0.02;
+            kept += !vf.suppress( v ) && bounds.contains( geo::Point{ lat[i] * 1e-7, lon[i] * 1e-7 } );
+        }
+        return kept;
+    };
+
+    BENCHMARK( "CorePrefilter, 4096 BSMs" ) {
+        return prefilter.apply( speed.data(), lat.data(), lon.data(), n, result.data() );
+    };
+}
+
+TEST_CASE( "SPSC Ring Benchmark", "[.benchmark][pipeline]" ) {
+
+    const uint64_t count = 1 << 20;
+
+    BENCHMARK( "SpscRing, 2^20 handles between two threads" ) {
+        SpscRing<uint64_t> ring{ 4096 };
+        uint64_t sum = 0;
+
+        std::thread consumer{ [&]() {
+            uint64_t value;
+            for ( uint64_t n = 0; n < count; ) {
+                if ( ring.try_pop( value ) ) {
+                    sum += value;
+                    ++n;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        } };
+
+        for ( uint64_t i = 0; i < count; ++i ) {
+            while ( !ring.try_push( uint64_t{ i } ) ) std::this_thread::yield();
+        }
+
+        consumer.join();
+        return sum;
+    };
+}
+
+TEST_CASE( "Id Inclusion Benchmark", "[.benchmark][redactor][idset]" ) {
+
+    const uint32_t count = 1000000;
+    std::unordered_set<std::string> strings;
+    IdRedactor idr{ ConfigMap{ { "privacy.redaction.id.inclusions", "ON" } } };
+    IdSet ids;
+    char buffer[IdRedactor::kIdLength];
+
+    std::mt19937 rgen{ 2017 };
+    for ( uint32_t i = 0; i < count; ++i ) {
+        uint32_t v = rgen();
+        IdRedactor::FormatId( v, buffer );
+        strings.emplace( buffer, IdRedactor::kIdLength );
+        ids.insert( v );
+    }
+
+    // half the probes are included.
+    std::vector<std::string> probes;
+    for ( auto& id : strings ) {
+        if ( probes.size() == 1024 ) break;
+        probes.push_back( id );
+        IdRedactor::FormatId( rgen(), buffer );
+        probes.emplace_back( buffer, IdRedactor::kIdLength );
+    }
+
+    std::size_t next = 0;
+
+    BENCHMARK( "std::unordered_set<std::string> lookup" ) {
+        return strings.count( probes[ next++ & 1023 ] );
+    };
+
+    BENCHMARK( "Parse and IdSet lookup" ) {
+        uint32_t value;
+        IdRedactor::ParseId( probes[ next++ & 1023 ], value );
+        return ids.contains( value );
+    };
+}
+
+TEST_CASE( "Velocity Filter", "[ppm][velocity]" ) {
+
+    ConfigMap conf{ 
+        { "privacy.filter.velocity.min", "5" },
+        { "privacy.filter.velocity.max", "100" }
+    };
+    
+    // cover default constructor
+    VelocityFilter v_test;
+
+    VelocityFilter vf{ conf };
+
+    SECTION( "Using Configuration" ) {
+        CHECK( vf( 4.999 ) );
+        CHECK( vf( 100.001 ) );
+        CHECK_FALSE( vf( 10 ) );
+
+        CHECK( vf.suppress( 4.999 ) );
+        CHECK( vf.suppress( 100.001 ) );
+        CHECK_FALSE( vf.suppress( 10 ) );
+
+        CHECK( vf.retain( 5 ) );
+        CHECK( vf.retain( 100 ) );
+        CHECK( vf.retain( 10 ) );
+        CHECK_FALSE( vf.retain( 4.999 ) );
+        CHECK_FALSE( vf.retain( 100.001 ) );
+    }
+
+    SECTION( "Changing the filter's min and max" ) {
+        vf.set_min( 3.0 );
+        vf.set_max( 200.0 );
+        CHECK( vf( 2.999 ) );
+        CHECK( vf( 200.001 ) );
+        CHECK_FALSE( vf( 10 ) );
+
+        CHECK( vf.suppress( 2.999 ) );
+        CHECK( vf.suppress( 200.001 ) );
+        CHECK_FALSE( vf.suppress( 10 ) );
+
+        CHECK( vf.retain( 3 ) );
+        CHECK( vf.retain( 200 ) );
+        CHECK( vf.retain( 10 ) );
+        CHECK_FALSE( vf.retain( 2.999 ) );
+        CHECK_FALSE( vf.retain( 200.001 ) );
+    }
+}
+
+TEST_CASE( "Downsample Filter", "[ppm][downsample]" ) {
+
+    SECTION( "Configuration" ) {
+        DownsampleFilter dsf;
+        CHECK( dsf.interval() == DownsampleFilter::kDefaultInterval );
+        CHECK( dsf.uses_sec_mark() );
+
+        // the table is allocated at first use.
+        CHECK( dsf.metrics().capacity == 0 );
+        dsf.retain( "4F435445", 0, -1 );
+        CHECK( dsf.metrics().capacity >= DownsampleFilter::kDefaultVehicles );
+
+        ConfigMap conf{ { "privacy.filter.downsample.interval", "200" }, { "privacy.filter.downsample.clock", "kafka" }, { "privacy.filter.downsample.vehicles", "100" } };
+        CHECK( DownsampleFilter{ conf }.metrics().capacity == 0 );
+
+        // or at construction when enabled, so copies share it.
+        conf["privacy.filter.downsample"] = "ON";
+        DownsampleFilter configured{ conf };
+        CHECK( configured.interval() == 200 );
+        CHECK_FALSE( configured.uses_sec_mark() );
+        CHECK( configured.metrics().capacity >= 100 );
+        CHECK( configured.metrics().capacity < DownsampleFilter::kDefaultVehicles );
+
+        conf["privacy.filter.downsample.clock"] = "wallclock";
+        CHECK_THROWS_AS( DownsampleFilter{ conf }, std::invalid_argument );
+
+        // secMark wraps every minute, so it cannot measure more than half of one.
+        conf["privacy.filter.downsample.clock"] = "secmark";
+        conf["privacy.filter.downsample.interval"] = std::to_string( DownsampleFilter::kMaxSecMarkInterval );
+        CHECK( DownsampleFilter{ conf }.interval() == DownsampleFilter::kMaxSecMarkInterval );
+        conf["privacy.filter.downsample.interval"] = "60000";
+        CHECK_THROWS_AS( DownsampleFilter{ conf }, std::invalid_argument );
+        conf["privacy.filter.downsample.interval"] = "18446744073709551615";
+        CHECK_THROWS_AS( DownsampleFilter{ conf }, std::invalid_argument );
+
+        conf["privacy.filter.downsample.clock"] = "kafka";
+        conf["privacy.filter.downsample.interval"] = "60000";
+        CHECK( DownsampleFilter{ conf }.interval() == 60000 );
+    }
+
+    SECTION( "secMark Clock" ) {
+        DownsampleFilter dsf;
+
+        // a 10 Hz vehicle is reduced to 1 Hz.
+        int retained = 0;
+        for ( int sec_mark = 48000; sec_mark < 52000; sec_mark += 100 ) {
+            if ( dsf.retain( "4F435445", sec_mark, -1 ) ) ++retained;
+        }
+        CHECK( retained == 4 );
+
+        // vehicles are independent.
+        CHECK( dsf.retain( "01020304", 51950, -1 ) );
+        CHECK_FALSE( dsf.retain( "01020304", 51999, -1 ) );
+
+        // late messages are suppressed.
+        CHECK_FALSE( dsf.retain( "4F435445", 49000, -1 ) );
+
+        // elapsed time wraps with the minute.
+        CHECK( dsf.retain( "4F435445", 59800, -1 ) );
+        CHECK_FALSE( dsf.retain( "4F435445", 500, -1 ) );
+        CHECK( dsf.retain( "4F435445", 800, -1 ) );
+
+        // unavailable secMarks are retained.
+        CHECK( dsf.retain( "4F435445", 65535, -1 ) );
+        CHECK( dsf.retain( "4F435445", -1, -1 ) );
+        CHECK_FALSE( dsf.retain( "4F435445", 900, -1 ) );
+
+        CHECK( dsf.metrics().occupancy == 2 );
+    }
+
+    SECTION( "Kafka Clock" ) {
+        DownsampleFilter dsf{ ConfigMap{ { "privacy.filter.downsample.clock", "kafka" }, { "privacy.filter.downsample.interval", "500" } } };
+
+        CHECK( dsf.retain( "4F435445", 0, 1000000 ) );
+        CHECK_FALSE( dsf.retain( "4F435445", 0, 1000499 ) );
+        CHECK( dsf.retain( "4F435445", 0, 1000500 ) );
+        CHECK_FALSE( dsf.retain( "4F435445", 0, 1000100 ) );
+
+        // messages without timestamps are retained.
+        CHECK( dsf.retain( "4F435445", 0, -1 ) );
+
+        // a vehicle unseen for longer than the TTL starts over.
+        CHECK( dsf.retain( "4F435445", 0, 1000500 + DownsampleFilter::kVehicleTTL + 1 ) );
+        CHECK( dsf.metrics().expirations == 1 );
+    }
+}
+
+TEST_CASE( "Duplicate Filter", "[ppm][duplicates]" ) {
+
+    SECTION( "Configuration" ) {
+        DuplicateFilter df;
+        CHECK( df.window() == DuplicateFilter::kDefaultWindow );
+
+        // the filters are allocated at first use.
+        CHECK( df.size() == 0 );
+        CHECK( df.duplicates() == 0 );
+        CHECK_FALSE( df.duplicate( "4F435445", 48034, 11, 0 ) );
+        CHECK( df.size() * 8 >= 2 * DuplicateFilter::kDefaultCapacity * DuplicateFilter::kBitsPerBSM );
+
+        // or at construction when enabled, so copies share them.
+        DuplicateFilter configured{ ConfigMap{ { "privacy.filter.duplicates", "ON" }, { "privacy.filter.duplicates.window", "500" }, { "privacy.filter.duplicates.capacity", "1000" } } };
+        CHECK( configured.window() == 500 );
+        CHECK( configured.size() * 8 >= 2 * 1000 * DuplicateFilter::kBitsPerBSM );
+        CHECK( configured.size() < df.size() );
+    }
+
+    SECTION( "Window" ) {
+        DuplicateFilter df{ ConfigMap{ { "privacy.filter.duplicates.window", "1000" } } };
+
+        CHECK_FALSE( df.duplicate( "4F435445", 48034, 11, 10000 ) );
+        CHECK( df.duplicate( "4F435445", 48034, 11, 10001 ) );
+
+        // any differing field makes a different BSM.
+        CHECK_FALSE( df.duplicate( "4F435446", 48034, 11, 10002 ) );
+        CHECK_FALSE( df.duplicate( "4F435445", 48035, 11, 10003 ) );
+        CHECK_FALSE( df.duplicate( "4F435445", 48034, 12, 10004 ) );
+
+        // the previous filter is searched after a rotation; a duplicate refreshes the BSM.
+        CHECK( df.duplicate( "4F435445", 48034, 11, 11000 ) );
+        CHECK( df.duplicate( "4F435445", 48034, 11, 12500 ) );
+
+        // forgotten after two windows.
+        CHECK_FALSE( df.duplicate( "4F435445", 48034, 11, 14600 ) );
+
+        CHECK( df.duplicates() == 3 );
+    }
+
+    SECTION( "False Positives" ) {
+        DuplicateFilter df{ ConfigMap{ { "privacy.filter.duplicates.capacity", "10000" } } };
+        char buffer[IdRedactor::kIdLength];
+        int false_positives = 0;
+
+        for ( uint32_t v = 0; v < 10000; ++v ) {
+            IdRedactor::FormatId( v * 2654435761U, buffer );
+            if ( df.duplicate( std::string( buffer, IdRedactor::kIdLength ), v % 60000, v % 128, 0 ) ) ++false_positives;
+        }
+        CHECK( false_positives < 50 );
+
+        // every one of them is now a duplicate.
+        int duplicates = 0;
+        for ( uint32_t v = 0; v < 10000; ++v ) {
+            IdRedactor::FormatId( v * 2654435761U, buffer );
+            if ( df.duplicate( std::string( buffer, IdRedactor::kIdLength ), v % 60000, v % 128, 1 ) ) ++duplicates;
+        }
+        CHECK( duplicates == 10000 );
+    }
+}
+
+TEST_CASE( "Trip Filter", "[ppm][trip]" ) {
+
+    // about 11.1 meters per 0.0001 degrees of latitude.
+    const double step = 0.0001;
+    std::vector<std::string> released;
+
+    SECTION( "Configuration" ) {
+        TripFilter tf;
+        CHECK( tf.head_distance() == TripFilter::kDefaultHeadDistance );
+        CHECK( tf.head_duration() == 0 );
+        CHECK_FALSE( tf.trims_tail() );
+        CHECK( tf.timeout() == TripFilter::kDefaultTimeout );
+        CHECK( tf.buffer() == TripFilter::kDefaultBuffer );
+
+        // the table is allocated at first use.
+        CHECK( tf.metrics().capacity == 0 );
+        tf.apply( TripFilter::key( "4F435445" ), false, 0.0, 0.0, "", released, 0 );
+        CHECK( tf.metrics().capacity >= TripFilter::kDefaultVehicles );
+
+        // or at construction when enabled, so copies share it.
+        TripFilter configured{ ConfigMap{ { "privacy.filter.trip", "ON" },
+            { "privacy.filter.trip.head.distance", "100" }, { "privacy.filter.trip.head.duration", "5000" },
+            { "privacy.filter.trip.tail.distance", "50" }, { "privacy.filter.trip.tail.duration", "3000" },
+            { "privacy.filter.trip.timeout", "60000" }, { "privacy.filter.trip.buffer", "8" }, { "privacy.filter.trip.vehicles", "100" } } };
+        CHECK( configured.head_distance() == 100.0 );
+        CHECK( configured.head_duration() == 5000 );
+        CHECK( configured.tail_distance() == 50.0 );
+        CHECK( configured.tail_duration() == 3000 );
+        CHECK( configured.trims_tail() );
+        CHECK( configured.timeout() == 60000 );
+        CHECK( configured.buffer() == 8 );
+        CHECK( configured.metrics().capacity > 0 );
+        CHECK( configured.metrics().capacity < TripFilter::kDefaultVehicles );
+    }
+
+    SECTION( "Head" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.head.distance", "100" }, { "privacy.filter.trip.timeout", "10000" } } };
+        uint64_t key = TripFilter::key( "4F435445" );
+
+        // no position, no trip.
+        CHECK( tf.apply( key, false, 0.0, 0.0, "", released, 1000 ) == TripFilter::TRIM );
+
+        for ( int i = 0; i < 9; ++i ) {
+            CHECK( tf.apply( key, true, 39.0 + i * step, -105.0, "", released, 1000 + i * 100 ) == TripFilter::TRIM );
+        }
+        CHECK( tf.apply( key, true, 39.0 + 10 * step, -105.0, "", released, 2000 ) == TripFilter::RETAIN );
+
+        // returning to the start does not matter.
+        CHECK( tf.apply( key, true, 39.0, -105.0, "", released, 2100 ) == TripFilter::RETAIN );
+        CHECK( tf.apply( key, false, 0.0, 0.0, "", released, 2200 ) == TripFilter::RETAIN );
+
+        // vehicles are independent.
+        CHECK( tf.apply( TripFilter::key( "01020304" ), true, 39.0 + 10 * step, -105.0, "", released, 2200 ) == TripFilter::TRIM );
+
+        // a new trip starts after the timeout.
+        CHECK( tf.apply( key, true, 39.0 + 10 * step, -105.0, "", released, 12201 ) == TripFilter::TRIM );
+        CHECK( released.empty() );
+    }
+
+    SECTION( "Head Duration" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.head.distance", "0" }, { "privacy.filter.trip.head.duration", "1000" } } };
+        uint64_t key = TripFilter::key( "4F435445" );
+
+        CHECK( tf.apply( key, true, 39.0, -105.0, "", released, 1000 ) == TripFilter::TRIM );
+        CHECK( tf.apply( key, true, 39.0, -105.0, "", released, 1999 ) == TripFilter::TRIM );
+        CHECK( tf.apply( key, true, 39.0, -105.0, "", released, 2000 ) == TripFilter::RETAIN );
+    }
+
+    SECTION( "Tail" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.head.distance", "0" }, { "privacy.filter.trip.tail.distance", "30" },
+            { "privacy.filter.trip.timeout", "10000" }, { "privacy.filter.trip.buffer", "4" } } };
+        uint64_t key = TripFilter::key( "4F435445" );
+
+        // held until the vehicle is 30 m further on.
+        CHECK( tf.apply( key, true, 39.0, -105.0, "0", released, 1000 ) == TripFilter::HOLD );
+        CHECK( tf.apply( key, true, 39.0 + step, -105.0, "1", released, 1100 ) == TripFilter::HOLD );
+        CHECK( tf.apply( key, true, 39.0 + 2 * step, -105.0, "2", released, 1200 ) == TripFilter::HOLD );
+        CHECK( released.empty() );
+
+        CHECK( tf.apply( key, true, 39.0 + 3 * step, -105.0, "3", released, 1300 ) == TripFilter::HOLD );
+        REQUIRE( released.size() == 1 );
+        CHECK( released[0] == "0" );
+
+        // a full ring releases early.
+        released.clear();
+        CHECK( tf.apply( key, false, 0.0, 0.0, "4", released, 1400 ) == TripFilter::HOLD );
+        CHECK( tf.apply( key, false, 0.0, 0.0, "5", released, 1500 ) == TripFilter::HOLD );
+        REQUIRE( released.size() == 1 );
+        CHECK( released[0] == "1" );
+
+        released.clear();
+        CHECK( tf.apply( key, true, 39.0 + 6 * step, -105.0, "6", released, 1600 ) == TripFilter::HOLD );
+        CHECK( released == std::vector<std::string>{ "2", "3", "4", "5" } );
+
+        // the tail is dropped when the trip ends.
+        released.clear();
+        CHECK( tf.apply( key, true, 39.0 + 10 * step, -105.0, "7", released, 11601 ) == TripFilter::HOLD );
+        CHECK( released.empty() );
+        CHECK( tf.metrics().expirations == 1 );
+    }
+
+    SECTION( "Holds" ) {
+        TripFilter tf{ ConfigMap{ { "privacy.filter.trip.head.distance", "0" }, { "privacy.filter.trip.tail.distance", "30" },
+            { "privacy.filter.trip.timeout", "10000" } } };
+        uint64_t key = TripFilter::key( "4F435445" );
+        std::vector<TripFilter::Hold> holds;
+        std::vector<std::weak_ptr<int>> made;
+
+        TripFilter::HoldFactory make_hold = [&made]() -> TripFilter::Hold {
+            std::shared_ptr<int> hold = std::make_shared<int>( static_cast<int>( made.size() ) );
+            made.push_back( hold );
+            return hold;
+        };
+
+        // each held BSM keeps its hold; a released BSM gives it back.
+        for ( int i = 0; i < 4; ++i ) {
+            CHECK( tf.apply( key, true, 39.0 + i * step, -105.0, std::to_string( i ), released, holds, &make_hold, 1000 + i * 100 ) == TripFilter::HOLD );
+        }
+        REQUIRE( made.size() == 4 );
+        REQUIRE( released.size() == 1 );
+        REQUIRE( holds.size() == 1 );
+        CHECK( *std::static_pointer_cast<int>( holds[0] ) == 0 );
+
+        holds.clear();
+        CHECK( made[0].expired() );
+        CHECK_FALSE( made[3].expired() );
+
+        // the BSMs still held when the trip ends destroy their holds.
+        released.clear();
+        CHECK( tf.apply( key, true, 39.0 + 10 * step, -105.0, "4", released, holds, nullptr, 11301 ) == TripFilter::HOLD );
+        CHECK( released.empty() );
+        CHECK( holds.empty() );
+        CHECK( made[1].expired() );
+        CHECK( made[2].expired() );
+        CHECK( made[3].expired() );
+    }
+}
+
+TEST_CASE( "Core Prefilter", "[ppm][prefilter]" ) {
+
+    VelocityFilter vf{ ConfigMap{ { "privacy.filter.velocity.min", "5" }, { "privacy.filter.velocity.max", "30.1" } } };
+    geo::Bounds bounds{ geo::Point{ 35.951853, -83.932832 }, geo::Point{ 35.953642, -83.929975 } };
+    CorePrefilter prefilter{ vf, bounds };
+
+    // raw values around every threshold, the sentinels, and random values, in sizes that exercise the scalar tail.
+    std::vector<int32_t> speeds{ 0, 249, 250, 251, 1504, 1505, 1506, 8190, 8191, -1 };
+    std::vector<int32_t> lats{ 359518529, 359518530, 359518531, 359536419, 359536420, 359536421, 900000001, -900000000 };
+    std::vector<int32_t> lons{ -839328321, -839328320, -839328319, -839299751, -839299750, -839299749, 1800000001, 0 };
+
+    std::mt19937 rgen{ 2017 };
+    std::uniform_int_distribution<int32_t> speed_dist{ 0, 8191 };
+    std::uniform_int_distribution<int32_t> lat_dist{ 359510000, 359540000 };
+    std::uniform_int_distribution<int32_t> lon_dist{ -839340000, -839290000 };
+
+    const std::size_t n = 1003;
+    std::vector<int32_t> speed( n ), lat( n ), lon( n );
+    for ( std::size_t i = 0; i < n; ++i ) {
+        speed[i] = i < 200 ? speeds[ i % speeds.size() ] : speed_dist( rgen );
+        lat[i] = i < 200 ? lats[ ( i / 3 ) % lats.size() ] : lat_dist( rgen );
+        lon[i] = i < 200 ? lons[ ( i / 7 ) % lons.size() ] : lon_dist( rgen );
+    }
+
+    std::vector<uint8_t> result( n );
+    std::size_t kept = prefilter.apply( speed.data(), lat.data(), lon.data(), n, result.data() );
+
+    std::size_t expected_kept = 0;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        double v = speed[i] == CorePrefilter::kSpeedUnavailable ? 0.0 : speed[i] * 0.02;
+        bool outside = lat[i] == CorePrefilter::kLatitudeUnavailable || lon[i] == CorePrefilter::kLongitudeUnavailable
+            || !bounds.contains( geo::Point{ lat[i] * 1e-7, lon[i] * 1e-7 } );
+        uint8_t expected = ( vf.suppress( v ) ? CorePrefilter::kSpeed : 0 ) | ( outside ? CorePrefilter::kOutside : 0 );
+
+        CHECK( result[i] == expected );
+        expected_kept += expected == 0;
+    }
+    CHECK( kept == expected_kept );
+    CHECK( kept > 0 );
+    CHECK( kept < n );
+
+    // only the requested checks are performed.
+    CHECK( prefilter.apply( speed.data(), lat.data(), lon.data(), n, result.data(), 0 ) == n );
+    prefilter.apply( speed.data(), lat.data(), lon.data(), n, result.data(), CorePrefilter::kSpeed );
+    for ( std::size_t i = 0; i < n; ++i ) {
+        CHECK( ( result[i] & CorePrefilter::kOutside ) == 0 );
+    }
+
+    // the default prefilter keeps everything but unavailable positions.
+    CorePrefilter none;
+    CHECK( none.apply( speed.data(), lat.data(), lon.data(), 16, result.data(), CorePrefilter::kSpeed ) == 16 );
+}
+
+TEST_CASE( "Payload Registry", "[ppm][payload]" ) {
+
+    SECTION( "Built In" ) {
+        PayloadRegistry registry;
+        std::string bsm = PayloadRegistry::kBsmPayloadType;
+
+        CHECK( registry.size() == 1 );
+        const PayloadType* type = registry.find( bsm.data(), bsm.size() );
+        REQUIRE( type != nullptr );
+        CHECK( type->builtin );
+        CHECK( registry.find( bsm.data(), bsm.size() - 1 ) == nullptr );
+        CHECK( registry.find( "", 0 ) == nullptr );
+    }
+
+    SECTION( "Configured" ) {
+        ConfigMap conf{
+            { "privacy.payload.types", "us.dot.its.jpo.ode.model.OdePsmPayload, Type2,Type3,Type4,Type5,Type6" },
+            { "privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.lat", "payload.data.position.lat" },
+            { "privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.long", "payload.data.position.long" },
+            { "privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.redact", "payload.data.id, payload.data.pathHistory" }
+        };
+        for ( int t = 2; t <= 6; ++t ) {
+            conf["privacy.payload.Type" + std::to_string( t ) + ".lat"] = "lat";
+            conf["privacy.payload.Type" + std::to_string( t ) + ".long"] = "long";
+        }
+
+        PayloadRegistry registry{ conf };
+        CHECK( registry.size() == 7 );
+
+        std::string psm = "us.dot.its.jpo.ode.model.OdePsmPayload";
+        const PayloadType* type = registry.find( psm.data(), psm.size() );
+        REQUIRE( type != nullptr );
+        CHECK_FALSE( type->builtin );
+        CHECK( type->latitude == PayloadType::Path{ "payload", "data", "position", "lat" } );
+        CHECK( type->longitude == PayloadType::Path{ "payload", "data", "position", "long" } );
+        CHECK( type->units == PayloadType::Units::J2735 );
+        CHECK( type->redactions == std::vector<std::string>{ "payload.data.id", "payload.data.pathHistory" } );
+
+        // all remain reachable as the table grows.
+        for ( int t = 2; t <= 6; ++t ) {
+            std::string name = "Type" + std::to_string( t );
+            REQUIRE( registry.find( name.data(), name.size() ) != nullptr );
+            CHECK( registry.find( name.data(), name.size() )->name == name );
+        }
+        std::string bsm = PayloadRegistry::kBsmPayloadType;
+        CHECK( registry.find( bsm.data(), bsm.size() ) != nullptr );
+
+        CHECK_THROWS_AS( registry.add( PayloadType{ "Type2", false, {}, {}, PayloadType::Units::J2735, {} } ), std::invalid_argument );
+
+        conf["privacy.payload.Type5.units"] = "DEGREES";
+        CHECK( PayloadRegistry{ conf }.find( "Type5", 5 )->units == PayloadType::Units::DEGREES );
+
+        conf["privacy.payload.Type5.units"] = "radians";
+        CHECK_THROWS_AS( PayloadRegistry{ conf }, std::invalid_argument );
+
+        conf.erase( "privacy.payload.Type5.units" );
+        conf.erase( "privacy.payload.Type6.long" );
+        CHECK_THROWS_AS( PayloadRegistry{ conf }, std::invalid_argument );
+    }
+}
+
+TEST_CASE( "Output Partitioner", "[ppm][partitioner]" ) {
+
+    SECTION( "Geohash" ) {
+        CHECK( OutputPartitioner::geohash( 57.64911, 10.40744, 11 ) == "u4pruydqqvj" );
+        CHECK( OutputPartitioner::geohash( 35.9494, -83.9272, 1 ) == "d" );
+
+        // a cell is the prefix of the cells within it.
+        std::string cell = OutputPartitioner::geohash( 35.9494, -83.9272, 8 );
+        CHECK( OutputPartitioner::geohash( 35.9494, -83.9272, 5 ) == cell.substr( 0, 5 ) );
+    }
+
+    SECTION( "Jump Consistent Hash" ) {
+        const int32_t partitions = 12;
+        const int keys = 24000;
+        std::vector<int> counts( partitions, 0 );
+        int moved = 0;
+        int misplaced = 0;
+
+        for ( int k = 0; k < keys; ++k ) {
+            std::string key = "id" + std::to_string( k );
+            int32_t p = OutputPartitioner::partition( key, partitions );
+            if ( p < 0 || p >= partitions ) {
+                FAIL( "partition out of range: " << p );
+            }
+            ++counts[p];
+
+            // adding a partition only moves keys to it.
+            int32_t q = OutputPartitioner::partition( key, partitions + 1 );
+            moved += q != p;
+            misplaced += q != p && q != partitions;
+        }
+
+        CHECK( misplaced == 0 );
+
+        for ( int c : counts ) {
+            CHECK( c > keys / partitions * 9 / 10 );
+            CHECK( c < keys / partitions * 11 / 10 );
+        }
+        CHECK( moved > keys / ( partitions + 1 ) * 9 / 10 );
+        CHECK( moved < keys / ( partitions + 1 ) * 11 / 10 );
+
+        CHECK( OutputPartitioner::jump( 0, 1 ) == 0 );
+    }
+
+    SECTION( "Keys" ) {
+        BSM bsm;
+        bsm.set_id( "ABCD1234" );
+
+        CHECK( OutputPartitioner{}.get_key() == OutputPartitioner::Key::NONE );
+        CHECK( OutputPartitioner{}.key( bsm ).empty() );
+
+        OutputPartitioner by_id{ ConfigMap{ { "privacy.output.key", "ID" } } };
+        CHECK( by_id.key( bsm ) == "ABCD1234" );
+
+        OutputPartitioner by_cell{ ConfigMap{ { "privacy.output.key", "GEOHASH" }, { "privacy.output.key.geohash.precision", "6" } } };
+        CHECK( by_cell.key( bsm ).empty() );
+        bsm.set_latitude( 35.9494 );
+        bsm.set_longitude( -83.9272 );
+        CHECK( by_cell.key( bsm ) == OutputPartitioner::geohash( 35.9494, -83.9272, 6 ) );
+
+        // unkeyed messages go round-robin; keyed messages to their partition.
+        std::string key = "ABCD1234";
+        CHECK( by_id.partitioner_cb( nullptr, nullptr, 3, nullptr ) == 0 );
+        CHECK( by_id.partitioner_cb( nullptr, nullptr, 3, nullptr ) == 1 );
+        CHECK( by_id.partitioner_cb( nullptr, &key, 3, nullptr ) == OutputPartitioner::partition( key, 3 ) );
+
+        CHECK_THROWS_AS( OutputPartitioner( ConfigMap{ { "privacy.output.key", "VIN" } } ), std::invalid_argument );
+        CHECK_THROWS_AS( OutputPartitioner( ConfigMap{ { "privacy.output.key.geohash.precision", "13" } } ), std::invalid_argument );
+    }
+}
+
+TEST_CASE( "Load Shedder", "[ppm][shed]" ) {
+
+    const int64_t now = 1700000000000;
+    bool changed = false;
+
+    SECTION( "Disabled" ) {
+        LoadShedder shedder;
+        CHECK_FALSE( shedder.enabled() );
+        CHECK( shedder.admit( now - 3600000, 1000000, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK_FALSE( changed );
+        CHECK_FALSE( shedder.degraded() );
+    }
+
+    SECTION( "Age" ) {
+        LoadShedder shedder{ ConfigMap{ { "privacy.shed", "ON" }, { "privacy.shed.age", "10000" }, { "privacy.shed.lag", "0" } } };
+        REQUIRE( shedder.enabled() );
+
+        CHECK( shedder.admit( now - 9000, 5000000, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK_FALSE( changed );
+
+        // an old backlog is shed before parsing.
+        CHECK( shedder.admit( now - 60000, -1, now, changed ) == LoadShedder::Decision::AGE );
+        CHECK( changed );
+        CHECK( shedder.degraded() );
+
+        // degraded until the age is below half the threshold.
+        changed = false;
+        CHECK( shedder.admit( now - 8000, -1, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK_FALSE( changed );
+        CHECK( shedder.degraded() );
+        CHECK( shedder.admit( now - 4000, -1, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK( changed );
+        CHECK_FALSE( shedder.degraded() );
+
+        // an unknown age neither starts nor ends the degraded mode.
+        changed = false;
+        CHECK( shedder.admit( -1, -1, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK_FALSE( changed );
+
+        auto metrics = shedder.metrics();
+        CHECK( metrics.aged == 1 );
+        CHECK( metrics.sampled == 0 );
+        CHECK( metrics.degradations == 1 );
+        CHECK_FALSE( metrics.degraded );
+    }
+
+    SECTION( "Lag and Sampling" ) {
+        LoadShedder shedder{ ConfigMap{ { "privacy.shed", "ON" }, { "privacy.shed.lag", "1000" }, { "privacy.shed.drop.age", "0" }, { "privacy.shed.keep", "4" } } };
+
+        int processed = 0;
+        for ( int i = 0; i < 100; ++i ) {
+            processed += shedder.admit( now - 3600000, 5000, now, changed ) == LoadShedder::Decision::PROCESS;
+        }
+        CHECK( changed );
+        CHECK( processed == 25 );
+        CHECK( shedder.metrics().sampled == 75 );
+        CHECK( shedder.metrics().aged == 0 );
+
+        // the lag must fall below half the threshold.
+        CHECK( shedder.admit( now, 600, now, changed ) != LoadShedder::Decision::AGE );
+        CHECK( shedder.degraded() );
+        CHECK( shedder.admit( now, 400, now, changed ) == LoadShedder::Decision::PROCESS );
+        CHECK_FALSE( shedder.degraded() );
+    }
+
+    SECTION( "Configuration" ) {
+        CHECK_THROWS_AS( LoadShedder( ConfigMap{ { "privacy.shed.keep", "0" } } ), std::invalid_argument );
+        CHECK_THROWS( LoadShedder( ConfigMap{ { "privacy.shed.age", "soon" } } ) );
+    }
+
+    SECTION( "Handler" ) {
+        ConfigMap pconf;
+        REQUIRE( buildBaseConfiguration( pconf ) );
+        BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+        handler.shed();
+        CHECK( handler.get_result() == BSMHandler::ResultStatus::SHED );
+        CHECK( handler.get_result_string() == "shed" );
+        CHECK( handler.get_released().empty() );
+    }
+}
+
+TEST_CASE( "Dead Letter Queue", "[ppm][deadletter]" ) {
+
+    auto letter = []( int64_t offset ) {
+        return DeadLetterQueue::Letter{ "{\"bad\"", "parse", "topic.OdeBsmJson", 3, offset, -1 };
+    };
+
+    SECTION( "Disabled" ) {
+        DeadLetterQueue queue;
+        CHECK_FALSE( queue.enabled() );
+        CHECK_FALSE( queue.due( 0 ) );
+    }
+
+    SECTION( "Routes" ) {
+        CHECK( DeadLetterQueue::routes( BSMHandler::ResultStatus::PARSE ) );
+        CHECK( DeadLetterQueue::routes( BSMHandler::ResultStatus::MISSING ) );
+        CHECK( DeadLetterQueue::routes( BSMHandler::ResultStatus::OTHER ) );
+        CHECK_FALSE( DeadLetterQueue::routes( BSMHandler::ResultStatus::SPEED ) );
+        CHECK_FALSE( DeadLetterQueue::routes( BSMHandler::ResultStatus::GEOPOSITION ) );
+        CHECK_FALSE( DeadLetterQueue::routes( BSMHandler::ResultStatus::SUCCESS ) );
+    }
+
+    SECTION( "Batches" ) {
+        DeadLetterQueue queue{ ConfigMap{ { "privacy.deadletter.topic", "topic.OdeBsmDeadLetter" }, { "privacy.deadletter.batch", "3" }, { "privacy.deadletter.linger.ms", "500" }, { "privacy.deadletter.capacity", "5" } } };
+        REQUIRE( queue.enabled() );
+        CHECK( queue.topic() == "topic.OdeBsmDeadLetter" );
+
+        // due when full or lingered.
+        CHECK_FALSE( queue.add( letter( 10 ), 1000 ) );
+        CHECK_FALSE( queue.add( letter( 11 ), 1100 ) );
+        CHECK_FALSE( queue.due( 1499 ) );
+        CHECK( queue.due( 1500 ) );
+        CHECK( queue.add( letter( 12 ), 1200 ) );
+
+        // bounded; the excess is dropped.
+        CHECK( queue.add( letter( 13 ), 1200 ) );
+        CHECK( queue.add( letter( 14 ), 1200 ) );
+        CHECK( queue.add( letter( 15 ), 1200 ) );
+
+        auto batch = queue.take();
+        REQUIRE( batch.size() == 3 );
+        CHECK( batch[0].offset == 10 );
+        CHECK( batch[2].offset == 12 );
+        CHECK( batch[0].partition == 3 );
+        CHECK( batch[0].reason == "parse" );
+
+        // the rest are older than the linger.
+        CHECK( queue.due( 1500 ) );
+        batch = queue.take();
+        REQUIRE( batch.size() == 2 );
+        CHECK( batch[1].offset == 14 );
+        CHECK_FALSE( queue.due( 1000000 ) );
+        CHECK( queue.take().empty() );
+
+        queue.delivered( 4, 1 );
+        auto metrics = queue.metrics();
+        CHECK( metrics.queued == 5 );
+        CHECK( metrics.dropped == 1 );
+        CHECK( metrics.produced == 4 );
+        CHECK( metrics.failed == 1 );
+    }
+
+    SECTION( "Configuration" ) {
+        CHECK_THROWS_AS( DeadLetterQueue( ConfigMap{ { "privacy.deadletter.batch", "0" } } ), std::invalid_argument );
+        CHECK_THROWS_AS( DeadLetterQueue( ConfigMap{ { "privacy.deadletter.capacity", "0" } } ), std::invalid_argument );
+        CHECK_THROWS( DeadLetterQueue( ConfigMap{ { "privacy.deadletter.linger.ms", "later" } } ) );
+    }
+}
+
+TEST_CASE( "Delivery Tracker", "[ppm][delivery]" ) {
+
+    DeliveryTracker tracker;
+    DeliveryTracker::Source& source = tracker.source( "topic.OdeBsmJson", 3 );
+
+    CHECK( &tracker.source( "topic.OdeBsmJson", 3 ) == &source );
+    CHECK( &tracker.source( "topic.OdeBsmJson", 4 ) != &source );
+    CHECK( &tracker.source( "topic.OdePsmJson", 3 ) != &source );
+    CHECK( source.topic() == "topic.OdeBsmJson" );
+    CHECK( source.partition() == 3 );
+
+    // nothing processed.
+    CHECK( tracker.committable( source ) < 0 );
+
+    // 10 is suppressed; 11 publishes a released and a retained BSM; 12 publishes one.
+    tracker.processed( source, 10 );
+    CHECK( tracker.committable( source ) == 11 );
+
+    DeliveryTracker::Delivery* released = tracker.produced( source, 11 );
+    DeliveryTracker::Delivery* retained = tracker.produced( source, 11 );
+    tracker.processed( source, 11 );
+    DeliveryTracker::Delivery* later = tracker.produced( source, 12 );
+    tracker.processed( source, 12 );
+
+    CHECK( tracker.undelivered( source ) == 3 );
+    CHECK( tracker.committable( source ) == 11 );
+
+    // out of order delivery commits nothing past the oldest undelivered BSM.
+    tracker.delivered( later, true );
+    tracker.delivered( released, true );
+    CHECK( tracker.committable( source ) == 11 );
+
+    tracker.delivered( retained, true );
+    CHECK( tracker.undelivered( source ) == 0 );
+    CHECK( tracker.committable( source ) == 13 );
+
+    // a failed delivery stays outstanding.
+    tracker.delivered( tracker.produced( source, 13 ), false );
+    tracker.processed( source, 13 );
+    tracker.processed( source, 14 );
+    CHECK( tracker.undelivered( source ) == 1 );
+    CHECK( tracker.committable( source ) == 13 );
+
+    // a revoked partition commits nothing new until it is processed again, and forgets its failed deliveries.
+    DeliveryTracker::Source& other = tracker.source( "topic.OdeBsmJson", 4 );
+    tracker.processed( other, 100 );
+    CHECK( tracker.reset( other ) == 0 );
+    CHECK( tracker.committable( other ) < 0 );
+
+    DeliveryTracker::Delivery* stale = tracker.produced( source, 14 );
+    CHECK( tracker.reset( source ) == 2 );
+    CHECK( tracker.undelivered( source ) == 0 );
+    CHECK( tracker.committable( source ) < 0 );
+
+    // once assigned again, a report from before the revocation does not settle the new BSM of the same offset.
+    DeliveryTracker::Delivery* again = tracker.produced( source, 14 );
+    tracker.processed( source, 14 );
+    tracker.delivered( stale, true );
+    CHECK( tracker.committable( source ) == 14 );
+    tracker.delivered( again, true );
+    CHECK( tracker.committable( source ) == 15 );
+
+    SECTION( "Holds" ) {
+        // 15 is held; 16 publishes its own BSM and releases the held one at the held offset.
+        std::shared_ptr<DeliveryTracker::Hold> hold = tracker.hold( source, 15 );
+        tracker.processed( source, 15 );
+        CHECK( hold->offset() == 15 );
+        CHECK( &hold->source() == &source );
+        CHECK( tracker.committable( source ) == 15 );
+
+        DeliveryTracker::Delivery* current = tracker.produced( source, 16 );
+        DeliveryTracker::Delivery* held = tracker.produced( hold->source(), hold->offset() );
+        tracker.processed( source, 16 );
+        hold.reset();
+        tracker.delivered( current, true );
+        CHECK( tracker.committable( source ) == 15 );
+        tracker.delivered( held, true );
+        CHECK( tracker.committable( source ) == 17 );
+
+        // a dropped hold settles its offset, unless processing has stopped.
+        tracker.hold( source, 17 );
+        tracker.processed( source, 17 );
+        CHECK( tracker.committable( source ) == 18 );
+
+        hold = tracker.hold( source, 18 );
+        tracker.processed( source, 18 );
+        tracker.freeze_holds();
+        hold.reset();
+        CHECK( tracker.committable( source ) == 18 );
+
+        // a restarted loop settles the holds it drops.
+        tracker.thaw_holds();
+        DeliveryTracker::Source& other = tracker.source( "topic.OdeBsmJson", 1 );
+        hold = tracker.hold( other, 19 );
+        tracker.processed( other, 19 );
+        CHECK( tracker.committable( other ) == 19 );
+        hold.reset();
+        CHECK( tracker.committable( other ) == 20 );
+    }
+}
+
+TEST_CASE( "Decision Audit", "[ppm][audit]" ) {
+
+    SECTION( "Defaults" ) {
+        DecisionAudit audit;
+        CHECK( audit.log_decisions() );
+        CHECK_FALSE( audit.headers_enabled() );
+        CHECK_FALSE( audit.audit_enabled() );
+    }
+
+    SECTION( "Sampling" ) {
+        DecisionAudit audit{ ConfigMap{ { "privacy.log.decisions", "OFF" }, { "privacy.output.headers", "ON" }, { "privacy.audit.topic", "topic.PpmAudit" }, { "privacy.audit.sample", "10" } } };
+        CHECK_FALSE( audit.log_decisions() );
+        CHECK( audit.headers_enabled() );
+        REQUIRE( audit.audit_enabled() );
+        CHECK( audit.topic() == "topic.PpmAudit" );
+
+        uint64_t represents = 0;
+        int speed = 0;
+        int geoposition = 0;
+        for ( int i = 0; i < 100; ++i ) {
+            speed += audit.sample( BSMHandler::ResultStatus::SPEED, represents );
+        }
+        for ( int i = 0; i < 5; ++i ) {
+            geoposition += audit.sample( BSMHandler::ResultStatus::GEOPOSITION, represents );
+        }
+
+        // each result is sampled on its own; the first is always recorded.
+        CHECK( speed == 10 );
+        CHECK( geoposition == 1 );
+        CHECK( represents == 10 );
+    }
+
+    SECTION( "Headers and Records" ) {
+        DecisionAudit audit;
+        audit.set_build( "0.1", "00000000deadbeef", 0x9 );
+
+        const auto& headers = audit.headers();
+        REQUIRE( headers.size() == 3 );
+        CHECK( headers[0] == std::make_pair( std::string{ "ppm.version" }, std::string{ "0.1" } ) );
+        CHECK( headers[1].second == "00000000deadbeef" );
+        CHECK( headers[2].second == "00000009" );
+
+        CHECK( DecisionAudit::record( "speed", "topic.OdeBsmJson", 2, 42, -1, 100 ) == "{\"result\":\"speed\",\"topic\":\"topic.OdeBsmJson\",\"partition\":2,\"offset\":42,\"timestamp\":-1,\"represents\":100}" );
+
+        rapidjson::Document d;
+        CHECK_FALSE( d.Parse( DecisionAudit::record( "parse", "t", 0, 1, 1700000000000, 1 ).c_str() ).HasParseError() );
+    }
+
+    SECTION( "Map Hash" ) {
+        std::istringstream empty{ "" };
+        std::istringstream a{ "a" };
+        std::istringstream map1{ "circle,1,39.0,-84.0,10\n" };
+        std::istringstream map2{ "circle,1,39.0,-84.0,11\n" };
+
+        // the FNV-1a offset basis and the published hash of "a".
+        CHECK( DecisionAudit::hash( empty ) == "cbf29ce484222325" );
+        CHECK( DecisionAudit::hash( a ) == "af63dc4c8601ec8c" );
+        CHECK( DecisionAudit::hash( map1 ) != DecisionAudit::hash( map2 ) );
+    }
+
+    SECTION( "Configuration" ) {
+        CHECK_THROWS_AS( DecisionAudit( ConfigMap{ { "privacy.audit.sample", "0" } } ), std::invalid_argument );
+    }
+}
+
+TEST_CASE( "Load Profile", "[ppm][loadgen]" ) {
+
+    SECTION( "Constant" ) {
+        LoadProfile profile{ "constant:1000:10" };
+        CHECK( profile.get_shape() == LoadProfile::Shape::CONSTANT );
+        CHECK( profile.total() == 10000 );
+        CHECK( profile.due( 0.5 ) == 500 );
+        CHECK( profile.rate_at( 3.0 ) == Approx( 1000.0 ) );
+        CHECK( profile.rate_at( 10.0 ) == Approx( 0.0 ) );
+
+        // message n is due once n + 1 messages are.
+        CHECK( profile.time_of( 0 ) == Approx( 0.001 ).margin( 1e-6 ) );
+        CHECK( profile.time_of( 999 ) == Approx( 1.0 ).margin( 1e-6 ) );
+    }
+
+    SECTION( "Ramp" ) {
+        LoadProfile profile{ "ramp:0:200:10" };
+        CHECK( profile.get_shape() == LoadProfile::Shape::RAMP );
+        CHECK( profile.total() == 1000 );
+        CHECK( profile.due( 5.0 ) == 250 );
+        CHECK( profile.rate_at( 5.0 ) == Approx( 100.0 ) );
+
+        // the gaps shrink as the rate climbs.
+        CHECK( profile.time_of( 1 ) - profile.time_of( 0 ) > profile.time_of( 999 ) - profile.time_of( 998 ) );
+    }
+
+    SECTION( "Burst" ) {
+        LoadProfile profile{ "burst:100:1000:1000:200:10" };
+        CHECK( profile.get_shape() == LoadProfile::Shape::BURST );
+        CHECK( profile.rate_at( 0.1 ) == Approx( 1000.0 ) );
+        CHECK( profile.rate_at( 0.5 ) == Approx( 100.0 ) );
+        CHECK( profile.rate_at( 1.1 ) == Approx( 1000.0 ) );
+
+        // 200 in each burst and 80 between.
+        CHECK( profile.due( 0.2 ) == 200 );
+        CHECK( profile.due( 1.0 ) == 280 );
+        CHECK( profile.total() == 2800 );
+    }
+
+    SECTION( "Open Loop Schedule" ) {
+        LoadProfile profile{ "burst:50:500:2000:500:6" };
+        bool ordered = true;
+        bool consistent = true;
+
+        for ( uint64_t n = 0; n < profile.total(); ++n ) {
+            double t = profile.time_of( n );
+            ordered = ordered && ( n == 0 || t >= profile.time_of( n - 1 ) );
+            consistent = consistent && profile.due( t ) > n && profile.due( t - 1e-6 ) <= n;
+        }
+
+        CHECK( ordered );
+        CHECK( consistent );
+    }
+
+    SECTION( "Specification" ) {
+        CHECK_THROWS_AS( LoadProfile( "square:1:2" ), std::invalid_argument );
+        CHECK_THROWS_AS( LoadProfile( "constant:1000" ), std::invalid_argument );
+        CHECK_THROWS_AS( LoadProfile( "constant:-5:10" ), std::invalid_argument );
+        CHECK_THROWS_AS( LoadProfile( "burst:1:2:0:0:10" ), std::invalid_argument );
+        CHECK_THROWS_AS( LoadProfile( "ramp:1:2:0" ), std::invalid_argument );
+        CHECK_THROWS( LoadProfile( "ramp:a:b:c" ) );
+    }
+}
+
+TEST_CASE( "BSM Synthesizer", "[ppm][loadgen]" ) {
+
+    std::vector<std::string> templates;
+    std::ifstream ifs{ "unit-test-data/test-case.all.good.json" };
+    std::string line;
+    while ( std::getline( ifs, line ) ) {
+        templates.push_back( line );
+    }
+    templates.push_back( "{\"not\":\"a BSM\"}" );
+    templates.push_back( "not JSON" );
+
+    BsmSynthesizer synthesize{ templates, 10 };
+    REQUIRE( synthesize.size() == templates.size() - 2 );
+
+    std::string bsm = synthesize( 123 );
+    CHECK( BsmSynthesizer::serial( bsm ) == 123 );
+    CHECK( BsmSynthesizer::serial( "{}" ) == -1 );
+    CHECK( BsmSynthesizer::serial( "not JSON" ) == -1 );
+
+    // vehicle 3, sending its 13th BSM.
+    rapidjson::Document d;
+    REQUIRE_FALSE( d.Parse( bsm.c_str() ).HasParseError() );
+    const auto& core = d["payload"]["data"]["value"]["BasicSafetyMessage"]["coreData"];
+    CHECK( std::string{ core["id"].GetString() } == "00000003" );
+    CHECK( synthesize.id( 123 ) == "00000003" );
+    CHECK( core["msgCnt"].GetUint() == 12 );
+    CHECK( core["secMark"].GetUint() == 1200 );
+
+    // the synthetic BSMs are processed as the templates are.
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) );
+    BSMHandler synthetic{ buildTestQuadTree(), pconf, testLogger };
+    BSMHandler original{ buildTestQuadTree(), pconf, testLogger };
+    CHECK( synthetic.process( synthesize( 0 ) ) == original.process( templates[0] ) );
+    CHECK( synthetic.get_result() == original.get_result() );
+}
+
+TEST_CASE( "SPSC Ring", "[ppm][pipeline]" ) {
+
+    SECTION( "Capacity" ) {
+        CHECK( SpscRing<int>{ 0 }.capacity() == 2 );
+        CHECK( SpscRing<int>{ 5 }.capacity() == 8 );
+        CHECK( SpscRing<int>{ 4096 }.capacity() == 4096 );
+    }
+
+    SECTION( "Single Thread" ) {
+        SpscRing<int> ring{ 4 };
+        int value = -1;
+
+        CHECK_FALSE( ring.try_pop( value ) );
+        for ( int i = 0; i < 4; ++i ) {
+            CHECK( ring.try_push( int{ i } ) );
+        }
+        CHECK_FALSE( ring.try_push( 4 ) );
+        CHECK( ring.size() == 4 );
+
+        // wraps around in order.
+        for ( int i = 0; i < 10; ++i ) {
+            REQUIRE( ring.try_pop( value ) );
+            CHECK( value == i );
+            CHECK( ring.try_push( i + 4 ) );
+        }
+        CHECK( ring.size() == 4 );
+    }
+
+    SECTION( "Handles" ) {
+        SpscRing<std::unique_ptr<std::string>> ring{ 2 };
+        std::unique_ptr<std::string> value;
+
+        CHECK( ring.try_push( std::unique_ptr<std::string>{ new std::string{ "bsm" } } ) );
+        REQUIRE( ring.try_pop( value ) );
+        REQUIRE( value );
+        CHECK( *value == "bsm" );
+    }
+
+    SECTION( "Two Threads" ) {
+        const uint64_t count = 200000;
+        SpscRing<uint64_t> ring{ 64 };
+        uint64_t out_of_order = 0;
+
+        std::thread consumer{ [&]() {
+            uint64_t value;
+            for ( uint64_t expected = 1; expected <= count; ) {
+                if ( !ring.try_pop( value ) ) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                out_of_order += value != expected;
+                expected = value + 1;
+            }
+        } };
+
+        for ( uint64_t i = 1; i <= count; ++i ) {
+            while ( !ring.try_push( uint64_t{ i } ) ) std::this_thread::yield();
+        }
+
+        consumer.join();
+        CHECK( out_of_order == 0 );
+        CHECK( ring.size() == 0 );
+    }
+}
+
+TEST_CASE( "BSM Checks", "[ppm][bsm]" ) {
+
+    BSM bsm;
+
+    SECTION( "Default Construction" ) {
+        CHECK( bsm.lat == 90.0 );
+        CHECK( bsm.lon == 180.0 );
+        CHECK( bsm.get_velocity() == -1.0 );
+        CHECK( bsm.get_secmark() == 0 );
+        CHECK( bsm.get_id() == "" );
+        CHECK( bsm.get_original_id() == "" );
+    }
+
+    SECTION( "Change and Reset" ) {
+
+        bsm.set_latitude( 22.0 );
+        CHECK( bsm.lat == 22.0 );
+        bsm.set_longitude( 22.0 );
+        CHECK( bsm.lon == 22.0 );
+        bsm.set_id( "XXX" );
+        CHECK( bsm.get_id() == "XXX" );
+        bsm.set_original_id( "YYY" );
+        CHECK( bsm.get_original_id() == "YYY" );
+        bsm.set_velocity( 456 );
+        CHECK( bsm.get_velocity() == 456.0 );
+        bsm.set_secmark( 123 );
+        CHECK( bsm.get_secmark() == 123 );
+        CHECK( bsm.logString() == "(XXX,123,22.000000,22.000000,456.000000)" );
+
+        SECTION( "Reset" ) {
+            bsm.reset();
+            CHECK( bsm.lat == 90.0 );
+            CHECK( bsm.lon == 180.0 );
+            CHECK( bsm.get_velocity() == -1.0 );
+            CHECK( bsm.get_id() == "" );
+            CHECK( bsm.get_secmark() == 0 );
+            CHECK( bsm.get_original_id() == "");
+        }
+    }
+}
+
+TEST_CASE( "BSMHandler Checks", "[ppm][handler]" ) {
+// designed to NOT trigger the quadtree code; we just checking basic functions of
+// state process within the BSMHandler.
+
+    ConfigMap pconf;
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    BSMHandler handler{ nullptr, pconf, testLogger };
+
+    // FOR EACH SECTION THE TEST CASE IS EXECUTED FROM THE START.
 
     SECTION( "Handler Instantiation" ) {
         CHECK( handler.get_result_string() == "success" );
@@ -1153,6 +3216,11 @@ TEST_CASE( "BSMHandler Checks", "[ppm][handler]" ) {
         CHECK( handler.is_active<BSMHandler::kIdRedactFlag>() );
         CHECK( handler.is_active<BSMHandler::kGeneralRedactFlag>() );
         CHECK( handler.get_json() == "" ); // there was a comment here about json being null when empty, but it appears to be "", not null
+
+        // the disabled stateful filters allocate nothing.
+        CHECK( handler.get_downsample_filter().metrics().capacity == 0 );
+        CHECK( handler.get_duplicate_filter().size() == 0 );
+        CHECK( handler.get_trip_filter().metrics().capacity == 0 );
     };
 
     SECTION( "Check Flag Setting" ) {
@@ -1178,6 +3246,216 @@ TEST_CASE( "BSMHandler Checks", "[ppm][handler]" ) {
 
         CHECK( handler.get_activation_flag() == 0 );
     }
+
+    SECTION( "Vehicle Key" ) {
+        std::string a = "{\"payload\":{\"data\":{\"coreData\":{\"msgCnt\":1,\"id\":\"31325433\",\"secMark\":1}}}}";
+        std::string b = "{\"metadata\":{\"id\":\"x\"},\"coreData\":{\"id\" : \"31325433\"}}";
+        std::string c = "{\"coreData\":{\"id\":\"31325434\"}}";
+        uint64_t ka = 0, kb = 0, kc = 0;
+
+        REQUIRE( BSMHandler::vehicle_key( a.data(), a.size(), ka ) );
+        REQUIRE( BSMHandler::vehicle_key( b.data(), b.size(), kb ) );
+        REQUIRE( BSMHandler::vehicle_key( c.data(), c.size(), kc ) );
+        CHECK( ka == kb );
+        CHECK( ka != kc );
+
+        std::string psm = "{\"payload\":{\"data\":{\"id\":\"01020304\"}}}";
+        CHECK_FALSE( BSMHandler::vehicle_key( psm.data(), psm.size(), ka ) );
+        CHECK_FALSE( BSMHandler::vehicle_key( c.data(), c.size() - 6, ka ) );
+    }
+}
+
+TEST_CASE( "BSMHandler Pipeline Selection", "[ppm][filtering][pipeline]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    std::vector<std::string> speed_cases;
+    std::vector<std::string> outside_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.bad.speed.json", speed_cases ) );
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.outside.geofence.json", outside_cases ) );
+    REQUIRE( speed_cases.size() > 0 );
+    REQUIRE( outside_cases.size() > 0 );
+
+    // every combination of the velocity and geofence filters with and without the redaction stages.
+    for ( uint32_t combination = 0; combination < 32; ++combination ) {
+        if ( combination & 0x1 ) handler.activate<BSMHandler::kVelocityFilterFlag>(); else handler.deactivate<BSMHandler::kVelocityFilterFlag>();
+        if ( combination & 0x2 ) handler.activate<BSMHandler::kGeofenceFilterFlag>(); else handler.deactivate<BSMHandler::kGeofenceFilterFlag>();
+        if ( combination & 0x4 ) handler.activate<BSMHandler::kIdRedactFlag>(); else handler.deactivate<BSMHandler::kIdRedactFlag>();
+        if ( combination & 0x8 ) handler.activate<BSMHandler::kSizeRedactFlag>(); else handler.deactivate<BSMHandler::kSizeRedactFlag>();
+        if ( combination & 0x10 ) handler.activate<BSMHandler::kGeneralRedactFlag>(); else handler.deactivate<BSMHandler::kGeneralRedactFlag>();
+
+        bool velocity = combination & 0x1;
+        bool geofence = combination & 0x2;
+
+        handler.process( speed_cases[0] );
+        CHECK( ( handler.get_result() == BSMHandler::ResultStatus::SPEED ) == velocity );
+
+        handler.process( outside_cases[0] );
+        CHECK( ( handler.get_result() == BSMHandler::ResultStatus::GEOPOSITION ) == geofence );
+    }
+}
+
+TEST_CASE( "BSMHandler Prefilter", "[ppm][filtering][prefilter]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    // inside; too slow; outside the quad; unavailable speed and position.
+    std::vector<int32_t> speed{ 1000, 10, 1000, 8191 };
+    std::vector<int32_t> lat{ 359525000, 359525000, 359600000, 900000001 };
+    std::vector<int32_t> lon{ -839310000, -839310000, -839310000, 1800000001 };
+    std::vector<uint8_t> result( 4 );
+
+    CHECK( handler.prefilter( speed.data(), lat.data(), lon.data(), 4, result.data() ) == 1 );
+    CHECK( result == std::vector<uint8_t>{ 0, CorePrefilter::kSpeed, CorePrefilter::kOutside, CorePrefilter::kSpeed | CorePrefilter::kOutside } );
+
+
+    SECTION( "Raw core fields" ) {
+        std::string a = "{\"payload\":{\"data\":{\"value\":{\"BasicSafetyMessage\":{\"coreData\":{\"id\":\"31325433\",\"lat\":359525000,\"long\" : -839310000,\"accelSet\":{\"lat\":1,\"long\":2},\"speed\":1000}}}}}}";
+        int32_t s = 0, la = 0, lo = 0;
+
+        REQUIRE( BSMHandler::core_fields( a.data(), a.size(), s, la, lo ) );
+        CHECK( s == 1000 );
+        CHECK( la == 359525000 );
+        CHECK( lo == -839310000 );
+
+        // a member of a nested object, a missing member, or a non-integer is not found; such BSMs are processed.
+        std::string nested = "{\"BasicSafetyMessage\":{\"coreData\":{\"lat\":1,\"long\":2,\"size\":{\"speed\":3}}}}";
+        std::string fraction = "{\"BasicSafetyMessage\":{\"coreData\":{\"lat\":1,\"long\":2,\"speed\":3.5}}}";
+        std::string psm = "{\"payload\":{\"data\":{\"coreData\":{\"lat\":1,\"long\":2,\"speed\":3}}}}";
+        CHECK_FALSE( BSMHandler::core_fields( nested.data(), nested.size(), s, la, lo ) );
+        CHECK_FALSE( BSMHandler::core_fields( fraction.data(), fraction.size(), s, la, lo ) );
+        CHECK_FALSE( BSMHandler::core_fields( psm.data(), psm.size(), s, la, lo ) );
+        CHECK_FALSE( BSMHandler::core_fields( a.data(), a.size() - 10, s, la, lo ) );
+    }
+
+    SECTION( "Agrees with process" ) {
+        std::vector<std::string> cases;
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.bad.speed.json", cases ) );
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.outside.geofence.json", cases ) );
+        std::size_t suppressed = 0;
+
+        for ( auto& bsm : cases ) {
+            int32_t s = 0, la = 0, lo = 0;
+            uint8_t r = 0;
+
+            if ( !BSMHandler::core_fields( bsm.data(), bsm.size(), s, la, lo ) ) continue;
+
+            // a BSM the prefilter suppresses is suppressed by process for the same reason.
+            if ( handler.prefilter( &s, &la, &lo, 1, &r ) == 0 ) {
+                CHECK_FALSE( handler.process( bsm ) );
+                BSMHandler::ResultStatus expected = handler.get_result();
+                CHECK_FALSE( handler.process( bsm, -1, r ) );
+                CHECK( handler.get_result() == expected );
+                CHECK( expected == ( ( r & CorePrefilter::kSpeed ) ? BSMHandler::ResultStatus::SPEED : BSMHandler::ResultStatus::GEOPOSITION ) );
+                ++suppressed;
+            }
+        }
+
+        CHECK( suppressed > 0 );
+    }
+
+    SECTION( "Bad metadata" ) {
+        std::vector<std::string> cases;
+        REQUIRE ( loadTestCases( "unit-test-data/test-case.bad.speed.json", cases ) );
+        DeadLetterQueue queue{ ConfigMap{ { "privacy.deadletter.topic", "topic.OdeBsmDeadLetter" } } };
+
+        // slow BSMs whose metadata or document is broken, as a worker or lane takes them from its ring.
+        const std::string& slow = cases[0];
+        std::vector<std::pair<std::string, BSMHandler::ResultStatus>> broken{
+            { std::regex_replace( slow, std::regex( "\"metadata\"" ), "\"metadatum\"" ), BSMHandler::ResultStatus::MISSING },
+            { std::regex_replace( slow, std::regex( "\"sanitized\":false" ), "\"sanitized\":0" ), BSMHandler::ResultStatus::OTHER },
+            { std::regex_replace( slow, std::regex( "OdeMessageFramePayload" ), "OdeUnknownPayload" ), BSMHandler::ResultStatus::MISSING },
+            { slow.substr( 0, slow.size() - 1 ), BSMHandler::ResultStatus::PARSE }
+        };
+
+        for ( auto& bad : broken ) {
+            int32_t s = 0, la = 0, lo = 0;
+            uint8_t r = 0;
+
+            REQUIRE( BSMHandler::core_fields( bad.first.data(), bad.first.size(), s, la, lo ) );
+            REQUIRE( handler.prefilter( &s, &la, &lo, 1, &r ) == 0 );
+            CHECK( ( r & CorePrefilter::kSpeed ) );
+
+            CHECK_FALSE( handler.process( bad.first, -1, r ) );
+            CHECK( handler.get_result() == bad.second );
+            REQUIRE( DeadLetterQueue::routes( handler.get_result() ) );
+            queue.add( DeadLetterQueue::Letter{ bad.first, handler.get_result_string(), "topic.OdeBsmJson", 0, 0, -1 }, 0 );
+        }
+
+        CHECK( queue.metrics().queued == broken.size() );
+    }
+
+    handler.deactivate<BSMHandler::kVelocityFilterFlag>();
+    CHECK( handler.prefilter( speed.data(), lat.data(), lon.data(), 4, result.data() ) == 2 );
+
+    handler.deactivate<BSMHandler::kGeofenceFilterFlag>();
+    CHECK( handler.prefilter( speed.data(), lat.data(), lon.data(), 4, result.data() ) == 4 );
+}
+
+TEST_CASE( "BSMHandler JSON Other Payload Types", "[ppm][filtering][payload]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    pconf["privacy.payload.types"] = "us.dot.its.jpo.ode.model.OdePsmPayload";
+    pconf["privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.lat"] = "payload.data.position.lat";
+    pconf["privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.long"] = "payload.data.position.long";
+    pconf["privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.redact"] = "payload.data.id";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    CHECK( handler.get_payload_registry().size() == 2 );
+
+    auto psm = []( const std::string& lat, const std::string& lon ) {
+        return "{\"metadata\":{\"payloadType\":\"us.dot.its.jpo.ode.model.OdePsmPayload\",\"sanitized\":false},"
+            "\"payload\":{\"data\":{\"id\":\"01020304\",\"position\":{\"lat\":" + lat + ",\"long\":" + lon + "}}}}";
+    };
+
+    CHECK( handler.process( psm( "359491100", "-839283430" ) ) );
+    CHECK( handler.get_result_string() == "success" );
+    CHECK( handler.get_json().find( "01020304" ) == std::string::npos );
+    CHECK( handler.get_json().find( "\"sanitized\":true" ) != std::string::npos );
+
+    CHECK_FALSE( handler.process( psm( "607801842", "-509407226" ) ) );
+    CHECK( handler.get_result_string() == "geoposition" );
+
+    CHECK_FALSE( handler.process( psm( "900000001", "-839283430" ) ) );
+    CHECK( handler.get_result_string() == "geoposition" );
+
+    CHECK_FALSE( handler.process( psm( "\"north\"", "-839283430" ) ) );
+    CHECK( handler.get_result_string() == "other" );
+
+    std::string missing = psm( "359491100", "-839283430" );
+    missing.replace( missing.find( "position" ), 8, "location" );
+    CHECK_FALSE( handler.process( missing ) );
+    CHECK( handler.get_result_string() == "missing" );
+
+    // the geofence filter applies to every type; types not registered are unsupported.
+    handler.deactivate<BSMHandler::kGeofenceFilterFlag>();
+    CHECK( handler.process( psm( "607801842", "-509407226" ) ) );
+
+    std::string unknown = psm( "359491100", "-839283430" );
+    unknown.replace( unknown.find( "OdePsmPayload" ), 13, "OdeTimPayload" );
+    CHECK_FALSE( handler.process( unknown ) );
+    CHECK( handler.get_result_string() == "missing" );
+
+    // a type whose position is in degrees.
+    pconf["privacy.payload.us.dot.its.jpo.ode.model.OdePsmPayload.units"] = "DEGREES";
+    BSMHandler degrees{ buildTestQuadTree(), pconf, testLogger };
+
+    CHECK( degrees.process( psm( "35.94911", "-83.928343" ) ) );
+    CHECK( degrees.get_result_string() == "success" );
+
+    CHECK_FALSE( degrees.process( psm( "60.7801842", "-50.9407226" ) ) );
+    CHECK( degrees.get_result_string() == "geoposition" );
+
+    CHECK_FALSE( degrees.process( psm( "\"north\"", "-83.928343" ) ) );
+    CHECK( degrees.get_result_string() == "other" );
 }
 
 TEST_CASE( "BSMHandler JSON Malformed Parsing", "[ppm][filtering][parsing]" ) {
@@ -1361,6 +3639,164 @@ TEST_CASE( "BSMHandler JSON Speed Only Filtering", "[ppm][filtering][speedonly]"
     }
 }
 
+TEST_CASE( "BSMHandler JSON Downsampling", "[ppm][filtering][downsample]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    pconf["privacy.filter.downsample"] = "ON";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    REQUIRE( handler.is_active<BSMHandler::kDownsampleFlag>() );
+    CHECK( handler.get_downsample_filter().metrics().capacity > 0 );
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( json_test_cases.size() > 0 );
+
+    std::string bsm = json_test_cases[0];
+    std::string later = bsm;
+    std::size_t pos = later.find( "\"secMark\":48034" );
+    REQUIRE( pos != std::string::npos );
+    later.replace( pos, 15, "\"secMark\":49034" );
+
+    CHECK( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "success" );
+
+    CHECK_FALSE( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "downsampled" );
+
+    CHECK( handler.process( later ) );
+    CHECK( handler.get_result_string() == "success" );
+
+    // a copy shares the state until it owns its own; only the enabled filters allocate it.
+    BSMHandler shared{ handler };
+    CHECK_FALSE( shared.process( later ) );
+
+    BSMHandler owned{ handler };
+    owned.own_state();
+    CHECK( owned.get_downsample_filter().metrics().capacity > 0 );
+    CHECK( owned.get_duplicate_filter().size() == 0 );
+    CHECK( owned.get_trip_filter().metrics().capacity == 0 );
+    CHECK( owned.process( later ) );
+    CHECK_FALSE( handler.process( later ) );
+
+    handler.deactivate<BSMHandler::kDownsampleFlag>();
+    CHECK( handler.process( later ) );
+    CHECK( handler.get_result_string() == "success" );
+}
+
+TEST_CASE( "BSMHandler JSON Duplicate Suppression", "[ppm][filtering][duplicates]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    pconf["privacy.filter.duplicates"] = "ON";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    REQUIRE( handler.is_active<BSMHandler::kDuplicateFlag>() );
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( json_test_cases.size() > 0 );
+
+    std::string bsm = json_test_cases[0];
+    std::string later = bsm;
+    std::size_t pos = later.find( "\"secMark\":48034" );
+    REQUIRE( pos != std::string::npos );
+    later.replace( pos, 15, "\"secMark\":48134" );
+
+    CHECK( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "success" );
+
+    CHECK_FALSE( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "duplicate" );
+
+    CHECK( handler.process( later ) );
+    CHECK( handler.get_result_string() == "success" );
+    CHECK( handler.get_duplicate_filter().duplicates() == 1 );
+
+    // copies, e.g., the pipeline workers, share the BSMs seen.
+    BSMHandler worker{ handler };
+    CHECK_FALSE( worker.process( later ) );
+    CHECK( worker.get_result_string() == "duplicate" );
+    CHECK( handler.get_duplicate_filter().duplicates() == 2 );
+
+    handler.deactivate<BSMHandler::kDuplicateFlag>();
+    CHECK( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "success" );
+}
+
+TEST_CASE( "BSMHandler JSON Trip Trimming", "[ppm][filtering][trip]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    pconf["privacy.filter.trip"] = "ON";
+    pconf["privacy.filter.trip.head.distance"] = "50";
+    pconf["privacy.filter.geofence"] = "OFF";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    REQUIRE( handler.is_active<BSMHandler::kTripFlag>() );
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( json_test_cases.size() > 0 );
+
+    std::string bsm = json_test_cases[0];
+    std::string start = bsm;
+    std::size_t pos = start.find( "\"lat\":" );
+    REQUIRE( pos != std::string::npos );
+    std::size_t end = start.find( ',', pos );
+    int lat = std::stoi( start.substr( pos + 6, end - pos - 6 ) );
+
+    // 100 m south.
+    start.replace( pos, end - pos, "\"lat\":" + std::to_string( lat - 9000 ) );
+
+    CHECK_FALSE( handler.process( start ) );
+    CHECK( handler.get_result_string() == "trimmed" );
+
+    CHECK( handler.process( bsm ) );
+    CHECK( handler.get_result_string() == "success" );
+    CHECK( handler.get_released().empty() );
+
+    // the trip is kept by original id.
+    BSMHandler redacting{ buildTestQuadTree(), pconf, testLogger };
+    redacting.activate<BSMHandler::kIdRedactFlag>();
+    CHECK_FALSE( redacting.process( start ) );
+    CHECK( redacting.get_result_string() == "trimmed" );
+    CHECK( redacting.process( bsm ) );
+}
+
+TEST_CASE( "BSMHandler JSON Trip Tail Trimming", "[ppm][filtering][trip]" ) {
+
+    ConfigMap pconf;
+
+    REQUIRE( buildBaseConfiguration( pconf ) ); 
+    pconf["privacy.filter.trip"] = "ON";
+    pconf["privacy.filter.trip.head.distance"] = "0";
+    pconf["privacy.filter.trip.tail.duration"] = "60000";
+    pconf["privacy.filter.trip.buffer"] = "1";
+    BSMHandler handler{ buildTestQuadTree(), pconf, testLogger };
+
+    std::vector<std::string> json_test_cases;
+    REQUIRE ( loadTestCases( "unit-test-data/test-case.all.good.json", json_test_cases ) );
+    REQUIRE( json_test_cases.size() > 0 );
+
+    CHECK_FALSE( handler.process( json_test_cases[0] ) );
+    CHECK( handler.get_result_string() == "held" );
+    std::string held = handler.get_json();
+
+    // the full ring releases the redacted BSM.
+    CHECK_FALSE( handler.process( json_test_cases[0] ) );
+    CHECK( handler.get_result_string() == "held" );
+    REQUIRE( handler.get_released().size() == 1 );
+    CHECK( handler.get_released()[0] == held );
+
+    CHECK_FALSE( handler.process( "{" ) );
+    CHECK( handler.get_released().empty() );
+}
+
 TEST_CASE( "BSMHandler JSON Geofence Only Filtering", "[ppm][filtering][geofenceonly]" ) {
 
     ConfigMap pconf;
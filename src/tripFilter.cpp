@@ -0,0 +1,203 @@
+#include <chrono>
+
+#include "tripFilter.hpp"
+#include "entity.hpp"
+
+constexpr double TripFilter::kDefaultHeadDistance;
+constexpr uint64_t TripFilter::kDefaultTimeout;
+constexpr std::size_t TripFilter::kDefaultBuffer;
+constexpr std::size_t TripFilter::kDefaultVehicles;
+
+TripFilter::TripFilter() :
+    head_distance_{ kDefaultHeadDistance },
+    head_duration_{ 0 },
+    tail_distance_{ 0.0 },
+    tail_duration_{ 0 },
+    timeout_{ kDefaultTimeout },
+    buffer_{ kDefaultBuffer },
+    capacity_{ kDefaultVehicles },
+    last_sweep_{ 0 },
+    trips_{}
+{}
+
+TripFilter::TripFilter( const ConfigMap& conf ) :
+    TripFilter{}
+{
+    auto search = conf.find("privacy.filter.trip.head.distance");
+    if ( search != conf.end() ) {
+        head_distance_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.head.duration");
+    if ( search != conf.end() ) {
+        head_duration_ = std::stoull( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.tail.distance");
+    if ( search != conf.end() ) {
+        tail_distance_ = std::stod( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.tail.duration");
+    if ( search != conf.end() ) {
+        tail_duration_ = std::stoull( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.timeout");
+    if ( search != conf.end() ) {
+        timeout_ = std::stoull( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.buffer");
+    if ( search != conf.end() ) {
+        buffer_ = std::stoul( search->second );
+    }
+
+    search = conf.find("privacy.filter.trip.vehicles");
+    if ( search != conf.end() ) {
+        capacity_ = std::stoul( search->second );
+    }
+
+    // allocated now so the handlers copied from this one share the table.
+    search = conf.find("privacy.filter.trip");
+    if ( search != conf.end() && search->second == "ON" ) {
+        trips();
+    }
+}
+
+TripFilter::Table& TripFilter::trips()
+{
+    if ( !trips_ ) {
+        trips_ = std::make_shared<Table>( capacity_, timeout_ );
+    }
+    return *trips_;
+}
+
+uint64_t TripFilter::key( const std::string& id )
+{
+    return Table::key( id );
+}
+
+TripFilter::Disposition TripFilter::apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released )
+{
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() );
+    return apply( key, has_position, lat, lon, json, released, static_cast<uint64_t>( now.count() ) );
+}
+
+TripFilter::Disposition TripFilter::apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, uint64_t now )
+{
+    std::vector<Hold> released_holds;
+    return apply( key, has_position, lat, lon, json, released, released_holds, nullptr, now );
+}
+
+TripFilter::Disposition TripFilter::apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, std::vector<Hold>& released_holds, const HoldFactory* make_hold )
+{
+    auto now = std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now().time_since_epoch() );
+    return apply( key, has_position, lat, lon, json, released, released_holds, make_hold, static_cast<uint64_t>( now.count() ) );
+}
+
+TripFilter::Disposition TripFilter::apply( uint64_t key, bool has_position, double lat, double lon, const std::string& json, std::vector<std::string>& released, std::vector<Hold>& released_holds, const HoldFactory* make_hold, uint64_t now )
+{
+    Table& trips = this->trips();
+
+    // free the held BSMs of ended trips that are not otherwise reused.
+    if ( now >= last_sweep_ + timeout_ ) {
+        last_sweep_ = now;
+        trips.expire( now );
+    }
+
+    return trips.update( key, now, [&]( Trip& trip, bool ) {
+        if ( !trip.started ) {
+            if ( !has_position ) return TRIM;
+
+            trip.started = true;
+            trip.lat = lat;
+            trip.lon = lon;
+            trip.start = now;
+        }
+
+        if ( !trip.past_head ) {
+            if ( !has_position || now < trip.start + head_duration_ || geo::Location::distance( trip.lat, trip.lon, lat, lon ) < head_distance_ ) {
+                return TRIM;
+            }
+            trip.past_head = true;
+        }
+
+        if ( !trims_tail() ) return RETAIN;
+
+        // a BSM without a position is held at the latest known position.
+        if ( has_position ) {
+            trip.lat = lat;
+            trip.lon = lon;
+        }
+
+        while ( !trip.pending.empty() ) {
+            Pending& oldest = trip.pending.front();
+            if ( now < oldest.time + tail_duration_ || geo::Location::distance( oldest.lat, oldest.lon, trip.lat, trip.lon ) < tail_distance_ ) {
+                break;
+            }
+            released.push_back( std::move( oldest.json ) );
+            released_holds.push_back( std::move( oldest.hold ) );
+            trip.pending.pop_front();
+        }
+
+        if ( trip.pending.size() >= buffer_ && !trip.pending.empty() ) {
+            released.push_back( std::move( trip.pending.front().json ) );
+            released_holds.push_back( std::move( trip.pending.front().hold ) );
+            trip.pending.pop_front();
+        }
+
+        if ( buffer_ == 0 ) return RETAIN;
+
+        trip.pending.push_back( Pending{ json, trip.lat, trip.lon, now, make_hold ? (*make_hold)() : Hold{} } );
+        return HOLD;
+    } );
+}
+
+bool TripFilter::trims_tail() const
+{
+    return tail_distance_ > 0.0 || tail_duration_ > 0;
+}
+
+double TripFilter::head_distance() const
+{
+    return head_distance_;
+}
+
+uint64_t TripFilter::head_duration() const
+{
+    return head_duration_;
+}
+
+double TripFilter::tail_distance() const
+{
+    return tail_distance_;
+}
+
+uint64_t TripFilter::tail_duration() const
+{
+    return tail_duration_;
+}
+
+uint64_t TripFilter::timeout() const
+{
+    return timeout_;
+}
+
+std::size_t TripFilter::buffer() const
+{
+    return buffer_;
+}
+
+void TripFilter::detach()
+{
+    if ( trips_ ) {
+        trips_.reset();
+        trips();
+    }
+}
+
+TripFilter::Table::Metrics TripFilter::metrics() const
+{
+    return trips_ ? trips_->metrics() : Table::Metrics{ 0, 0, 0, 0, 0 };
+}
@@ -27,6 +27,14 @@ void VelocityFilter::set_max( double v ) {
     max_ = v;
 }
 
+double VelocityFilter::get_min() const {
+    return min_;
+}
+
+double VelocityFilter::get_max() const {
+    return max_;
+}
+
 bool VelocityFilter::operator()( double v ) {
     // true = filter it!
     return v < min_ || v > max_;